@@ -1,53 +1,107 @@
 # This is pytho script to draw graph
+import os
+
+import numpy as np
 import matplotlib
 import matplotlib.pyplot as plt
 
+MAGIC = b'NS3TRCOL'
+HEADER_SIZE = 64
+RECORD = np.dtype([('t', '<i8'), ('v', '<f8')])
 
-# queue, RTT, gradient
-if __name__ == '__main__':
-    val = input("Enter your txt file to draw: ")
-    file1 = open(val, 'r')
-    G = []
-    Q = []
-    R = []
-    T_G = []
-    T_Q = []
-    T_R = []
-    checked_1 = 1
-    checked_2 = 1
-    for eachl in file1:
-        if eachl[0] == '~' or checked_1 == 1:
-            checked_1 = 0
-            continue
-        if checked_2 == 1:
-            checked_2 = 0
-            continue
-        data = eachl.split(',')
-        if data[0] == 'G':
-            G.append(float(data[1]))
-            T_G.append(int(data[2]))
-        if data[0] == 'Q':
-            Q.append(float(data[1]))
-            T_Q.append(int(data[2]))
-        if data[0] == 'RTT':
-            R.append(float(data[1]))
-            T_R.append(int(data[2]))
-
-    plt.plot(T_G, G, label='Normalized gradient vs Time')
-    plt.title("Normalized gradient vs Time")
-    plt.xlabel("Time in microsecond")
-    plt.ylabel("RTT in microsecond")
-    plt.show()
+# points kept per series for plotting
+PLOT_POINTS = 4000
 
-    plt.plot(T_R, R, label='RTT vs Time')
-    plt.title("RTT vs Time")
-    plt.xlabel("Time in microsecond")
-    plt.ylabel("RTT in microsecond")
-    plt.show()
 
-    plt.plot(T_Q, Q, label='Number of packets in queue vs Time')
-    plt.title("Number of packets in queue vs Time")
+# one series file written by ns3::BinaryTraceWriter
+# returns (name, memory-mapped record array with fields t (ns) and v)
+def map_series(path):
+    header = np.fromfile(path, dtype=np.uint8, count=HEADER_SIZE).tobytes()
+    if header[:8] != MAGIC:
+        raise ValueError(path + ' is not a trace series')
+    version, header_size, record_size, bom = np.frombuffer(header, dtype='<u4', count=4, offset=8)
+    if bom != 0x01020304:
+        raise ValueError(path + ' was written with a different byte order')
+    if record_size != RECORD.itemsize:
+        raise ValueError(path + ' has an unknown record size')
+    count = int(np.frombuffer(header, dtype='<u8', count=1, offset=24)[0])
+    if count == 0:
+        # run stopped before Close: trust the file size
+        count = (os.path.getsize(path) - header_size) // record_size
+    name = header[32:64].split(b'\0', 1)[0].decode()
+    if count == 0:
+        return name, np.zeros(0, dtype=RECORD)
+    return name, np.memmap(path, dtype=RECORD, mode='r', offset=header_size, shape=(count,))
+
+
+# trace directory of scratch/test --trace_dir=...
+# returns {series name: record array}
+def read_trace(directory):
+    series = {}
+    for f in sorted(os.listdir(directory)):
+        if f.endswith('.bin'):
+            name, records = map_series(os.path.join(directory, f))
+            series[name] = records
+    return series
+
+
+# legacy text output of scratch/test redirected to a file
+def read_text(path):
+    rows = {'G': [], 'Q': [], 'RTT': []}
+    with open(path, 'r') as file1:
+        for eachl in file1:
+            data = eachl.strip().split(',')
+            if len(data) != 3 or data[0] not in rows:
+                continue
+            # text outputs are in microsecond
+            rows[data[0]].append((int(data[2]) * 1000, float(data[1])))
+    return {name: np.array(r, dtype=RECORD) for name, r in rows.items()}
+
+
+# min/max decimation: keeps every spike while bounding the number of points
+# returns (times in microsecond, values)
+def downsample(records, points=PLOT_POINTS):
+    t = records['t']
+    v = records['v']
+    n = len(v)
+    buckets = max(points // 2, 1)
+    if n <= points:
+        return np.asarray(t) / 1000.0, np.asarray(v)
+    width = n // buckets
+    n = width * buckets
+    tb = np.asarray(t[:n]).reshape(buckets, width)
+    vb = np.asarray(v[:n]).reshape(buckets, width)
+    lo = vb.argmin(axis=1)
+    hi = vb.argmax(axis=1)
+    rows = np.arange(buckets)
+    first = np.minimum(lo, hi)
+    second = np.maximum(lo, hi)
+    times = np.stack([tb[rows, first], tb[rows, second]], axis=1).ravel()
+    values = np.stack([vb[rows, first], vb[rows, second]], axis=1).ravel()
+    if n < len(v):
+        # tail shorter than a bucket
+        tt = np.asarray(t[n:])
+        tv = np.asarray(v[n:])
+        ends = sorted({int(tv.argmin()), int(tv.argmax())})
+        times = np.concatenate([times, tt[ends]])
+        values = np.concatenate([values, tv[ends]])
+    return times / 1000.0, values
+
+
+def plot(records, title, ylabel):
+    x, y = downsample(records)
+    plt.plot(x, y, label=title)
+    plt.title(title)
     plt.xlabel("Time in microsecond")
-    plt.ylabel("Packets number")
+    plt.ylabel(ylabel)
     plt.show()
 
+
+# queue, RTT, gradient
+if __name__ == '__main__':
+    val = input("Enter your trace directory (or legacy txt file) to draw: ")
+    series = read_trace(val) if os.path.isdir(val) else read_text(val)
+
+    plot(series['G'], "Normalized gradient vs Time", "Normalized gradient")
+    plot(series['RTT'], "RTT vs Time", "RTT in microsecond")
+    plot(series['Q'], "Number of packets in queue vs Time", "Packets number")
@@ -0,0 +1,268 @@
+# Parameter sweep driver for scratch/test
+#
+# Runs every configuration of a grid (or N random draws) as independent
+# scratch/test processes, one per local core, each with its own RngRun, and
+# collects the summary lines printed at the end of a run into one table.
+#
+# Example, the EWMA weight x HAI counter study on 3 seeds:
+#   python3 sweep.py --ns3 ~/ns-allinone-3.33/ns-3.33 \
+#       --param Alpha=0.2,0.4,0.6,0.8 --param HAI=1,5,10 --seeds 3 --out alpha_hai.csv
+#
+# Random search, 50 draws:
+#   python3 sweep.py --ns3 ... --random 50 --param Alpha=0.1:0.9 --param Hth=2000:8000 \
+#       --param incast=5,10,15 --out random.parquet
+import argparse
+import concurrent.futures
+import csv
+import glob
+import itertools
+import os
+import random
+import re
+import subprocess
+import sys
+import threading
+import time
+
+# parameters scratch/test takes as its own options; scratch/test sets the
+# matching ns3::TCPCCTIMELY defaults itself, so they must not be passed as
+# --ns3::TCPCCTIMELY::X (that value would be overwritten)
+TEST_OPTIONS = {
+    'congestion': 'congestion',
+    'bandwidth': 'bandwitdh',
+    'bandwitdh': 'bandwitdh',
+    'incast': 'incast',
+    'queue_size': 'queue_size',
+    'duration': 'duration',
+    'Alpha': 'Alpha',
+    'AI': 'AI',
+    'MD': 'MD',
+    'Hth': 'Hth',
+    'Lth': 'Lth',
+    'HAI': 'HAI',
+    'N_hai': 'HAI',
+    'initial_rate': 'initial_rate',
+    'chunk': 'chunk',
+    'CompletionEventBytes': 'chunk',
+    'paced': 'paced',
+    'precise_rtt': 'precise_rtt',
+    'aligned_tx': 'aligned_tx',
+    'SegmentAligned': 'aligned_tx',
+    'rtt_per_segment': 'rtt_per_segment',
+    'RttPerSegment': 'rtt_per_segment',
+    'ack_coalesce': 'ack_coalesce',
+    'RxCoalesceBytes': 'ack_coalesce',
+    'tso': 'tso',
+    'TsoMaxSize': 'tso',
+    'checksum': 'checksum',
+    'ChecksumEnabled': 'checksum',
+    'timer_wheel': 'timer_wheel',
+    'TimerWheel': 'timer_wheel',
+    'batch_sent': 'batch_sent',
+    'BatchDataSent': 'batch_sent',
+}
+
+# summary lines printed by scratch/test -> table columns
+SUMMARY = [
+    ('p99_rtt_us', re.compile(r'^99-percentile RTT: (\S+)')),
+    ('median_rtt_us', re.compile(r'^Median RTT: (\S+)')),
+    ('avg_rtt_us', re.compile(r'^Average RTT: (\S+)')),
+    ('avg_queue_pkts', re.compile(r'^AVG queue occupancy: (\S+)')),
+    ('throughput_mbps', re.compile(r'^AVG Throughput: ([^M\s]+)')),
+]
+QUANTILES = re.compile(r'^All flows RTT p50/p90/p99/p99.9: (\S+) / (\S+) / (\S+) / (\S+)')
+QUANTILE_COLUMNS = ['p50_rtt_us', 'p90_rtt_us', 'p99_rtt_us', 'p999_rtt_us']
+
+STATUS_COLUMNS = ['run', 'rng_run', 'status', 'attempts', 'wall_s']
+METRIC_COLUMNS = ['p50_rtt_us', 'median_rtt_us', 'p90_rtt_us', 'p99_rtt_us', 'p999_rtt_us',
+                  'avg_rtt_us', 'avg_queue_pkts', 'throughput_mbps']
+
+
+# name=v1,v2,v3 (choices) or name=lo:hi (uniform range, random search only)
+def parse_param(text):
+    if '=' not in text:
+        raise argparse.ArgumentTypeError('expected name=values, got ' + text)
+    name, values = text.split('=', 1)
+    if ':' in values and ',' not in values:
+        lo, hi = values.split(':', 1)
+        return name, ('range', lo, hi)
+    return name, ('choice', values.split(','))
+
+
+def is_int(text):
+    return re.match(r'^-?\d+$', text) is not None
+
+
+def draw(spec, rng):
+    if spec[0] == 'choice':
+        return rng.choice(spec[1])
+    lo, hi = spec[1], spec[2]
+    if is_int(lo) and is_int(hi):
+        return str(rng.randint(int(lo), int(hi)))
+    return '%g' % rng.uniform(float(lo), float(hi))
+
+
+def configurations(params, samples, seed):
+    names = [name for name, _ in params]
+    if samples == 0:
+        for name, spec in params:
+            if spec[0] != 'choice':
+                raise SystemExit('range ' + name + ' needs --random')
+        for values in itertools.product(*[spec[1] for _, spec in params]):
+            yield dict(zip(names, values))
+    else:
+        rng = random.Random(seed)
+        for _ in range(samples):
+            yield {name: draw(spec, rng) for name, spec in params}
+
+
+def command_line(binary, config, rng_run):
+    args = [binary, '--trace=false', '--RngRun=%d' % rng_run]
+    for name, value in config.items():
+        if name in TEST_OPTIONS:
+            args.append('--%s=%s' % (TEST_OPTIONS[name], value))
+        elif name.startswith('ns3::'):
+            args.append('--%s=%s' % (name, value))
+        else:
+            # any other TIMELY attribute, e.g. CwndGain, RateUnit
+            args.append('--ns3::TCPCCTIMELY::%s=%s' % (name, value))
+    return args
+
+
+def parse_summary(output):
+    metrics = {}
+    for line in output.splitlines():
+        line = line.strip()
+        for column, pattern in SUMMARY:
+            m = pattern.match(line)
+            if m:
+                metrics[column] = m.group(1)
+        m = QUANTILES.match(line)
+        if m:
+            metrics.update(zip(QUANTILE_COLUMNS, m.groups()))
+    return metrics
+
+
+# the built scratch/test of an ns-3.33 tree, e.g. build/scratch/ns3.33-test-debug
+def find_binary(ns3):
+    found = sorted(glob.glob(os.path.join(ns3, 'build', 'scratch', '*test-*')))
+    found = [f for f in found if os.path.basename(f).split('-')[0].startswith('ns3') and os.access(f, os.X_OK)]
+    if not found:
+        raise SystemExit('no built scratch/test in ' + ns3 + '/build/scratch, run ./waf first')
+    return found[0]
+
+
+def run_one(args, env, timeout, retries):
+    start = time.time()
+    status = 'failed'
+    metrics = {}
+    attempt = 0
+    for attempt in range(1, retries + 2):
+        try:
+            proc = subprocess.run(args, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                  timeout=timeout, universal_newlines=True)
+        except subprocess.TimeoutExpired:
+            status = 'timeout'
+            continue
+        metrics = parse_summary(proc.stdout)
+        if proc.returncode == 0 and 'throughput_mbps' in metrics:
+            status = 'ok'
+            break
+        status = 'failed'
+        sys.stderr.write('run failed (exit %d): %s\n%s\n' % (proc.returncode, ' '.join(args),
+                                                           '\n'.join(proc.stdout.splitlines()[-5:])))
+    return status, attempt, time.time() - start, metrics
+
+
+class Table:
+    # rows are appended to the CSV as runs finish, so an interrupted sweep
+    # keeps its results; Parquet is written once at the end
+    def __init__(self, path, columns):
+        self.path = path
+        self.columns = columns
+        self.rows = []
+        self.lock = threading.Lock()
+        self.parquet = path.endswith('.parquet')
+        self.file = None
+        if not self.parquet:
+            self.file = open(path, 'w', newline='')
+            self.writer = csv.DictWriter(self.file, fieldnames=columns)
+            self.writer.writeheader()
+
+    def add(self, row):
+        with self.lock:
+            self.rows.append(row)
+            if self.file:
+                self.writer.writerow(row)
+                self.file.flush()
+
+    def close(self):
+        if self.file:
+            self.file.close()
+            return
+        import pandas
+        frame = pandas.DataFrame(sorted(self.rows, key=lambda r: r['run']), columns=self.columns)
+        for column in METRIC_COLUMNS + ['wall_s']:
+            frame[column] = pandas.to_numeric(frame[column], errors='coerce')
+        frame.to_parquet(self.path, index=False)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Parameter sweep over scratch/test')
+    parser.add_argument('--ns3', default='.', help='ns-3.33 directory holding the built scratch/test')
+    parser.add_argument('--binary', help='scratch/test executable (default: found under --ns3)')
+    parser.add_argument('--param', action='append', type=parse_param, default=[],
+                        help='name=v1,v2,... or name=lo:hi; names are scratch/test options '
+                             '(Alpha, HAI, bandwidth, incast, queue_size, ...) or TCPCCTIMELY attributes')
+    parser.add_argument('--random', type=int, default=0, help='random search with this many draws instead of the grid')
+    parser.add_argument('--seeds', type=int, default=1, help='runs per configuration, each with its own RngRun')
+    parser.add_argument('--rng_base', type=int, default=1, help='RngRun of the first run')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count() or 1, help='parallel processes')
+    parser.add_argument('--timeout', type=float, default=3600, help='seconds before a run is killed')
+    parser.add_argument('--retries', type=int, default=2, help='retries of a failed or timed out run')
+    parser.add_argument('--out', default='sweep.csv', help='result table, .csv or .parquet')
+    parser.add_argument('--dry_run', action='store_true', help='print the command lines only')
+    opts = parser.parse_args()
+
+    binary = opts.binary or find_binary(opts.ns3)
+    env = dict(os.environ)
+    libdir = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(binary))), 'lib')
+    env['LD_LIBRARY_PATH'] = libdir + os.pathsep + env.get('LD_LIBRARY_PATH', '')
+
+    names = [name for name, _ in opts.param]
+    runs = []
+    for config in configurations(opts.param, opts.random, opts.rng_base):
+        for _ in range(opts.seeds):
+            rng_run = opts.rng_base + len(runs)
+            runs.append((len(runs), rng_run, config))
+
+    if opts.dry_run:
+        for _, rng_run, config in runs:
+            print(' '.join(command_line(binary, config, rng_run)))
+        return
+
+    table = Table(opts.out, STATUS_COLUMNS + names + METRIC_COLUMNS)
+    done = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=opts.jobs) as pool:
+        futures = {}
+        for index, rng_run, config in runs:
+            future = pool.submit(run_one, command_line(binary, config, rng_run), env, opts.timeout, opts.retries)
+            futures[future] = (index, rng_run, config)
+        for future in concurrent.futures.as_completed(futures):
+            index, rng_run, config = futures[future]
+            status, attempts, wall, metrics = future.result()
+            row = {'run': index, 'rng_run': rng_run, 'status': status, 'attempts': attempts,
+                   'wall_s': '%.1f' % wall}
+            row.update(config)
+            row.update(metrics)
+            table.add(row)
+            done += 1
+            print('[%d/%d] run %d %s %s' % (done, len(runs), index, status,
+                                            ' '.join('%s=%s' % kv for kv in config.items())))
+    table.close()
+    failed = sum(1 for r in table.rows if r['status'] != 'ok')
+    print('%d runs, %d failed, results in %s' % (len(runs), failed, opts.out))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/data-rate.h"
+#include "ns3/mac48-address.h"
+#include "ns3/simple-net-device.h"
+#include "ns3/simple-channel.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/arp-cache.h"
+
+#include "incast-star-helper.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("IncastStarHelper");
+
+IncastStarHelper::IncastStarHelper (uint32_t numSenders)
+  : m_numSenders (numSenders),
+    m_bottleneckRate (0),
+    m_mtu (1500)
+{
+  m_deviceFactory.SetTypeId ("ns3::SimpleNetDevice");
+  m_channelFactory.SetTypeId ("ns3::SimpleChannel");
+  m_switchFactory.SetTypeId ("ns3::OutputQueuedSwitch");
+}
+
+void
+IncastStarHelper::SetDeviceAttribute (std::string name, const AttributeValue &value)
+{
+  m_deviceFactory.Set (name, value);
+}
+
+void
+IncastStarHelper::SetChannelAttribute (std::string name, const AttributeValue &value)
+{
+  m_channelFactory.Set (name, value);
+}
+
+void
+IncastStarHelper::SetSwitchAttribute (std::string name, const AttributeValue &value)
+{
+  m_switchFactory.Set (name, value);
+}
+
+void
+IncastStarHelper::SetBottleneckDataRate (DataRate rate)
+{
+  m_bottleneckRate = rate;
+}
+
+void
+IncastStarHelper::SetMtu (uint16_t mtu)
+{
+  m_mtu = mtu;
+}
+
+void
+IncastStarHelper::Install (void)
+{
+  NS_LOG_FUNCTION (this << m_numSenders);
+  NS_ASSERT_MSG (m_switch == 0, "IncastStarHelper::Install called twice");
+
+  m_sink = CreateObject<Node> ();
+  m_senders.Create (m_numSenders);
+  m_switchNode = CreateObject<Node> ();
+  m_switch = m_switchFactory.Create<OutputQueuedSwitch> ();
+  m_switchNode->AggregateObject (m_switch);
+
+  // port 0 is the sink
+  m_sinkDevice = Connect (m_sink, m_bottleneckRate);
+  for (uint32_t i = 0; i < m_numSenders; i++)
+    {
+      m_senderDevices.Add (Connect (m_senders.Get (i), DataRate (0)));
+    }
+}
+
+Ptr<SimpleNetDevice>
+IncastStarHelper::Connect (Ptr<Node> host, DataRate rate)
+{
+  Ptr<SimpleChannel> channel = m_channelFactory.Create<SimpleChannel> ();
+
+  Ptr<SimpleNetDevice> hostDevice = m_deviceFactory.Create<SimpleNetDevice> ();
+  hostDevice->SetAddress (Mac48Address::Allocate ());
+  hostDevice->SetMtu (m_mtu);
+  host->AddDevice (hostDevice);
+  hostDevice->SetChannel (channel);
+
+  Ptr<SimpleNetDevice> port = m_deviceFactory.Create<SimpleNetDevice> ();
+  port->SetAddress (Mac48Address::Allocate ());
+  port->SetMtu (m_mtu);
+  if (rate.GetBitRate () > 0)
+    {
+      port->SetAttribute ("DataRate", DataRateValue (rate));
+    }
+  m_switchNode->AddDevice (port);
+  port->SetChannel (channel);
+
+  UintegerValue bufferSize;
+  m_switch->GetAttribute ("BufferSize", bufferSize);
+  Ptr<Queue<Packet> > queue = port->GetQueue ();
+  queue->SetMaxSize (QueueSize (QueueSizeUnit::BYTES, bufferSize.Get ()));
+
+  uint32_t index = m_switch->AddPort (port, queue);
+  m_switch->AddHost (Mac48Address::ConvertFrom (hostDevice->GetAddress ()), index);
+  return hostDevice;
+}
+
+void
+IncastStarHelper::InstallStack (InternetStackHelper stack)
+{
+  NS_LOG_FUNCTION (this);
+  stack.Install (m_sink);
+  stack.Install (m_senders);
+}
+
+void
+IncastStarHelper::AssignIpv4Addresses (Ipv4AddressHelper address)
+{
+  NS_LOG_FUNCTION (this);
+  m_sinkInterface = address.Assign (NetDeviceContainer (m_sinkDevice));
+  m_senderInterfaces = address.Assign (m_senderDevices);
+
+  // ARP requests would be flooded to every port
+  Ipv4Address sinkAddress = GetSinkIpv4Address ();
+  for (uint32_t i = 0; i < m_numSenders; i++)
+    {
+      AddArpEntry (m_senderDevices.Get (i), sinkAddress, m_sinkDevice->GetAddress ());
+      AddArpEntry (m_sinkDevice, GetSenderIpv4Address (i), m_senderDevices.Get (i)->GetAddress ());
+    }
+}
+
+void
+IncastStarHelper::AddArpEntry (Ptr<NetDevice> device, Ipv4Address address, Address mac)
+{
+  Ptr<Ipv4L3Protocol> ipv4 = device->GetNode ()->GetObject<Ipv4L3Protocol> ();
+  NS_ASSERT_MSG (ipv4 != 0, "IncastStarHelper::AssignIpv4Addresses needs InstallStack first");
+  Ptr<ArpCache> cache = ipv4->GetInterface (ipv4->GetInterfaceForDevice (device))->GetArpCache ();
+  ArpCache::Entry *entry = cache->Lookup (address);
+  if (entry == 0)
+    {
+      entry = cache->Add (address);
+    }
+  entry->SetMacAddress (mac);
+  entry->MarkPermanent ();
+}
+
+Ptr<Node>
+IncastStarHelper::GetSink (void) const
+{
+  return m_sink;
+}
+
+Ptr<Node>
+IncastStarHelper::GetSender (uint32_t i) const
+{
+  return m_senders.Get (i);
+}
+
+NodeContainer
+IncastStarHelper::GetSenders (void) const
+{
+  return m_senders;
+}
+
+uint32_t
+IncastStarHelper::SenderCount (void) const
+{
+  return m_numSenders;
+}
+
+Ptr<Node>
+IncastStarHelper::GetSwitchNode (void) const
+{
+  return m_switchNode;
+}
+
+Ptr<OutputQueuedSwitch>
+IncastStarHelper::GetSwitch (void) const
+{
+  return m_switch;
+}
+
+Ptr<Queue<Packet> >
+IncastStarHelper::GetBottleneckQueue (void) const
+{
+  return m_switch->GetPortQueue (0);
+}
+
+Ipv4Address
+IncastStarHelper::GetSinkIpv4Address (void) const
+{
+  return m_sinkInterface.GetAddress (0);
+}
+
+Ipv4Address
+IncastStarHelper::GetSenderIpv4Address (uint32_t i) const
+{
+  return m_senderInterfaces.GetAddress (i);
+}
+
+} // namespace ns3
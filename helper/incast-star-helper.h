@@ -0,0 +1,190 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef INCAST_STAR_HELPER_H
+#define INCAST_STAR_HELPER_H
+
+#include <string>
+#include <vector>
+
+#include "ns3/object-factory.h"
+#include "ns3/node-container.h"
+#include "ns3/net-device-container.h"
+#include "ns3/data-rate.h"
+#include "ns3/queue.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-interface-container.h"
+#include "ns3/output-queued-switch.h"
+
+namespace ns3 {
+
+class SimpleNetDevice;
+
+/**
+ * \ingroup internet
+ * \brief Build an N to 1 incast: N senders and one sink, each on its own
+ * full duplex point-to-point link to an OutputQueuedSwitch.
+ *
+ * The links are SimpleNetDevice pairs over a SimpleChannel, the switch
+ * forwards through a MAC table, and AssignIpv4Addresses puts all hosts in
+ * one subnet with permanent ARP entries, so there is no ARP or flooding
+ * traffic. Building is linear in the number of senders and the per-packet
+ * cost does not depend on it.
+ *
+ * The switch ports get egress queues as large as the switch BufferSize so
+ * that only the shared buffer admission drops packets.
+ */
+class IncastStarHelper
+{
+public:
+  /**
+   * \param numSenders the number of senders
+   */
+  IncastStarHelper (uint32_t numSenders);
+
+  /**
+   * \brief Set an attribute of every SimpleNetDevice, e.g. DataRate.
+   * \param name the attribute name
+   * \param value the attribute value
+   */
+  void SetDeviceAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * \brief Set an attribute of every SimpleChannel, e.g. Delay.
+   * \param name the attribute name
+   * \param value the attribute value
+   */
+  void SetChannelAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * \brief Set an attribute of the OutputQueuedSwitch, e.g. BufferSize.
+   * \param name the attribute name
+   * \param value the attribute value
+   */
+  void SetSwitchAttribute (std::string name, const AttributeValue &value);
+
+  /**
+   * \brief Give the switch port toward the sink its own rate.
+   * \param rate the bottleneck rate, 0 keeps the device DataRate
+   */
+  void SetBottleneckDataRate (DataRate rate);
+
+  /**
+   * \param mtu the MTU of every device
+   */
+  void SetMtu (uint16_t mtu);
+
+  /**
+   * \brief Create the nodes, links and the switch.
+   */
+  void Install (void);
+
+  /**
+   * \param stack the stack installed on the sink and the senders
+   */
+  void InstallStack (InternetStackHelper stack);
+
+  /**
+   * \brief Assign the sink the first address of the subnet, the senders
+   * the next ones, and fill the ARP caches.
+   * \param address helper holding the subnet
+   */
+  void AssignIpv4Addresses (Ipv4AddressHelper address);
+
+  /**
+   * \return the sink node
+   */
+  Ptr<Node> GetSink (void) const;
+
+  /**
+   * \param i sender index
+   * \return the sender node
+   */
+  Ptr<Node> GetSender (uint32_t i) const;
+
+  /**
+   * \return all the sender nodes
+   */
+  NodeContainer GetSenders (void) const;
+
+  /**
+   * \return the number of senders
+   */
+  uint32_t SenderCount (void) const;
+
+  /**
+   * \return the switch node
+   */
+  Ptr<Node> GetSwitchNode (void) const;
+
+  /**
+   * \return the switch
+   */
+  Ptr<OutputQueuedSwitch> GetSwitch (void) const;
+
+  /**
+   * \return the egress queue of the switch port toward the sink
+   */
+  Ptr<Queue<Packet> > GetBottleneckQueue (void) const;
+
+  /**
+   * \return the sink address
+   */
+  Ipv4Address GetSinkIpv4Address (void) const;
+
+  /**
+   * \param i sender index
+   * \return the sender address
+   */
+  Ipv4Address GetSenderIpv4Address (uint32_t i) const;
+
+private:
+  /**
+   * \brief Connect a host to the switch.
+   * \param host the host node
+   * \param rate egress rate of the switch port, 0 keeps the device DataRate
+   * \return the host device
+   */
+  Ptr<SimpleNetDevice> Connect (Ptr<Node> host, DataRate rate);
+
+  /**
+   * \brief Add a permanent ARP entry.
+   * \param device the device owning the ARP cache
+   * \param address the IPv4 address
+   * \param mac the MAC address of the address
+   */
+  static void AddArpEntry (Ptr<NetDevice> device, Ipv4Address address, Address mac);
+
+  uint32_t m_numSenders; //!< number of senders
+  ObjectFactory m_deviceFactory; //!< SimpleNetDevice factory
+  ObjectFactory m_channelFactory; //!< SimpleChannel factory
+  ObjectFactory m_switchFactory; //!< OutputQueuedSwitch factory
+  DataRate m_bottleneckRate; //!< rate of the port toward the sink
+  uint16_t m_mtu; //!< device MTU
+
+  Ptr<Node> m_sink; //!< sink node
+  NodeContainer m_senders; //!< sender nodes
+  Ptr<Node> m_switchNode; //!< switch node
+  Ptr<OutputQueuedSwitch> m_switch; //!< switch
+  Ptr<SimpleNetDevice> m_sinkDevice; //!< sink device
+  NetDeviceContainer m_senderDevices; //!< sender devices
+  Ipv4InterfaceContainer m_sinkInterface; //!< sink address
+  Ipv4InterfaceContainer m_senderInterfaces; //!< sender addresses
+};
+
+} // namespace ns3
+
+#endif /* INCAST_STAR_HELPER_H */
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cstring>
+#include "binary-trace-writer.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/system-path.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BinaryTraceWriter");
+
+BinaryTraceWriter::BinaryTraceWriter (std::string directory, uint32_t bufferSize)
+  : m_directory (directory),
+    m_bufferSize (bufferSize > 0 ? bufferSize : 1),
+    m_closed (false)
+{
+  NS_LOG_FUNCTION (this << directory << bufferSize);
+  SystemPath::MakeDirectories (m_directory);
+}
+
+BinaryTraceWriter::~BinaryTraceWriter ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+}
+
+uint32_t
+BinaryTraceWriter::AddSeries (std::string name)
+{
+  NS_LOG_FUNCTION (this << name);
+  NS_ABORT_MSG_IF (m_closed, "BinaryTraceWriter: series added after Close");
+  NS_ABORT_MSG_IF (name.empty () || name.size () >= 32, "BinaryTraceWriter: bad series name " << name);
+
+  std::string filename = SystemPath::Append (m_directory, name + ".bin");
+  Series s;
+  s.name = name;
+  s.os = new std::ofstream (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  s.count = 0;
+  NS_ABORT_MSG_UNLESS (s.os->is_open (), "BinaryTraceWriter: unable to open " << filename);
+
+  char header[HEADER_SIZE];
+  std::memset (header, 0, sizeof (header));
+  const uint32_t version = 2;
+  const uint32_t headerSize = HEADER_SIZE;
+  const uint32_t recordSize = sizeof (Record);
+  const uint32_t byteOrder = 0x01020304;
+  std::memcpy (header, "NS3TRCOL", 8);
+  std::memcpy (header + 8, &version, 4);
+  std::memcpy (header + 12, &headerSize, 4);
+  std::memcpy (header + 16, &recordSize, 4);
+  std::memcpy (header + 20, &byteOrder, 4);
+  // the record count at offset 24 is written on Close
+  std::memcpy (header + 32, name.data (), name.size ());
+  s.os->write (header, sizeof (header));
+
+  m_series.push_back (s);
+  m_series.back ().buffer.reserve (m_bufferSize);
+  return m_series.size () - 1;
+}
+
+void
+BinaryTraceWriter::Write (uint32_t series, double value)
+{
+  Write (series, Simulator::Now (), value);
+}
+
+void
+BinaryTraceWriter::Write (uint32_t series, Time t, double value)
+{
+  NS_ASSERT (series < m_series.size ());
+  if (m_closed)
+    {
+      return;
+    }
+  Series &s = m_series[series];
+  Record r;
+  r.time = t.GetNanoSeconds ();
+  r.value = value;
+  s.buffer.push_back (r);
+  ++s.count;
+  if (s.buffer.size () >= m_bufferSize)
+    {
+      FlushSeries (s);
+    }
+}
+
+void
+BinaryTraceWriter::FlushSeries (Series &s)
+{
+  if (!s.buffer.empty ())
+    {
+      s.os->write (reinterpret_cast<const char *> (s.buffer.data ()),
+                   s.buffer.size () * sizeof (Record));
+      s.buffer.clear ();
+    }
+}
+
+void
+BinaryTraceWriter::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_closed)
+    {
+      return;
+    }
+  for (std::vector<Series>::iterator it = m_series.begin (); it != m_series.end (); ++it)
+    {
+      FlushSeries (*it);
+    }
+}
+
+void
+BinaryTraceWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_closed)
+    {
+      return;
+    }
+  Flush ();
+  for (std::vector<Series>::iterator it = m_series.begin (); it != m_series.end (); ++it)
+    {
+      it->os->seekp (24);
+      it->os->write (reinterpret_cast<const char *> (&it->count), sizeof (it->count));
+      it->os->close ();
+      delete it->os;
+      it->os = 0;
+    }
+  m_closed = true;
+}
+
+} // namespace ns3
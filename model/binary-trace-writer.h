@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BINARY_TRACE_WRITER_H
+#define BINARY_TRACE_WRITER_H
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ns3/simple-ref-count.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Buffered, columnar writer of (time, value) samples
+ *
+ * Meant to be hooked to trace sources (e.g. the TCPCCTIMELY
+ * NormalizedGradient, or a queue PacketsInQueue) in place of printing
+ * every sample on std::cout. Each series is stored in its own file
+ * \<directory\>/\<name\>.bin, so that it can be memory-mapped as a single
+ * array. Samples are kept in memory and written in batches of BufferSize
+ * records per series; nothing is flushed per record.
+ *
+ * Each file is a 64 byte header followed by the records, in host byte
+ * order:
+ *
+ * \verbatim
+   offset  0: char[8]  magic "NS3TRCOL"
+   offset  8: uint32   version (2)
+   offset 12: uint32   header size (64)
+   offset 16: uint32   record size (16)
+   offset 20: uint32   byte order mark 0x01020304
+   offset 24: uint64   number of records (written on Close)
+   offset 32: char[32] series name, NUL padded
+   records:   int64 time (ns), double value
+   \endverbatim
+ *
+ * A file of a run that did not reach Close has a zero record count; the
+ * count can then be derived from the file size. Draw/main.py reads this
+ * format.
+ */
+class BinaryTraceWriter : public SimpleRefCount<BinaryTraceWriter>
+{
+public:
+  /**
+   * \brief Create the output directory
+   * \param directory directory holding one file per series
+   * \param bufferSize records kept in memory per series between two writes
+   */
+  BinaryTraceWriter (std::string directory, uint32_t bufferSize = 65536);
+  ~BinaryTraceWriter ();
+
+  /**
+   * \brief Declare a series and open its file
+   * \param name name of the series, e.g. "G", "Q", "RTT" (at most 31 characters)
+   * \return the series identifier to pass to Write
+   */
+  uint32_t AddSeries (std::string name);
+
+  /**
+   * \brief Record a sample at the current simulation time
+   * \param series series identifier returned by AddSeries
+   * \param value the sample
+   */
+  void Write (uint32_t series, double value);
+
+  /**
+   * \brief Record a sample
+   * \param series series identifier returned by AddSeries
+   * \param t time of the sample
+   * \param value the sample
+   */
+  void Write (uint32_t series, Time t, double value);
+
+  /**
+   * \brief Write the buffered records to the files
+   */
+  void Flush (void);
+
+  /**
+   * \brief Flush, write the record counts and close the files.
+   * Further writes are ignored.
+   */
+  void Close (void);
+
+private:
+  /**
+   * \brief One sample, as stored in the file
+   */
+  struct Record
+  {
+    int64_t time;  //!< Time in ns
+    double  value; //!< Sample value
+  };
+
+  /**
+   * \brief Output file and pending records of one series
+   */
+  struct Series
+  {
+    std::string         name;    //!< Series name
+    std::ofstream      *os;      //!< Output file
+    std::vector<Record> buffer;  //!< Records not yet written
+    uint64_t            count;   //!< Records written or buffered
+  };
+
+  /**
+   * \brief Write the buffered records of one series
+   * \param s the series
+   */
+  void FlushSeries (Series &s);
+
+  static const uint32_t HEADER_SIZE = 64; //!< Size of the file header
+
+  std::string         m_directory;  //!< Output directory
+  std::vector<Series> m_series;     //!< Declared series
+  uint32_t            m_bufferSize; //!< Records per write
+  bool                m_closed;     //!< Close has been called
+};
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_WRITER_H */
@@ -51,22 +51,26 @@ operator<< (std::ostream& os, const CandidateQueue& q)
 {
   typedef CandidateQueue::CandidateList_t List_t;
   typedef List_t::const_iterator CIter_t;
-  const CandidateQueue::CandidateList_t& list = q.m_candidates;
+  // print in pop order
+  List_t list = q.m_candidates;
+  std::sort (list.begin (), list.end (), &CandidateQueue::CompareCandidate);
 
   os << "*** CandidateQueue Begin (<id, distance, LSA-type>) ***" << std::endl;
   for (CIter_t iter = list.begin (); iter != list.end (); iter++)
     {
       os << "<" 
-      << (*iter)->GetVertexId () << ", "
-      << (*iter)->GetDistanceFromRoot () << ", "
-      << (*iter)->GetVertexType () << ">" << std::endl;
+      << iter->vertex->GetVertexId () << ", "
+      << iter->vertex->GetDistanceFromRoot () << ", "
+      << iter->vertex->GetVertexType () << ">" << std::endl;
     }
   os << "*** CandidateQueue End ***";
   return os;
 }
 
 CandidateQueue::CandidateQueue()
-  : m_candidates ()
+  : m_candidates (),
+    m_positions (),
+    m_nextOrder (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -93,12 +97,14 @@ void
 CandidateQueue::Push (SPFVertex *vNew)
 {
   NS_LOG_FUNCTION (this << vNew);
+  NS_ASSERT_MSG (Find (vNew->GetVertexId ()) == 0, "Vertex " << vNew->GetVertexId () << " already queued");
 
-  CandidateList_t::iterator i = std::upper_bound (
-      m_candidates.begin (), m_candidates.end (), vNew,
-      &CandidateQueue::CompareSPFVertex
-      );
-  m_candidates.insert (i, vNew);
+  Candidate c;
+  c.vertex = vNew;
+  c.order = m_nextOrder++;
+  m_candidates.push_back (c);
+  m_positions[vNew->GetVertexId ().Get ()] = m_candidates.size () - 1;
+  SiftUp (m_candidates.size () - 1);
 }
 
 SPFVertex *
@@ -110,8 +116,15 @@ CandidateQueue::Pop (void)
       return 0;
     }
 
-  SPFVertex *v = m_candidates.front ();
-  m_candidates.pop_front ();
+  SPFVertex *v = m_candidates.front ().vertex;
+  m_positions.erase (v->GetVertexId ().Get ());
+  Candidate last = m_candidates.back ();
+  m_candidates.pop_back ();
+  if (!m_candidates.empty ())
+    {
+      Place (0, last);
+      SiftDown (0);
+    }
   return v;
 }
 
@@ -124,7 +137,7 @@ CandidateQueue::Top (void) const
       return 0;
     }
 
-  return m_candidates.front ();
+  return m_candidates.front ().vertex;
 }
 
 bool
@@ -145,18 +158,13 @@ SPFVertex *
 CandidateQueue::Find (const Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (this);
-  CandidateList_t::const_iterator i = m_candidates.begin ();
-
-  for (; i != m_candidates.end (); i++)
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = m_positions.find (addr.Get ());
+  if (i == m_positions.end ())
     {
-      SPFVertex *v = *i;
-      if (v->GetVertexId () == addr)
-        {
-          return v;
-        }
+      return 0;
     }
 
-  return 0;
+  return m_candidates[i->second].vertex;
 }
 
 void
@@ -164,11 +172,91 @@ CandidateQueue::Reorder (void)
 {
   NS_LOG_FUNCTION (this);
 
-  m_candidates.sort (&CandidateQueue::CompareSPFVertex);
+  // rebuild the heap from the bottom up, whichever distances changed
+  for (uint32_t i = m_candidates.size () / 2; i > 0; i--)
+    {
+      SiftDown (i - 1);
+    }
   NS_LOG_LOGIC ("After reordering the CandidateQueue");
   NS_LOG_LOGIC (*this);
 }
 
+void
+CandidateQueue::Reorder (SPFVertex *v)
+{
+  NS_LOG_FUNCTION (this << v);
+
+  std::unordered_map<uint32_t, uint32_t>::const_iterator i = m_positions.find (v->GetVertexId ().Get ());
+  NS_ASSERT_MSG (i != m_positions.end () && m_candidates[i->second].vertex == v,
+                 "Vertex " << v->GetVertexId () << " not in the CandidateQueue");
+  uint32_t position = i->second;
+  m_candidates[position].order = m_nextOrder++;
+  SiftUp (position);
+  NS_LOG_LOGIC ("After reordering the CandidateQueue");
+  NS_LOG_LOGIC (*this);
+}
+
+void
+CandidateQueue::Place (uint32_t position, const Candidate &c)
+{
+  m_candidates[position] = c;
+  m_positions[c.vertex->GetVertexId ().Get ()] = position;
+}
+
+void
+CandidateQueue::SiftUp (uint32_t position)
+{
+  Candidate c = m_candidates[position];
+  while (position > 0)
+    {
+      uint32_t parent = (position - 1) / 2;
+      if (!CompareCandidate (c, m_candidates[parent]))
+        {
+          break;
+        }
+      Place (position, m_candidates[parent]);
+      position = parent;
+    }
+  Place (position, c);
+}
+
+void
+CandidateQueue::SiftDown (uint32_t position)
+{
+  Candidate c = m_candidates[position];
+  uint32_t size = m_candidates.size ();
+  while (2 * position + 1 < size)
+    {
+      uint32_t child = 2 * position + 1;
+      if (child + 1 < size && CompareCandidate (m_candidates[child + 1], m_candidates[child]))
+        {
+          child++;
+        }
+      if (!CompareCandidate (m_candidates[child], c))
+        {
+          break;
+        }
+      Place (position, m_candidates[child]);
+      position = child;
+    }
+  Place (position, c);
+}
+
+bool
+CandidateQueue::CompareCandidate (const Candidate &c1, const Candidate &c2)
+{
+  if (CompareSPFVertex (c1.vertex, c2.vertex))
+    {
+      return true;
+    }
+  if (CompareSPFVertex (c2.vertex, c1.vertex))
+    {
+      return false;
+    }
+  // tie: first pushed (or reordered) first, as the sorted list did
+  return c1.order < c2.order;
+}
+
 /*
  * In this implementation, SPFVertex follows the ordering where
  * a vertex is ranked first if its GetDistanceFromRoot () is smaller;
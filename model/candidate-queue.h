@@ -22,7 +22,8 @@
 #define CANDIDATE_QUEUE_H
 
 #include <stdint.h>
-#include <list>
+#include <vector>
+#include <unordered_map>
 #include "ns3/ipv4-address.h"
 
 namespace ns3 {
@@ -47,6 +48,13 @@ class SPFVertex;
  * for a Find () operation, the dynamic nature of the data and the derived
  * requirement for a Reorder () operation led us to implement this simple 
  * enhanced priority queue.
+ *
+ * The queue is a binary heap indexed by vertex ID: Find () is a hash lookup
+ * and Reorder (SPFVertex*) moves the one vertex whose distance decreased.
+ * Vertices that tie in CompareSPFVertex leave the queue in the order they
+ * were pushed or last reordered, as they did from the sorted list the queue
+ * used to be, so that the SPF results (and their ECMP next hops) do not
+ * depend on the implementation.
  */
 class CandidateQueue
 {
@@ -154,6 +162,18 @@ public:
  */
   void Reorder (void);
 
+/**
+ * @brief Restores the priority order after the distance of one vertex
+ * decreased.
+ *
+ * The vertex goes after the vertices that tie with it, as if it had just
+ * been pushed. This is what the Shortest Path First calculation calls on
+ * a lower-cost path; it costs O(log n).
+ * @see SPFVertex
+ * @param v The vertex whose m_distanceFromRoot decreased.
+ */
+  void Reorder (SPFVertex *v);
+
 private:
 /**
  * Candidate Queue copy construction is disallowed (not implemented) to 
@@ -184,8 +204,44 @@ private:
  */
   static bool CompareSPFVertex (const SPFVertex* v1, const SPFVertex* v2);
 
-  typedef std::list<SPFVertex*> CandidateList_t; //!< container of SPFVertex pointers
-  CandidateList_t m_candidates;  //!< SPFVertex candidates
+  /// A vertex in the heap, with its rank among the vertices it ties with
+  struct Candidate
+  {
+    SPFVertex *vertex; //!< the vertex
+    uint64_t order;    //!< push or reorder sequence number
+  };
+
+/**
+ * \brief return true if c1 must be popped before c2
+ * \param c1 first operand
+ * \param c2 second operand
+ * \return True if c1 should be popped before c2; false otherwise
+ */
+  static bool CompareCandidate (const Candidate &c1, const Candidate &c2);
+
+/**
+ * \brief Store a candidate at a heap position
+ * \param position the position
+ * \param c the candidate
+ */
+  void Place (uint32_t position, const Candidate &c);
+
+/**
+ * \brief Move a candidate towards the top of the heap
+ * \param position the position of the candidate
+ */
+  void SiftUp (uint32_t position);
+
+/**
+ * \brief Move a candidate towards the bottom of the heap
+ * \param position the position of the candidate
+ */
+  void SiftDown (uint32_t position);
+
+  typedef std::vector<Candidate> CandidateList_t; //!< container of SPFVertex pointers
+  CandidateList_t m_candidates;  //!< SPFVertex candidates, as a binary heap
+  std::unordered_map<uint32_t, uint32_t> m_positions; //!< heap position of each vertex ID
+  uint64_t m_nextOrder;          //!< sequence number of the next push or reorder
 
   /**
    * \brief Stream insertion operator.
@@ -27,10 +27,19 @@
 #include <queue>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <set>
+#include <thread>
 #include "ns3/assert.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
 #include "ns3/node-list.h"
+#include "ns3/channel.h"
+#include "ns3/net-device.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-list-routing.h"
@@ -38,11 +47,31 @@
 #include "global-route-manager-impl.h"
 #include "candidate-queue.h"
 #include "ipv4-global-routing.h"
+#include "loopback-net-device.h"
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("GlobalRouteManagerImpl");
 
+/// Threads of the SPF calculation of GlobalRouteManagerImpl::InitializeRoutes
+static GlobalValue g_globalRoutingThreads ("GlobalRoutingThreads",
+                                           "Threads computing the global routes, one SPF "
+                                           "calculation per router at a time; 0 uses one per "
+                                           "hardware thread. The routes are installed after "
+                                           "each batch of 64 routers per thread is computed, "
+                                           "in the order of a serial run",
+                                           UintegerValue (1),
+                                           MakeUintegerChecker<uint32_t> ());
+
+/// Incremental route updates of GlobalRouteManagerImpl::UpdateRoutes
+static GlobalValue g_globalRoutingIncremental ("GlobalRoutingIncremental",
+                                               "Update the global routes incrementally when the "
+                                               "point-to-point interfaces of a node change, "
+                                               "keeping the distance of every router from every "
+                                               "router between the updates",
+                                               BooleanValue (false),
+                                               MakeBooleanChecker ());
+
 /**
  * \brief Stream insertion operator.
  *
@@ -470,7 +499,48 @@ GlobalRouteManagerLSDB::Insert (Ipv4Address addr, GlobalRoutingLSA* lsa)
   else
     {
       m_database.insert (LSDBPair_t (addr, lsa));
+      uint32_t index = m_vertexIndex.size ();
+      m_vertexIndex.insert (std::make_pair (addr, index));
+    }
+}
+
+GlobalRoutingLSA*
+GlobalRouteManagerLSDB::Replace (Ipv4Address addr, GlobalRoutingLSA* lsa)
+{
+  NS_LOG_FUNCTION (this << addr << lsa);
+  LSDBMap_t::iterator i = m_database.find (addr);
+  NS_ASSERT_MSG (i != m_database.end (), "GlobalRouteManagerLSDB::Replace (): no LSA for " << addr);
+  GlobalRoutingLSA* old = i->second;
+  i->second = lsa;
+  return old;
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetVertexIndex (Ipv4Address addr) const
+{
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator i = m_vertexIndex.find (addr);
+  return i == m_vertexIndex.end () ? SPF_INFINITY : i->second;
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetNumVertices () const
+{
+  return m_vertexIndex.size ();
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetNumNetworkLSAs () const
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t count = 0;
+  for (LSDBMap_t::const_iterator i = m_database.begin (); i != m_database.end (); i++)
+    {
+      if (i->second->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+        {
+          count++;
+        }
     }
+  return count;
 }
 
 GlobalRoutingLSA*
@@ -494,13 +564,10 @@ GlobalRouteManagerLSDB::GetLSA (Ipv4Address addr) const
 //
 // Look up an LSA by its address.
 //
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  LSDBMap_t::const_iterator i = m_database.find (addr);
+  if (i != m_database.end ())
     {
-      if (i->first == addr)
-        {
-          return i->second;
-        }
+      return i->second;
     }
   return 0;
 }
@@ -538,16 +605,30 @@ GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 
 GlobalRouteManagerImpl::GlobalRouteManagerImpl () 
   :
-    m_spfroot (0)
+    m_spfroot (0),
+    m_ownsLsdb (true),
+    m_routes (0),
+    m_incremental (false)
 {
   NS_LOG_FUNCTION (this);
   m_lsdb = new GlobalRouteManagerLSDB ();
 }
 
+GlobalRouteManagerImpl::GlobalRouteManagerImpl (GlobalRouteManagerLSDB* lsdb)
+  :
+    m_spfroot (0),
+    m_lsdb (lsdb),
+    m_ownsLsdb (false),
+    m_routes (0),
+    m_incremental (false)
+{
+  NS_LOG_FUNCTION (this << lsdb);
+}
+
 GlobalRouteManagerImpl::~GlobalRouteManagerImpl ()
 {
   NS_LOG_FUNCTION (this);
-  if (m_lsdb)
+  if (m_lsdb && m_ownsLsdb)
     {
       delete m_lsdb;
     }
@@ -557,11 +638,12 @@ void
 GlobalRouteManagerImpl::DebugUseLsdb (GlobalRouteManagerLSDB* lsdb)
 {
   NS_LOG_FUNCTION (this << lsdb);
-  if (m_lsdb)
+  if (m_lsdb && m_ownsLsdb)
     {
       delete m_lsdb;
     }
   m_lsdb = lsdb;
+  m_ownsLsdb = true;
 }
 
 void
@@ -591,6 +673,8 @@ GlobalRouteManagerImpl::DeleteGlobalRoutes ()
         }
       NS_LOG_LOGIC ("Deleted " << j << " global routes from node "<< node->GetId ());
     }
+  m_roots.clear ();
+  m_incremental = false;
   if (m_lsdb)
     {
       NS_LOG_LOGIC ("Deleting LSDB, creating new one");
@@ -699,6 +783,10 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 // Walk the list of nodes in the system.
 //
   NS_LOG_INFO ("About to start SPF calculation");
+  BooleanValue incrementalValue;
+  g_globalRoutingIncremental.GetValue (incrementalValue);
+  m_incremental = incrementalValue.Get () && m_lsdb->GetNumNetworkLSAs () == 0;
+  m_roots.clear ();
   NodeList::Iterator listEnd = NodeList::End ();
   for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
     {
@@ -723,202 +811,761 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 //
       if (rtr && rtr->GetNumLSAs () )
         {
-          SPFCalculate (rtr->GetRouterId ());
+          SPFRoot root;
+          root.routerId = rtr->GetRouterId ();
+          root.ipv4 = node->GetObject<Ipv4> ();
+          root.routing = rtr->GetRoutingProtocol ();
+          root.keepDistances = m_incremental;
+          root.stub = false;
+          m_roots.push_back (root);
         }
     }
+
+  std::vector<SPFRoot*> roots;
+  for (std::vector<SPFRoot>::iterator i = m_roots.begin (); i != m_roots.end (); i++)
+    {
+      roots.push_back (&*i);
+    }
+  CalculateRoots (roots, false);
+  if (!m_incremental)
+    {
+      m_roots.clear ();
+    }
   NS_LOG_INFO ("Finished SPF calculation");
 }
 
-//
-// This method is derived from quagga ospf_spf_next ().  See RFC2328 Section 
-// 16.1 (2) for further details.
-//
-// We're passed a parameter <v> that is a vertex which is already in the SPF
-// tree.  A vertex represents a router node.  We also get a reference to the
-// SPF candidate queue, which is a priority queue containing the shortest paths
-// to the networks we know about.
-//
-// We examine the links in v's LSA and update the list of candidates with any
-// vertices not already on the list.  If a lower-cost path is found to a
-// vertex already on the candidate list, store the new (lower) cost.
-//
-void
-GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
+/**
+ * \return true if a log component written by the SPF calculation is enabled
+ */
+static bool
+SpfLogEnabled (void)
 {
-  NS_LOG_FUNCTION (this << v << &candidate);
+  // this file, the LSAs, the candidate queue, and the Ipv4 of the root
+  // that the calculation queries for its interfaces
+  static const char *components[] = { "GlobalRouteManagerImpl", "GlobalRouter", "CandidateQueue",
+                                      "Ipv4L3Protocol", "Ipv4Interface", "Ipv4InterfaceAddress",
+                                      "Ipv4RoutingTableEntry" };
+  LogComponent::ComponentList *list = LogComponent::GetComponentList ();
+  for (uint32_t i = 0; i < sizeof (components) / sizeof (components[0]); i++)
+    {
+      LogComponent::ComponentList::const_iterator c = list->find (components[i]);
+      if (c != list->end () && !c->second->IsNoneEnabled ())
+        {
+          return true;
+        }
+    }
+  return false;
+}
 
-  SPFVertex* w = 0;
-  GlobalRoutingLSA* w_lsa = 0;
-  GlobalRoutingLinkRecord *l = 0;
-  uint32_t distance = 0;
-  uint32_t numRecordsInVertex = 0;
-//
-// V points to a Router-LSA or Network-LSA
-// Loop over the links in router LSA or attached routers in Network LSA
-//
-  if (v->GetVertexType () == SPFVertex::VertexRouter)
+void
+GlobalRouteManagerImpl::CalculateRoots (const std::vector<SPFRoot*>& roots, bool replace)
+{
+  NS_LOG_FUNCTION (this << roots.size () << replace);
+  UintegerValue threadsValue;
+  g_globalRoutingThreads.GetValue (threadsValue);
+  uint32_t threads = threadsValue.Get ();
+  if (threads == 0)
     {
-      numRecordsInVertex = v->GetLSA ()->GetNLinkRecords (); 
+      threads = std::max (std::thread::hardware_concurrency (), 1u);
     }
-  if (v->GetVertexType () == SPFVertex::VertexNetwork)
+  threads = std::min<uint32_t> (threads, roots.size ());
+  if (SpfLogEnabled ())
     {
-      numRecordsInVertex = v->GetLSA ()->GetNAttachedRouters (); 
+      // the log is not written from several threads
+      threads = 1;
     }
 
-  for (uint32_t i = 0; i < numRecordsInVertex; i++)
+  if (threads <= 1)
     {
-// Get w_lsa:  In case of V is Router-LSA
-      if (v->GetVertexType () == SPFVertex::VertexRouter) 
+      for (std::vector<SPFRoot*>::const_iterator i = roots.begin (); i != roots.end (); i++)
         {
-          NS_LOG_LOGIC ("Examining link " << i << " of " << 
-                        v->GetVertexId () << "'s " <<
-                        v->GetLSA ()->GetNLinkRecords () << " link records");
-//
-// (a) If this is a link to a stub network, examine the next link in V's LSA.
-// Links to stub networks will be considered in the second stage of the
-// shortest path calculation.
-//
-          l = v->GetLSA ()->GetLinkRecord (i);
-          NS_ASSERT (l != 0);
-          if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork)
-            {
-              NS_LOG_LOGIC ("Found a Stub record to " << l->GetLinkId ());
-              continue;
-            }
-//
-// (b) Otherwise, W is a transit vertex (router or transit network).  Look up
-// the vertex W's LSA (router-LSA or network-LSA) in Area A's link state
-// database. 
-//
-          if (l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
-            {
+          SPFCalculateRoutes (**i);
+          InstallRoutes (**i, replace);
+        }
+      return;
+    }
+
 //
-// Lookup the link state advertisement of the new link -- we call it <w> in
-// the link state database.
+// The SPF calculations of the roots only read the LSDB: each worker holds
+// the SPF state of its current root, and stages its routes in the root.
+// The ns-3 objects of a root (its Ipv4) are only used by the worker that
+// calculates it; the routing tables are written from here, between batches
+// of roots, which bounds the memory of the staged routes.
 //
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
-              NS_LOG_LOGIC ("Found a P2P record from " << 
-                            v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
-            }
-          else if (l->GetLinkType () == 
-                   GlobalRoutingLinkRecord::TransitNetwork)
-            {
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
-              NS_LOG_LOGIC ("Found a Transit record from " << 
-                            v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
-            }
-          else 
+  NS_LOG_INFO ("SPF calculation of " << roots.size () << " routers on " << threads << " threads");
+  uint32_t batch = 64 * threads;
+  GlobalRouteManagerLSDB* lsdb = m_lsdb;
+  for (uint32_t first = 0; first < roots.size (); first += batch)
+    {
+      uint32_t last = std::min<uint32_t> (first + batch, roots.size ());
+      std::atomic<uint32_t> next (first);
+      auto work = [&roots, &next, last, lsdb] ()
+        {
+          GlobalRouteManagerImpl worker (lsdb);
+          for (uint32_t i = next++; i < last; i = next++)
             {
-              NS_ASSERT_MSG (0, "illegal Link Type");
+              worker.SPFCalculateRoutes (*roots[i]);
             }
+        };
+      std::vector<std::thread> pool;
+      for (uint32_t t = 1; t < threads; t++)
+        {
+          pool.push_back (std::thread (work));
         }
-// Get w_lsa:  In case of V is Network-LSA
-      if (v->GetVertexType () == SPFVertex::VertexNetwork) 
+      work ();
+      for (std::vector<std::thread>::iterator t = pool.begin (); t != pool.end (); t++)
         {
-          w_lsa = m_lsdb->GetLSAByLinkData 
-              (v->GetLSA ()->GetAttachedRouter (i));
-          if (!w_lsa)
-            {
-              continue;
-            }
-          NS_LOG_LOGIC ("Found a Network LSA from " << 
-                        v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
+          t->join ();
         }
 
-// Note:  w_lsa at this point may be either RouterLSA or NetworkLSA
-//
-// (c) If vertex W is already on the shortest-path tree, examine the next
-// link in the LSA.
-//
-// If the link is to a router that is already in the shortest path first tree
-// then we have it covered -- ignore it.
-//
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
+      for (uint32_t i = first; i < last; i++)
         {
-          NS_LOG_LOGIC ("Skipping ->  LSA "<< 
-                        w_lsa->GetLinkStateId () << " already in SPF tree");
-          continue;
+          InstallRoutes (*roots[i], replace);
         }
-//
-// (d) Calculate the link state cost D of the resulting path from the root to 
-// vertex W.  D is equal to the sum of the link state cost of the (already 
-// calculated) shortest path to vertex V and the advertised cost of the link
-// between vertices V and W.
-//
-      if (v->GetLSA ()->GetLSType () == GlobalRoutingLSA::RouterLSA)
+    }
+}
+
+void
+GlobalRouteManagerImpl::RecomputeRoutes ()
+{
+  NS_LOG_FUNCTION (this);
+  DeleteGlobalRoutes ();
+  BuildGlobalRoutingDatabase ();
+  InitializeRoutes ();
+}
+
+/// \returns true if two link records are equal
+static bool
+SameLink (const GlobalRoutingLinkRecord* a, const GlobalRoutingLinkRecord* b)
+{
+  return a->GetLinkType () == b->GetLinkType () && a->GetLinkId () == b->GetLinkId ()
+         && a->GetLinkData () == b->GetLinkData () && a->GetMetric () == b->GetMetric ();
+}
+
+/// \returns true if two LSAs have the same link records, in the same order
+static bool
+SameLinks (const GlobalRoutingLSA* a, const GlobalRoutingLSA* b)
+{
+  if (a->GetNLinkRecords () != b->GetNLinkRecords ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < a->GetNLinkRecords (); i++)
+    {
+      if (!SameLink (a->GetLinkRecord (i), b->GetLinkRecord (i)))
         {
-          NS_ASSERT (l != 0);
-          distance = v->GetDistanceFromRoot () + l->GetMetric ();
+          return false;
         }
-      else
+    }
+  return true;
+}
+
+/// \returns true if an LSA has a link to a transit network
+static bool
+HasTransitLinks (const GlobalRoutingLSA* lsa)
+{
+  for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+    {
+      if (lsa->GetLinkRecord (i)->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork)
         {
-          distance = v->GetDistanceFromRoot ();
+          return true;
         }
+    }
+  return false;
+}
 
-      NS_LOG_LOGIC ("Considering w_lsa " << w_lsa->GetLinkStateId ());
+/// Get the link records of an LSA of a type, or with a link ID
+static void
+GetLinks (const GlobalRoutingLSA* lsa, GlobalRoutingLinkRecord::LinkType type, Ipv4Address linkId,
+          std::vector<GlobalRoutingLinkRecord*>& links)
+{
+  links.clear ();
+  for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+    {
+      GlobalRoutingLinkRecord* l = lsa->GetLinkRecord (i);
+      if (l->GetLinkType () == type || l->GetLinkId () == linkId)
+        {
+          links.push_back (l);
+        }
+    }
+}
 
-// Is there already vertex w in candidate list?
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
+/// \returns true if a link record equal to l is among links
+static bool
+HasLink (const std::vector<GlobalRoutingLinkRecord*>& links, const GlobalRoutingLinkRecord* l)
+{
+  for (std::vector<GlobalRoutingLinkRecord*>::const_iterator i = links.begin (); i != links.end (); i++)
+    {
+      if (SameLink (*i, l))
         {
-// Calculate nexthop to w
-// We need to figure out how to actually get to the new router represented
-// by <w>.  This will (among other things) find the next hop address to send
-// packets destined for this network to, and also find the outbound interface
-// used to forward the packets.
+          return true;
+        }
+    }
+  return false;
+}
 
-// prepare vertex w
-          w = new SPFVertex (w_lsa);
-          if (SPFNexthopCalculation (v, w, l, distance))
-            {
-              w_lsa->SetStatus (GlobalRoutingLSA::LSA_SPF_CANDIDATE);
-//
-// Push this new vertex onto the priority queue (ordered by distance from the
-// root node).
-//
-              candidate.Push (w);
-              NS_LOG_LOGIC ("Pushing " << 
-                            w->GetVertexId () << ", parent vertexId: " <<
-                            v->GetVertexId () << ", distance: " <<
-                            w->GetDistanceFromRoot ());
-            }
-          else
-            NS_ASSERT_MSG (0, "SPFNexthopCalculation never " 
-                           << "return false, but it does now!");
+/// Get the routes that SPFIntraAddRouter (point-to-point links) or
+/// SPFProcessStubs (stub links) installs for a router through its exits
+static void
+GetVertexRoutes (const GlobalRoutingLSA* lsa, GlobalRoutingLinkRecord::LinkType type,
+                 const std::vector<Ipv4RoutingTableEntry>& exits,
+                 std::vector<Ipv4RoutingTableEntry>& routes)
+{
+  routes.clear ();
+  for (uint32_t i = 0; i < lsa->GetNLinkRecords (); i++)
+    {
+      GlobalRoutingLinkRecord* l = lsa->GetLinkRecord (i);
+      if (l->GetLinkType () != type)
+        {
+          continue;
         }
-      else if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
+      for (std::vector<Ipv4RoutingTableEntry>::const_iterator e = exits.begin (); e != exits.end (); e++)
         {
-//
-// We have already considered the link represented by <w>.  What wse have to
-// do now is to decide if this new router represents a route with a shorter
-// distance metric.
-//
-// So, locate the vertex in the candidate queue and take a look at the 
-// distance.
-
-/* (quagga-0.98.6) W is already on the candidate list; call it cw.
-* Compare the previously calculated cost (cw->distance)
-* with the cost we just determined (w->distance) to see
-* if we've found a shorter path.
-*/
-          SPFVertex* cw;
-          cw = candidate.Find (w_lsa->GetLinkStateId ());
-          if (cw->GetDistanceFromRoot () < distance)
+          if (type == GlobalRoutingLinkRecord::PointToPoint)
             {
-//
-// This is not a shorter path, so don't do anything.
-//
-              continue;
+              routes.push_back (Ipv4RoutingTableEntry::CreateHostRouteTo (l->GetLinkData (),
+                                                                          e->GetGateway (),
+                                                                          e->GetInterface ()));
             }
-          else if (cw->GetDistanceFromRoot () == distance)
+          else
             {
+              Ipv4Mask mask (l->GetLinkData ().Get ());
+              routes.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (l->GetLinkId ().CombineMask (mask),
+                                                                             mask,
+                                                                             e->GetGateway (),
+                                                                             e->GetInterface ()));
+            }
+        }
+    }
+}
+
+bool
+GlobalRouteManagerImpl::FindAffectedRouters (Ptr<Node> node, std::vector<Ptr<GlobalRouter> >& routers) const
+{
+  NS_LOG_FUNCTION (this << node);
 //
-// This path is one with an equal cost.
+// The LSA of a router describes its point-to-point links with the state of
+// the interfaces at both ends: a change of the node changes its LSA and the
+// LSAs of its neighbors, and no other.
 //
-              NS_LOG_LOGIC ("Equal cost multiple paths found.");
-
-// At this point, there are two instances 'w' and 'cw' of the
+  routers.clear ();
+  Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
+  if (rtr)
+    {
+      routers.push_back (rtr);
+    }
+  for (uint32_t i = 0; i < node->GetNDevices (); i++)
+    {
+      Ptr<NetDevice> device = node->GetDevice (i);
+      if (DynamicCast<LoopbackNetDevice> (device))
+        {
+          continue;
+        }
+      if (!device->IsPointToPoint ())
+        {
+          NS_LOG_LOGIC ("Device " << i << " of node " << node->GetId () << " is not point-to-point");
+          return false;
+        }
+      Ptr<Channel> channel = device->GetChannel ();
+      for (uint32_t j = 0; channel && j < channel->GetNDevices (); j++)
+        {
+          Ptr<GlobalRouter> neighbor = channel->GetDevice (j)->GetNode ()->GetObject<GlobalRouter> ();
+          if (neighbor && std::find (routers.begin (), routers.end (), neighbor) == routers.end ())
+            {
+              routers.push_back (neighbor);
+            }
+        }
+    }
+  return true;
+}
+
+bool
+GlobalRouteManagerImpl::CompareLinks (LSAChange& change) const
+{
+  NS_LOG_FUNCTION (this << change.oldLsa << change.newLsa);
+  std::vector<GlobalRoutingLinkRecord*> oldLinks;
+  std::vector<GlobalRoutingLinkRecord*> newLinks;
+  GetLinks (change.oldLsa, GlobalRoutingLinkRecord::PointToPoint, Ipv4Address::GetAny (), oldLinks);
+  GetLinks (change.newLsa, GlobalRoutingLinkRecord::PointToPoint, Ipv4Address::GetAny (), newLinks);
+  std::vector<GlobalRoutingLinkRecord*> oldKept;
+  std::vector<GlobalRoutingLinkRecord*> newKept;
+  for (std::vector<GlobalRoutingLinkRecord*>::const_iterator i = oldLinks.begin (); i != oldLinks.end (); i++)
+    {
+      uint32_t w = m_lsdb->GetVertexIndex ((*i)->GetLinkId ());
+      if (w == SPF_INFINITY)
+        {
+          return false;
+        }
+      if (HasLink (newLinks, *i))
+        {
+          oldKept.push_back (*i);
+        }
+      else
+        {
+          change.removed.push_back (std::make_pair (w, (*i)->GetMetric ()));
+        }
+    }
+  for (std::vector<GlobalRoutingLinkRecord*>::const_iterator i = newLinks.begin (); i != newLinks.end (); i++)
+    {
+      uint32_t w = m_lsdb->GetVertexIndex ((*i)->GetLinkId ());
+      if (w == SPF_INFINITY)
+        {
+          return false;
+        }
+      if (HasLink (oldLinks, *i))
+        {
+          newKept.push_back (*i);
+        }
+      else
+        {
+          change.added.push_back (std::make_pair (w, (*i)->GetMetric ()));
+        }
+    }
+//
+// SPFNext examines the links in the order of the LSA, which decides among
+// the vertices at equal distance: the links kept must keep their order.
+//
+  change.reordered = oldKept.size () != newKept.size ()
+    || !std::equal (oldKept.begin (), oldKept.end (), newKept.begin (), SameLink);
+  return true;
+}
+
+bool
+GlobalRouteManagerImpl::ChangesTree (const SPFRoot& root, const LSAChange& change) const
+{
+  NS_LOG_FUNCTION (this << root.routerId << change.newLsa->GetLinkStateId ());
+//
+// The root reaches the changed router v.  A link v->w that is not on a
+// shortest path (d(v) + metric > d(w)) is examined by SPFNext and dropped,
+// or gives w a candidate distance that a shorter path replaces, exit
+// directions, parents and place in the candidate queue included: adding or
+// removing such links leaves the tree as it is.  Any other link may change
+// the distances or the equal cost paths.
+//
+  const std::vector<uint32_t>& d = root.distances;
+  uint64_t dv = d[change.vertex];
+  if (change.reordered)
+    {
+      return true;
+    }
+  for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator i = change.removed.begin (); i != change.removed.end (); i++)
+    {
+      if (d[i->first] != SPF_INFINITY && dv + i->second <= d[i->first])
+        {
+          return true;
+        }
+    }
+  for (std::vector<std::pair<uint32_t, uint32_t> >::const_iterator i = change.added.begin (); i != change.added.end (); i++)
+    {
+      if (d[i->first] == SPF_INFINITY || dv + i->second <= d[i->first])
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+bool
+GlobalRouteManagerImpl::PatchRoutes (SPFRoot& root, const LSAChange& change) const
+{
+  NS_LOG_FUNCTION (this << root.routerId << change.newLsa->GetLinkStateId ());
+  if (root.routing == 0)
+    {
+      return true;
+    }
+//
+// The routes to the addresses of the router (SPFIntraAddRouter) and to its
+// stub networks (SPFProcessStubs) are consecutive in the table, one per exit
+// direction of its vertex; the exits do not change with the tree, and the
+// host routes to one of its addresses give them.
+//
+  std::vector<GlobalRoutingLinkRecord*> links;
+  GetLinks (change.oldLsa, GlobalRoutingLinkRecord::PointToPoint, Ipv4Address::GetAny (), links);
+  if (links.empty ())
+    {
+      return false;
+    }
+  std::vector<Ipv4RoutingTableEntry> exits;
+  root.routing->GetHostRoutesTo (links.front ()->GetLinkData (), exits);
+  if (exits.empty ())
+    {
+      // no exit direction has an outgoing interface: no routes before or after
+      return true;
+    }
+  std::vector<Ipv4RoutingTableEntry> oldRoutes;
+  std::vector<Ipv4RoutingTableEntry> newRoutes;
+  GetVertexRoutes (change.oldLsa, GlobalRoutingLinkRecord::PointToPoint, exits, oldRoutes);
+  GetVertexRoutes (change.newLsa, GlobalRoutingLinkRecord::PointToPoint, exits, newRoutes);
+  if (oldRoutes != newRoutes && !root.routing->ReplaceRoutes (true, oldRoutes, newRoutes))
+    {
+      return false;
+    }
+  GetVertexRoutes (change.oldLsa, GlobalRoutingLinkRecord::StubNetwork, exits, oldRoutes);
+  GetVertexRoutes (change.newLsa, GlobalRoutingLinkRecord::StubNetwork, exits, newRoutes);
+  if (oldRoutes != newRoutes)
+    {
+      // routes to place after no routes of the router have no known place
+      return !oldRoutes.empty () && root.routing->ReplaceRoutes (false, oldRoutes, newRoutes);
+    }
+  return true;
+}
+
+void
+GlobalRouteManagerImpl::UpdateRoutes (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node);
+  std::vector<Ptr<GlobalRouter> > routers;
+  if (!m_incremental || !FindAffectedRouters (node, routers))
+    {
+      RecomputeRoutes ();
+      return;
+    }
+//
+// Discover the LSAs of the routers again.  The incremental update covers
+// the changes of router LSAs without transit networks; a change of an
+// external or a network LSA recomputes everything.
+//
+  std::vector<LSAChange> changes;
+  bool full = false;
+  for (std::vector<Ptr<GlobalRouter> >::const_iterator i = routers.begin (); i != routers.end () && !full; i++)
+    {
+      Ipv4Address routerId = (*i)->GetRouterId ();
+      std::vector<GlobalRoutingLSA*> externals;
+      for (uint32_t j = 0; j < m_lsdb->GetNumExtLSAs (); j++)
+        {
+          if (m_lsdb->GetExtLSA (j)->GetAdvertisingRouter () == routerId)
+            {
+              externals.push_back (m_lsdb->GetExtLSA (j));
+            }
+        }
+      GlobalRoutingLSA* lsa = 0;
+      uint32_t nExternals = 0;
+      uint32_t numLSAs = (*i)->DiscoverLSAs ();
+      for (uint32_t j = 0; j < numLSAs && !full; j++)
+        {
+          GlobalRoutingLSA* discovered = new GlobalRoutingLSA ();
+          (*i)->GetLSA (j, *discovered);
+          if (discovered->GetLSType () == GlobalRoutingLSA::RouterLSA && lsa == 0)
+            {
+              lsa = discovered;
+              continue;
+            }
+          if (discovered->GetLSType () == GlobalRoutingLSA::ASExternalLSAs
+              && nExternals < externals.size ()
+              && discovered->GetLinkStateId () == externals[nExternals]->GetLinkStateId ()
+              && discovered->GetNetworkLSANetworkMask () == externals[nExternals]->GetNetworkLSANetworkMask ())
+            {
+              nExternals++;
+            }
+          else
+            {
+              full = true;
+            }
+          delete discovered;
+        }
+      GlobalRoutingLSA* old = m_lsdb->GetLSA (routerId);
+      if (full || nExternals != externals.size () || lsa == 0 || old == 0
+          || HasTransitLinks (old) || HasTransitLinks (lsa))
+        {
+          delete lsa;
+          full = true;
+          break;
+        }
+      if (SameLinks (old, lsa))
+        {
+          delete lsa;
+          continue;
+        }
+      LSAChange change;
+      change.oldLsa = old;
+      change.newLsa = lsa;
+      change.vertex = m_lsdb->GetVertexIndex (routerId);
+      if (!CompareLinks (change))
+        {
+          delete lsa;
+          full = true;
+          break;
+        }
+      changes.push_back (change);
+    }
+  if (full)
+    {
+      NS_LOG_INFO ("Change not covered by the incremental update, recomputing all routes");
+      for (std::vector<LSAChange>::iterator c = changes.begin (); c != changes.end (); c++)
+        {
+          delete c->newLsa;
+        }
+      RecomputeRoutes ();
+      return;
+    }
+
+//
+// The node itself and the routers with a changed LSA get a new SPF
+// calculation, and so do their neighbors if the links back to them changed:
+// SPFNexthopCalculation takes the next hop from the root to a neighbor, and
+// CheckForStubNode the default route of a stub root, from the first link of
+// the neighbor to the root.
+//
+  std::set<Ipv4Address> recalculate;
+  if (node->GetObject<GlobalRouter> ())
+    {
+      recalculate.insert (node->GetObject<GlobalRouter> ()->GetRouterId ());
+    }
+  for (std::vector<LSAChange>::iterator c = changes.begin (); c != changes.end (); c++)
+    {
+      recalculate.insert (c->newLsa->GetLinkStateId ());
+      std::vector<GlobalRoutingLinkRecord*> links;
+      GetLinks (c->oldLsa, GlobalRoutingLinkRecord::PointToPoint, Ipv4Address::GetAny (), links);
+      std::vector<GlobalRoutingLinkRecord*> newLinks;
+      GetLinks (c->newLsa, GlobalRoutingLinkRecord::PointToPoint, Ipv4Address::GetAny (), newLinks);
+      links.insert (links.end (), newLinks.begin (), newLinks.end ());
+      for (std::vector<GlobalRoutingLinkRecord*>::const_iterator l = links.begin (); l != links.end (); l++)
+        {
+          std::vector<GlobalRoutingLinkRecord*> oldTo;
+          std::vector<GlobalRoutingLinkRecord*> newTo;
+          GetLinks (c->oldLsa, GlobalRoutingLinkRecord::Unknown, (*l)->GetLinkId (), oldTo);
+          GetLinks (c->newLsa, GlobalRoutingLinkRecord::Unknown, (*l)->GetLinkId (), newTo);
+          if (oldTo.size () != newTo.size ()
+              || !std::equal (oldTo.begin (), oldTo.end (), newTo.begin (), SameLink))
+            {
+              recalculate.insert ((*l)->GetLinkId ());
+            }
+        }
+      m_lsdb->Replace (c->newLsa->GetLinkStateId (), c->newLsa);
+    }
+
+//
+// The other roots that reach a changed router either keep their tree, and
+// get the routes to the router patched, or get a new SPF calculation.
+//
+  std::vector<SPFRoot*> calculate;
+  uint32_t patched = 0;
+  for (std::vector<SPFRoot>::iterator r = m_roots.begin (); r != m_roots.end (); r++)
+    {
+      bool spf = recalculate.count (r->routerId) > 0;
+      std::vector<const LSAChange*> reached;
+      for (std::vector<LSAChange>::const_iterator c = changes.begin (); c != changes.end () && !spf && !r->stub; c++)
+        {
+          if (r->distances[c->vertex] == SPF_INFINITY)
+            {
+              continue;
+            }
+          spf = ChangesTree (*r, *c);
+          reached.push_back (&*c);
+        }
+      for (std::vector<const LSAChange*>::const_iterator c = reached.begin (); c != reached.end () && !spf; c++)
+        {
+          spf = !PatchRoutes (*r, **c);
+        }
+      if (spf)
+        {
+          calculate.push_back (&*r);
+        }
+      else if (!reached.empty ())
+        {
+          patched++;
+        }
+    }
+  NS_LOG_INFO ("Changed " << changes.size () << " LSAs, SPF calculation of " << calculate.size () <<
+               " of " << m_roots.size () << " routers, " << patched << " patched");
+  CalculateRoots (calculate, true);
+
+  for (std::vector<LSAChange>::iterator c = changes.begin (); c != changes.end (); c++)
+    {
+      delete c->oldLsa;
+    }
+}
+
+//
+// This method is derived from quagga ospf_spf_next ().  See RFC2328 Section 
+// 16.1 (2) for further details.
+//
+// We're passed a parameter <v> that is a vertex which is already in the SPF
+// tree.  A vertex represents a router node.  We also get a reference to the
+// SPF candidate queue, which is a priority queue containing the shortest paths
+// to the networks we know about.
+//
+// We examine the links in v's LSA and update the list of candidates with any
+// vertices not already on the list.  If a lower-cost path is found to a
+// vertex already on the candidate list, store the new (lower) cost.
+//
+void
+GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
+{
+  NS_LOG_FUNCTION (this << v << &candidate);
+
+  SPFVertex* w = 0;
+  GlobalRoutingLSA* w_lsa = 0;
+  GlobalRoutingLinkRecord *l = 0;
+  uint32_t distance = 0;
+  uint32_t numRecordsInVertex = 0;
+//
+// V points to a Router-LSA or Network-LSA
+// Loop over the links in router LSA or attached routers in Network LSA
+//
+  if (v->GetVertexType () == SPFVertex::VertexRouter)
+    {
+      numRecordsInVertex = v->GetLSA ()->GetNLinkRecords (); 
+    }
+  if (v->GetVertexType () == SPFVertex::VertexNetwork)
+    {
+      numRecordsInVertex = v->GetLSA ()->GetNAttachedRouters (); 
+    }
+
+  for (uint32_t i = 0; i < numRecordsInVertex; i++)
+    {
+// Get w_lsa:  In case of V is Router-LSA
+      if (v->GetVertexType () == SPFVertex::VertexRouter) 
+        {
+          NS_LOG_LOGIC ("Examining link " << i << " of " << 
+                        v->GetVertexId () << "'s " <<
+                        v->GetLSA ()->GetNLinkRecords () << " link records");
+//
+// (a) If this is a link to a stub network, examine the next link in V's LSA.
+// Links to stub networks will be considered in the second stage of the
+// shortest path calculation.
+//
+          l = v->GetLSA ()->GetLinkRecord (i);
+          NS_ASSERT (l != 0);
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork)
+            {
+              NS_LOG_LOGIC ("Found a Stub record to " << l->GetLinkId ());
+              continue;
+            }
+//
+// (b) Otherwise, W is a transit vertex (router or transit network).  Look up
+// the vertex W's LSA (router-LSA or network-LSA) in Area A's link state
+// database. 
+//
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+            {
+//
+// Lookup the link state advertisement of the new link -- we call it <w> in
+// the link state database.
+//
+              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
+              NS_ASSERT (w_lsa);
+              NS_LOG_LOGIC ("Found a P2P record from " << 
+                            v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
+            }
+          else if (l->GetLinkType () == 
+                   GlobalRoutingLinkRecord::TransitNetwork)
+            {
+              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
+              NS_ASSERT (w_lsa);
+              NS_LOG_LOGIC ("Found a Transit record from " << 
+                            v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
+            }
+          else 
+            {
+              NS_ASSERT_MSG (0, "illegal Link Type");
+            }
+        }
+// Get w_lsa:  In case of V is Network-LSA
+      if (v->GetVertexType () == SPFVertex::VertexNetwork) 
+        {
+          w_lsa = m_lsdb->GetLSAByLinkData 
+              (v->GetLSA ()->GetAttachedRouter (i));
+          if (!w_lsa)
+            {
+              continue;
+            }
+          NS_LOG_LOGIC ("Found a Network LSA from " << 
+                        v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
+        }
+
+// Note:  w_lsa at this point may be either RouterLSA or NetworkLSA
+//
+// (c) If vertex W is already on the shortest-path tree, examine the next
+// link in the LSA.
+//
+// If the link is to a router that is already in the shortest path first tree
+// then we have it covered -- ignore it.
+//
+      if (GetLSAStatus (w_lsa) == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
+        {
+          NS_LOG_LOGIC ("Skipping ->  LSA "<< 
+                        w_lsa->GetLinkStateId () << " already in SPF tree");
+          continue;
+        }
+//
+// (d) Calculate the link state cost D of the resulting path from the root to 
+// vertex W.  D is equal to the sum of the link state cost of the (already 
+// calculated) shortest path to vertex V and the advertised cost of the link
+// between vertices V and W.
+//
+      if (v->GetLSA ()->GetLSType () == GlobalRoutingLSA::RouterLSA)
+        {
+          NS_ASSERT (l != 0);
+          distance = v->GetDistanceFromRoot () + l->GetMetric ();
+        }
+      else
+        {
+          distance = v->GetDistanceFromRoot ();
+        }
+
+      NS_LOG_LOGIC ("Considering w_lsa " << w_lsa->GetLinkStateId ());
+
+// Is there already vertex w in candidate list?
+      if (GetLSAStatus (w_lsa) == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
+        {
+// Calculate nexthop to w
+// We need to figure out how to actually get to the new router represented
+// by <w>.  This will (among other things) find the next hop address to send
+// packets destined for this network to, and also find the outbound interface
+// used to forward the packets.
+
+// prepare vertex w
+          w = new SPFVertex (w_lsa);
+          if (SPFNexthopCalculation (v, w, l, distance))
+            {
+              SetLSAStatus (w_lsa, GlobalRoutingLSA::LSA_SPF_CANDIDATE);
+//
+// Push this new vertex onto the priority queue (ordered by distance from the
+// root node).
+//
+              candidate.Push (w);
+              NS_LOG_LOGIC ("Pushing " << 
+                            w->GetVertexId () << ", parent vertexId: " <<
+                            v->GetVertexId () << ", distance: " <<
+                            w->GetDistanceFromRoot ());
+            }
+          else
+            NS_ASSERT_MSG (0, "SPFNexthopCalculation never " 
+                           << "return false, but it does now!");
+        }
+      else if (GetLSAStatus (w_lsa) == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
+        {
+//
+// We have already considered the link represented by <w>.  What wse have to
+// do now is to decide if this new router represents a route with a shorter
+// distance metric.
+//
+// So, locate the vertex in the candidate queue and take a look at the 
+// distance.
+
+/* (quagga-0.98.6) W is already on the candidate list; call it cw.
+* Compare the previously calculated cost (cw->distance)
+* with the cost we just determined (w->distance) to see
+* if we've found a shorter path.
+*/
+          SPFVertex* cw;
+          cw = candidate.Find (w_lsa->GetLinkStateId ());
+          if (cw->GetDistanceFromRoot () < distance)
+            {
+//
+// This is not a shorter path, so don't do anything.
+//
+              continue;
+            }
+          else if (cw->GetDistanceFromRoot () == distance)
+            {
+//
+// This path is one with an equal cost.
+//
+              NS_LOG_LOGIC ("Equal cost multiple paths found.");
+
+// At this point, there are two instances 'w' and 'cw' of the
 // same vertex, the vertex that is currently being considered
 // for adding into the shortest path tree. 'w' is the instance
 // as seen from the root via vertex 'v', and 'cw' is the instance 
@@ -959,7 +1606,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // If we've changed the cost to get to the vertex represented by <w>, we 
 // must reorder the priority queue keyed to that cost.
 //
-                  candidate.Reorder ();
+                  candidate.Reorder (cw);
                 }
             } // new lower cost path found
         } // end W is already on the candidate list
@@ -1277,76 +1924,218 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
           transitLink = l;
         }
     }
-  if (transits == 0)
+  if (transits == 0)
+    {
+      // This router is not connected to any router.  Probably, global
+      // routing should not be called for this node, but we can just raise
+      // a warning here and return true.
+      NS_LOG_WARN ("all nodes should have at least one transit link:" << root );
+      return true;
+    }
+  if (transits == 1)
+    {
+      if (transitLink->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork)
+        {
+          // Install default route to next hop router
+          // What is the next hop?  We need to check all neighbors on the link.
+          // If there is a single router that has two transit links, then
+          // that is the default next hop.  If there are more than one
+          // routers on link with multiple transit links, return false.
+          // Not yet implemented, so simply return false
+          NS_LOG_LOGIC ("TBD: Would have inserted default for transit");
+          return false;
+        }
+      else if (transitLink->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+        {
+          // Install default route to next hop
+          // The link record LinkID is the router ID of the peer.
+          // The Link Data is the local IP interface address
+          GlobalRoutingLSA *w_lsa = m_lsdb->GetLSA (transitLink->GetLinkId ());
+          uint32_t nLinkRecords = w_lsa->GetNLinkRecords ();
+          for (uint32_t j = 0; j < nLinkRecords; ++j)
+            {
+              //
+              // We are only concerned about point-to-point links
+              //
+              GlobalRoutingLinkRecord *lr = w_lsa->GetLinkRecord (j);
+              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+                {
+                  continue;
+                }
+              // Find the link record that corresponds to our routerId
+              if (lr->GetLinkId () == myRouterId)
+                {
+                  // Next hop is stored in the LinkID field of lr
+                  StagedRoute route;
+                  route.type = StagedRoute::NETWORK;
+                  route.dest = Ipv4Address ("0.0.0.0");
+                  route.mask = Ipv4Mask ("0.0.0.0");
+                  route.nextHop = lr->GetLinkData ();
+                  route.outIf = FindOutgoingInterfaceId (transitLink->GetLinkData ());
+                  m_routes->push_back (route);
+                  NS_LOG_LOGIC ("Inserting default route for node " << myRouterId << " to next hop " << 
+                                lr->GetLinkData () << " via interface " << 
+                                FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                  return true;
+                }
+            }
+        }
+    }
+  return false;
+}
+
+GlobalRoutingLSA::SPFStatus
+GlobalRouteManagerImpl::GetLSAStatus (const GlobalRoutingLSA* lsa) const
+{
+  std::unordered_map<const GlobalRoutingLSA*, GlobalRoutingLSA::SPFStatus>::const_iterator i = m_lsaStatus.find (lsa);
+  return i == m_lsaStatus.end () ? GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED : i->second;
+}
+
+void
+GlobalRouteManagerImpl::SetLSAStatus (const GlobalRoutingLSA* lsa, GlobalRoutingLSA::SPFStatus status)
+{
+  m_lsaStatus[lsa] = status;
+}
+
+bool
+GlobalRouteManagerImpl::ResolveRoot (Ipv4Address routerId, SPFRoot& root) const
+{
+  NS_LOG_FUNCTION (this << routerId);
+  root.routerId = routerId;
+  root.keepDistances = false;
+  root.stub = false;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<GlobalRouter> rtr = (*i)->GetObject<GlobalRouter> ();
+      if (rtr != 0 && rtr->GetRouterId () == routerId)
+        {
+          root.ipv4 = (*i)->GetObject<Ipv4> ();
+          NS_ASSERT_MSG (root.ipv4, 
+                         "GlobalRouteManagerImpl::ResolveRoot (): "
+                         "GetObject for <Ipv4> interface failed");
+          root.routing = rtr->GetRoutingProtocol ();
+          return true;
+        }
+    }
+  NS_LOG_LOGIC ("ResolveRoot():Can't find root node " << routerId);
+  return false;
+}
+
+void
+GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
+{
+  NS_LOG_FUNCTION (this << root);
+  SPFRoot spfRoot;
+  ResolveRoot (root, spfRoot);
+  SPFCalculateRoutes (spfRoot);
+  InstallRoutes (spfRoot, false);
+}
+
+void
+GlobalRouteManagerImpl::InstallRoutes (SPFRoot& root, bool replace)
+{
+  NS_LOG_FUNCTION (this << root.routerId << root.routes.size () << replace);
+  if (root.routing == 0)
+    {
+      root.routes.clear ();
+      return;
+    }
+  if (replace)
+    {
+      std::vector<Ipv4RoutingTableEntry> hostRoutes;
+      std::vector<Ipv4RoutingTableEntry> networkRoutes;
+      std::vector<Ipv4RoutingTableEntry> externalRoutes;
+      for (StagedRoutes_t::const_iterator i = root.routes.begin (); i != root.routes.end (); i++)
+        {
+          switch (i->type)
+            {
+            case StagedRoute::HOST:
+              hostRoutes.push_back (Ipv4RoutingTableEntry::CreateHostRouteTo (i->dest, i->nextHop, i->outIf));
+              break;
+            case StagedRoute::NETWORK:
+              networkRoutes.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (i->dest, i->mask, i->nextHop, i->outIf));
+              break;
+            case StagedRoute::EXTERNAL:
+              externalRoutes.push_back (Ipv4RoutingTableEntry::CreateNetworkRouteTo (i->dest, i->mask, i->nextHop, i->outIf));
+              break;
+            }
+        }
+      root.routing->SetRoutes (hostRoutes, networkRoutes, externalRoutes);
+      root.routes.clear ();
+      return;
+    }
+  for (StagedRoutes_t::const_iterator i = root.routes.begin (); i != root.routes.end (); i++)
     {
-      // This router is not connected to any router.  Probably, global
-      // routing should not be called for this node, but we can just raise
-      // a warning here and return true.
-      NS_LOG_WARN ("all nodes should have at least one transit link:" << root );
-      return true;
+      switch (i->type)
+        {
+        case StagedRoute::HOST:
+          root.routing->AddHostRouteTo (i->dest, i->nextHop, i->outIf);
+          break;
+        case StagedRoute::NETWORK:
+          root.routing->AddNetworkRouteTo (i->dest, i->mask, i->nextHop, i->outIf);
+          break;
+        case StagedRoute::EXTERNAL:
+          root.routing->AddASExternalRouteTo (i->dest, i->mask, i->nextHop, i->outIf);
+          break;
+        }
     }
-  if (transits == 1)
+  root.routes.clear ();
+}
+
+void
+GlobalRouteManagerImpl::StageRoutes (StagedRoute::Type type, Ipv4Address dest, Ipv4Mask mask, SPFVertex* v)
+{
+  NS_LOG_FUNCTION (this << type << dest << mask << v);
+  // walk through all available exit directions due to ECMP,
+  // and add a route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
     {
-      if (transitLink->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork)
+      SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
+      Ipv4Address nextHop = exit.first;
+      int32_t outIf = exit.second;
+      if (outIf >= 0)
         {
-          // Install default route to next hop router
-          // What is the next hop?  We need to check all neighbors on the link.
-          // If there is a single router that has two transit links, then
-          // that is the default next hop.  If there are more than one
-          // routers on link with multiple transit links, return false.
-          // Not yet implemented, so simply return false
-          NS_LOG_LOGIC ("TBD: Would have inserted default for transit");
-          return false;
+          StagedRoute route;
+          route.type = type;
+          route.dest = dest;
+          route.mask = mask;
+          route.nextHop = nextHop;
+          route.outIf = outIf;
+          m_routes->push_back (route);
+          NS_LOG_LOGIC ("(Route " << i << ") Router " << m_spfroot->GetVertexId () <<
+                        " add route to " << dest << "/" << mask <<
+                        " using next hop " << nextHop <<
+                        " via interface " << outIf);
         }
-      else if (transitLink->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+      else
         {
-          // Install default route to next hop
-          // The link record LinkID is the router ID of the peer.
-          // The Link Data is the local IP interface address
-          GlobalRoutingLSA *w_lsa = m_lsdb->GetLSA (transitLink->GetLinkId ());
-          uint32_t nLinkRecords = w_lsa->GetNLinkRecords ();
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
-              //
-              // We are only concerned about point-to-point links
-              //
-              GlobalRoutingLinkRecord *lr = w_lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
-              // Find the link record that corresponds to our routerId
-              if (lr->GetLinkId () == myRouterId)
-                {
-                  // Next hop is stored in the LinkID field of lr
-                  Ptr<GlobalRouter> router = rlsa->GetNode ()->GetObject<GlobalRouter> ();
-                  NS_ASSERT (router);
-                  Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-                  NS_ASSERT (gr);
-                  gr->AddNetworkRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), lr->GetLinkData (), 
-                                         FindOutgoingInterfaceId (transitLink->GetLinkData ()));
-                  NS_LOG_LOGIC ("Inserting default route for node " << myRouterId << " to next hop " << 
-                                lr->GetLinkData () << " via interface " << 
-                                FindOutgoingInterfaceId (transitLink->GetLinkData ()));
-                  return true;
-                }
-            }
+          NS_LOG_LOGIC ("(Route " << i << ") Router " << m_spfroot->GetVertexId () <<
+                        " NOT able to add route to " << dest <<
+                        " using next hop " << nextHop <<
+                        " since outgoing interface id is negative " << outIf);
         }
     }
-  return false;
 }
 
 // quagga ospf_spf_calculate
 void
-GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
+GlobalRouteManagerImpl::SPFCalculateRoutes (SPFRoot& spfRoot)
 {
+  Ipv4Address root = spfRoot.routerId;
   NS_LOG_FUNCTION (this << root);
 
   SPFVertex *v;
 //
-// Initialize the Link State Database.
+// The SPF state of the LSAs (and the node the routes are for) belong to
+// this root only.
 //
-  m_lsdb->Initialize ();
+  m_lsaStatus.clear ();
+  m_spfrootIpv4 = spfRoot.ipv4;
+  m_routes = &spfRoot.routes;
+  spfRoot.stub = false;
+  spfRoot.distances.clear ();
 //
 // The candidate queue is a priority queue of SPFVertex objects, with the top
 // of the queue being the closest vertex in terms of distance from the root
@@ -1366,7 +2155,7 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 //
   m_spfroot= v;
   v->SetDistanceFromRoot (0);
-  v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+  SetLSAStatus (v->GetLSA (), GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
   NS_LOG_LOGIC ("Starting SPFCalculate for node " << root);
 
 //
@@ -1376,12 +2165,21 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // reached.  Instead, short-circuit this computation and just install
 // a default route in the CheckForStubNode() method.
 //
-  if (NodeList::GetNNodes () > 0 && CheckForStubNode (root))
+  if (spfRoot.routing != 0 && CheckForStubNode (root))
     {
       NS_LOG_LOGIC ("SPFCalculate truncated for stub node " << root);
+      spfRoot.stub = true;
       delete m_spfroot;
+      m_spfroot = 0;
+      m_spfrootIpv4 = 0;
+      m_routes = 0;
       return;
     }
+  if (spfRoot.keepDistances)
+    {
+      spfRoot.distances.assign (m_lsdb->GetNumVertices (), SPF_INFINITY);
+      spfRoot.distances[m_lsdb->GetVertexIndex (root)] = 0;
+    }
 
   for (;;)
     {
@@ -1427,7 +2225,11 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // Update the status field of the vertex to indicate that it is in the SPF
 // tree.
 //
-      v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+      SetLSAStatus (v->GetLSA (), GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+      if (spfRoot.keepDistances)
+        {
+          spfRoot.distances[m_lsdb->GetVertexIndex (v->GetVertexId ())] = v->GetDistanceFromRoot ();
+        }
 //
 // The current vertex has a parent pointer.  By calling this rather oddly 
 // named method (blame quagga) we add the current vertex to the list of 
@@ -1501,6 +2303,8 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 //
   delete m_spfroot;
   m_spfroot = 0;
+  m_spfrootIpv4 = 0;
+  m_routes = 0;
 }
 
 void
@@ -1554,110 +2358,22 @@ GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v
     }
   NS_LOG_LOGIC ("External is on remote host: " 
                 << extlsa->GetAdvertisingRouter () << "; installing");
-
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
+// The routes go to the node at the root of the SPF tree, once the
+// calculation is done.
 //
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFAddASExternal (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
 //
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
+// The vertex <v> has the next hops and outgoing interfaces from the root
+// towards the advertising router, possibly inherited from the root; the
+// external network is reached through each of them.
 //
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  StageRoutes (StagedRoute::EXTERNAL, tempip, tempmask, v);
 }
 
 
@@ -1719,116 +2435,22 @@ GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex*
   NS_LOG_LOGIC ("Stub is on remote host: " << v->GetVertexId () << "; installing");
 //
 // The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+// going to write the actual routing table entries, once the calculation is
+// done.
+//
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFIntraAddStub (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
+//
+// The vertex <v> (corresponding to the node that has the stub network) has
+// the next hop addresses precalculated for us, to which the root node should
+// send packets to be forwarded to the stub network, and the outbound
+// interfaces (m_rootOif) to which the packets should be sent.
+//
+  StageRoutes (StagedRoute::NETWORK, tempip, tempmask, v);
 }
 
 //
@@ -1843,70 +2465,30 @@ GlobalRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
 {
   NS_LOG_FUNCTION (this << a << amask);
 //
-// We have an IP address <a> and a vertex ID of the root of the SPF tree.
-// The question is what interface index does this address correspond to.
-// The answer is a little complicated since we have to find a pointer to
-// the node corresponding to the vertex ID, find the Ipv4 interface on that
-// node in order to iterate the interfaces and find the one corresponding to
-// the address in question.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-//
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
+// We have an IP address <a> and the Ipv4 of the node at the root of the SPF
+// tree, resolved before the calculation.  This is the node for which we are
 // building the routing table.
 //
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  if (m_spfrootIpv4 == 0)
     {
-      Ptr<Node> node = *i;
-
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-//
-// If the node doesn't have a GlobalRouter interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
-        {
-          continue;
-        }
-
-      if (rtr->GetRouterId () == routerId)
-        {
-//
-// This is the node we're building the routing table for.  We're going to need
-// the Ipv4 interface to look for the ipv4 interface index.  Since this node
-// is participating in routing IP version 4 packets, it certainly must have 
-// an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4> interface failed");
+      NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << m_spfroot->GetVertexId ());
+      return -1;
+    }
 //
 // Look through the interfaces on this node for one that has the IP address
 // we're looking for.  If we find one, return the corresponding interface
 // index, or -1 if not found.
 //
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
+  int32_t interface = m_spfrootIpv4->GetInterfaceForPrefix (a, amask);
 
 #if 0
-          if (interface < 0)
-            {
-              NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
-            }
-#endif 
-          return interface;
-        }
+  if (interface < 0)
+    {
+      NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
+                      "Expected an interface associated with address a:" << a);
     }
-//
-// Couldn't find it.
-//
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
-  return -1;
+#endif 
+  return interface;
 }
 
 //
@@ -1934,69 +2516,22 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
                  "GlobalRouteManagerImpl::SPFIntraAddRouter (): Root pointer not set");
 //
 // The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
+// going to write the actual routing table entries, once the calculation is
+// done.
 //
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4> interface failed");
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in SPFVertex* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -2005,18 +2540,18 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  NS_LOG_LOGIC (" Router " << m_spfroot->GetVertexId () <<
+                " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -2030,44 +2565,7 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-              Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              // walk through all available exit directions due to ECMP,
-              // and add host route for each of the exit direction toward
-              // the vertex 'v'
-              for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-                {
-                  SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-                  Ipv4Address nextHop = exit.first;
-                  int32_t outIf = exit.second;
-                  if (outIf >= 0)
-                    {
-                      gr->AddHostRouteTo (lr->GetLinkData (), nextHop,
-                                          outIf);
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " adding host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " and outgoing interface " << outIf);
-                    }
-                  else
-                    {
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " NOT able to add host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " since outgoing interface id is negative " << outIf);
-                    }
-                } // for all routes from the root the vertex 'v'
-            }
-//
-// Done adding the routes for the selected node.
-//
-          return;
-        }
+      StageRoutes (StagedRoute::HOST, lr->GetLinkData (), Ipv4Mask::GetOnes (), v);
     }
 }
 void
@@ -2079,104 +2577,22 @@ GlobalRouteManagerImpl::SPFIntraAddTransit (SPFVertex* v)
                  "GlobalRouteManagerImpl::SPFIntraAddTransit (): Root pointer not set");
 //
 // The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
+// going to write the actual routing table entries, once the calculation is
+// done.
 //
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4> interface failed");
+  NS_LOG_LOGIC ("Vertex ID = " << m_spfroot->GetVertexId ());
 //
 // Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
-        }
-    } 
+// adding the routes to.  The LSA describes the transit network.
+//
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  StageRoutes (StagedRoute::NETWORK, tempip, tempmask, v);
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
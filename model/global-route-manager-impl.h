@@ -27,6 +27,7 @@
 #include <queue>
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include "ns3/object.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-address.h"
@@ -37,7 +38,9 @@ namespace ns3 {
 const uint32_t SPF_INFINITY = 0xffffffff; //!< "infinite" distance between nodes
 
 class CandidateQueue;
+class Ipv4;
 class Ipv4GlobalRouting;
+class Node;
 
 /**
  * \ingroup globalrouting
@@ -674,6 +677,41 @@ public:
    */
   uint32_t GetNumExtLSAs () const;
 
+  /**
+   * @brief Replace the Link State Advertisement of a link state ID.
+   *
+   * @param addr the link state ID, already in the database
+   * @param lsa the new Link State Advertisement
+   * @returns the Link State Advertisement replaced, now owned by the caller
+   */
+  GlobalRoutingLSA* Replace (Ipv4Address addr, GlobalRoutingLSA* lsa);
+
+  /**
+   * @brief Get the index of the SPF vertex of a link state ID.
+   *
+   * The router and network LSAs are numbered in the order they are first
+   * inserted; the index of a link state ID does not change when its LSA is
+   * replaced.
+   *
+   * @param addr the link state ID
+   * @returns the index, or SPF_INFINITY if no LSA has this link state ID
+   */
+  uint32_t GetVertexIndex (Ipv4Address addr) const;
+
+  /**
+   * @brief Get the number of link state IDs of router and network LSAs.
+   *
+   * @returns the number of vertex indexes
+   */
+  uint32_t GetNumVertices () const;
+
+  /**
+   * @brief Get the number of Network LSAs.
+   *
+   * @returns the number of Network LSAs
+   */
+  uint32_t GetNumNetworkLSAs () const;
+
 
 private:
   typedef std::map<Ipv4Address, GlobalRoutingLSA*> LSDBMap_t; //!< container of IPv4 addresses / Link State Advertisements
@@ -681,6 +719,8 @@ private:
 
   LSDBMap_t m_database; //!< database of IPv4 addresses / Link State Advertisements
   std::vector<GlobalRoutingLSA*> m_extdatabase; //!< database of External Link State Advertisements
+  /// index of the SPF vertex of each link state ID of m_database
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_vertexIndex;
 
 /**
  * @brief GlobalRouteManagerLSDB copy construction is disallowed.  There's no 
@@ -708,6 +748,23 @@ private:
  * and finally configure each of the node's forwarding tables.
  *
  * The design is guided by OSPFv2 \RFC{2328} section 16.1.1 and quagga ospfd.
+ *
+ * The SPF calculation of a root only reads the LSDB: the SPF status of the
+ * LSAs is kept per calculation, and the routes are staged and installed in
+ * the forwarding table of the root once the calculation is done. With the
+ * "GlobalRoutingThreads" global value above 1, InitializeRoutes calculates
+ * the roots on that many threads, then installs all the routes in the order
+ * of a serial run.
+ *
+ * With the "GlobalRoutingIncremental" global value, InitializeRoutes keeps
+ * the distance of every vertex from every root, and UpdateRoutes handles the
+ * change of the point-to-point interfaces of a node incrementally: only the
+ * LSAs of the node and of its neighbors are discovered again, and only the
+ * roots whose shortest paths may go through a link added or removed get a
+ * new SPF calculation. For the other roots that reach a changed router, the
+ * tree is the same, and the routes to the addresses and stub networks of the
+ * router are replaced in place. The forwarding tables are those of a full
+ * recomputation, route for route and in the same order.
  */
 class GlobalRouteManagerImpl
 {
@@ -735,6 +792,18 @@ public:
  */
   virtual void InitializeRoutes ();
 
+/**
+ * @brief Update the routing database and the forwarding tables after a
+ * change of the interfaces of a node
+ *
+ * Without the "GlobalRoutingIncremental" global value, or for a change that
+ * the incremental update does not cover, this deletes the global routes,
+ * rebuilds the routing database and initializes the routes again.
+ *
+ * @param node the node whose interfaces changed
+ */
+  virtual void UpdateRoutes (Ptr<Node> node);
+
 /**
  * @brief Debugging routine; allow client code to supply a pre-built LSDB
  */
@@ -766,8 +835,160 @@ private:
  */
   GlobalRouteManagerImpl& operator= (GlobalRouteManagerImpl& srmi);
 
+/**
+ * @brief Create a worker of the parallel SPF calculation, computing the
+ * routes of some roots from the LSDB of the manager.
+ *
+ * @param lsdb the LSDB, read only and not owned
+ */
+  explicit GlobalRouteManagerImpl (GlobalRouteManagerLSDB* lsdb);
+
+  /// A route found by the SPF calculation, installed once the calculation is done
+  struct StagedRoute
+  {
+    /// Kind of route
+    enum Type
+    {
+      HOST,     //!< Ipv4GlobalRouting::AddHostRouteTo
+      NETWORK,  //!< Ipv4GlobalRouting::AddNetworkRouteTo
+      EXTERNAL  //!< Ipv4GlobalRouting::AddASExternalRouteTo
+    };
+    Type type;            //!< kind of route
+    Ipv4Address dest;     //!< destination host or network
+    Ipv4Mask mask;        //!< destination mask, unused for HOST
+    Ipv4Address nextHop;  //!< next hop
+    uint32_t outIf;       //!< outgoing interface
+  };
+  typedef std::vector<StagedRoute> StagedRoutes_t; //!< routes of one root
+
+  /// A root of the SPF calculation, resolved before the calculation
+  struct SPFRoot
+  {
+    Ipv4Address routerId;           //!< router ID of the root
+    Ptr<Ipv4> ipv4;                 //!< Ipv4 of the root node
+    Ptr<Ipv4GlobalRouting> routing; //!< routing protocol the routes go to
+    StagedRoutes_t routes;          //!< routes found for the root
+    bool keepDistances;             //!< keep the distances of the vertices
+    bool stub;                      //!< routes set by CheckForStubNode, without SPF tree
+    /// distance of each vertex from the root, by LSDB vertex index, if kept
+    std::vector<uint32_t> distances;
+  };
+
+  /// A router LSA changed by UpdateRoutes
+  struct LSAChange
+  {
+    GlobalRoutingLSA* oldLsa;  //!< LSA replaced, no longer in the LSDB
+    GlobalRoutingLSA* newLsa;  //!< LSA in the LSDB
+    uint32_t vertex;           //!< LSDB vertex index of the router
+    bool reordered;            //!< the point-to-point links kept are in another order
+    /// point-to-point links removed: LSDB vertex index of the neighbor, metric
+    std::vector<std::pair<uint32_t, uint32_t> > removed;
+    /// point-to-point links added: LSDB vertex index of the neighbor, metric
+    std::vector<std::pair<uint32_t, uint32_t> > added;
+  };
+
   SPFVertex* m_spfroot; //!< the root node
   GlobalRouteManagerLSDB* m_lsdb; //!< the Link State DataBase (LSDB) of the Global Route Manager
+  bool m_ownsLsdb;      //!< m_lsdb is deleted with the manager (not a worker)
+  Ptr<Ipv4> m_spfrootIpv4;  //!< Ipv4 of the root node, 0 if it has none
+  StagedRoutes_t* m_routes; //!< routes found for the current root
+  bool m_incremental;       //!< m_roots and their distances are kept for UpdateRoutes
+  std::vector<SPFRoot> m_roots; //!< roots of the last InitializeRoutes, if m_incremental
+  /// SPF status of the LSAs for the current root; absent means LSA_SPF_NOT_EXPLORED
+  std::unordered_map<const GlobalRoutingLSA*, GlobalRoutingLSA::SPFStatus> m_lsaStatus;
+
+  /**
+   * \param lsa an LSA
+   * \returns the SPF status of the LSA for the current root
+   */
+  GlobalRoutingLSA::SPFStatus GetLSAStatus (const GlobalRoutingLSA* lsa) const;
+
+  /**
+   * \brief Set the SPF status of an LSA for the current root
+   * \param lsa the LSA
+   * \param status the status
+   */
+  void SetLSAStatus (const GlobalRoutingLSA* lsa, GlobalRoutingLSA::SPFStatus status);
+
+  /**
+   * \brief Find the node of a router
+   * \param routerId the router ID
+   * \param root the root to fill in
+   * \returns true if a node has this router ID
+   */
+  bool ResolveRoot (Ipv4Address routerId, SPFRoot& root) const;
+
+  /**
+   * \brief Calculate the routes of a root, staged in root.routes
+   *
+   * Touches nothing but the root and the LSDB, so that several workers
+   * can calculate the routes of different roots at the same time.
+   * \param root the root
+   */
+  void SPFCalculateRoutes (SPFRoot& root);
+
+  /**
+   * \brief Install the staged routes of a root in its routing protocol
+   * \param root the root
+   * \param replace replace the routes of the table rather than add to them
+   */
+  void InstallRoutes (SPFRoot& root, bool replace);
+
+  /**
+   * \brief Calculate and install the routes of roots, on the
+   * "GlobalRoutingThreads" threads
+   * \param roots the roots
+   * \param replace replace the routes of the tables rather than add to them
+   */
+  void CalculateRoots (const std::vector<SPFRoot*>& roots, bool replace);
+
+  /**
+   * \brief Delete the global routes, build the routing database and
+   * initialize the routes
+   */
+  void RecomputeRoutes ();
+
+  /**
+   * \brief Find the routers whose LSAs depend on the interfaces of a node
+   * \param node the node
+   * \param routers the node and its point-to-point neighbors, if global routers
+   * \returns false if the node has other than point-to-point devices
+   */
+  bool FindAffectedRouters (Ptr<Node> node, std::vector<Ptr<GlobalRouter> >& routers) const;
+
+  /**
+   * \brief Compare the point-to-point links of two LSAs of a router
+   * \param change the change, with oldLsa and newLsa set, to fill in
+   * \returns false if a link goes to a router missing from the LSDB
+   */
+  bool CompareLinks (LSAChange& change) const;
+
+  /**
+   * \brief Test if the shortest paths of a root may go through a link that
+   * changed
+   * \param root the root, not a stub, with its distances
+   * \param change the change of a router LSA
+   * \returns true if the SPF tree of the root may change
+   */
+  bool ChangesTree (const SPFRoot& root, const LSAChange& change) const;
+
+  /**
+   * \brief Replace the routes of a root to the addresses and stub networks of
+   * a changed router, which the SPF tree of the root reaches unchanged
+   * \param root the root
+   * \param change the change of the router LSA
+   * \returns false if the routes could not be located in the table
+   */
+  bool PatchRoutes (SPFRoot& root, const LSAChange& change) const;
+
+  /**
+   * \brief Stage a route to every exit direction of a vertex
+   * \param type the kind of route
+   * \param dest the destination
+   * \param mask the destination mask
+   * \param v the vertex whose exit directions the route goes through
+   */
+  void StageRoutes (StagedRoute::Type type, Ipv4Address dest, Ipv4Mask mask, SPFVertex* v);
 
   /**
    * \brief Test if a node is a stub, from an OSPF sense.
@@ -782,7 +1003,8 @@ private:
   bool CheckForStubNode (Ipv4Address root);
 
   /**
-   * \brief Calculate the shortest path first (SPF) tree
+   * \brief Calculate the shortest path first (SPF) tree of a root, and install
+   * the routes of the root
    *
    * Equivalent to quagga ospf_spf_calculate
    * \param root the root node
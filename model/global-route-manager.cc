@@ -21,6 +21,7 @@
 #include "ns3/assert.h"
 #include "ns3/log.h"
 #include "ns3/simulation-singleton.h"
+#include "ns3/node.h"
 #include "global-route-manager.h"
 #include "global-route-manager-impl.h"
 
@@ -58,6 +59,14 @@ GlobalRouteManager::InitializeRoutes (void)
   InitializeRoutes ();
 }
 
+void
+GlobalRouteManager::UpdateRoutes (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (node);
+  SimulationSingleton<GlobalRouteManagerImpl>::Get ()->
+  UpdateRoutes (node);
+}
+
 uint32_t
 GlobalRouteManager::AllocateRouterId (void)
 {
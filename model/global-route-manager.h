@@ -22,8 +22,12 @@
 #ifndef GLOBAL_ROUTE_MANAGER_H
 #define GLOBAL_ROUTE_MANAGER_H
 
+#include "ns3/ptr.h"
+
 namespace ns3 {
 
+class Node;
+
 /**
  * \ingroup globalrouting
  *
@@ -65,6 +69,18 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Update the routing database and the forwarding tables after a
+ * change of the interfaces of a node
+ *
+ * With the "GlobalRoutingIncremental" global value, only the routers whose
+ * routes may change get a new SPF calculation; otherwise all routes are
+ * deleted and computed again.
+ *
+ * @param node the node whose interfaces changed
+ */
+  static void UpdateRoutes (Ptr<Node> node);
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
@@ -47,6 +47,13 @@
  *   routes, build global routing database, and initialize routes.
  *   There is a helper method that encapsulates this 
  *   (Ipv4GlobalRoutingHelper::RecomputeRoutingTables())
+ *
+ * With the "GlobalRoutingIncremental" global value set to true, the
+ * interface events call GlobalRouteManager::UpdateRoutes () for the node,
+ * which rediscovers the LSAs of the node and of its point-to-point
+ * neighbors only, and recalculates only the roots whose shortest paths may
+ * change; the other tables are patched in place.  Topologies with network
+ * LSAs (shared channels with several routers) are always recomputed.
  * 
  * \section api API and Usage
  * 
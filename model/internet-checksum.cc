@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cstring>
+#include "internet-checksum.h"
+
+namespace ns3 {
+
+/**
+ * \brief Fold a sum of 16 bit words to 16 bits
+ * \param sum the sum
+ * \return the folded sum
+ */
+static uint16_t
+Fold (uint64_t sum)
+{
+  while (sum >> 16)
+    {
+      sum = (sum & 0xffff) + (sum >> 16);
+    }
+  return static_cast<uint16_t> (sum);
+}
+
+/**
+ * \brief Swap the bytes of a 16 bit value
+ * \param value the value
+ * \return the swapped value
+ */
+static uint16_t
+Swap (uint16_t value)
+{
+  return static_cast<uint16_t> ((value << 8) | (value >> 8));
+}
+
+uint16_t
+ChecksumSum (const uint8_t *data, uint32_t size, uint16_t sum)
+{
+  // The words are added in host order; the one's complement sum does not
+  // depend on the byte order, so only the result is swapped back
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const bool swap = true;
+#else
+  const bool swap = false;
+#endif
+
+  // Two accumulators of 32 bit lanes: 2^32 lanes before any overflow
+  uint64_t a = 0;
+  uint64_t b = 0;
+  while (size >= 16)
+    {
+      uint64_t w[2];
+      std::memcpy (w, data, 16);
+      a += (w[0] & 0xffffffff) + (w[0] >> 32);
+      b += (w[1] & 0xffffffff) + (w[1] >> 32);
+      data += 16;
+      size -= 16;
+    }
+  a += b;
+  while (size >= 2)
+    {
+      uint16_t w;
+      std::memcpy (&w, data, 2);
+      a += w;
+      data += 2;
+      size -= 2;
+    }
+  if (size)
+    {
+      uint8_t last[2] = { data[0], 0 };
+      uint16_t w;
+      std::memcpy (&w, last, 2);
+      a += w;
+    }
+
+  uint16_t folded = Fold (a);
+  return ChecksumAdd (sum, swap ? Swap (folded) : folded);
+}
+
+uint16_t
+ChecksumAdd (uint16_t sum, uint16_t add, uint32_t offset)
+{
+  if (offset % 2)
+    {
+      add = Swap (add);
+    }
+  return Fold (uint32_t (sum) + add);
+}
+
+} // namespace ns3
@@ -0,0 +1,61 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef INTERNET_CHECKSUM_H
+#define INTERNET_CHECKSUM_H
+
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief One's complement sum of a byte range (RFC 1071)
+ *
+ * The sum is folded to 16 bits but not complemented, so that partial sums
+ * of a pseudo-header, a header and a payload can be computed apart and
+ * added with ChecksumAdd. The bytes are read as big-endian 16 bit words;
+ * an odd last byte is padded with a zero.
+ *
+ * The kernel adds the data as 32 bit lanes of 64 bit words into 64 bit
+ * accumulators and folds the carries once at the end, a loop compilers
+ * turn into SIMD additions.
+ *
+ * \param data the first byte
+ * \param size the number of bytes
+ * \param sum the partial sum to start from
+ * \return the folded sum, in host order
+ */
+uint16_t ChecksumSum (const uint8_t *data, uint32_t size, uint16_t sum = 0);
+
+/**
+ * \ingroup internet
+ *
+ * \brief One's complement addition of two partial sums
+ *
+ * \param sum a partial sum
+ * \param add a partial sum
+ * \param offset the offset of the bytes summed in add from those summed in
+ * sum; when odd, add is byte swapped (RFC 1071, byte order independence)
+ * \return the folded sum
+ */
+uint16_t ChecksumAdd (uint16_t sum, uint16_t add, uint32_t offset = 0);
+
+} // namespace ns3
+
+#endif /* INTERNET_CHECKSUM_H */
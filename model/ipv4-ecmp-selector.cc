@@ -0,0 +1,220 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include "ipv4-ecmp-selector.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-routing-table-entry.h"
+#include "ns3/boolean.h"
+#include "tcp-l4-protocol.h"
+#include "udp-l4-protocol.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4EcmpSelector");
+
+NS_OBJECT_ENSURE_REGISTERED (Ipv4EcmpSelector);
+
+TypeId
+Ipv4EcmpSelector::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Ipv4EcmpSelector")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<Ipv4EcmpSelector> ()
+    .AddAttribute ("Seed",
+                   "Seed of the flow hash",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4EcmpSelector::m_seed),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FlowletTimeout",
+                   "Idle time after which a flow may change route, 0 to keep flows on their route",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&Ipv4EcmpSelector::m_flowletTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("CountLoad",
+                   "Count the packets and bytes routed to each next hop",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4EcmpSelector::m_countLoad),
+                   MakeBooleanChecker ())
+  ;
+  return tid;
+}
+
+Ipv4EcmpSelector::Ipv4EcmpSelector ()
+  : m_seed (0),
+    m_flowletSweep (1024),
+    m_countLoad (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ipv4EcmpSelector::~Ipv4EcmpSelector ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+/**
+ * \brief Mix the bits of a word (the finalizer of MurmurHash3)
+ * \param x the word
+ * \return the mixed word
+ */
+static uint64_t
+Mix (uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+uint64_t
+Ipv4EcmpSelector::HashFlow (const Ipv4Header &header, Ptr<const Packet> p) const
+{
+  uint64_t addresses = (uint64_t (header.GetSource ().Get ()) << 32) | header.GetDestination ().Get ();
+  uint64_t rest = uint64_t (header.GetProtocol ()) << 32;
+  // the ports are the first four bytes of the TCP and UDP headers; the
+  // fragments of a packet have no ports but its first, so none is used
+  if (p != 0 && (header.GetProtocol () == TcpL4Protocol::PROT_NUMBER || header.GetProtocol () == UdpL4Protocol::PROT_NUMBER)
+      && header.GetFragmentOffset () == 0 && header.IsLastFragment () && p->GetSize () >= 4)
+    {
+      uint8_t ports[4];
+      p->CopyData (ports, 4);
+      rest |= (uint32_t (ports[0]) << 24) | (uint32_t (ports[1]) << 16) | (uint32_t (ports[2]) << 8) | ports[3];
+    }
+  return Mix (Mix (addresses ^ m_seed) ^ rest);
+}
+
+uint32_t
+Ipv4EcmpSelector::GetFlowlet (uint64_t flow)
+{
+  Time now = Simulator::Now ();
+  if (m_flowlets.size () >= m_flowletSweep)
+    {
+      // the flows idle for longer than the timeout start a new flowlet at
+      // their next packet, which may as well be their first
+      for (std::unordered_map<uint64_t, Flowlet>::iterator i = m_flowlets.begin (); i != m_flowlets.end (); )
+        {
+          if (now - i->second.last > m_flowletTimeout)
+            {
+              i = m_flowlets.erase (i);
+            }
+          else
+            {
+              i++;
+            }
+        }
+      m_flowletSweep = std::max<std::size_t> (1024, 2 * m_flowlets.size ());
+    }
+  std::pair<std::unordered_map<uint64_t, Flowlet>::iterator, bool> inserted =
+    m_flowlets.insert (std::make_pair (flow, Flowlet ()));
+  Flowlet &flowlet = inserted.first->second;
+  if (inserted.second)
+    {
+      flowlet.id = 0;
+    }
+  else if (now - flowlet.last > m_flowletTimeout)
+    {
+      flowlet.id++;
+      NS_LOG_LOGIC ("Flow " << flow << " starts flowlet " << flowlet.id);
+    }
+  flowlet.last = now;
+  return flowlet.id;
+}
+
+uint32_t
+Ipv4EcmpSelector::Select (const Ipv4Header &header, Ptr<const Packet> p,
+                          const std::vector<Ipv4RoutingTableEntry *> &routes, uint32_t n)
+{
+  NS_LOG_FUNCTION (this << header << p << n);
+  NS_ASSERT (n > 0 && n <= routes.size ());
+  if (n == 1)
+    {
+      return 0;
+    }
+  uint64_t flow = HashFlow (header, p);
+  if (!m_flowletTimeout.IsZero ())
+    {
+      flow = Mix (flow + GetFlowlet (flow));
+    }
+  // rendezvous hashing: the route of heaviest weight, the first on a tie
+  uint32_t select = 0;
+  uint64_t heaviest = 0;
+  for (uint32_t i = 0; i < n; i++)
+    {
+      uint64_t nextHop = (uint64_t (routes[i]->GetInterface ()) << 32) | routes[i]->GetGateway ().Get ();
+      uint64_t weight = Mix (flow ^ Mix (nextHop));
+      if (i == 0 || weight > heaviest)
+        {
+          select = i;
+          heaviest = weight;
+        }
+    }
+  return select;
+}
+
+void
+Ipv4EcmpSelector::CountLoad (const Ipv4RoutingTableEntry &route, Ptr<const Packet> p)
+{
+  if (!m_countLoad)
+    {
+      return;
+    }
+  Load &load = m_load[NextHop (route.GetInterface (), route.GetGateway ().Get ())];
+  load.packets++;
+  load.bytes += p->GetSize ();
+}
+
+uint64_t
+Ipv4EcmpSelector::GetPackets (uint32_t interface, Ipv4Address gateway) const
+{
+  std::map<NextHop, Load>::const_iterator i = m_load.find (NextHop (interface, gateway.Get ()));
+  return i == m_load.end () ? 0 : i->second.packets;
+}
+
+uint64_t
+Ipv4EcmpSelector::GetBytes (uint32_t interface, Ipv4Address gateway) const
+{
+  std::map<NextHop, Load>::const_iterator i = m_load.find (NextHop (interface, gateway.Get ()));
+  return i == m_load.end () ? 0 : i->second.bytes;
+}
+
+void
+Ipv4EcmpSelector::PrintLoad (std::ostream &os) const
+{
+  for (std::map<NextHop, Load>::const_iterator i = m_load.begin (); i != m_load.end (); i++)
+    {
+      os << "interface " << i->first.first << " gateway " << Ipv4Address (i->first.second)
+         << " packets " << i->second.packets << " bytes " << i->second.bytes << std::endl;
+    }
+}
+
+void
+Ipv4EcmpSelector::ResetLoad (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_load.clear ();
+}
+
+} // namespace ns3
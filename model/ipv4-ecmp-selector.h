@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef IPV4_ECMP_SELECTOR_H
+#define IPV4_ECMP_SELECTOR_H
+
+#include <stdint.h>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+class Packet;
+class Ipv4Header;
+class Ipv4RoutingTableEntry;
+
+/**
+ * \ingroup ipv4
+ *
+ * \brief Per-flow choice among equal-cost routes, and load per next hop
+ *
+ * The flow of a packet is the hash of its addresses, protocol and, for
+ * unfragmented TCP and UDP packets, ports, keyed by the Seed attribute;
+ * switches on successive tiers of a network should have different seeds,
+ * or their choices are correlated. The route of the flow is chosen by
+ * rendezvous hashing: each route gets a weight, the hash of the flow and
+ * of its next hop (interface and gateway), and the heaviest route wins.
+ * The choice depends only on the flow and the set of next hops, whatever
+ * their order, and when a next hop leaves or joins the group, only the
+ * flows to or from that next hop move.
+ *
+ * With a FlowletTimeout, a flow idle for longer than the timeout starts a
+ * new flowlet, which is hashed as another flow and may take another route;
+ * the packets of a flowlet follow a single route.
+ *
+ * With CountLoad, the selector also counts the packets and bytes sent to
+ * each next hop by the routing protocol owning it, whatever the way the
+ * routes are chosen, so that the balance of random, per-flow and
+ * single-route forwarding can be compared. The count costs a map lookup
+ * per packet, and is off by default.
+ */
+class Ipv4EcmpSelector : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  Ipv4EcmpSelector ();
+  virtual ~Ipv4EcmpSelector ();
+
+  /**
+   * \brief Choose the route of a packet
+   * \param header the IP header of the packet
+   * \param p the packet, starting with its transport header, or 0 to hash
+   * the addresses and protocol only
+   * \param routes the equal-cost routes
+   * \param n the number of routes to choose from, the first of routes
+   * \return the index of the route
+   */
+  uint32_t Select (const Ipv4Header &header, Ptr<const Packet> p,
+                   const std::vector<Ipv4RoutingTableEntry *> &routes, uint32_t n);
+
+  /**
+   * \brief Count a packet sent through a route, if CountLoad is set
+   * \param route the route
+   * \param p the packet
+   */
+  void CountLoad (const Ipv4RoutingTableEntry &route, Ptr<const Packet> p);
+
+  /**
+   * \param interface the interface
+   * \param gateway the gateway, or 0.0.0.0 for the directly connected hosts
+   * \return the number of packets counted to the next hop
+   */
+  uint64_t GetPackets (uint32_t interface, Ipv4Address gateway) const;
+
+  /**
+   * \param interface the interface
+   * \param gateway the gateway, or 0.0.0.0 for the directly connected hosts
+   * \return the number of bytes counted to the next hop
+   */
+  uint64_t GetBytes (uint32_t interface, Ipv4Address gateway) const;
+
+  /**
+   * \brief Print the packets and bytes of every next hop, one per line
+   * \param os the output stream
+   */
+  void PrintLoad (std::ostream &os) const;
+
+  /**
+   * \brief Reset the load counters
+   */
+  void ResetLoad (void);
+
+private:
+  /// Load of a next hop
+  struct Load
+  {
+    uint64_t packets;   //!< Packets
+    uint64_t bytes;     //!< Bytes
+  };
+
+  /// Flowlet of a flow
+  struct Flowlet
+  {
+    Time last;          //!< Time of the last packet
+    uint32_t id;        //!< Number of the flowlet in the flow
+  };
+
+  /// Next hop: interface and gateway
+  typedef std::pair<uint32_t, uint32_t> NextHop;
+
+  /**
+   * \brief Hash the flow of a packet
+   * \param header the IP header
+   * \param p the packet, starting with its transport header, or 0
+   * \return the hash
+   */
+  uint64_t HashFlow (const Ipv4Header &header, Ptr<const Packet> p) const;
+
+  /**
+   * \brief Get the flowlet of a flow, starting a new one after a gap
+   * \param flow the hash of the flow
+   * \return the number of the flowlet
+   */
+  uint32_t GetFlowlet (uint64_t flow);
+
+  uint32_t m_seed;                                        //!< Hash seed
+  Time m_flowletTimeout;                                  //!< Gap starting a flowlet, 0 for none
+  std::unordered_map<uint64_t, Flowlet> m_flowlets;       //!< Flowlets by flow hash
+  std::size_t m_flowletSweep;                             //!< Size of m_flowlets purging the idle flows
+  bool m_countLoad;                                       //!< Count the load of the next hops
+  std::map<NextHop, Load> m_load;                         //!< Load by next hop
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ECMP_SELECTOR_H */
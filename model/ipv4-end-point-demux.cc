@@ -29,7 +29,7 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("Ipv4EndPointDemux");
 
 Ipv4EndPointDemux::Ipv4EndPointDemux ()
-  : m_ephemeral (49152), m_portLast (65535), m_portFirst (49152)
+  : m_ports (49152, 65535)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -43,26 +43,26 @@ Ipv4EndPointDemux::~Ipv4EndPointDemux ()
       delete endPoint;
     }
   m_endPoints.clear ();
+  m_positions.clear ();
+  m_connections.clear ();
+  m_listeners.clear ();
 }
 
 bool
 Ipv4EndPointDemux::LookupPortLocal (uint16_t port)
 {
   NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
-    {
-      if ((*i)->GetLocalPort  () == port) 
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_ports.IsUsed (port);
 }
 
 bool
 Ipv4EndPointDemux::LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv4Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
+  if (!LookupPortLocal (port))
+    {
+      return false;
+    }
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
     {
       if ((*i)->GetLocalPort () == port &&
@@ -86,7 +86,7 @@ Ipv4EndPointDemux::Allocate (void)
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (Ipv4Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -102,7 +102,7 @@ Ipv4EndPointDemux::Allocate (Ipv4Address address)
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -125,7 +125,7 @@ Ipv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address address,
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -136,21 +136,26 @@ Ipv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
                              Ipv4Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << localAddress << localPort << peerAddress << peerPort << boundNetDevice);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  // a duplicate has the same local port and peer, so it is in this bucket
+  EndPoints *bucket = FindBucket (localPort, peerAddress, peerPort);
+  if (bucket != 0)
     {
-      if ((*i)->GetLocalPort () == localPort &&
-          (*i)->GetLocalAddress () == localAddress &&
-          (*i)->GetPeerPort () == peerPort &&
-          (*i)->GetPeerAddress () == peerAddress &&
-          ((*i)->GetBoundNetDevice () == boundNetDevice || (*i)->GetBoundNetDevice () == 0))
+      for (EndPointsI i = bucket->begin (); i != bucket->end (); i++)
         {
-          NS_LOG_WARN ("Duplicated endpoint.");
-          return 0;
+          if ((*i)->GetLocalPort () == localPort &&
+              (*i)->GetLocalAddress () == localAddress &&
+              (*i)->GetPeerPort () == peerPort &&
+              (*i)->GetPeerAddress () == peerAddress &&
+              ((*i)->GetBoundNetDevice () == boundNetDevice || (*i)->GetBoundNetDevice () == 0))
+            {
+              NS_LOG_WARN ("Duplicated endpoint.");
+              return 0;
+            }
         }
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
 
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
 
@@ -161,17 +166,92 @@ void
 Ipv4EndPointDemux::DeAllocate (Ipv4EndPoint *endPoint)
 {
   NS_LOG_FUNCTION (this << endPoint);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  std::unordered_map<Ipv4EndPoint *, EndPointsI>::iterator pos = m_positions.find (endPoint);
+  if (pos == m_positions.end ())
+    {
+      return;
+    }
+  Unindex (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+  m_ports.Remove (endPoint->GetLocalPort ());
+  m_endPoints.erase (pos->second);
+  m_positions.erase (pos);
+  delete endPoint;
+}
+
+void
+Ipv4EndPointDemux::Insert (Ipv4EndPoint *endPoint)
+{
+  NS_LOG_FUNCTION (this << endPoint);
+  m_positions[endPoint] = m_endPoints.insert (m_endPoints.end (), endPoint);
+  m_ports.Add (endPoint->GetLocalPort ());
+  Index (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+  endPoint->SetPeerChangeCallback (MakeCallback (&Ipv4EndPointDemux::PeerChanged, this));
+}
+
+bool
+Ipv4EndPointDemux::IsConnected (Ipv4Address peerAddress, uint16_t peerPort)
+{
+  return peerPort != 0 && peerAddress != Ipv4Address::GetAny ();
+}
+
+uint64_t
+Ipv4EndPointDemux::ConnectionKey (uint16_t localPort, Ipv4Address peerAddress, uint16_t peerPort)
+{
+  return (static_cast<uint64_t> (peerAddress.Get ()) << 32) | (static_cast<uint64_t> (peerPort) << 16) | localPort;
+}
+
+Ipv4EndPointDemux::EndPoints *
+Ipv4EndPointDemux::FindBucket (uint16_t localPort, Ipv4Address peerAddress, uint16_t peerPort)
+{
+  if (IsConnected (peerAddress, peerPort))
     {
-      if (*i == endPoint)
+      std::unordered_map<uint64_t, EndPoints>::iterator i = m_connections.find (ConnectionKey (localPort, peerAddress, peerPort));
+      return i == m_connections.end () ? 0 : &i->second;
+    }
+  std::unordered_map<uint16_t, EndPoints>::iterator i = m_listeners.find (localPort);
+  return i == m_listeners.end () ? 0 : &i->second;
+}
+
+void
+Ipv4EndPointDemux::Index (Ipv4EndPoint *endPoint, Ipv4Address peerAddress, uint16_t peerPort)
+{
+  if (IsConnected (peerAddress, peerPort))
+    {
+      m_connections[ConnectionKey (endPoint->GetLocalPort (), peerAddress, peerPort)].push_back (endPoint);
+    }
+  else
+    {
+      m_listeners[endPoint->GetLocalPort ()].push_back (endPoint);
+    }
+}
+
+void
+Ipv4EndPointDemux::Unindex (Ipv4EndPoint *endPoint, Ipv4Address peerAddress, uint16_t peerPort)
+{
+  EndPoints *bucket = FindBucket (endPoint->GetLocalPort (), peerAddress, peerPort);
+  NS_ASSERT (bucket != 0);
+  bucket->remove (endPoint);
+  if (bucket->empty ())
+    {
+      if (IsConnected (peerAddress, peerPort))
+        {
+          m_connections.erase (ConnectionKey (endPoint->GetLocalPort (), peerAddress, peerPort));
+        }
+      else
         {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
+          m_listeners.erase (endPoint->GetLocalPort ());
         }
     }
 }
 
+void
+Ipv4EndPointDemux::PeerChanged (Ipv4EndPoint *endPoint, Ipv4Address oldAddress, uint16_t oldPort)
+{
+  NS_LOG_FUNCTION (this << endPoint << oldAddress << oldPort);
+  Unindex (endPoint, oldAddress, oldPort);
+  Index (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+}
+
 /*
  * return list of all available Endpoints
  */
@@ -208,119 +288,132 @@ Ipv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport,
   EndPoints retval4; // Exact match on all 4
 
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr << ":" << dport);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  // only the connections to (saddr, sport) and the wildcard end points of
+  // dport can match
+  EndPoints *buckets[2] = {
+    IsConnected (saddr, sport) ? FindBucket (dport, saddr, sport) : 0,
+    FindBucket (dport, Ipv4Address::GetAny (), 0)
+  };
+  for (uint32_t b = 0; b < 2; b++)
     {
-      Ipv4EndPoint* endP = *i;
-
-      NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
-                                                 << " daddr=" << endP->GetLocalAddress ()
-                                                 << " sport=" << endP->GetPeerPort ()
-                                                 << " saddr=" << endP->GetPeerAddress ());
-
-      if (!endP->IsRxEnabled ())
+      if (buckets[b] == 0)
         {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                        << " because endpoint can not receive packets");
           continue;
         }
-
-      if (endP->GetLocalPort () != dport) 
+      for (EndPointsI i = buckets[b]->begin (); i != buckets[b]->end (); i++)
         {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
-      if (endP->GetBoundNetDevice ())
-        {
-          if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+          Ipv4EndPoint* endP = *i;
+
+          NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
+                                                     << " daddr=" << endP->GetLocalAddress ()
+                                                     << " sport=" << endP->GetPeerPort ()
+                                                     << " saddr=" << endP->GetPeerAddress ());
+
+          if (!endP->IsRxEnabled ())
             {
               NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                                 << " because endpoint is bound to specific device and"
-                                                 << endP->GetBoundNetDevice ()
-                                                 << " does not match packet device " << incomingInterface->GetDevice ());
+                            << " because endpoint can not receive packets");
               continue;
             }
-        }
 
-      bool localAddressMatchesExact = false;
-      bool localAddressIsAny = false;
-      bool localAddressIsSubnetAny = false;
+          if (endP->GetLocalPort () != dport) 
+            {
+              NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                                 << " because endpoint dport "
+                                                 << endP->GetLocalPort ()
+                                                 << " does not match packet dport " << dport);
+              continue;
+            }
+          if (endP->GetBoundNetDevice ())
+            {
+              if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+                {
+                  NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                                     << " because endpoint is bound to specific device and"
+                                                     << endP->GetBoundNetDevice ()
+                                                     << " does not match packet device " << incomingInterface->GetDevice ());
+                  continue;
+                }
+            }
 
-      // We have 3 cases:
-      // 1) Exact local / destination address match
-      // 2) Local endpoint bound to Any -> matches anything
-      // 3) Local endpoint bound to x.y.z.0 -> matches Subnet-directed broadcast packet (e.g., x.y.z.255 in a /24 net) and direct destination match.
+          bool localAddressMatchesExact = false;
+          bool localAddressIsAny = false;
+          bool localAddressIsSubnetAny = false;
 
-      if (endP->GetLocalAddress () == daddr)
-        {
-          // Case 1:
-          localAddressMatchesExact = true;
-        }
-      else if (endP->GetLocalAddress () == Ipv4Address::GetAny ())
-        {
-          // Case 2:
-          localAddressIsAny = true;
-        }
-      else
-        {
-          // Case 3:
-          for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
-            {
-              Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+          // We have 3 cases:
+          // 1) Exact local / destination address match
+          // 2) Local endpoint bound to Any -> matches anything
+          // 3) Local endpoint bound to x.y.z.0 -> matches Subnet-directed broadcast packet (e.g., x.y.z.255 in a /24 net) and direct destination match.
 
-              Ipv4Address addrNetpart = addr.GetLocal ().CombineMask (addr.GetMask ());
-              if (endP->GetLocalAddress () == addrNetpart)
+          if (endP->GetLocalAddress () == daddr)
+            {
+              // Case 1:
+              localAddressMatchesExact = true;
+            }
+          else if (endP->GetLocalAddress () == Ipv4Address::GetAny ())
+            {
+              // Case 2:
+              localAddressIsAny = true;
+            }
+          else
+            {
+              // Case 3:
+              for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
                 {
-                  NS_LOG_LOGIC ("Endpoint is SubnetDirectedAny " << endP->GetLocalAddress () << "/" << addr.GetMask ().GetPrefixLength ());
+                  Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
 
-                  Ipv4Address daddrNetPart = daddr.CombineMask (addr.GetMask ());
-                  if (addrNetpart == daddrNetPart)
+                  Ipv4Address addrNetpart = addr.GetLocal ().CombineMask (addr.GetMask ());
+                  if (endP->GetLocalAddress () == addrNetpart)
                     {
-                      localAddressIsSubnetAny = true;
+                      NS_LOG_LOGIC ("Endpoint is SubnetDirectedAny " << endP->GetLocalAddress () << "/" << addr.GetMask ().GetPrefixLength ());
+
+                      Ipv4Address daddrNetPart = daddr.CombineMask (addr.GetMask ());
+                      if (addrNetpart == daddrNetPart)
+                        {
+                          localAddressIsSubnetAny = true;
+                        }
                     }
                 }
-            }
 
-          // if no match here, keep looking
-          if (!localAddressIsSubnetAny)
-            continue;
-        }
+              // if no match here, keep looking
+              if (!localAddressIsSubnetAny)
+                continue;
+            }
 
-      bool remotePortMatchesExact = endP->GetPeerPort () == sport;
-      bool remotePortMatchesWildCard = endP->GetPeerPort () == 0;
-      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
-      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
+          bool remotePortMatchesExact = endP->GetPeerPort () == sport;
+          bool remotePortMatchesWildCard = endP->GetPeerPort () == 0;
+          bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+          bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
 
-      // If remote does not match either with exact or wildcard,
-      // skip this one
-      if (!(remotePortMatchesExact || remotePortMatchesWildCard))
-        continue;
-      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
-        continue;
+          // If remote does not match either with exact or wildcard,
+          // skip this one
+          if (!(remotePortMatchesExact || remotePortMatchesWildCard))
+            continue;
+          if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+            continue;
 
-      bool localAddressMatchesWildCard = localAddressIsAny || localAddressIsSubnetAny;
+          bool localAddressMatchesWildCard = localAddressIsAny || localAddressIsSubnetAny;
 
-      if (localAddressMatchesExact && remoteAddressMatchesExact && remotePortMatchesExact)
-        { // All 4 match - this is the case of an open TCP connection, for example.
-          NS_LOG_LOGIC ("Found an endpoint for case 4, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval4.push_back (endP);
-        }
-      if (localAddressMatchesWildCard && remoteAddressMatchesExact && remotePortMatchesExact)
-        { // All but local address - no idea what this case could be.
-          NS_LOG_LOGIC ("Found an endpoint for case 3, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval3.push_back (endP);
-        }
-      if (localAddressMatchesExact && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
-        { // Only local port and local address matches exactly - Not yet opened connection
-          NS_LOG_LOGIC ("Found an endpoint for case 2, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval2.push_back (endP);
-        }
-      if (localAddressMatchesWildCard && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
-        { // Only local port matches exactly - Endpoint open to "any" connection
-          NS_LOG_LOGIC ("Found an endpoint for case 1, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval1.push_back (endP);
+          if (localAddressMatchesExact && remoteAddressMatchesExact && remotePortMatchesExact)
+            { // All 4 match - this is the case of an open TCP connection, for example.
+              NS_LOG_LOGIC ("Found an endpoint for case 4, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+              retval4.push_back (endP);
+            }
+          if (localAddressMatchesWildCard && remoteAddressMatchesExact && remotePortMatchesExact)
+            { // All but local address - no idea what this case could be.
+              NS_LOG_LOGIC ("Found an endpoint for case 3, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+              retval3.push_back (endP);
+            }
+          if (localAddressMatchesExact && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+            { // Only local port and local address matches exactly - Not yet opened connection
+              NS_LOG_LOGIC ("Found an endpoint for case 2, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+              retval2.push_back (endP);
+            }
+          if (localAddressMatchesWildCard && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+            { // Only local port matches exactly - Endpoint open to "any" connection
+              NS_LOG_LOGIC ("Found an endpoint for case 1, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+              retval1.push_back (endP);
+            }
         }
     }
 
@@ -345,6 +438,12 @@ Ipv4EndPointDemux::SimpleLookup (Ipv4Address daddr,
 
   // this code is a copy/paste version of an old BSD ip stack lookup
   // function.
+  // It is only used for ICMP errors and a generic match may be any end point
+  // of dport, so it still walks the list.
+  if (!LookupPortLocal (dport))
+    {
+      return 0;
+    }
   uint32_t genericity = 3;
   Ipv4EndPoint *generic = 0;
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
@@ -380,24 +479,8 @@ Ipv4EndPointDemux::SimpleLookup (Ipv4Address daddr,
 uint16_t
 Ipv4EndPointDemux::AllocateEphemeralPort (void)
 {
-  // Similar to counting up logic in netinet/in_pcb.c
   NS_LOG_FUNCTION (this);
-  uint16_t port = m_ephemeral;
-  int count = m_portLast - m_portFirst;
-  do 
-    {
-      if (count-- < 0)
-        {
-          return 0;
-        }
-      ++port;
-      if (port < m_portFirst || port > m_portLast)
-        {
-          port = m_portFirst;
-        }
-    } while (LookupPortLocal (port));
-  m_ephemeral = port;
-  return port;
+  return m_ports.AllocateEphemeral ();
 }
 
 } // namespace ns3
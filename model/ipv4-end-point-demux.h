@@ -23,8 +23,10 @@
 
 #include <stdint.h>
 #include <list>
+#include <unordered_map>
 #include "ns3/ipv4-address.h"
 #include "ipv4-interface.h"
+#include "port-allocator.h"
 
 namespace ns3 {
 
@@ -40,6 +42,12 @@ class Ipv4EndPoint;
  * of endpoints, and has APIs to add and find endpoints in this demux.  This
  * code is shared in common to TCP and UDP protocols in ns3.  This demux
  * sits between ns3's layer four and the socket layer
+ *
+ * Lookup does not walk the list: endpoints with a peer address and port
+ * (established connections) are hashed on local port, peer address and peer
+ * port, and the other ones (listeners, partially bound) on their local port.
+ * A lookup only matches the endpoints of these two buckets, so its cost does
+ * not depend on the number of connections.
  */
 
 class Ipv4EndPointDemux {
@@ -174,24 +182,85 @@ private:
   uint16_t AllocateEphemeralPort (void);
 
   /**
-   * \brief The ephemeral port.
+   * \brief Add an end point to the list and the indexes.
+   * \param endPoint the end point
    */
-  uint16_t m_ephemeral;
+  void Insert (Ipv4EndPoint *endPoint);
 
   /**
-   * \brief The last ephemeral port.
+   * \brief Add an end point to the bucket of its peer.
+   * \param endPoint the end point
+   * \param peerAddress peer address of the end point
+   * \param peerPort peer port of the end point
    */
-  uint16_t m_portLast;
+  void Index (Ipv4EndPoint *endPoint, Ipv4Address peerAddress, uint16_t peerPort);
 
   /**
-   * \brief The first ephemeral port.
+   * \brief Remove an end point from the bucket of its peer.
+   * \param endPoint the end point
+   * \param peerAddress peer address the end point was indexed with
+   * \param peerPort peer port the end point was indexed with
    */
-  uint16_t m_portFirst;
+  void Unindex (Ipv4EndPoint *endPoint, Ipv4Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Move an end point whose peer changed to its new bucket.
+   * \param endPoint the end point
+   * \param oldAddress previous peer address
+   * \param oldPort previous peer port
+   */
+  void PeerChanged (Ipv4EndPoint *endPoint, Ipv4Address oldAddress, uint16_t oldPort);
+
+  /**
+   * \brief Find the bucket of a local port and peer.
+   * \param localPort local port
+   * \param peerAddress peer address
+   * \param peerPort peer port
+   * \return the connection bucket if the peer is fully specified, the
+   * listener bucket of the local port otherwise; 0 if it does not exist
+   */
+  EndPoints *FindBucket (uint16_t localPort, Ipv4Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Connection index key.
+   * \param localPort local port
+   * \param peerAddress peer address
+   * \param peerPort peer port
+   * \return the key
+   */
+  static uint64_t ConnectionKey (uint16_t localPort, Ipv4Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \param peerAddress peer address
+   * \param peerPort peer port
+   * \return true if neither the peer address nor the peer port is a wildcard
+   */
+  static bool IsConnected (Ipv4Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Local ports in use and ephemeral port allocation.
+   */
+  PortAllocator m_ports;
 
   /**
    * \brief A list of IPv4 end points.
    */
   EndPoints m_endPoints;
+
+  /**
+   * \brief Position of each end point in m_endPoints.
+   */
+  std::unordered_map<Ipv4EndPoint *, EndPointsI> m_positions;
+
+  /**
+   * \brief End points with a fully specified peer, by (local port, peer address, peer port).
+   */
+  std::unordered_map<uint64_t, EndPoints> m_connections;
+
+  /**
+   * \brief End points with a wildcard peer address or port, by local port.
+   */
+  std::unordered_map<uint16_t, EndPoints> m_listeners;
 };
 
 } // namespace ns3
@@ -140,6 +140,13 @@ public:
    * \param callback callback function
    */
   void SetDestroyCallback (Callback<void> callback);
+  /**
+   * \brief Set the callback invoked after the peer changed.
+   *
+   * The demux uses it to keep its connection index up to date.
+   * \param callback callback function, given this end point and its previous peer address and port
+   */
+  void SetPeerChangeCallback (Callback<void, Ipv4EndPoint *, Ipv4Address, uint16_t> callback);
 
   /**
    * \brief Forward the packet to the upper level.
@@ -223,6 +230,11 @@ private:
    */
   Callback<void> m_destroyCallback;
 
+  /**
+   * \brief The peer change callback.
+   */
+  Callback<void, Ipv4EndPoint *, Ipv4Address, uint16_t> m_peerChangeCallback;
+
   /**
    * \brief true if the endpoint can receive packets.
    */
@@ -17,6 +17,7 @@
 //
 
 #include <vector>
+#include <iterator>
 #include <iomanip>
 #include "ns3/names.h"
 #include "ns3/log.h"
@@ -30,6 +31,7 @@
 #include "ns3/node.h"
 #include "ipv4-global-routing.h"
 #include "global-route-manager.h"
+#include "tcp-l4-protocol.h"
 
 namespace ns3 {
 
@@ -48,6 +50,11 @@ Ipv4GlobalRouting::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&Ipv4GlobalRouting::m_randomEcmpRouting),
                    MakeBooleanChecker ())
+    .AddAttribute ("FlowEcmpRouting",
+                   "Set to true if the packets of a flow are routed on the same route among ECMP, chosen by the EcmpSelector; takes precedence over RandomEcmpRouting",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_flowEcmpRouting),
+                   MakeBooleanChecker ())
     .AddAttribute ("RespondToInterfaceEvents",
                    "Set to true if you want to dynamically recompute the global routes upon Interface notification events (up/down, or add/remove address)",
                    BooleanValue (false),
@@ -59,11 +66,14 @@ Ipv4GlobalRouting::GetTypeId (void)
 
 Ipv4GlobalRouting::Ipv4GlobalRouting () 
   : m_randomEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_flowEcmpRouting (false),
+    m_respondToInterfaceEvents (false),
+    m_tableChanged (true)
 {
   NS_LOG_FUNCTION (this);
 
   m_rand = CreateObject<UniformRandomVariable> ();
+  m_ecmpSelector = CreateObject<Ipv4EcmpSelector> ();
 }
 
 Ipv4GlobalRouting::~Ipv4GlobalRouting ()
@@ -80,6 +90,7 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
+  m_tableChanged = true;
 }
 
 void 
@@ -90,6 +101,7 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
+  m_tableChanged = true;
 }
 
 void 
@@ -105,6 +117,7 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_tableChanged = true;
 }
 
 void 
@@ -118,6 +131,7 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_tableChanged = true;
 }
 
 void 
@@ -133,104 +147,223 @@ Ipv4GlobalRouting::AddASExternalRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_ASexternalRoutes.push_back (route);
+  m_tableChanged = true;
 }
 
+/**
+ * \brief Replace the routes of a list, keeping the head and the tail that
+ * do not change
+ * \param list the list of routes
+ * \param routes the new routes
+ */
+static void
+SetRouteList (std::list<Ipv4RoutingTableEntry *> &list, const std::vector<Ipv4RoutingTableEntry> &routes)
+{
+  std::list<Ipv4RoutingTableEntry *>::iterator first = list.begin ();
+  uint32_t head = 0;
+  while (first != list.end () && head < routes.size () && **first == routes[head])
+    {
+      first++;
+      head++;
+    }
+  std::list<Ipv4RoutingTableEntry *>::iterator last = list.end ();
+  uint32_t tail = routes.size ();
+  while (last != first && tail > head)
+    {
+      std::list<Ipv4RoutingTableEntry *>::iterator previous = std::prev (last);
+      if (!(**previous == routes[tail - 1]))
+        {
+          break;
+        }
+      last = previous;
+      tail--;
+    }
+  while (first != last)
+    {
+      delete *first;
+      first = list.erase (first);
+    }
+  for (uint32_t i = head; i < tail; i++)
+    {
+      list.insert (last, new Ipv4RoutingTableEntry (routes[i]));
+    }
+}
 
-Ptr<Ipv4Route>
-Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+void
+Ipv4GlobalRouting::SetRoutes (const std::vector<Ipv4RoutingTableEntry> &hostRoutes,
+                              const std::vector<Ipv4RoutingTableEntry> &networkRoutes,
+                              const std::vector<Ipv4RoutingTableEntry> &externalRoutes)
 {
-  NS_LOG_FUNCTION (this << dest << oif);
-  NS_LOG_LOGIC ("Looking for route for destination " << dest);
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  NS_LOG_FUNCTION (this << hostRoutes.size () << networkRoutes.size () << externalRoutes.size ());
+  SetRouteList (m_hostRoutes, hostRoutes);
+  SetRouteList (m_networkRoutes, networkRoutes);
+  SetRouteList (m_ASexternalRoutes, externalRoutes);
+  m_tableChanged = true;
+}
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+bool
+Ipv4GlobalRouting::ReplaceRoutes (bool host,
+                                  const std::vector<Ipv4RoutingTableEntry> &oldRoutes,
+                                  const std::vector<Ipv4RoutingTableEntry> &newRoutes)
+{
+  NS_LOG_FUNCTION (this << host << oldRoutes.size () << newRoutes.size ());
+  NS_ASSERT (!oldRoutes.empty ());
+  std::list<Ipv4RoutingTableEntry *> &list = host ? m_hostRoutes : m_networkRoutes;
+  std::list<Ipv4RoutingTableEntry *>::iterator found = list.end ();
+  uint32_t matches = 0;
+  for (std::list<Ipv4RoutingTableEntry *>::iterator i = list.begin (); i != list.end (); i++)
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest () == dest)
+      if (!(**i == oldRoutes[0]))
         {
-          if (oif != 0)
-            {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found global host route" << *i); 
+          continue;
+        }
+      std::list<Ipv4RoutingTableEntry *>::iterator j = i;
+      uint32_t k = 0;
+      while (j != list.end () && k < oldRoutes.size () && **j == oldRoutes[k])
+        {
+          j++;
+          k++;
         }
+      if (k == oldRoutes.size ())
+        {
+          found = i;
+          matches++;
+        }
+    }
+  if (matches != 1)
+    {
+      NS_LOG_LOGIC ("Routes to replace found " << matches << " times");
+      return false;
     }
-  if (allRoutes.size () == 0) // if no host route is found
+  for (uint32_t k = 0; k < oldRoutes.size (); k++)
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
+      delete *found;
+      found = list.erase (found);
+    }
+  for (std::vector<Ipv4RoutingTableEntry>::const_iterator i = newRoutes.begin (); i != newRoutes.end (); i++)
+    {
+      list.insert (found, new Ipv4RoutingTableEntry (*i));
+    }
+  m_tableChanged = true;
+  return true;
+}
+
+void
+Ipv4GlobalRouting::GetHostRoutesTo (Ipv4Address dest, std::vector<Ipv4RoutingTableEntry> &routes) const
+{
+  NS_LOG_FUNCTION (this << dest);
+  routes.clear ();
+  for (HostRoutesCI i = m_hostRoutes.begin (); i != m_hostRoutes.end (); i++)
+    {
+      if ((*i)->GetDest () == dest)
         {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
-            {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found global network route" << *j);
-            }
+          routes.push_back (**i);
         }
     }
-  if (allRoutes.size () == 0)  // consider external if no host/network found
+}
+
+
+void
+Ipv4GlobalRouting::CompileTable (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_hostTrie.Clear ();
+  for (HostRoutesCI i = m_hostRoutes.begin (); i != m_hostRoutes.end (); i++)
+    {
+      NS_ASSERT ((*i)->IsHost ());
+      m_hostTrie.Insert ((*i)->GetDest (), Ipv4Mask::GetOnes (), *i);
+    }
+  m_hostTrie.Compile ();
+  m_networkTrie.Clear ();
+  for (NetworkRoutesCI j = m_networkRoutes.begin (); j != m_networkRoutes.end (); j++)
+    {
+      m_networkTrie.Insert ((*j)->GetDestNetwork (), (*j)->GetDestNetworkMask (), *j);
+    }
+  m_networkTrie.Compile ();
+  m_externalTrie.Clear ();
+  for (ASExternalRoutesCI k = m_ASexternalRoutes.begin (); k != m_ASexternalRoutes.end (); k++)
+    {
+      m_externalTrie.Insert ((*k)->GetDestNetwork (), (*k)->GetDestNetworkMask (), *k);
+    }
+  m_externalTrie.Compile ();
+  m_tableChanged = false;
+}
+
+const std::vector<Ipv4RoutingTableEntry*> *
+Ipv4GlobalRouting::MatchRoutes (const Ipv4RouteTrie &trie, Ipv4Address dest, Ptr<NetDevice> oif,
+                                std::vector<Ipv4RoutingTableEntry*> &onInterface) const
+{
+  const std::vector<Ipv4RoutingTableEntry*> *routes = trie.Lookup (dest);
+  if (routes == 0 || oif == 0)
+    {
+      return routes;
+    }
+  onInterface.clear ();
+  for (std::vector<Ipv4RoutingTableEntry*>::const_iterator i = routes->begin (); i != routes->end (); i++)
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
-           k != m_ASexternalRoutes.end ();
-           k++)
+      if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
         {
-          Ipv4Mask mask = (*k)->GetDestNetworkMask ();
-          Ipv4Address entry = (*k)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry))
-            {
-              NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*k);
-              break;
-            }
+          NS_LOG_LOGIC ("Not on requested interface, skipping");
+          continue;
         }
+      onInterface.push_back (*i);
+    }
+  return onInterface.empty () ? 0 : &onInterface;
+}
+
+Ptr<Ipv4Route>
+Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> p, bool transport, Ptr<NetDevice> oif)
+{
+  Ipv4Address dest = header.GetDestination ();
+  NS_LOG_FUNCTION (this << dest << p << transport << oif);
+  NS_LOG_LOGIC ("Looking for route for destination " << dest);
+  if (m_tableChanged)
+    {
+      CompileTable ();
+    }
+
+  // all the routes that bring packets to their destination: the host
+  // routes if any, else all the matching network routes, each in table
+  // order
+  std::vector<Ipv4RoutingTableEntry*> onInterface;
+  const std::vector<Ipv4RoutingTableEntry*> *allRoutes = MatchRoutes (m_hostTrie, dest, oif, onInterface);
+  if (allRoutes == 0)
+    {
+      allRoutes = MatchRoutes (m_networkTrie, dest, oif, onInterface);
+    }
+  uint32_t nRoutes = allRoutes != 0 ? allRoutes->size () : 0;
+  if (allRoutes == 0)  // consider external if no host/network found
+    {
+      // only the first matching external route is used
+      allRoutes = MatchRoutes (m_externalTrie, dest, oif, onInterface);
+      nRoutes = allRoutes != 0 ? 1 : 0;
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
+  if (allRoutes != 0) // if route(s) is found
     {
-      // pick up one of the routes uniformly at random if random
-      // ECMP routing is enabled, or always select the first route
-      // consistently if random ECMP routing is disabled
+      // pick up the route of the flow if flow ECMP routing is enabled,
+      // else one of the routes uniformly at random if random ECMP
+      // routing is enabled, or always select the first route
+      // consistently if both are disabled
       uint32_t selectIndex;
-      if (m_randomEcmpRouting)
+      if (m_flowEcmpRouting)
         {
-          selectIndex = m_rand->GetInteger (0, allRoutes.size ()-1);
+          selectIndex = m_ecmpSelector->Select (header, transport ? p : Ptr<const Packet> (), *allRoutes, nRoutes);
+        }
+      else if (m_randomEcmpRouting)
+        {
+          selectIndex = m_rand->GetInteger (0, nRoutes - 1);
         }
       else 
         {
           selectIndex = 0;
         }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
+      Ipv4RoutingTableEntry* route = (*allRoutes)[selectIndex]; 
+      if (p != 0)
+        {
+          m_ecmpSelector->CountLoad (*route, p);
+        }
       // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
+      Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
       rtentry->SetDestination (route->GetDest ());
       /// \todo handle multi-address case
       rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
@@ -309,6 +442,7 @@ void
 Ipv4GlobalRouting::RemoveRoute (uint32_t index)
 {
   NS_LOG_FUNCTION (this << index);
+  m_tableChanged = true;
   if (index < m_hostRoutes.size ())
     {
       uint32_t tmp = 0;
@@ -370,6 +504,12 @@ Ipv4GlobalRouting::AssignStreams (int64_t stream)
   return 1;
 }
 
+Ptr<Ipv4EcmpSelector>
+Ipv4GlobalRouting::GetEcmpSelector (void) const
+{
+  return m_ecmpSelector;
+}
+
 void
 Ipv4GlobalRouting::DoDispose (void)
 {
@@ -392,6 +532,10 @@ Ipv4GlobalRouting::DoDispose (void)
     {
       delete (*l);
     }
+  m_hostTrie.Clear ();
+  m_networkTrie.Clear ();
+  m_externalTrie.Clear ();
+  m_tableChanged = true;
 
   Ipv4RoutingProtocol::DoDispose ();
 }
@@ -411,41 +555,46 @@ Ipv4GlobalRouting::PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Uni
   if (GetNRoutes () > 0)
     {
       *os << "Destination     Gateway         Genmask         Flags Metric Ref    Use Iface" << std::endl;
-      for (uint32_t j = 0; j < GetNRoutes (); j++)
+      // in the order of GetRoute, without its walk from the head of the table
+      const std::list<Ipv4RoutingTableEntry *> *lists[] = { &m_hostRoutes, &m_networkRoutes, &m_ASexternalRoutes };
+      for (uint32_t l = 0; l < 3; l++)
         {
-          std::ostringstream dest, gw, mask, flags;
-          Ipv4RoutingTableEntry route = GetRoute (j);
-          dest << route.GetDest ();
-          *os << std::setiosflags (std::ios::left) << std::setw (16) << dest.str ();
-          gw << route.GetGateway ();
-          *os << std::setiosflags (std::ios::left) << std::setw (16) << gw.str ();
-          mask << route.GetDestNetworkMask ();
-          *os << std::setiosflags (std::ios::left) << std::setw (16) << mask.str ();
-          flags << "U";
-          if (route.IsHost ())
-            {
-              flags << "H";
-            }
-          else if (route.IsGateway ())
+          for (std::list<Ipv4RoutingTableEntry *>::const_iterator j = lists[l]->begin (); j != lists[l]->end (); j++)
             {
-              flags << "G";
-            }
-          *os << std::setiosflags (std::ios::left) << std::setw (6) << flags.str ();
-          // Metric not implemented
-          *os << "-" << "      ";
-          // Ref ct not implemented
-          *os << "-" << "      ";
-          // Use not implemented
-          *os << "-" << "   ";
-          if (Names::FindName (m_ipv4->GetNetDevice (route.GetInterface ())) != "")
-            {
-              *os << Names::FindName (m_ipv4->GetNetDevice (route.GetInterface ()));
-            }
-          else
-            {
-              *os << route.GetInterface ();
+              std::ostringstream dest, gw, mask, flags;
+              const Ipv4RoutingTableEntry &route = **j;
+              dest << route.GetDest ();
+              *os << std::setiosflags (std::ios::left) << std::setw (16) << dest.str ();
+              gw << route.GetGateway ();
+              *os << std::setiosflags (std::ios::left) << std::setw (16) << gw.str ();
+              mask << route.GetDestNetworkMask ();
+              *os << std::setiosflags (std::ios::left) << std::setw (16) << mask.str ();
+              flags << "U";
+              if (route.IsHost ())
+                {
+                  flags << "H";
+                }
+              else if (route.IsGateway ())
+                {
+                  flags << "G";
+                }
+              *os << std::setiosflags (std::ios::left) << std::setw (6) << flags.str ();
+              // Metric not implemented
+              *os << "-" << "      ";
+              // Ref ct not implemented
+              *os << "-" << "      ";
+              // Use not implemented
+              *os << "-" << "   ";
+              if (Names::FindName (m_ipv4->GetNetDevice (route.GetInterface ())) != "")
+                {
+                  *os << Names::FindName (m_ipv4->GetNetDevice (route.GetInterface ()));
+                }
+              else
+                {
+                  *os << route.GetInterface ();
+                }
+              *os << std::endl;
             }
-          *os << std::endl;
         }
     }
   *os << std::endl;
@@ -468,7 +617,9 @@ Ipv4GlobalRouting::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<Net
 // See if this is a unicast packet we have a route for.
 //
   NS_LOG_LOGIC ("Unicast destination- looking up");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination (), oif);
+  // TCP asks for the routes of its segments with their header, UDP and
+  // the others with their payload only
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header, p, header.GetProtocol () == TcpL4Protocol::PROT_NUMBER, oif);
   if (rtentry)
     {
       sockerr = Socket::ERROR_NOTERROR;
@@ -517,7 +668,7 @@ Ipv4GlobalRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, P
     }
   // Next, try to find a route
   NS_LOG_LOGIC ("Unicast destination- looking up global route");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination ());
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header, p, true);
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Found unicast destination- calling unicast callback");
@@ -537,9 +688,7 @@ Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -549,9 +698,7 @@ Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
   NS_LOG_FUNCTION (this << i);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -561,9 +708,7 @@ Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress ad
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -573,9 +718,7 @@ Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress
   NS_LOG_FUNCTION (this << interface << address);
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateRoutes (m_ipv4->GetObject<Node> ());
     }
 }
 
@@ -21,6 +21,7 @@
 #define IPV4_GLOBAL_ROUTING_H
 
 #include <list>
+#include <vector>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-header.h"
@@ -28,6 +29,8 @@
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/ipv4-route-trie.h"
+#include "ns3/ipv4-ecmp-selector.h"
 
 namespace ns3 {
 
@@ -65,6 +68,16 @@ class Node;
  *
  * This class deals with Ipv4 unicast routes only.
  *
+ * The routes are kept in lists, which GetRoute and PrintRoutingTable walk.
+ * The packets are forwarded through a compiled copy of the lists, a prefix
+ * trie per list (Ipv4RouteTrie) giving at once all the routes matching a
+ * destination; any change to the routes marks the tries to be built again
+ * at the next lookup.
+ *
+ * Among the equal-cost routes to a destination, the packets take the
+ * first one, a random one (RandomEcmpRouting), or the route of their flow
+ * (FlowEcmpRouting), chosen by an Ipv4EcmpSelector.
+ *
  * \see Ipv4RoutingProtocol
  * \see GlobalRouteManager
  */
@@ -169,6 +182,41 @@ public:
                              Ipv4Address nextHop,
                              uint32_t interface);
 
+  /**
+   * \brief Replace the routes of the global routing table.
+   *
+   * The routes common to the head and to the tail of each list and of the
+   * table stay in place; the others are replaced.
+   *
+   * \param hostRoutes the routes to hosts
+   * \param networkRoutes the routes to networks
+   * \param externalRoutes the external routes
+   */
+  void SetRoutes (const std::vector<Ipv4RoutingTableEntry> &hostRoutes,
+                  const std::vector<Ipv4RoutingTableEntry> &networkRoutes,
+                  const std::vector<Ipv4RoutingTableEntry> &externalRoutes);
+
+  /**
+   * \brief Replace a run of consecutive routes of the global routing table.
+   *
+   * \param host replace routes to hosts, rather than to networks
+   * \param oldRoutes the routes to replace, not empty
+   * \param newRoutes the routes that take their place
+   * \returns false, with the table unchanged, unless the routes to replace
+   * are found exactly once
+   */
+  bool ReplaceRoutes (bool host,
+                      const std::vector<Ipv4RoutingTableEntry> &oldRoutes,
+                      const std::vector<Ipv4RoutingTableEntry> &newRoutes);
+
+  /**
+   * \brief Get the routes to a host, in the order of the table.
+   *
+   * \param dest the host address
+   * \param routes the host routes to dest
+   */
+  void GetHostRoutesTo (Ipv4Address dest, std::vector<Ipv4RoutingTableEntry> &routes) const;
+
   /**
    * \brief Get the number of individual unicast routes that have been added
    * to the routing table.
@@ -228,16 +276,31 @@ public:
    */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * \brief Get the selector of the routes of the flows
+   *
+   * It chooses the routes when FlowEcmpRouting is set, and counts the
+   * packets sent to each next hop, whatever the routing, when its
+   * CountLoad attribute is set.
+   *
+   * \return the selector
+   */
+  Ptr<Ipv4EcmpSelector> GetEcmpSelector (void) const;
+
 protected:
   void DoDispose (void);
 
 private:
   /// Set to true if packets are randomly routed among ECMP; set to false for using only one route consistently
   bool m_randomEcmpRouting;
+  /// Set to true if the packets of a flow are routed on the same route among ECMP
+  bool m_flowEcmpRouting;
   /// Set to true if this interface should respond to interface events by globallly recomputing routes 
   bool m_respondToInterfaceEvents;
   /// A uniform random number generator for randomly routing packets among ECMP 
   Ptr<UniformRandomVariable> m_rand;
+  /// Route selection of the flows among ECMP, and load per next hop
+  Ptr<Ipv4EcmpSelector> m_ecmpSelector;
 
   /// container of Ipv4RoutingTableEntry (routes to hosts)
   typedef std::list<Ipv4RoutingTableEntry *> HostRoutes;
@@ -262,16 +325,41 @@ private:
 
   /**
    * \brief Lookup in the forwarding table for destination.
-   * \param dest destination address
+   * \param header IP header of the packet
+   * \param p the packet, or 0 if the route is not for a packet
+   * \param transport true if the packet starts with its transport header
    * \param oif output interface if any (put 0 otherwise)
    * \return Ipv4Route to route the packet to reach dest address
    */
-  Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0);
+  Ptr<Ipv4Route> LookupGlobal (const Ipv4Header &header, Ptr<const Packet> p, bool transport,
+                               Ptr<NetDevice> oif = 0);
+
+  /**
+   * \brief Find the routes matching a destination in a lookup trie
+   * \param trie the trie
+   * \param dest destination address
+   * \param oif output interface if any (put 0 otherwise)
+   * \param onInterface storage of the routes on oif
+   * \return the matching routes, in table order, or 0 if none
+   */
+  const std::vector<Ipv4RoutingTableEntry*> * MatchRoutes (const Ipv4RouteTrie &trie, Ipv4Address dest,
+                                                          Ptr<NetDevice> oif,
+                                                          std::vector<Ipv4RoutingTableEntry*> &onInterface) const;
+
+  /**
+   * \brief Build the lookup tries from the route lists
+   */
+  void CompileTable (void);
 
   HostRoutes m_hostRoutes;             //!< Routes to hosts
   NetworkRoutes m_networkRoutes;       //!< Routes to networks
   ASExternalRoutes m_ASexternalRoutes; //!< External routes imported
 
+  Ipv4RouteTrie m_hostTrie;            //!< Lookup of m_hostRoutes
+  Ipv4RouteTrie m_networkTrie;         //!< Lookup of m_networkRoutes
+  Ipv4RouteTrie m_externalTrie;        //!< Lookup of m_ASexternalRoutes
+  bool m_tableChanged;                 //!< Routes changed since the tries were built
+
   Ptr<Ipv4> m_ipv4; //!< associated IPv4 instance
 };
 
@@ -18,6 +18,7 @@
 // Author: George F. Riley<riley@ece.gatech.edu>
 //
 
+#include <algorithm>
 #include "ns3/packet.h"
 #include "ns3/log.h"
 #include "ns3/callback.h"
@@ -43,6 +44,8 @@
 #include "icmpv4-l4-protocol.h"
 #include "ipv4-interface.h"
 #include "ipv4-raw-socket-impl.h"
+#include "tcp-header.h"
+#include "tcp-segmentation-tag.h"
 
 namespace ns3 {
 
@@ -989,6 +992,18 @@ Ipv4L3Protocol::SendRealOut (Ptr<Ipv4Route> route,
   if (outInterface->IsUp ())
     {
       NS_LOG_LOGIC ("Send to " << targetLabel << " " << target);
+      TcpSegmentationTag segmentation;
+      if (packet->RemovePacketTag (segmentation))
+        {
+          // TCP segmentation offload: send the wire segments of the super-segment
+          std::list<Ipv4PayloadHeaderPair> listSegments;
+          DoSegmentation (packet, ipHeader, segmentation.GetSegmentSize (), listSegments);
+          for (std::list<Ipv4PayloadHeaderPair>::iterator it = listSegments.begin (); it != listSegments.end (); it++)
+            {
+              SendRealOut (route, it->first, it->second);
+            }
+          return;
+        }
       if ( packet->GetSize () + ipHeader.GetSerializedSize () > outInterface->GetDevice ()->GetMtu () )
         {
           std::list<Ipv4PayloadHeaderPair> listFragments;
@@ -1516,6 +1531,66 @@ Ipv4L3Protocol::DoFragmentation (Ptr<Packet> packet, const Ipv4Header & ipv4Head
   return;
 }
 
+void
+Ipv4L3Protocol::DoSegmentation (Ptr<Packet> packet, const Ipv4Header & ipv4Header, uint32_t segmentSize, std::list<Ipv4PayloadHeaderPair>& listSegments)
+{
+  NS_LOG_FUNCTION (this << *packet << segmentSize << &listSegments);
+  NS_ASSERT (segmentSize > 0);
+
+  Ptr<Packet> p = packet->Copy ();
+  TcpHeader tcpHeader;
+  p->RemoveHeader (tcpHeader);
+
+  uint64_t srcDst = ipv4Header.GetDestination ().Get () | (uint64_t (ipv4Header.GetSource ().Get ()) << 32);
+  std::pair<uint64_t, uint8_t> key = std::make_pair (srcDst, ipv4Header.GetProtocol ());
+
+  uint32_t offset = 0;
+  do
+    {
+      uint32_t size = std::min (segmentSize, p->GetSize () - offset);
+      Ptr<Packet> segment = p->CreateFragment (offset, size);
+
+      // CWR goes with the first segment, FIN and PSH with the last one
+      TcpHeader segmentHeader = tcpHeader;
+      uint8_t flags = tcpHeader.GetFlags ();
+      if (offset > 0)
+        {
+          flags &= ~TcpHeader::CWR;
+        }
+      if (offset + size < p->GetSize ())
+        {
+          flags &= ~(TcpHeader::FIN | TcpHeader::PSH);
+        }
+      segmentHeader.SetFlags (flags);
+      segmentHeader.SetSequenceNumber (tcpHeader.GetSequenceNumber () + SequenceNumber32 (offset));
+      if (Node::ChecksumEnabled ())
+        {
+          segmentHeader.EnableChecksums ();
+          segmentHeader.InitializeChecksum (ipv4Header.GetSource (), ipv4Header.GetDestination (), ipv4Header.GetProtocol ());
+        }
+      segment->AddHeader (segmentHeader);
+
+      // the first segment keeps the identification of the super-segment,
+      // the others take the next ones as if TCP had sent them one by one
+      Ipv4Header segmentIpHeader = ipv4Header;
+      segmentIpHeader.SetPayloadSize (segment->GetSize ());
+      if (offset > 0)
+        {
+          segmentIpHeader.SetIdentification (m_identification[key]);
+          m_identification[key]++;
+        }
+      if (Node::ChecksumEnabled ())
+        {
+          segmentIpHeader.EnableChecksum ();
+        }
+
+      NS_LOG_LOGIC ("Segment " << segmentHeader.GetSequenceNumber () << " of " << size << " bytes");
+      listSegments.emplace_back (segment, segmentIpHeader);
+      offset += size;
+    }
+  while (offset < p->GetSize ());
+}
+
 bool
 Ipv4L3Protocol::ProcessFragment (Ptr<Packet>& packet, Ipv4Header& ipHeader, uint32_t iif)
 {
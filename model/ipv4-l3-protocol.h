@@ -416,6 +416,20 @@ private:
    */
   void DoFragmentation (Ptr<Packet> packet, const Ipv4Header& ipv4Header, uint32_t outIfaceMtu, std::list<Ipv4PayloadHeaderPair>& listFragments);
 
+  /**
+   * \brief Cut a TCP super-segment into wire segments (segmentation offload)
+   *
+   * Each segment gets a copy of the TCP header with its own sequence number
+   * and checksum, and a copy of the IPv4 header with its own payload size
+   * and identification.
+   *
+   * \param packet the TCP header and the data of the super-segment
+   * \param ipv4Header the IPv4 header of the super-segment
+   * \param segmentSize the payload size of the segments (TcpSegmentationTag)
+   * \param listSegments the list of segments
+   */
+  void DoSegmentation (Ptr<Packet> packet, const Ipv4Header& ipv4Header, uint32_t segmentSize, std::list<Ipv4PayloadHeaderPair>& listSegments);
+
   /**
    * \brief Process a packet fragment
    * \param packet the packet
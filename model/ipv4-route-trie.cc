@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include "ipv4-route-trie.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4RouteTrie");
+
+Ipv4RouteTrie::Ipv4RouteTrie ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+}
+
+void
+Ipv4RouteTrie::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_nodes.clear ();
+  m_routes.clear ();
+  m_groups.clear ();
+  NewNode (0, 0);
+}
+
+uint32_t
+Ipv4RouteTrie::MaskOf (uint8_t length)
+{
+  return length == 0 ? 0 : 0xffffffff << (32 - length);
+}
+
+uint32_t
+Ipv4RouteTrie::NewNode (uint32_t prefix, uint8_t length)
+{
+  Node node;
+  node.prefix = prefix & MaskOf (length);
+  node.length = length;
+  node.child[0] = NONE;
+  node.child[1] = NONE;
+  node.group = NONE;
+  m_nodes.push_back (node);
+  return m_nodes.size () - 1;
+}
+
+void
+Ipv4RouteTrie::Insert (Ipv4Address network, Ipv4Mask mask, Ipv4RoutingTableEntry *route)
+{
+  NS_LOG_FUNCTION (this << network << mask << route);
+  uint8_t length = mask.GetPrefixLength ();
+  NS_ASSERT_MSG (mask.Get () == MaskOf (length), "Ipv4RouteTrie::Insert (): non-contiguous mask " << mask);
+  uint32_t prefix = network.Get () & MaskOf (length);
+
+  // walk down from the root, whose prefix matches everything, splitting
+  // the edge the new prefix branches off
+  uint32_t i = 0;
+  while (length > m_nodes[i].length)
+    {
+      uint32_t bit = (prefix >> (31 - m_nodes[i].length)) & 1;
+      uint32_t c = m_nodes[i].child[bit];
+      if (c == NONE)
+        {
+          c = NewNode (prefix, length);
+          m_nodes[i].child[bit] = c;
+          i = c;
+          break;
+        }
+      uint32_t diff = prefix ^ m_nodes[c].prefix;
+      uint8_t common = 0;
+      while (common < 32 && (diff & (0x80000000 >> common)) == 0)
+        {
+          common++;
+        }
+      common = std::min (common, std::min (length, m_nodes[c].length));
+      if (common == m_nodes[c].length)
+        {
+          i = c;
+          continue;
+        }
+      // the new prefix, or a branching point, goes between i and c
+      uint32_t split = NewNode (prefix, common);
+      m_nodes[split].child[(m_nodes[c].prefix >> (31 - common)) & 1] = c;
+      m_nodes[i].child[bit] = split;
+      i = split;
+      if (common < length)
+        {
+          uint32_t leaf = NewNode (prefix, length);
+          m_nodes[split].child[(prefix >> (31 - common)) & 1] = leaf;
+          i = leaf;
+        }
+      break;
+    }
+  m_nodes[i].routes.push_back (m_routes.size ());
+  m_routes.push_back (route);
+}
+
+void
+Ipv4RouteTrie::Compile (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_groups.clear ();
+  // depth first, each node getting the routes of its parent followed, in
+  // table order, by its own
+  std::vector<std::vector<uint32_t> > indices;
+  std::vector<std::pair<uint32_t, uint32_t> > stack;    // node, parent group
+  stack.push_back (std::make_pair (0, NONE));
+  while (!stack.empty ())
+    {
+      Node &node = m_nodes[stack.back ().first];
+      uint32_t group = stack.back ().second;
+      stack.pop_back ();
+      if (!node.routes.empty ())
+        {
+          std::vector<uint32_t> merged;
+          if (group == NONE)
+            {
+              merged = node.routes;
+            }
+          else
+            {
+              std::merge (indices[group].begin (), indices[group].end (),
+                          node.routes.begin (), node.routes.end (),
+                          std::back_inserter (merged));
+            }
+          group = indices.size ();
+          indices.push_back (merged);
+        }
+      node.group = group;
+      for (uint32_t bit = 0; bit < 2; bit++)
+        {
+          if (node.child[bit] != NONE)
+            {
+              stack.push_back (std::make_pair (node.child[bit], group));
+            }
+        }
+    }
+
+  m_groups.resize (indices.size ());
+  for (uint32_t g = 0; g < indices.size (); g++)
+    {
+      m_groups[g].reserve (indices[g].size ());
+      for (uint32_t r = 0; r < indices[g].size (); r++)
+        {
+          m_groups[g].push_back (m_routes[indices[g][r]]);
+        }
+    }
+  NS_LOG_LOGIC (m_routes.size () << " routes, " << m_nodes.size () << " nodes, " << m_groups.size () << " groups");
+}
+
+const Ipv4RouteTrie::Group *
+Ipv4RouteTrie::Lookup (Ipv4Address dest) const
+{
+  uint32_t address = dest.Get ();
+  uint32_t group = NONE;
+  uint32_t i = 0;
+  while (i != NONE)
+    {
+      const Node &node = m_nodes[i];
+      if ((address ^ node.prefix) & MaskOf (node.length))
+        {
+          break;
+        }
+      group = node.group;
+      if (node.length == 32)
+        {
+          break;
+        }
+      i = node.child[(address >> (31 - node.length)) & 1];
+    }
+  return group == NONE ? 0 : &m_groups[group];
+}
+
+uint32_t
+Ipv4RouteTrie::GetNNodes (void) const
+{
+  return m_nodes.size ();
+}
+
+} // namespace ns3
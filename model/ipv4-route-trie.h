@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef IPV4_ROUTE_TRIE_H
+#define IPV4_ROUTE_TRIE_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+class Ipv4RoutingTableEntry;
+
+/**
+ * \ingroup ipv4
+ *
+ * \brief Compiled prefix match of a list of IPv4 routes
+ *
+ * The routes are inserted in the order of their routing table, then the
+ * table is compiled into a path-compressed binary trie: a node per prefix
+ * and per branching point, in a single vector. Each node holds the group
+ * of all the routes matching the addresses below it, its own and those of
+ * the shorter prefixes, in table order: the lookup is a walk down the trie
+ * that returns the group of the last node it reaches, which is the list of
+ * every route of the table matching the address, ready for the ECMP
+ * selection.
+ *
+ * The masks must be contiguous. The trie holds pointers to the routes and
+ * must be cleared and built again when the table changes.
+ */
+class Ipv4RouteTrie
+{
+public:
+  /// Routes matching an address, in table order
+  typedef std::vector<Ipv4RoutingTableEntry *> Group;
+
+  Ipv4RouteTrie ();
+
+  /**
+   * \brief Remove all the routes
+   */
+  void Clear (void);
+
+  /**
+   * \brief Add a route after those already inserted
+   * \param network the destination network
+   * \param mask the contiguous network mask
+   * \param route the route
+   */
+  void Insert (Ipv4Address network, Ipv4Mask mask, Ipv4RoutingTableEntry *route);
+
+  /**
+   * \brief Compute the groups of the nodes, after the insertions
+   */
+  void Compile (void);
+
+  /**
+   * \param dest the address
+   * \return the routes matching the address, in table order, or 0 if none
+   */
+  const Group * Lookup (Ipv4Address dest) const;
+
+  /**
+   * \return the number of nodes of the trie
+   */
+  uint32_t GetNNodes (void) const;
+
+private:
+  /// No node or no group
+  static const uint32_t NONE = 0xffffffff;
+
+  /// Node of the trie
+  struct Node
+  {
+    uint32_t prefix;                //!< Prefix, with the bits past length cleared
+    uint8_t length;                 //!< Prefix length
+    uint32_t child[2];              //!< Children by the bit after the prefix
+    uint32_t group;                 //!< Routes matching below the node
+    std::vector<uint32_t> routes;   //!< Routes of this exact prefix, by index in m_routes
+  };
+
+  /**
+   * \param length a prefix length
+   * \return the mask of the length
+   */
+  static uint32_t MaskOf (uint8_t length);
+
+  /**
+   * \brief Add a node
+   * \param prefix the prefix
+   * \param length the prefix length
+   * \return the index of the node
+   */
+  uint32_t NewNode (uint32_t prefix, uint8_t length);
+
+  std::vector<Node> m_nodes;                       //!< Nodes, the root first
+  std::vector<Ipv4RoutingTableEntry *> m_routes;   //!< Routes, in table order
+  std::vector<Group> m_groups;                     //!< Groups of the nodes
+};
+
+} // namespace ns3
+
+#endif /* IPV4_ROUTE_TRIE_H */
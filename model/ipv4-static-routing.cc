@@ -23,6 +23,7 @@
       std::clog << Simulator::Now ().GetSeconds () \
                 << " [node " << m_ipv4->GetObject<Node> ()->GetId () << "] "; }
 
+#include <vector>
 #include <iomanip>
 #include "ns3/log.h"
 #include "ns3/names.h"
@@ -31,8 +32,10 @@
 #include "ns3/simulator.h"
 #include "ns3/ipv4-route.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ns3/boolean.h"
 #include "ipv4-static-routing.h"
 #include "ipv4-routing-table-entry.h"
+#include "tcp-l4-protocol.h"
 
 using std::make_pair;
 
@@ -49,14 +52,21 @@ Ipv4StaticRouting::GetTypeId (void)
     .SetParent<Ipv4RoutingProtocol> ()
     .SetGroupName ("Internet")
     .AddConstructor<Ipv4StaticRouting> ()
+    .AddAttribute ("FlowEcmpRouting",
+                   "Set to true if the packets of a flow are routed on the same route among the routes of equal mask length and metric, chosen by the EcmpSelector; set to false for using only one route consistently",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4StaticRouting::m_flowEcmpRouting),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
 
 Ipv4StaticRouting::Ipv4StaticRouting () 
-  : m_ipv4 (0)
+  : m_flowEcmpRouting (false),
+    m_ipv4 (0)
 {
   NS_LOG_FUNCTION (this);
+  m_ecmpSelector = CreateObject<Ipv4EcmpSelector> ();
 }
 
 void 
@@ -220,12 +230,17 @@ Ipv4StaticRouting::RemoveMulticastRoute (uint32_t index)
 }
 
 Ptr<Ipv4Route>
-Ipv4StaticRouting::LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif)
+Ipv4StaticRouting::LookupStatic (const Ipv4Header &header, Ptr<const Packet> p, bool transport, Ptr<NetDevice> oif)
 {
+  Ipv4Address dest = header.GetDestination ();
   NS_LOG_FUNCTION (this << dest << " " << oif);
   Ptr<Ipv4Route> rtentry = 0;
   uint16_t longest_mask = 0;
   uint32_t shortest_metric = 0xffffffff;
+  Ipv4RoutingTableEntry* route = 0;
+  // with FlowEcmpRouting, all the routes of the longest mask and the
+  // shortest metric, for the selector to choose from
+  std::vector<Ipv4RoutingTableEntry *> multipath;
   /* when sending on local multicast, there have to be interface specified */
   if (dest.IsLocalMulticast ())
     {
@@ -269,6 +284,7 @@ Ipv4StaticRouting::LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif)
           if (masklen > longest_mask) // Reset metric if longer masklen
             {
               shortest_metric = 0xffffffff;
+              multipath.clear ();
             }
           longest_mask = masklen;
           if (metric > shortest_metric)
@@ -276,20 +292,40 @@ Ipv4StaticRouting::LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif)
               NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
               continue;
             }
+          if (metric < shortest_metric)
+            {
+              multipath.clear ();
+            }
           shortest_metric = metric;
-          Ipv4RoutingTableEntry* route = (j);
-          uint32_t interfaceIdx = route->GetInterface ();
-          rtentry = Create<Ipv4Route> ();
-          rtentry->SetDestination (route->GetDest ());
-          rtentry->SetSource (m_ipv4->SourceAddressSelection (interfaceIdx, route->GetDest ()));
-          rtentry->SetGateway (route->GetGateway ());
-          rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+          if (m_flowEcmpRouting)
+            {
+              multipath.push_back (j);
+              continue;
+            }
+          route = (j);
           if (masklen == 32)
             {
               break;
             }
         }
     }
+  if (!multipath.empty ())
+    {
+      route = multipath[m_ecmpSelector->Select (header, transport ? p : Ptr<const Packet> (), multipath, multipath.size ())];
+    }
+  if (route != 0)
+    {
+      uint32_t interfaceIdx = route->GetInterface ();
+      rtentry = Create<Ipv4Route> ();
+      rtentry->SetDestination (route->GetDest ());
+      rtentry->SetSource (m_ipv4->SourceAddressSelection (interfaceIdx, route->GetDest ()));
+      rtentry->SetGateway (route->GetGateway ());
+      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+      if (p != 0)
+        {
+          m_ecmpSelector->CountLoad (*route, p);
+        }
+    }
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Matching route via " << rtentry->GetGateway () << " at the end");
@@ -474,7 +510,9 @@ Ipv4StaticRouting::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<Net
       // So, we just log it and fall through to LookupStatic ()
       NS_LOG_LOGIC ("RouteOutput()::Multicast destination");
     }
-  rtentry = LookupStatic (destination, oif);
+  // TCP asks for the routes of its segments with their header, UDP and
+  // the others with their payload only
+  rtentry = LookupStatic (header, p, header.GetProtocol () == TcpL4Protocol::PROT_NUMBER, oif);
   if (rtentry)
     { 
       sockerr = Socket::ERROR_NOTERROR;
@@ -546,7 +584,7 @@ Ipv4StaticRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &ipHeader,
       return true;
     }
   // Next, try to find a route
-  Ptr<Ipv4Route> rtentry = LookupStatic (ipHeader.GetDestination ());
+  Ptr<Ipv4Route> rtentry = LookupStatic (ipHeader, p, true);
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Found unicast destination- calling unicast callback");
@@ -565,6 +603,12 @@ Ipv4StaticRouting::~Ipv4StaticRouting ()
   NS_LOG_FUNCTION (this);
 }
 
+Ptr<Ipv4EcmpSelector>
+Ipv4StaticRouting::GetEcmpSelector (void) const
+{
+  return m_ecmpSelector;
+}
+
 void
 Ipv4StaticRouting::DoDispose (void)
 {
@@ -31,6 +31,7 @@
 #include "ns3/ptr.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4-ecmp-selector.h"
 
 namespace ns3 {
 
@@ -53,6 +54,10 @@ class Node;
  * This particular protocol is designed to be inserted into an 
  * Ipv4ListRouting protocol but can be used also as a standalone
  * protocol.
+ *
+ * Among the matching routes of the longest mask and the shortest metric,
+ * the packets take a single one, or with FlowEcmpRouting the route of
+ * their flow, chosen by an Ipv4EcmpSelector.
  * 
  * The Ipv4StaticRouting class inherits from the abstract base class 
  * Ipv4RoutingProtocol that defines the interface methods that a routing 
@@ -354,6 +359,13 @@ public:
  */
   void RemoveMulticastRoute (uint32_t index);
 
+/**
+ * \brief Get the Ipv4EcmpSelector of this protocol
+ * \return the selector, used with FlowEcmpRouting, which also counts the
+ * packets routed to each next hop when its CountLoad attribute is set
+ */
+  Ptr<Ipv4EcmpSelector> GetEcmpSelector (void) const;
+
 protected:
   virtual void DoDispose (void);
 
@@ -378,11 +390,14 @@ private:
 
   /**
    * \brief Lookup in the forwarding table for destination.
-   * \param dest destination address
+   * \param header IP header of the packet
+   * \param p the packet, or 0 if the route is not for a packet
+   * \param transport true if the packet starts with its transport header
    * \param oif output interface if any (put 0 otherwise)
    * \return Ipv4Route to route the packet to reach dest address
    */
-  Ptr<Ipv4Route> LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif = 0);
+  Ptr<Ipv4Route> LookupStatic (const Ipv4Header &header, Ptr<const Packet> p, bool transport,
+                               Ptr<NetDevice> oif = 0);
 
   /**
    * \brief Lookup in the multicast forwarding table for destination.
@@ -404,6 +419,16 @@ private:
    */
   MulticastRoutes m_multicastRoutes;
 
+  /**
+   * \brief Set to true if the packets of a flow are routed on the same route among ECMP.
+   */
+  bool m_flowEcmpRouting;
+
+  /**
+   * \brief Route selection of the flows among ECMP, and load per next hop.
+   */
+  Ptr<Ipv4EcmpSelector> m_ecmpSelector;
+
   /**
    * \brief Ipv4 reference.
    */
@@ -27,9 +27,7 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("Ipv6EndPointDemux");
 
 Ipv6EndPointDemux::Ipv6EndPointDemux ()
-  : m_ephemeral (49152),
-    m_portFirst (49152),
-    m_portLast (65535)
+  : m_ports (49152, 65535)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -43,24 +41,24 @@ Ipv6EndPointDemux::~Ipv6EndPointDemux ()
       delete endPoint;
     }
   m_endPoints.clear ();
+  m_positions.clear ();
+  m_connections.clear ();
+  m_listeners.clear ();
 }
 
 bool Ipv6EndPointDemux::LookupPortLocal (uint16_t port)
 {
   NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
-    {
-      if ((*i)->GetLocalPort  () == port)
-        {
-          return true;
-        }
-    }
-  return false;
+  return m_ports.IsUsed (port);
 }
 
 bool Ipv6EndPointDemux::LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv6Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
+  if (!LookupPortLocal (port))
+    {
+      return false;
+    }
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
     {
       if ((*i)->GetLocalPort () == port &&
@@ -83,7 +81,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate ()
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (Ipv6Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -98,7 +96,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address address)
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -119,7 +117,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv6Ad
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
   return endPoint;
 }
@@ -129,21 +127,26 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
                                            Ipv6Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << boundNetDevice << localAddress << localPort << peerAddress << peerPort);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  // a duplicate has the same local port and peer, so it is in this bucket
+  EndPoints *bucket = FindBucket (localPort, peerAddress, peerPort);
+  if (bucket != 0)
     {
-      if ((*i)->GetLocalPort () == localPort &&
-          (*i)->GetLocalAddress () == localAddress &&
-          (*i)->GetPeerPort () == peerPort &&
-          (*i)->GetPeerAddress () == peerAddress &&
-          ((*i)->GetBoundNetDevice () == boundNetDevice || (*i)->GetBoundNetDevice () == 0))
+      for (EndPointsI i = bucket->begin (); i != bucket->end (); i++)
         {
-          NS_LOG_WARN ("Duplicated endpoint.");
-          return 0;
+          if ((*i)->GetLocalPort () == localPort &&
+              (*i)->GetLocalAddress () == localAddress &&
+              (*i)->GetPeerPort () == peerPort &&
+              (*i)->GetPeerAddress () == peerAddress &&
+              ((*i)->GetBoundNetDevice () == boundNetDevice || (*i)->GetBoundNetDevice () == 0))
+            {
+              NS_LOG_WARN ("Duplicated endpoint.");
+              return 0;
+            }
         }
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
+  Insert (endPoint);
 
   NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
 
@@ -153,17 +156,93 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
 void Ipv6EndPointDemux::DeAllocate (Ipv6EndPoint *endPoint)
 {
   NS_LOG_FUNCTION (this);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  std::unordered_map<Ipv6EndPoint *, EndPointsI>::iterator pos = m_positions.find (endPoint);
+  if (pos == m_positions.end ())
+    {
+      return;
+    }
+  Unindex (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+  m_ports.Remove (endPoint->GetLocalPort ());
+  m_endPoints.erase (pos->second);
+  m_positions.erase (pos);
+  delete endPoint;
+}
+
+void Ipv6EndPointDemux::Insert (Ipv6EndPoint *endPoint)
+{
+  NS_LOG_FUNCTION (this << endPoint);
+  m_positions[endPoint] = m_endPoints.insert (m_endPoints.end (), endPoint);
+  m_ports.Add (endPoint->GetLocalPort ());
+  Index (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+  endPoint->SetPeerChangeCallback (MakeCallback (&Ipv6EndPointDemux::PeerChanged, this));
+}
+
+bool Ipv6EndPointDemux::ConnectionKey::operator == (const ConnectionKey &other) const
+{
+  return localPort == other.localPort && peerPort == other.peerPort && peerAddress == other.peerAddress;
+}
+
+size_t Ipv6EndPointDemux::ConnectionKeyHash::operator () (const ConnectionKey &key) const
+{
+  return Ipv6AddressHash () (key.peerAddress) ^ (((size_t) key.peerPort << 16 | key.localPort) * 0x9e3779b1u);
+}
+
+bool Ipv6EndPointDemux::IsConnected (Ipv6Address peerAddress, uint16_t peerPort)
+{
+  return peerPort != 0 && peerAddress != Ipv6Address::GetAny ();
+}
+
+Ipv6EndPointDemux::EndPoints *Ipv6EndPointDemux::FindBucket (uint16_t localPort, Ipv6Address peerAddress, uint16_t peerPort)
+{
+  if (IsConnected (peerAddress, peerPort))
+    {
+      ConnectionKey key = { localPort, peerAddress, peerPort };
+      std::unordered_map<ConnectionKey, EndPoints, ConnectionKeyHash>::iterator i = m_connections.find (key);
+      return i == m_connections.end () ? 0 : &i->second;
+    }
+  std::unordered_map<uint16_t, EndPoints>::iterator i = m_listeners.find (localPort);
+  return i == m_listeners.end () ? 0 : &i->second;
+}
+
+void Ipv6EndPointDemux::Index (Ipv6EndPoint *endPoint, Ipv6Address peerAddress, uint16_t peerPort)
+{
+  if (IsConnected (peerAddress, peerPort))
+    {
+      ConnectionKey key = { endPoint->GetLocalPort (), peerAddress, peerPort };
+      m_connections[key].push_back (endPoint);
+    }
+  else
+    {
+      m_listeners[endPoint->GetLocalPort ()].push_back (endPoint);
+    }
+}
+
+void Ipv6EndPointDemux::Unindex (Ipv6EndPoint *endPoint, Ipv6Address peerAddress, uint16_t peerPort)
+{
+  EndPoints *bucket = FindBucket (endPoint->GetLocalPort (), peerAddress, peerPort);
+  NS_ASSERT (bucket != 0);
+  bucket->remove (endPoint);
+  if (bucket->empty ())
     {
-      if (*i == endPoint)
+      if (IsConnected (peerAddress, peerPort))
         {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
+          ConnectionKey key = { endPoint->GetLocalPort (), peerAddress, peerPort };
+          m_connections.erase (key);
+        }
+      else
+        {
+          m_listeners.erase (endPoint->GetLocalPort ());
         }
     }
 }
 
+void Ipv6EndPointDemux::PeerChanged (Ipv6EndPoint *endPoint, Ipv6Address oldAddress, uint16_t oldPort)
+{
+  NS_LOG_FUNCTION (this << endPoint << oldAddress << oldPort);
+  Unindex (endPoint, oldAddress, oldPort);
+  Index (endPoint, endPoint->GetPeerAddress (), endPoint->GetPeerPort ());
+}
+
 /*
  * If we have an exact match, we return it.
  * Otherwise, if we find a generic match, we return it.
@@ -181,99 +260,112 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::Lookup (Ipv6Address daddr, uint1
   EndPoints retval4; /* Exact match on all 4 */
 
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  /* only the connections to (saddr, sport) and the wildcard end points of
+     dport can match */
+  EndPoints *buckets[2] = {
+    IsConnected (saddr, sport) ? FindBucket (dport, saddr, sport) : 0,
+    FindBucket (dport, Ipv6Address::GetAny (), 0)
+  };
+  for (uint32_t b = 0; b < 2; b++)
     {
-      Ipv6EndPoint* endP = *i;
-
-      NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
-                                                 << " daddr=" << endP->GetLocalAddress ()
-                                                 << " sport=" << endP->GetPeerPort ()
-                                                 << " saddr=" << endP->GetPeerAddress ());
-
-      if (!endP->IsRxEnabled ())
+      if (buckets[b] == 0)
         {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                        << " because endpoint can not receive packets");
           continue;
         }
-
-      if (endP->GetLocalPort () != dport)
+      for (EndPointsI i = buckets[b]->begin (); i != buckets[b]->end (); i++)
         {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
+          Ipv6EndPoint* endP = *i;
 
-      if (endP->GetBoundNetDevice ())
-        {
-          if (!incomingInterface)
+          NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
+                                                     << " daddr=" << endP->GetLocalAddress ()
+                                                     << " sport=" << endP->GetPeerPort ()
+                                                     << " saddr=" << endP->GetPeerAddress ());
+
+          if (!endP->IsRxEnabled ())
             {
+              NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                            << " because endpoint can not receive packets");
               continue;
             }
-          if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+
+          if (endP->GetLocalPort () != dport)
             {
               NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                                 << " because endpoint is bound to specific device and"
-                                                 << endP->GetBoundNetDevice ()
-                                                 << " does not match packet device " << incomingInterface->GetDevice ());
+                                                 << " because endpoint dport "
+                                                 << endP->GetLocalPort ()
+                                                 << " does not match packet dport " << dport);
               continue;
             }
-        }
 
-      /*    Ipv6Address incomingInterfaceAddr = incomingInterface->GetAddress (); */
-      NS_LOG_DEBUG ("dest addr " << daddr);
+          if (endP->GetBoundNetDevice ())
+            {
+              if (!incomingInterface)
+                {
+                  continue;
+                }
+              if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+                {
+                  NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                                     << " because endpoint is bound to specific device and"
+                                                     << endP->GetBoundNetDevice ()
+                                                     << " does not match packet device " << incomingInterface->GetDevice ());
+                  continue;
+                }
+            }
 
-      bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv6Address::GetAny ();
-      bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
-      bool localAddressMatchesAllRouters = endP->GetLocalAddress () == Ipv6Address::GetAllRoutersMulticast ();
+          /*    Ipv6Address incomingInterfaceAddr = incomingInterface->GetAddress (); */
+          NS_LOG_DEBUG ("dest addr " << daddr);
 
-      /* if no match here, keep looking */
-      if (!(localAddressMatchesExact || localAddressMatchesWildCard))
-        {
-          continue;
-        }
-      bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
-      bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
-      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
-      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv6Address::GetAny ();
-
-      /* If remote does not match either with exact or wildcard,i
-         skip this one */
-      if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
-        {
-          continue;
-        }
-      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
-        {
-          continue;
-        }
+          bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv6Address::GetAny ();
+          bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
+          bool localAddressMatchesAllRouters = endP->GetLocalAddress () == Ipv6Address::GetAllRoutersMulticast ();
 
-      /* Now figure out which return list to add this one to */
-      if (localAddressMatchesWildCard
-          && remotePeerMatchesWildCard
-          && remoteAddressMatchesWildCard)
-        { /* Only local port matches exactly */
-          retval1.push_back (endP);
-        }
-      if ((localAddressMatchesExact || (localAddressMatchesAllRouters))
-          && remotePeerMatchesWildCard
-          && remoteAddressMatchesWildCard)
-        { /* Only local port and local address matches exactly */
-          retval2.push_back (endP);
-        }
-      if (localAddressMatchesWildCard
-          && remotePeerMatchesExact
-          && remoteAddressMatchesExact)
-        { /* All but local address */
-          retval3.push_back (endP);
-        }
-      if (localAddressMatchesExact
-          && remotePeerMatchesExact
-          && remoteAddressMatchesExact)
-        { /* All 4 match */
-          retval4.push_back (endP);
+          /* if no match here, keep looking */
+          if (!(localAddressMatchesExact || localAddressMatchesWildCard))
+            {
+              continue;
+            }
+          bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
+          bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
+          bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+          bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv6Address::GetAny ();
+
+          /* If remote does not match either with exact or wildcard,i
+             skip this one */
+          if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+            {
+              continue;
+            }
+          if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+            {
+              continue;
+            }
+
+          /* Now figure out which return list to add this one to */
+          if (localAddressMatchesWildCard
+              && remotePeerMatchesWildCard
+              && remoteAddressMatchesWildCard)
+            { /* Only local port matches exactly */
+              retval1.push_back (endP);
+            }
+          if ((localAddressMatchesExact || (localAddressMatchesAllRouters))
+              && remotePeerMatchesWildCard
+              && remoteAddressMatchesWildCard)
+            { /* Only local port and local address matches exactly */
+              retval2.push_back (endP);
+            }
+          if (localAddressMatchesWildCard
+              && remotePeerMatchesExact
+              && remoteAddressMatchesExact)
+            { /* All but local address */
+              retval3.push_back (endP);
+            }
+          if (localAddressMatchesExact
+              && remotePeerMatchesExact
+              && remoteAddressMatchesExact)
+            { /* All 4 match */
+              retval4.push_back (endP);
+            }
         }
     }
 
@@ -290,6 +382,13 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::Lookup (Ipv6Address daddr, uint1
 
 Ipv6EndPoint* Ipv6EndPointDemux::SimpleLookup (Ipv6Address dst, uint16_t dport, Ipv6Address src, uint16_t sport)
 {
+  /* only used for ICMP errors, and a generic match may be any end point of
+     dport, so it still walks the list */
+  if (!LookupPortLocal (dport))
+    {
+      return 0;
+    }
+
   uint32_t genericity = 3;
   Ipv6EndPoint *generic = 0;
 
@@ -331,23 +430,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::SimpleLookup (Ipv6Address dst, uint16_t dport,
 uint16_t Ipv6EndPointDemux::AllocateEphemeralPort ()
 {
   NS_LOG_FUNCTION (this);
-  uint16_t port = m_ephemeral;
-  int count = m_portLast - m_portFirst;
-  do
-    {
-      if (count-- < 0)
-        {
-          return 0;
-        }
-      ++port;
-      if (port < m_portFirst || port > m_portLast)
-        {
-          port = m_portFirst;
-        }
-    }
-  while (LookupPortLocal (port));
-  m_ephemeral = port;
-  return port;
+  return m_ports.AllocateEphemeral ();
 }
 
 Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::GetEndPoints () const
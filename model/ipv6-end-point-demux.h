@@ -23,8 +23,10 @@
 
 #include <stdint.h>
 #include <list>
+#include <unordered_map>
 #include "ns3/ipv6-address.h"
 #include "ipv6-interface.h"
+#include "port-allocator.h"
 
 namespace ns3 {
 
@@ -34,6 +36,10 @@ class Ipv6EndPoint;
  * \ingroup ipv6
  *
  * \brief Demultiplexer for end points.
+ *
+ * Like Ipv4EndPointDemux, end points with a peer address and port are
+ * hashed on local port, peer address and peer port, and the other ones on
+ * their local port, so Lookup only matches the end points of two buckets.
  */
 class Ipv6EndPointDemux
 {
@@ -160,24 +166,104 @@ private:
   uint16_t AllocateEphemeralPort ();
 
   /**
-   * \brief The ephemeral port.
+   * \brief Connection index key: local port, peer address and peer port.
+   */
+  struct ConnectionKey
+  {
+    uint16_t localPort;      //!< local port
+    Ipv6Address peerAddress; //!< peer address
+    uint16_t peerPort;       //!< peer port
+
+    /**
+     * \param other the other key
+     * \return true if both keys are equal
+     */
+    bool operator == (const ConnectionKey &other) const;
+  };
+
+  /**
+   * \brief Hash of a ConnectionKey.
+   */
+  struct ConnectionKeyHash
+  {
+    /**
+     * \param key the key
+     * \return the hash
+     */
+    size_t operator () (const ConnectionKey &key) const;
+  };
+
+  /**
+   * \brief Add an end point to the list and the indexes.
+   * \param endPoint the end point
+   */
+  void Insert (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Add an end point to the bucket of its peer.
+   * \param endPoint the end point
+   * \param peerAddress peer address of the end point
+   * \param peerPort peer port of the end point
+   */
+  void Index (Ipv6EndPoint *endPoint, Ipv6Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Remove an end point from the bucket of its peer.
+   * \param endPoint the end point
+   * \param peerAddress peer address the end point was indexed with
+   * \param peerPort peer port the end point was indexed with
+   */
+  void Unindex (Ipv6EndPoint *endPoint, Ipv6Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Move an end point whose peer changed to its new bucket.
+   * \param endPoint the end point
+   * \param oldAddress previous peer address
+   * \param oldPort previous peer port
    */
-  uint16_t m_ephemeral;
+  void PeerChanged (Ipv6EndPoint *endPoint, Ipv6Address oldAddress, uint16_t oldPort);
 
   /**
-   * \brief The first ephemeral port.
+   * \brief Find the bucket of a local port and peer.
+   * \param localPort local port
+   * \param peerAddress peer address
+   * \param peerPort peer port
+   * \return the connection bucket if the peer is fully specified, the
+   * listener bucket of the local port otherwise; 0 if it does not exist
    */
-  uint16_t m_portFirst;
+  EndPoints *FindBucket (uint16_t localPort, Ipv6Address peerAddress, uint16_t peerPort);
 
   /**
-   * \brief The last ephemeral port.
+   * \param peerAddress peer address
+   * \param peerPort peer port
+   * \return true if neither the peer address nor the peer port is a wildcard
    */
-  uint16_t m_portLast;
+  static bool IsConnected (Ipv6Address peerAddress, uint16_t peerPort);
+
+  /**
+   * \brief Local ports in use and ephemeral port allocation.
+   */
+  PortAllocator m_ports;
 
   /**
    * \brief A list of IPv6 end points.
    */
   EndPoints m_endPoints;
+
+  /**
+   * \brief Position of each end point in m_endPoints.
+   */
+  std::unordered_map<Ipv6EndPoint *, EndPointsI> m_positions;
+
+  /**
+   * \brief End points with a fully specified peer.
+   */
+  std::unordered_map<ConnectionKey, EndPoints, ConnectionKeyHash> m_connections;
+
+  /**
+   * \brief End points with a wildcard peer address or port, by local port.
+   */
+  std::unordered_map<uint16_t, EndPoints> m_listeners;
 };
 
 } /* namespace ns3 */
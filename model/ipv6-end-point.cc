@@ -47,6 +47,7 @@ Ipv6EndPoint::~Ipv6EndPoint ()
   m_rxCallback.Nullify ();
   m_icmpCallback.Nullify ();
   m_destroyCallback.Nullify ();
+  m_peerChangeCallback.Nullify ();
 }
 
 Ipv6Address Ipv6EndPoint::GetLocalAddress ()
@@ -92,8 +93,14 @@ Ptr<NetDevice> Ipv6EndPoint::GetBoundNetDevice (void)
 
 void Ipv6EndPoint::SetPeer (Ipv6Address addr, uint16_t port)
 {
+  Ipv6Address oldAddr = m_peerAddr;
+  uint16_t oldPort = m_peerPort;
   m_peerAddr = addr;
   m_peerPort = port;
+  if (!m_peerChangeCallback.IsNull ())
+    {
+      m_peerChangeCallback (this, oldAddr, oldPort);
+    }
 }
 
 void Ipv6EndPoint::SetRxCallback (Callback<void, Ptr<Packet>, Ipv6Header, uint16_t, Ptr<Ipv6Interface> > callback)
@@ -111,6 +118,11 @@ void Ipv6EndPoint::SetDestroyCallback (Callback<void> callback)
   m_destroyCallback = callback;
 }
 
+void Ipv6EndPoint::SetPeerChangeCallback (Callback<void, Ipv6EndPoint *, Ipv6Address, uint16_t> callback)
+{
+  m_peerChangeCallback = callback;
+}
+
 void Ipv6EndPoint::ForwardUp (Ptr<Packet> p, Ipv6Header header, uint16_t port, Ptr<Ipv6Interface> incomingInterface)
 {
   if (!m_rxCallback.IsNull ())
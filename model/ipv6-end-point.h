@@ -151,6 +151,14 @@ public:
    */
   void SetDestroyCallback (Callback<void> callback);
 
+  /**
+   * \brief Set the callback invoked after the peer changed.
+   *
+   * The demux uses it to keep its connection index up to date.
+   * \param callback callback function, given this end point and its previous peer address and port
+   */
+  void SetPeerChangeCallback (Callback<void, Ipv6EndPoint *, Ipv6Address, uint16_t> callback);
+
   /**
    * \brief Forward the packet to the upper level.
    *
@@ -232,6 +240,11 @@ private:
    */
   Callback<void> m_destroyCallback;
 
+  /**
+   * \brief The peer change callback.
+   */
+  Callback<void, Ipv6EndPoint *, Ipv6Address, uint16_t> m_peerChangeCallback;
+
   /**
    * \brief true if the endpoint can receive packets.
    */
@@ -0,0 +1,241 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/node.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/trace-source-accessor.h"
+
+#include "output-queued-switch.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("OutputQueuedSwitch");
+
+NS_OBJECT_ENSURE_REGISTERED (OutputQueuedSwitch);
+
+TypeId
+OutputQueuedSwitch::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::OutputQueuedSwitch")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<OutputQueuedSwitch> ()
+    .AddAttribute ("BufferSize",
+                   "Size in bytes of the buffer shared by the egress queues of all ports.",
+                   UintegerValue (800000),
+                   MakeUintegerAccessor (&OutputQueuedSwitch::m_bufferSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Alpha",
+                   "Dynamic threshold factor: an egress queue may hold at most Alpha "
+                   "times the free shared buffer. 0 lets a single port take the "
+                   "whole buffer.",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&OutputQueuedSwitch::m_alpha),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Learning",
+                   "Learn the port of a host from the source address of its frames.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&OutputQueuedSwitch::m_learning),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("BufferOccupancy",
+                     "Bytes held in the shared buffer.",
+                     MakeTraceSourceAccessor (&OutputQueuedSwitch::m_bufferBytes),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("Drop",
+                     "Frame dropped because the shared buffer is full or "
+                     "its destination is unknown.",
+                     MakeTraceSourceAccessor (&OutputQueuedSwitch::m_dropTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+OutputQueuedSwitch::OutputQueuedSwitch ()
+  : m_bufferBytes (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+OutputQueuedSwitch::~OutputQueuedSwitch ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+OutputQueuedSwitch::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_ports.clear ();
+  m_queues.clear ();
+  m_portOfIfIndex.clear ();
+  m_table.clear ();
+  Object::DoDispose ();
+}
+
+uint32_t
+OutputQueuedSwitch::AddPort (Ptr<NetDevice> port, Ptr<Queue<Packet> > queue)
+{
+  NS_LOG_FUNCTION (this << port << queue);
+  NS_ASSERT_MSG (port->SupportsSendFrom (), "OutputQueuedSwitch ports must support SendFrom");
+  NS_ASSERT (port->GetNode () != 0);
+
+  uint32_t index = m_ports.size ();
+  m_ports.push_back (port);
+  m_queues.push_back (queue);
+  if (port->GetIfIndex () >= m_portOfIfIndex.size ())
+    {
+      m_portOfIfIndex.resize (port->GetIfIndex () + 1, index);
+    }
+  m_portOfIfIndex[port->GetIfIndex ()] = index;
+
+  // straight from the device: a protocol handler per port would make the
+  // node walk its handler list, i.e. every port, for each frame
+  port->SetPromiscReceiveCallback (MakeCallback (&OutputQueuedSwitch::ReceiveFromPort, this));
+  queue->TraceConnectWithoutContext ("Dequeue", MakeCallback (&OutputQueuedSwitch::PortDequeue, this));
+  return index;
+}
+
+void
+OutputQueuedSwitch::AddHost (Mac48Address address, uint32_t port)
+{
+  NS_LOG_FUNCTION (this << address << port);
+  NS_ASSERT (port < m_ports.size ());
+  m_table[MacKey (address)] = port;
+}
+
+uint32_t
+OutputQueuedSwitch::GetNPorts (void) const
+{
+  return m_ports.size ();
+}
+
+Ptr<NetDevice>
+OutputQueuedSwitch::GetPort (uint32_t port) const
+{
+  NS_ASSERT (port < m_ports.size ());
+  return m_ports[port];
+}
+
+Ptr<Queue<Packet> >
+OutputQueuedSwitch::GetPortQueue (uint32_t port) const
+{
+  NS_ASSERT (port < m_queues.size ());
+  return m_queues[port];
+}
+
+uint32_t
+OutputQueuedSwitch::GetBufferOccupancy (void) const
+{
+  return m_bufferBytes;
+}
+
+uint64_t
+OutputQueuedSwitch::MacKey (Mac48Address address)
+{
+  uint8_t buffer[6];
+  address.CopyTo (buffer);
+  uint64_t key = 0;
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      key = (key << 8) | buffer[i];
+    }
+  return key;
+}
+
+bool
+OutputQueuedSwitch::ReceiveFromPort (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                                     const Address &src, const Address &dst, NetDevice::PacketType packetType)
+{
+  NS_LOG_FUNCTION (this << device << packet << protocol << src << dst << packetType);
+  uint32_t in = m_portOfIfIndex[device->GetIfIndex ()];
+
+  if (m_learning)
+    {
+      m_table[MacKey (Mac48Address::ConvertFrom (src))] = in;
+    }
+
+  switch (packetType)
+    {
+    case NetDevice::PACKET_HOST:
+      // addressed to the port itself, there is nothing above the switch
+      break;
+
+    case NetDevice::PACKET_BROADCAST:
+    case NetDevice::PACKET_MULTICAST:
+      for (uint32_t port = 0; port < m_ports.size (); port++)
+        {
+          if (port != in)
+            {
+              Forward (port, packet, protocol, src, dst);
+            }
+        }
+      break;
+
+    case NetDevice::PACKET_OTHERHOST:
+      {
+        std::unordered_map<uint64_t, uint32_t>::const_iterator it = m_table.find (MacKey (Mac48Address::ConvertFrom (dst)));
+        if (it == m_table.end ())
+          {
+            NS_LOG_LOGIC ("Unknown destination " << dst << ", dropping");
+            m_dropTrace (packet);
+          }
+        else if (it->second != in)
+          {
+            Forward (it->second, packet, protocol, src, dst);
+          }
+      }
+      break;
+    }
+  return true;
+}
+
+void
+OutputQueuedSwitch::Forward (uint32_t port, Ptr<const Packet> packet, uint16_t protocol,
+                             const Address &src, const Address &dst)
+{
+  NS_LOG_FUNCTION (this << port << packet);
+  uint32_t size = packet->GetSize ();
+  uint32_t used = m_bufferBytes;
+  if (used + size > m_bufferSize
+      || (m_alpha > 0 && m_queues[port]->GetNBytes () + size > m_alpha * (m_bufferSize - used)))
+    {
+      NS_LOG_LOGIC ("Shared buffer full (" << used << " bytes), dropping");
+      m_dropTrace (packet);
+      return;
+    }
+
+  // accounted before SendFrom: an idle port dequeues the frame right away
+  m_bufferBytes = used + size;
+  if (!m_ports[port]->SendFrom (packet->Copy (), src, dst, protocol))
+    {
+      m_bufferBytes -= size;
+      m_dropTrace (packet);
+    }
+}
+
+void
+OutputQueuedSwitch::PortDequeue (Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  NS_ASSERT (m_bufferBytes >= packet->GetSize ());
+  m_bufferBytes -= packet->GetSize ();
+}
+
+} // namespace ns3
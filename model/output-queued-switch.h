@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef OUTPUT_QUEUED_SWITCH_H
+#define OUTPUT_QUEUED_SWITCH_H
+
+#include <vector>
+#include <unordered_map>
+#include "ns3/object.h"
+#include "ns3/net-device.h"
+#include "ns3/mac48-address.h"
+#include "ns3/queue.h"
+#include "ns3/traced-callback.h"
+#include "ns3/traced-value.h"
+
+namespace ns3 {
+
+class Packet;
+
+/**
+ * \ingroup internet
+ * \brief An output-queued layer 2 switch with a shared packet buffer.
+ *
+ * Frames received on a port are forwarded to the port of their destination
+ * MAC address through a hash table, so the per-frame cost does not depend on
+ * the number of ports. Unknown unicast destinations are dropped instead of
+ * flooded; only broadcast and multicast frames go to every port. Hosts are
+ * registered with AddHost (or learned from the source address of their
+ * frames).
+ *
+ * The egress queues of all ports share one buffer of BufferSize bytes. A
+ * frame is admitted if it fits in the free shared space and, when Alpha is
+ * positive, if its egress queue stays below Alpha times the free space
+ * (dynamic threshold). The egress queues themselves should be large enough
+ * never to drop on their own.
+ *
+ * The switch is aggregated to its node, and its ports are devices of that
+ * node. Nothing above the switch receives the frames.
+ */
+class OutputQueuedSwitch : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  OutputQueuedSwitch ();
+  virtual ~OutputQueuedSwitch ();
+
+  /**
+   * \brief Add a port to the switch.
+   * \param port a device of the switch node; it must support SendFrom
+   * \param queue the egress queue of the device
+   * \return the port index
+   */
+  uint32_t AddPort (Ptr<NetDevice> port, Ptr<Queue<Packet> > queue);
+
+  /**
+   * \brief Forward the frames sent to a MAC address through a port.
+   * \param address the host MAC address
+   * \param port the port index returned by AddPort
+   */
+  void AddHost (Mac48Address address, uint32_t port);
+
+  /**
+   * \return the number of ports
+   */
+  uint32_t GetNPorts (void) const;
+
+  /**
+   * \param port the port index
+   * \return the port device
+   */
+  Ptr<NetDevice> GetPort (uint32_t port) const;
+
+  /**
+   * \param port the port index
+   * \return the egress queue of the port
+   */
+  Ptr<Queue<Packet> > GetPortQueue (uint32_t port) const;
+
+  /**
+   * \return the bytes currently held in the shared buffer
+   */
+  uint32_t GetBufferOccupancy (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief Promiscuous receive callback of the ports.
+   * \param device the port device
+   * \param packet the frame
+   * \param protocol the protocol number
+   * \param src the source MAC address
+   * \param dst the destination MAC address
+   * \param packetType the packet type seen by the port
+   * \return true
+   */
+  bool ReceiveFromPort (Ptr<NetDevice> device, Ptr<const Packet> packet, uint16_t protocol,
+                        const Address &src, const Address &dst, NetDevice::PacketType packetType);
+
+  /**
+   * \brief Admit a frame to the shared buffer and send it through a port.
+   * \param port the egress port index
+   * \param packet the frame
+   * \param protocol the protocol number
+   * \param src the source MAC address
+   * \param dst the destination MAC address
+   */
+  void Forward (uint32_t port, Ptr<const Packet> packet, uint16_t protocol,
+                const Address &src, const Address &dst);
+
+  /**
+   * \brief Release the buffer space of a frame leaving an egress queue.
+   * \param packet the frame
+   */
+  void PortDequeue (Ptr<const Packet> packet);
+
+  /**
+   * \param address a MAC address
+   * \return the forwarding table key of the address
+   */
+  static uint64_t MacKey (Mac48Address address);
+
+  std::vector<Ptr<NetDevice> > m_ports; //!< port devices
+  std::vector<Ptr<Queue<Packet> > > m_queues; //!< egress queue of each port
+  std::vector<uint32_t> m_portOfIfIndex; //!< node interface index -> port index
+  std::unordered_map<uint64_t, uint32_t> m_table; //!< MAC address -> port index
+  uint32_t m_bufferSize; //!< shared buffer size (bytes)
+  double m_alpha; //!< dynamic threshold factor, 0 for complete sharing
+  bool m_learning; //!< learn the source address of received frames
+  TracedValue<uint32_t> m_bufferBytes; //!< bytes held in the shared buffer
+  TracedCallback<Ptr<const Packet> > m_dropTrace; //!< frames dropped by the switch
+};
+
+} // namespace ns3
+
+#endif /* OUTPUT_QUEUED_SWITCH_H */
@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "port-allocator.h"
+#include "ns3/log.h"
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PortAllocator");
+
+PortAllocator::PortAllocator (uint16_t first, uint16_t last)
+  : m_ephemeral (first),
+    m_portFirst (first),
+    m_portLast (last)
+{
+  NS_LOG_FUNCTION (this << first << last);
+  NS_ASSERT (first > 0 && first <= last);
+}
+
+void
+PortAllocator::Add (uint16_t port)
+{
+  NS_LOG_FUNCTION (this << port);
+  if (++m_users[port] == 1)
+    {
+      Mark (port, true);
+    }
+}
+
+void
+PortAllocator::Remove (uint16_t port)
+{
+  NS_LOG_FUNCTION (this << port);
+  std::unordered_map<uint16_t, uint32_t>::iterator i = m_users.find (port);
+  NS_ASSERT (i != m_users.end ());
+  if (--i->second == 0)
+    {
+      m_users.erase (i);
+      Mark (port, false);
+    }
+}
+
+bool
+PortAllocator::IsUsed (uint16_t port) const
+{
+  return m_users.find (port) != m_users.end ();
+}
+
+void
+PortAllocator::Mark (uint16_t port, bool used)
+{
+  if (m_used.empty () || port < m_portFirst || port > m_portLast)
+    {
+      return;
+    }
+  uint32_t bit = port - m_portFirst;
+  if (used)
+    {
+      m_used[bit / 64] |= uint64_t (1) << (bit % 64);
+    }
+  else
+    {
+      m_used[bit / 64] &= ~(uint64_t (1) << (bit % 64));
+    }
+}
+
+uint16_t
+PortAllocator::FindFree (uint16_t from, uint16_t to) const
+{
+  uint32_t bit = from - m_portFirst;
+  uint32_t end = to - m_portFirst;
+  while (bit <= end)
+    {
+      // free ports of this word at or after bit
+      uint64_t free = ~m_used[bit / 64] & (~uint64_t (0) << (bit % 64));
+      if (free != 0)
+        {
+          uint32_t found = (bit & ~63u) + __builtin_ctzll (free);
+          return found <= end ? m_portFirst + found : 0;
+        }
+      bit = (bit & ~63u) + 64;
+    }
+  return 0;
+}
+
+uint16_t
+PortAllocator::AllocateEphemeral (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_used.empty ())
+    {
+      m_used.resize ((m_portLast - m_portFirst) / 64 + 1, 0);
+      for (std::unordered_map<uint16_t, uint32_t>::const_iterator i = m_users.begin (); i != m_users.end (); i++)
+        {
+          Mark (i->first, true);
+        }
+    }
+
+  // first free port after the last allocated one, wrapping around
+  uint16_t port = 0;
+  if (m_ephemeral < m_portLast)
+    {
+      port = FindFree (m_ephemeral + 1, m_portLast);
+    }
+  if (port == 0)
+    {
+      port = FindFree (m_portFirst, m_ephemeral);
+    }
+  if (port != 0)
+    {
+      m_ephemeral = port;
+    }
+  return port;
+}
+
+} // namespace ns3
@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PORT_ALLOCATOR_H
+#define PORT_ALLOCATOR_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief Local port usage of an end point demux and ephemeral port allocator.
+ *
+ * The demux reports each end point with Add/Remove, which keeps a user count
+ * per port, and a bitmap of the ephemeral range marking the ports in use.
+ * AllocateEphemeral returns the first free port after the previously
+ * allocated one, like the counting-up loop of netinet/in_pcb.c, by scanning
+ * the bitmap a word at a time: allocation does not depend on the number of
+ * end points. The bitmap is only built on the first allocation, so demuxes
+ * that never allocate ephemeral ports do not pay for it.
+ *
+ * Shared by Ipv4EndPointDemux and Ipv6EndPointDemux.
+ */
+class PortAllocator
+{
+public:
+  /**
+   * \param first the first ephemeral port
+   * \param last the last ephemeral port
+   */
+  PortAllocator (uint16_t first = 49152, uint16_t last = 65535);
+
+  /**
+   * \brief An end point now uses a local port.
+   * \param port the port
+   */
+  void Add (uint16_t port);
+
+  /**
+   * \brief An end point no longer uses a local port.
+   * \param port the port
+   */
+  void Remove (uint16_t port);
+
+  /**
+   * \param port the port
+   * \return true if an end point uses the port
+   */
+  bool IsUsed (uint16_t port) const;
+
+  /**
+   * \brief Find an unused ephemeral port.
+   *
+   * The port is not marked as used until an end point is added on it.
+   * \return the port, 0 if all the ephemeral ports are used
+   */
+  uint16_t AllocateEphemeral (void);
+
+private:
+  /**
+   * \brief Set or clear the bit of a port, if in the ephemeral range.
+   * \param port the port
+   * \param used the new bit value
+   */
+  void Mark (uint16_t port, bool used);
+
+  /**
+   * \brief Find the first free ephemeral port in [from, to].
+   * \param from first port
+   * \param to last port
+   * \return the port, 0 if none
+   */
+  uint16_t FindFree (uint16_t from, uint16_t to) const;
+
+  uint16_t m_ephemeral; //!< the last allocated ephemeral port
+  uint16_t m_portFirst; //!< the first ephemeral port
+  uint16_t m_portLast; //!< the last ephemeral port
+  std::unordered_map<uint16_t, uint32_t> m_users; //!< number of end points per used port
+  std::vector<uint64_t> m_used; //!< one bit per ephemeral port, set if used
+};
+
+} // namespace ns3
+
+#endif /* PORT_ALLOCATOR_H */
@@ -0,0 +1,242 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "quantile-sketch.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("QuantileSketch");
+
+NS_OBJECT_ENSURE_REGISTERED (QuantileSketch);
+
+TypeId
+QuantileSketch::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::QuantileSketch")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<QuantileSketch> ()
+    .AddAttribute ("RelativeAccuracy",
+                   "Maximum relative error of the returned quantiles",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&QuantileSketch::SetRelativeAccuracy,
+                                       &QuantileSketch::GetRelativeAccuracy),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("MaxBins",
+                   "Maximum number of bins; the lowest bins are collapsed past it",
+                   UintegerValue (2048),
+                   MakeUintegerAccessor (&QuantileSketch::m_maxBins),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+QuantileSketch::QuantileSketch ()
+  : m_maxBins (2048),
+    m_offset (0),
+    m_zeroCount (0),
+    m_count (0),
+    m_sum (0),
+    m_min (std::numeric_limits<double>::max ()),
+    m_max (std::numeric_limits<double>::lowest ())
+{
+  NS_LOG_FUNCTION (this);
+  SetRelativeAccuracy (0.01);
+}
+
+QuantileSketch::~QuantileSketch ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+QuantileSketch::SetRelativeAccuracy (double accuracy)
+{
+  NS_LOG_FUNCTION (this << accuracy);
+  NS_ABORT_MSG_IF (accuracy <= 0 || accuracy >= 1, "Relative accuracy must be in (0, 1)");
+  NS_ABORT_MSG_IF (m_count > 0, "Cannot change the accuracy of a non-empty sketch");
+  m_accuracy = accuracy;
+  m_gamma = (1 + accuracy) / (1 - accuracy);
+  m_logGamma = std::log (m_gamma);
+}
+
+double
+QuantileSketch::GetRelativeAccuracy (void) const
+{
+  return m_accuracy;
+}
+
+void
+QuantileSketch::Add (double value)
+{
+  NS_LOG_FUNCTION (this << value);
+  ++m_count;
+  m_sum += value;
+  m_min = std::min (m_min, value);
+  m_max = std::max (m_max, value);
+  if (value <= 0)
+    {
+      ++m_zeroCount;
+      return;
+    }
+  AddToBin (static_cast<int32_t> (std::ceil (std::log (value) / m_logGamma)), 1);
+}
+
+void
+QuantileSketch::AddToBin (int32_t key, uint64_t n)
+{
+  if (m_bins.empty ())
+    {
+      m_offset = key;
+      m_bins.push_back (0);
+    }
+
+  int32_t highest = m_offset + static_cast<int32_t> (m_bins.size ()) - 1;
+  if (key > highest)
+    {
+      m_bins.resize (key - m_offset + 1, 0);
+      if (m_bins.size () > m_maxBins)
+        {
+          // keep the highest keys, fold the lowest ones into the new lowest bin
+          uint32_t excess = m_bins.size () - m_maxBins;
+          uint64_t folded = 0;
+          for (uint32_t i = 0; i < excess; ++i)
+            {
+              folded += m_bins[i];
+            }
+          m_bins.erase (m_bins.begin (), m_bins.begin () + excess);
+          m_bins[0] += folded;
+          m_offset += excess;
+        }
+    }
+  else if (key < m_offset)
+    {
+      int32_t lowest = highest - static_cast<int32_t> (m_maxBins) + 1;
+      key = std::max (key, lowest);
+      if (key < m_offset)
+        {
+          m_bins.insert (m_bins.begin (), m_offset - key, 0);
+          m_offset = key;
+        }
+    }
+  m_bins[key - m_offset] += n;
+}
+
+void
+QuantileSketch::Merge (Ptr<const QuantileSketch> other)
+{
+  NS_LOG_FUNCTION (this << other);
+  NS_ABORT_MSG_IF (other->m_gamma != m_gamma, "Cannot merge sketches of different accuracy");
+  if (other->m_count == 0)
+    {
+      return;
+    }
+  // add from the highest key, so that collapsing keeps the same bins as
+  // if the samples had been added here
+  for (int32_t i = static_cast<int32_t> (other->m_bins.size ()) - 1; i >= 0; --i)
+    {
+      if (other->m_bins[i] > 0)
+        {
+          AddToBin (other->m_offset + i, other->m_bins[i]);
+        }
+    }
+  m_zeroCount += other->m_zeroCount;
+  m_count += other->m_count;
+  m_sum += other->m_sum;
+  m_min = std::min (m_min, other->m_min);
+  m_max = std::max (m_max, other->m_max);
+}
+
+double
+QuantileSketch::GetQuantile (double q) const
+{
+  NS_LOG_FUNCTION (this << q);
+  NS_ASSERT (q >= 0 && q <= 1);
+  if (m_count == 0)
+    {
+      return 0;
+    }
+
+  double rank = q * (m_count - 1);
+  uint64_t seen = m_zeroCount;
+  if (rank < seen)
+    {
+      return std::min (0.0, m_max);
+    }
+  for (uint32_t i = 0; i < m_bins.size (); ++i)
+    {
+      seen += m_bins[i];
+      if (rank < seen)
+        {
+          double value = 2 * std::pow (m_gamma, m_offset + static_cast<int32_t> (i)) / (m_gamma + 1);
+          return std::max (m_min, std::min (m_max, value));
+        }
+    }
+  return m_max;
+}
+
+uint64_t
+QuantileSketch::GetCount (void) const
+{
+  return m_count;
+}
+
+double
+QuantileSketch::GetMean (void) const
+{
+  return m_count > 0 ? m_sum / m_count : 0;
+}
+
+double
+QuantileSketch::GetMin (void) const
+{
+  return m_min;
+}
+
+double
+QuantileSketch::GetMax (void) const
+{
+  return m_max;
+}
+
+uint32_t
+QuantileSketch::GetBinCount (void) const
+{
+  return m_bins.size ();
+}
+
+void
+QuantileSketch::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_bins.clear ();
+  m_offset = 0;
+  m_zeroCount = 0;
+  m_count = 0;
+  m_sum = 0;
+  m_min = std::numeric_limits<double>::max ();
+  m_max = std::numeric_limits<double>::lowest ();
+}
+
+} // namespace ns3
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/object.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Streaming quantile estimator with bounded memory (DDSketch)
+ *
+ * Positive samples are counted in logarithmic bins of ratio
+ * gamma = (1 + a) / (1 - a), where a is the RelativeAccuracy attribute:
+ * every quantile returned is within a relative error a of the exact one.
+ * At most MaxBins bins are kept; past that the lowest bins are collapsed,
+ * which only affects the accuracy of the lowest quantiles. Zero and
+ * negative samples are counted in a separate bin.
+ *
+ * Sketches with the same accuracy can be merged, e.g. per-flow sketches
+ * into an aggregate one. The Add method has the signature of the
+ * TcpCongestionOps TCP_RTTstat callback, so a sketch can be attached to it
+ * directly:
+ *
+ * \code
+ *   Ptr<QuantileSketch> rtt = CreateObject<QuantileSketch> ();
+ *   Config::SetDefault ("ns3::TcpCongestionOps::TCP_RTTstat",
+ *                       CallbackValue (MakeCallback (&QuantileSketch::Add, rtt)));
+ * \endcode
+ */
+class QuantileSketch : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  QuantileSketch ();
+  virtual ~QuantileSketch ();
+
+  /**
+   * \brief Add a sample
+   * \param value the sample
+   */
+  void Add (double value);
+
+  /**
+   * \brief Add the samples of another sketch to this one
+   * \param other sketch built with the same relative accuracy
+   */
+  void Merge (Ptr<const QuantileSketch> other);
+
+  /**
+   * \brief Estimate a quantile
+   * \param q the quantile, in [0, 1]
+   * \return the estimated value, 0 if no sample has been added
+   */
+  double GetQuantile (double q) const;
+
+  /**
+   * \return the number of samples
+   */
+  uint64_t GetCount (void) const;
+
+  /**
+   * \return the exact mean of the samples, 0 if there is none
+   */
+  double GetMean (void) const;
+
+  /**
+   * \return the exact minimum of the samples
+   */
+  double GetMin (void) const;
+
+  /**
+   * \return the exact maximum of the samples
+   */
+  double GetMax (void) const;
+
+  /**
+   * \return the number of bins currently used
+   */
+  uint32_t GetBinCount (void) const;
+
+  /**
+   * \brief Drop all the samples
+   */
+  void Reset (void);
+
+  /**
+   * \brief Set the relative accuracy; the sketch must be empty
+   * \param accuracy the relative accuracy, in (0, 1)
+   */
+  void SetRelativeAccuracy (double accuracy);
+
+  /**
+   * \return the relative accuracy
+   */
+  double GetRelativeAccuracy (void) const;
+
+private:
+  /**
+   * \brief Add samples to the bin of a given key, growing or collapsing
+   * the bins as needed
+   * \param key the bin key
+   * \param n number of samples
+   */
+  void AddToBin (int32_t key, uint64_t n);
+
+  double   m_accuracy;  //!< Relative accuracy
+  double   m_gamma;     //!< Ratio between two consecutive bins
+  double   m_logGamma;  //!< log (m_gamma)
+  uint32_t m_maxBins;   //!< Maximum number of bins
+
+  std::vector<uint64_t> m_bins; //!< Bin m_bins[i] counts the samples of key m_offset + i
+  int32_t  m_offset;    //!< Key of m_bins[0]
+  uint64_t m_zeroCount; //!< Samples <= 0
+  uint64_t m_count;     //!< Total number of samples
+  double   m_sum;       //!< Sum of the samples
+  double   m_min;       //!< Smallest sample
+  double   m_max;       //!< Largest sample
+};
+
+} // namespace ns3
+
+#endif /* QUANTILE_SKETCH_H */
@@ -20,8 +20,11 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include "tcp-header.h"
 #include "tcp-option.h"
+#include "internet-checksum.h"
 #include "ns3/buffer.h"
 #include "ns3/address-utils.h"
 #include "ns3/log.h"
@@ -32,6 +35,70 @@ NS_LOG_COMPONENT_DEFINE ("TcpHeader");
 
 NS_OBJECT_ENSURE_REGISTERED (TcpHeader);
 
+/**
+ * \brief Read a 32 bit value in network order
+ * \param p the first byte
+ * \return the value
+ */
+static uint32_t
+ReadNetworkU32 (const uint8_t *p)
+{
+  return (uint32_t (p[0]) << 24) | (uint32_t (p[1]) << 16) | (uint32_t (p[2]) << 8) | p[3];
+}
+
+/**
+ * \brief Write a 32 bit value in network order
+ * \param p the first byte
+ * \param value the value
+ */
+static void
+WriteNetworkU32 (uint8_t *p, uint32_t value)
+{
+  p[0] = (value >> 24) & 0xff;
+  p[1] = (value >> 16) & 0xff;
+  p[2] = (value >> 8) & 0xff;
+  p[3] = value & 0xff;
+}
+
+/**
+ * \brief Create the TcpOption object of an option in wire format
+ * \param option the option bytes
+ * \param size the option size
+ * \return the option
+ */
+static Ptr<TcpOption>
+DeserializeOption (const uint8_t *option, uint32_t size)
+{
+  Buffer buffer;
+  buffer.AddAtStart (size);
+  buffer.Begin ().Write (option, size);
+  Ptr<TcpOption> op = TcpOption::CreateOption (TcpOption::IsKindKnown (option[0]) ? option[0] : uint8_t (TcpOption::UNKNOWN));
+  op->Deserialize (buffer.Begin ());
+  return op;
+}
+
+/**
+ * \brief One's complement sum of the bytes of a buffer
+ * \param i the first byte
+ * \param size the number of bytes
+ * \param sum the partial sum to start from
+ * \return the folded sum
+ */
+static uint16_t
+IteratorChecksumSum (Buffer::Iterator i, uint32_t size, uint16_t sum)
+{
+  // even sized chunks, so that each one starts on a word
+  uint8_t chunk[2048];
+  while (size > 0)
+    {
+      uint32_t length = std::min<uint32_t> (size, sizeof (chunk));
+      i.Read (chunk, length);
+      sum = ChecksumSum (chunk, length, sum);
+      size -= length;
+    }
+  return sum;
+}
+
 TcpHeader::TcpHeader ()
   : m_sourcePort (0),
     m_destinationPort (0),
@@ -41,10 +108,14 @@ TcpHeader::TcpHeader ()
     m_flags (0),
     m_windowSize (0xffff),
     m_urgentPointer (0),
+    m_pseudoHeaderSum (0),
+    m_payloadSum (0),
+    m_hasPayloadSum (false),
     m_calcChecksum (false),
     m_goodChecksum (true),
     m_optionsLen (0)
 {
+  std::memset (m_optionOffset, m_maxOptionsLen, sizeof (m_optionOffset));
 }
 
 TcpHeader::~TcpHeader ()
@@ -192,9 +263,10 @@ TcpHeader::InitializeChecksum (const Ipv4Address &source,
                                const Ipv4Address &destination,
                                uint8_t protocol)
 {
-  m_source = source;
-  m_destination = destination;
-  m_protocol = protocol;
+  uint8_t addresses[8];
+  source.Serialize (addresses);
+  destination.Serialize (addresses + 4);
+  m_pseudoHeaderSum = ChecksumAdd (ChecksumSum (addresses, 8), protocol);
 }
 
 void
@@ -202,9 +274,10 @@ TcpHeader::InitializeChecksum (const Ipv6Address &source,
                                const Ipv6Address &destination,
                                uint8_t protocol)
 {
-  m_source = source;
-  m_destination = destination;
-  m_protocol = protocol;
+  uint8_t addresses[32];
+  source.Serialize (addresses);
+  destination.Serialize (addresses + 16);
+  m_pseudoHeaderSum = ChecksumAdd (ChecksumSum (addresses, 32), protocol);
 }
 
 void
@@ -212,52 +285,33 @@ TcpHeader::InitializeChecksum (const Address &source,
                                const Address &destination,
                                uint8_t protocol)
 {
-  m_source = source;
-  m_destination = destination;
-  m_protocol = protocol;
-}
-
-uint16_t
-TcpHeader::CalculateHeaderChecksum (uint16_t size) const
-{
-  /* Buffer size must be at least as large as the largest IP pseudo-header */
-  /* [per RFC2460, but without consideration for IPv6 extension hdrs]      */
-  /* Src address            16 bytes (more generally, Address::MAX_SIZE)   */
-  /* Dst address            16 bytes (more generally, Address::MAX_SIZE)   */
-  /* Upper layer pkt len    4 bytes                                        */
-  /* Zero                   3 bytes                                        */
-  /* Next header            1 byte                                         */
-
-  uint32_t maxHdrSz = (2 * Address::MAX_SIZE) + 8;
-  Buffer buf = Buffer (maxHdrSz);
-  buf.AddAtStart (maxHdrSz);
-  Buffer::Iterator it = buf.Begin ();
-  uint32_t hdrSize = 0;
-
-  WriteTo (it, m_source);
-  WriteTo (it, m_destination);
-  if (Ipv4Address::IsMatchingType (m_source))
+  if (Ipv4Address::IsMatchingType (source))
     {
-      it.WriteU8 (0); /* protocol */
-      it.WriteU8 (m_protocol); /* protocol */
-      it.WriteU8 (size >> 8); /* length */
-      it.WriteU8 (size & 0xff); /* length */
-      hdrSize = 12;
+      InitializeChecksum (Ipv4Address::ConvertFrom (source),
+                          Ipv4Address::ConvertFrom (destination), protocol);
     }
   else
     {
-      it.WriteU16 (0);
-      it.WriteU8 (size >> 8); /* length */
-      it.WriteU8 (size & 0xff); /* length */
-      it.WriteU16 (0);
-      it.WriteU8 (0);
-      it.WriteU8 (m_protocol); /* protocol */
-      hdrSize = 40;
+      InitializeChecksum (Ipv6Address::ConvertFrom (source),
+                          Ipv6Address::ConvertFrom (destination), protocol);
     }
+}
+
+void
+TcpHeader::SetPayloadSum (uint16_t sum)
+{
+  m_payloadSum = sum;
+  m_hasPayloadSum = true;
+}
 
-  it = buf.Begin ();
-  /* we don't CompleteChecksum ( ~ ) now */
-  return ~(it.CalculateIpChecksum (hdrSize));
+uint16_t
+TcpHeader::CalculateHeaderChecksum (uint16_t size) const
+{
+  /* The pseudo-header is the addresses, the protocol and the upper layer */
+  /* length (RFC 793, RFC 2460); the sum of the addresses and protocol is */
+  /* kept from InitializeChecksum, and the length is the same 16 bit word */
+  /* in the IPv4 and in the IPv6 pseudo-header.                           */
+  return ChecksumAdd (m_pseudoHeaderSum, size);
 }
 
 bool
@@ -295,9 +349,10 @@ TcpHeader::Print (std::ostream &os)  const
 
   os << " Seq=" << m_sequenceNumber << " Ack=" << m_ackNumber << " Win=" << m_windowSize;
 
+  TcpOptionList options = GetOptionList ();
   TcpOptionList::const_iterator op;
 
-  for (op = m_options.begin (); op != m_options.end (); ++op)
+  for (op = options.begin (); op != options.end (); ++op)
     {
       os << " " << (*op)->GetInstanceTypeId ().GetName () << "(";
       (*op)->Print (os);
@@ -327,14 +382,8 @@ TcpHeader::Serialize (Buffer::Iterator start)  const
   // Serialize options if they exist
   // This implementation does not presently try to align options on word
   // boundaries using NOP options
-  uint32_t optionLen = 0;
-  TcpOptionList::const_iterator op;
-  for (op = m_options.begin (); op != m_options.end (); ++op)
-    {
-      optionLen += (*op)->GetSerializedSize ();
-      (*op)->Serialize (i);
-      i.Next ((*op)->GetSerializedSize ());
-    }
+  uint32_t optionLen = m_optionsLen;
+  i.Write (m_options, m_optionsLen);
 
   // padding to word alignment; add ENDs and/or pad values (they are the same)
   while (optionLen % 4)
@@ -343,16 +392,24 @@ TcpHeader::Serialize (Buffer::Iterator start)  const
       ++optionLen;
     }
 
-  // Make checksum
+  // Make checksum; with the payload sum given, only the header is read
   if (m_calcChecksum)
     {
-      uint16_t headerChecksum = CalculateHeaderChecksum (start.GetSize ());
-      i = start;
-      uint16_t checksum = i.CalculateIpChecksum (start.GetSize (), headerChecksum);
+      uint16_t sum = CalculateHeaderChecksum (start.GetSize ());
+      if (m_hasPayloadSum)
+        {
+          uint32_t headerSize = GetSerializedSize ();
+          sum = IteratorChecksumSum (start, headerSize, sum);
+          sum = ChecksumAdd (sum, m_payloadSum, headerSize);
+        }
+      else
+        {
+          sum = IteratorChecksumSum (start, start.GetSize (), sum);
+        }
 
       i = start;
       i.Next (16);
-      i.WriteU16 (checksum);
+      i.WriteHtonU16 (~sum);
     }
 }
 
@@ -373,56 +430,16 @@ TcpHeader::Deserialize (Buffer::Iterator start)
   m_urgentPointer = i.ReadNtohU16 ();
 
   // Deserialize options if they exist
-  m_options.clear ();
+  std::memset (m_optionOffset, m_maxOptionsLen, sizeof (m_optionOffset));
   uint32_t optionLen = (m_length - 5) * 4;
   if (optionLen > m_maxOptionsLen)
     {
       NS_LOG_ERROR ("Illegal TCP option length " << optionLen << "; options discarded");
       return 20;
     }
-  while (optionLen)
-    {
-      uint8_t kind = i.PeekU8 ();
-      Ptr<TcpOption> op;
-      uint32_t optionSize;
-      if (TcpOption::IsKindKnown (kind))
-        {
-          op = TcpOption::CreateOption (kind);
-        }
-      else
-        {
-          op = TcpOption::CreateOption (TcpOption::UNKNOWN);
-          NS_LOG_WARN ("Option kind " << static_cast<int> (kind) << " unknown, skipping.");
-        }
-      optionSize = op->Deserialize (i);
-      if (optionSize != op->GetSerializedSize ())
-        {
-          NS_LOG_ERROR ("Option did not deserialize correctly");
-          break;
-        }
-      if (optionLen >= optionSize)
-        {
-          optionLen -= optionSize;
-          i.Next (optionSize);
-          m_options.push_back (op);
-          m_optionsLen += optionSize;
-        }
-      else
-        {
-          NS_LOG_ERROR ("Option exceeds TCP option space; option discarded");
-          break;
-        }
-      if (op->GetKind () == TcpOption::END)
-        {
-          while (optionLen)
-            {
-              // Discard padding bytes without adding to option list
-              i.Next (1);
-              --optionLen;
-              ++m_optionsLen;
-            }
-        }
-    }
+  i.Read (m_options, optionLen);
+  m_optionsLen = optionLen;
+  IndexOptions ();
 
   if (m_length != CalculateHeaderLength ())
     {
@@ -430,12 +447,11 @@ TcpHeader::Deserialize (Buffer::Iterator start)
     }
 
   // Do checksum
+  m_hasPayloadSum = false;
   if (m_calcChecksum)
     {
-      uint16_t headerChecksum = CalculateHeaderChecksum (start.GetSize ());
-      i = start;
-      uint16_t checksum = i.CalculateIpChecksum (start.GetSize (), headerChecksum);
-      m_goodChecksum = (checksum == 0);
+      uint16_t sum = CalculateHeaderChecksum (start.GetSize ());
+      m_goodChecksum = (IteratorChecksumSum (start, start.GetSize (), sum) == 0xffff);
     }
 
   return GetSerializedSize ();
@@ -444,13 +460,7 @@ TcpHeader::Deserialize (Buffer::Iterator start)
 uint8_t
 TcpHeader::CalculateHeaderLength () const
 {
-  uint32_t len = 20;
-  TcpOptionList::const_iterator i;
-
-  for (i = m_options.begin (); i != m_options.end (); ++i)
-    {
-      len += (*i)->GetSerializedSize ();
-    }
+  uint32_t len = 20 + m_optionsLen;
   // Option list may not include padding; need to pad up to word boundary
   if (len % 4)
     {
@@ -459,6 +469,108 @@ TcpHeader::CalculateHeaderLength () const
   return len >> 2;
 }
 
+void
+TcpHeader::IndexOptions (void)
+{
+  uint8_t offset = 0;
+  while (offset < m_optionsLen)
+    {
+      uint8_t kind = m_options[offset];
+      if (kind == TcpOption::END)
+        {
+          // the rest is padding, kept in the option length
+          m_optionOffset[kind] = std::min (m_optionOffset[kind], offset);
+          return;
+        }
+
+      uint8_t size = 1;
+      if (kind != TcpOption::NOP)
+        {
+          size = offset + 1 < m_optionsLen ? m_options[offset + 1] : 0;
+          bool valid;
+          switch (kind)
+            {
+            case TcpOption::MSS:
+              valid = (size == 4);
+              break;
+            case TcpOption::WINSCALE:
+              valid = (size == 3);
+              break;
+            case TcpOption::SACKPERMITTED:
+              valid = (size == 2);
+              break;
+            case TcpOption::SACK:
+              valid = (size >= 2 && (size - 2) % 8 == 0);
+              break;
+            case TcpOption::TS:
+              valid = (size == 10);
+              break;
+            default:
+              NS_LOG_WARN ("Option kind " << static_cast<int> (kind) << " unknown, skipping.");
+              valid = (size >= 2);
+              break;
+            }
+          if (!valid || size > m_optionsLen - offset)
+            {
+              NS_LOG_ERROR ("Option did not deserialize correctly");
+              m_optionsLen = offset;
+              return;
+            }
+        }
+
+      if (kind < m_indexedKinds && m_optionOffset[kind] == m_maxOptionsLen)
+        {
+          m_optionOffset[kind] = offset;
+        }
+      offset += size;
+    }
+}
+
+uint8_t*
+TcpHeader::ReserveOption (uint8_t kind, uint8_t size)
+{
+  if (m_optionsLen + size > m_maxOptionsLen)
+    {
+      return 0;
+    }
+
+  uint8_t *option = m_options + m_optionsLen;
+  option[0] = kind;
+  if (size > 1)
+    {
+      option[1] = size;
+    }
+  if (kind < m_indexedKinds && m_optionOffset[kind] == m_maxOptionsLen)
+    {
+      m_optionOffset[kind] = m_optionsLen;
+    }
+  m_optionsLen += size;
+
+  uint32_t totalLen = 20 + 3 + m_optionsLen;
+  m_length = totalLen >> 2;
+  return option;
+}
+
+uint8_t
+TcpHeader::FindOption (uint8_t kind) const
+{
+  if (kind < m_indexedKinds)
+    {
+      return m_optionOffset[kind];
+    }
+
+  uint8_t offset = 0;
+  while (offset < m_optionsLen && m_options[offset] != TcpOption::END)
+    {
+      if (m_options[offset] == kind)
+        {
+          return offset;
+        }
+      offset += m_options[offset] == TcpOption::NOP ? 1 : m_options[offset + 1];
+    }
+  return m_maxOptionsLen;
+}
+
 bool
 TcpHeader::AppendOption (Ptr<const TcpOption> option)
 {
@@ -472,11 +584,11 @@ TcpHeader::AppendOption (Ptr<const TcpOption> option)
 
       if (option->GetKind () != TcpOption::END)
         {
-          m_options.push_back (option);
-          m_optionsLen += option->GetSerializedSize ();
-
-          uint32_t totalLen = 20 + 3 + m_optionsLen;
-          m_length = totalLen >> 2;
+          uint8_t size = option->GetSerializedSize ();
+          Buffer buffer;
+          buffer.AddAtStart (size);
+          option->Serialize (buffer.Begin ());
+          buffer.CopyData (ReserveOption (option->GetKind (), size), size);
         }
 
       return true;
@@ -485,42 +597,137 @@ TcpHeader::AppendOption (Ptr<const TcpOption> option)
   return false;
 }
 
-const TcpHeader::TcpOptionList&
+TcpHeader::TcpOptionList
 TcpHeader::GetOptionList () const
 {
-  return m_options;
+  TcpOptionList options;
+  uint8_t offset = 0;
+  while (offset < m_optionsLen)
+    {
+      uint8_t kind = m_options[offset];
+      uint8_t size = (kind == TcpOption::END || kind == TcpOption::NOP) ? 1 : m_options[offset + 1];
+      options.push_back (DeserializeOption (m_options + offset, size));
+      if (kind == TcpOption::END)
+        {
+          break;
+        }
+      offset += size;
+    }
+  return options;
 }
 
 Ptr<const TcpOption>
 TcpHeader::GetOption(uint8_t kind) const
 {
-  TcpOptionList::const_iterator i;
-
-  for (i = m_options.begin (); i != m_options.end (); ++i)
+  uint8_t offset = FindOption (kind);
+  if (offset == m_maxOptionsLen)
     {
-      if ((*i)->GetKind () == kind)
-        {
-          return (*i);
-        }
+      return 0;
     }
 
-  return 0;
+  uint8_t size = (kind == TcpOption::END || kind == TcpOption::NOP) ? 1 : m_options[offset + 1];
+  return DeserializeOption (m_options + offset, size);
 }
 
 bool
 TcpHeader::HasOption (uint8_t kind) const
 {
-  TcpOptionList::const_iterator i;
+  return FindOption (kind) != m_maxOptionsLen;
+}
 
-  for (i = m_options.begin (); i != m_options.end (); ++i)
+bool
+TcpHeader::AppendTimestamp (uint32_t value, uint32_t echo)
+{
+  uint8_t *option = ReserveOption (TcpOption::TS, 10);
+  if (option == 0)
     {
-      if ((*i)->GetKind () == kind)
-        {
-          return true;
-        }
+      return false;
     }
+  WriteNetworkU32 (option + 2, value);
+  WriteNetworkU32 (option + 6, echo);
+  return true;
+}
 
-  return false;
+uint32_t
+TcpHeader::GetTimestampValue (void) const
+{
+  NS_ASSERT (m_optionOffset[TcpOption::TS] != m_maxOptionsLen);
+  return ReadNetworkU32 (m_options + m_optionOffset[TcpOption::TS] + 2);
+}
+
+uint32_t
+TcpHeader::GetTimestampEcho (void) const
+{
+  NS_ASSERT (m_optionOffset[TcpOption::TS] != m_maxOptionsLen);
+  return ReadNetworkU32 (m_options + m_optionOffset[TcpOption::TS] + 6);
+}
+
+bool
+TcpHeader::AppendWindowScale (uint8_t scale)
+{
+  uint8_t *option = ReserveOption (TcpOption::WINSCALE, 3);
+  if (option == 0)
+    {
+      return false;
+    }
+  option[2] = scale;
+  return true;
+}
+
+uint8_t
+TcpHeader::GetWindowScale (void) const
+{
+  NS_ASSERT (m_optionOffset[TcpOption::WINSCALE] != m_maxOptionsLen);
+  return m_options[m_optionOffset[TcpOption::WINSCALE] + 2];
+}
+
+bool
+TcpHeader::AppendSackPermitted (void)
+{
+  return ReserveOption (TcpOption::SACKPERMITTED, 2) != 0;
+}
+
+bool
+TcpHeader::AppendSack (const TcpOptionSack::SackList &list)
+{
+  if (m_optionsLen + 2 > m_maxOptionsLen)
+    {
+      return false;
+    }
+  uint32_t blocks = std::min<uint32_t> (list.size (), (m_maxOptionsLen - m_optionsLen - 2) / 8);
+  if (blocks == 0)
+    {
+      return false;
+    }
+
+  uint8_t *option = ReserveOption (TcpOption::SACK, 2 + blocks * 8);
+  TcpOptionSack::SackList::const_iterator it = list.begin ();
+  for (uint32_t i = 0; i < blocks; ++i, ++it)
+    {
+      WriteNetworkU32 (option + 2 + i * 8, it->first.GetValue ());
+      WriteNetworkU32 (option + 6 + i * 8, it->second.GetValue ());
+    }
+  return true;
+}
+
+uint8_t
+TcpHeader::GetSackBlockCount (void) const
+{
+  uint8_t offset = m_optionOffset[TcpOption::SACK];
+  if (offset == m_maxOptionsLen)
+    {
+      return 0;
+    }
+  return (m_options[offset + 1] - 2) / 8;
+}
+
+TcpOptionSack::SackBlock
+TcpHeader::GetSackBlock (uint8_t index) const
+{
+  NS_ASSERT (index < GetSackBlockCount ());
+  const uint8_t *block = m_options + m_optionOffset[TcpOption::SACK] + 2 + index * 8;
+  return TcpOptionSack::SackBlock (SequenceNumber32 (ReadNetworkU32 (block)),
+                                   SequenceNumber32 (ReadNetworkU32 (block + 4)));
 }
 
 bool
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include "ns3/header.h"
 #include "ns3/tcp-option.h"
+#include "ns3/tcp-option-sack.h"
 #include "ns3/buffer.h"
 #include "ns3/tcp-socket-factory.h"
 #include "ns3/ipv4-address.h"
@@ -39,6 +40,13 @@ namespace ns3 {
  * This class has fields corresponding to those in a network TCP header
  * (port numbers, sequence and acknowledgement numbers, flags, etc) as well
  * as methods for serialization to and deserialization from a byte buffer.
+ *
+ * The options are kept inline, in their wire format, in the 40 bytes of
+ * option space, so that building and parsing a header allocates nothing.
+ * The timestamp, window scale, SACK-permitted and SACK options have typed
+ * accessors (AppendTimestamp, GetTimestampValue, ...). AppendOption,
+ * GetOption and GetOptionList convert from and to TcpOption objects, and
+ * allocate them.
  */
 
 class TcpHeader : public Header
@@ -182,6 +190,10 @@ public:
 
   /**
    * \brief Get the option specified
+   *
+   * The option is deserialized into a new TcpOption object; prefer the
+   * typed accessors for the options they cover.
+   *
    * \param kind the option to retrieve
    * \return Whether the header contains a specific kind of option, or 0
    */
@@ -189,9 +201,12 @@ public:
 
   /**
    * \brief Get the list of option in this header
-   * \return a const reference to the option list
+   *
+   * Each option is deserialized into a new TcpOption object.
+   *
+   * \return the option list
    */
-  const TcpOptionList& GetOptionList (void) const;
+  TcpOptionList GetOptionList (void) const;
 
   /**
    * \brief Get the total length of appended options
@@ -219,6 +234,77 @@ public:
    */
   bool AppendOption (Ptr<const TcpOption> option);
 
+  /**
+   * \brief Append a timestamp option (RFC 7323)
+   * \param value the timestamp value (TSval)
+   * \param echo the timestamp echo reply (TSecr)
+   * \return true if the option has been appended, false if it does not fit
+   */
+  bool AppendTimestamp (uint32_t value, uint32_t echo);
+
+  /**
+   * \brief Get the TSval of the timestamp option
+   *
+   * The header must have the option (HasOption (TcpOption::TS)).
+   *
+   * \return the timestamp value
+   */
+  uint32_t GetTimestampValue (void) const;
+
+  /**
+   * \brief Get the TSecr of the timestamp option
+   *
+   * The header must have the option (HasOption (TcpOption::TS)).
+   *
+   * \return the timestamp echo reply
+   */
+  uint32_t GetTimestampEcho (void) const;
+
+  /**
+   * \brief Append a window scale option (RFC 7323)
+   * \param scale the shift count
+   * \return true if the option has been appended, false if it does not fit
+   */
+  bool AppendWindowScale (uint8_t scale);
+
+  /**
+   * \brief Get the shift count of the window scale option
+   *
+   * The header must have the option (HasOption (TcpOption::WINSCALE)).
+   *
+   * \return the shift count
+   */
+  uint8_t GetWindowScale (void) const;
+
+  /**
+   * \brief Append a SACK-permitted option (RFC 2018)
+   * \return true if the option has been appended, false if it does not fit
+   */
+  bool AppendSackPermitted (void);
+
+  /**
+   * \brief Append a SACK option (RFC 2018)
+   *
+   * The blocks are taken in order, as many as fit in the free option space.
+   *
+   * \param list the SACK blocks
+   * \return true if the option has been appended with at least one block
+   */
+  bool AppendSack (const TcpOptionSack::SackList &list);
+
+  /**
+   * \brief Get the number of blocks of the SACK option
+   * \return the number of blocks, 0 if the header has no SACK option
+   */
+  uint8_t GetSackBlockCount (void) const;
+
+  /**
+   * \brief Get a block of the SACK option
+   * \param index the block index, less than GetSackBlockCount ()
+   * \return the block
+   */
+  TcpOptionSack::SackBlock GetSackBlock (uint8_t index) const;
+
   /**
    * \brief Initialize the TCP checksum.
    *
@@ -273,6 +359,18 @@ public:
                            const Address &destination,
                            uint8_t protocol);
 
+  /**
+   * \brief Set the one's complement sum of the payload
+   *
+   * With checksums enabled, Serialize adds this sum (see ChecksumSum) to
+   * the sums of the pseudo-header and of the header instead of reading the
+   * payload again. The sum must be the one of the bytes that follow the
+   * header in the packet; it is not kept by Deserialize.
+   *
+   * \param sum the folded, not complemented, sum of the payload
+   */
+  void SetPayloadSum (uint16_t sum);
+
   /**
    * \brief TCP flag field values
    */
@@ -316,9 +414,9 @@ public:
 
 private:
   /**
-   * \brief Calculate the header checksum
+   * \brief Calculate the sum of the pseudo-header
    * \param size packet size
-   * \returns the checksum
+   * \returns the folded, not complemented, sum
    */
   uint16_t CalculateHeaderChecksum (uint16_t size) const;
 
@@ -332,6 +430,29 @@ private:
    */
   uint8_t CalculateHeaderLength () const;
 
+  /**
+   * \brief Reserve option space for an option
+   *
+   * \param kind the option kind
+   * \param size the option size, kind and length bytes included
+   * \return the option bytes to fill, or 0 if the option does not fit
+   */
+  uint8_t* ReserveOption (uint8_t kind, uint8_t size);
+
+  /**
+   * \brief Find an option
+   * \param kind the option kind
+   * \return the offset of the first option of this kind in m_options,
+   * or m_maxOptionsLen if there is none
+   */
+  uint8_t FindOption (uint8_t kind) const;
+
+  /**
+   * \brief Walk the options after deserialization, drop what follows a
+   * malformed option and record where the known ones are
+   */
+  void IndexOptions (void);
+
   uint16_t m_sourcePort;        //!< Source port
   uint16_t m_destinationPort;   //!< Destination port
   SequenceNumber32 m_sequenceNumber;  //!< Sequence number
@@ -341,16 +462,18 @@ private:
   uint16_t m_windowSize;        //!< Window size
   uint16_t m_urgentPointer;     //!< Urgent pointer
 
-  Address m_source;       //!< Source IP address
-  Address m_destination;  //!< Destination IP address
-  uint8_t m_protocol;     //!< Protocol number
+  uint16_t m_pseudoHeaderSum; //!< Sum of the pseudo-header addresses and protocol
+  uint16_t m_payloadSum;  //!< Sum of the payload, if m_hasPayloadSum
+  bool m_hasPayloadSum;   //!< Flag to use m_payloadSum instead of reading the payload
 
   bool m_calcChecksum;    //!< Flag to calculate checksum
   bool m_goodChecksum;    //!< Flag to indicate that checksum is correct
 
   static const uint8_t m_maxOptionsLen = 40;         //!< Maximum options length
-  TcpOptionList m_options;     //!< TcpOption present in the header
+  static const uint8_t m_indexedKinds = TcpOption::TS + 1; //!< Kinds whose offset is kept
+  uint8_t m_options[m_maxOptionsLen];          //!< Options, in wire format, without the padding
   uint8_t m_optionsLen;        //!< Tcp options length.
+  uint8_t m_optionOffset[m_indexedKinds];      //!< Offset of the first option of each known kind, m_maxOptionsLen if none
 };
 
 } // namespace ns3
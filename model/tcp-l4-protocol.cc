@@ -41,6 +41,7 @@
 #include "ipv6-routing-protocol.h"
 #include "tcp-socket-factory-impl.h"
 #include "tcp-socket-base.h"
+#include "tcp-timer-wheel.h"
 #include "tcp-congestion-ops.h"
 #include "tcp-recovery-ops.h"
 #include "tcp-prr-recovery.h"
@@ -99,6 +100,7 @@ TcpL4Protocol::TcpL4Protocol ()
   : m_endPoints (new Ipv4EndPointDemux ()), m_endPoints6 (new Ipv6EndPointDemux ())
 {
   NS_LOG_FUNCTION (this);
+  m_timerWheel = CreateObject<TcpTimerWheel> ();
 }
 
 TcpL4Protocol::~TcpL4Protocol ()
@@ -150,6 +152,12 @@ TcpL4Protocol::NotifyNewAggregate ()
   IpL4Protocol::NotifyNewAggregate ();
 }
 
+Ptr<TcpTimerWheel>
+TcpL4Protocol::GetTimerWheel (void) const
+{
+  return m_timerWheel;
+}
+
 int
 TcpL4Protocol::GetProtocolNumber (void) const
 {
@@ -174,6 +182,12 @@ TcpL4Protocol::DoDispose (void)
       m_endPoints6 = 0;
     }
 
+  if (m_timerWheel != 0)
+    {
+      m_timerWheel->Dispose ();
+      m_timerWheel = 0;
+    }
+
   m_node = 0;
   m_downTarget.Nullify ();
   m_downTarget6.Nullify ();
@@ -41,6 +41,7 @@ class TcpSocketBase;
 class Ipv4EndPoint;
 class Ipv6EndPoint;
 class NetDevice;
+class TcpTimerWheel;
 
 
 /**
@@ -128,6 +129,12 @@ public:
     */
   Ptr<Socket> CreateSocket (TypeId congestionTypeId);
 
+  /**
+   * \brief Get the timer wheel shared by the sockets of the node
+   * \return the timer wheel
+   */
+  Ptr<TcpTimerWheel> GetTimerWheel (void) const;
+
   /**
    * \brief Allocate an IPv4 Endpoint
    * \return the Endpoint
@@ -321,6 +328,7 @@ private:
   TypeId m_congestionTypeId;       //!< The socket TypeId
   TypeId m_recoveryTypeId;         //!< The recovery TypeId
   std::vector<Ptr<TcpSocketBase> > m_sockets;      //!< list of sockets
+  Ptr<TcpTimerWheel> m_timerWheel;                 //!< Timer wheel of the sockets
   IpL4Protocol::DownTargetCallback m_downTarget;   //!< Callback to send packets over IPv4
   IpL4Protocol::DownTargetCallback6 m_downTarget6; //!< Callback to send packets over IPv6
 
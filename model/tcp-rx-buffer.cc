@@ -18,6 +18,8 @@
  * Author: Adrian Sai-wah Tam <adrian.sw.tam@gmail.com>
  */
 
+#include <algorithm>
+
 #include "ns3/packet.h"
 #include "ns3/log.h"
 #include "tcp-rx-buffer.h"
@@ -113,9 +115,9 @@ TcpRxBuffer::MaxRxSequence (void) const
     { // No data allowed beyond FIN
       return m_finSeq;
     }
-  else if (m_data.size () && m_nextRxSeq > m_data.begin ()->first)
+  else if (m_data.size () && m_nextRxSeq > m_data.front ().first)
     { // No data allowed beyond Rx window allowed
-      return m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+      return m_data.front ().first + SequenceNumber32 (m_maxBuffer);
     }
   return m_nextRxSeq + SequenceNumber32 (m_maxBuffer);
 }
@@ -136,6 +138,52 @@ TcpRxBuffer::Finished (void)
   return (m_gotFin && m_finSeq < m_nextRxSeq);
 }
 
+TcpRxBuffer::BufIterator
+TcpRxBuffer::FindSegment (const SequenceNumber32 &seq)
+{
+  // In-order data goes after the last segment
+  if (m_data.empty ()
+      || m_data.back ().first + SequenceNumber32 (m_data.back ().second->GetSize ()) <= seq)
+    {
+      return m_data.end ();
+    }
+  BufIterator i = std::upper_bound (m_data.begin (), m_data.end (), seq,
+                                    [] (const SequenceNumber32 &s, const Segment &segment)
+                                    { return s < segment.first; });
+  if (i != m_data.begin ())
+    {
+      BufIterator previous = std::prev (i);
+      if (previous->first + SequenceNumber32 (previous->second->GetSize ()) > seq)
+        {
+          return previous;
+        }
+    }
+  return i;
+}
+
+TcpOptionSack::SackBlock
+TcpRxBuffer::AddBlock (const SequenceNumber32 &head, const SequenceNumber32 &tail)
+{
+  NS_LOG_FUNCTION (this << head << tail);
+
+  // First block that ends at or after head, i.e. that touches the range
+  std::deque<TcpOptionSack::SackBlock>::iterator first =
+    std::lower_bound (m_blocks.begin (), m_blocks.end (), head,
+                      [] (const TcpOptionSack::SackBlock &block, const SequenceNumber32 &s)
+                      { return block.second < s; });
+  std::deque<TcpOptionSack::SackBlock>::iterator last = first;
+  TcpOptionSack::SackBlock merged (head, tail);
+  while (last != m_blocks.end () && last->first <= tail)
+    {
+      merged.first = std::min (merged.first, last->first);
+      merged.second = std::max (merged.second, last->second);
+      ++last;
+    }
+  first = m_blocks.erase (first, last);
+  m_blocks.insert (first, merged);
+  return merged;
+}
+
 bool
 TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
 {
@@ -151,12 +199,13 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
   if (headSeq < m_nextRxSeq) headSeq = m_nextRxSeq;
   if (m_data.size ())
     {
-      SequenceNumber32 maxSeq = m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+      SequenceNumber32 maxSeq = m_data.front ().first + SequenceNumber32 (m_maxBuffer);
       if (maxSeq < tailSeq) tailSeq = maxSeq;
       if (tailSeq < headSeq) headSeq = tailSeq;
     }
-  // Remove overlapped bytes from packet
-  BufIterator i = m_data.begin ();
+  // Remove overlapped bytes from packet; the segments that end before
+  // headSeq cannot overlap
+  BufIterator i = FindSegment (headSeq);
   while (i != m_data.end () && i->first <= tailSeq)
     {
       SequenceNumber32 lastByteSeq = i->first + SequenceNumber32 (i->second->GetSize ());
@@ -165,7 +214,7 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
           if (i->first > headSeq && lastByteSeq < tailSeq)
             { // Rare case: Existing packet is embedded fully in the new packet
               m_size -= i->second->GetSize ();
-              m_data.erase (i++);
+              i = m_data.erase (i);
               continue;
             }
           if (i->first <= headSeq)
@@ -189,34 +238,32 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
     {
       uint32_t start = static_cast<uint32_t> (headSeq - tcph.GetSequenceNumber ());
       uint32_t length = static_cast<uint32_t> (tailSeq - headSeq);
-      p = p->CreateFragment (start, length);
+      // the buffer keeps its own packet, the caller may still change p
+      p = length == pktSize ? p->Copy () : p->CreateFragment (start, length);
       NS_ASSERT (length == p->GetSize ());
     }
-  // Insert packet into buffer
-  NS_ASSERT (m_data.find (headSeq) == m_data.end ()); // Shouldn't be there yet
-  m_data [ headSeq ] = p;
+  // Insert packet into buffer, after the data before headSeq
+  i = FindSegment (headSeq);
+  NS_ASSERT (i == m_data.end () || i->first >= tailSeq); // Shouldn't be there yet
+  m_data.insert (i, Segment (headSeq, p));
 
-  if (headSeq > m_nextRxSeq)
+  NS_LOG_LOGIC ("Buffered packet of seqno=" << headSeq << " len=" << p->GetSize ());
+  // Update variables
+  m_size += p->GetSize ();      // Occupancy
+  TcpOptionSack::SackBlock block = AddBlock (headSeq, tailSeq);
+  if (block.first > m_nextRxSeq)
     {
       // Generate a new SACK block
       UpdateSackList (headSeq, tailSeq);
     }
-
-  NS_LOG_LOGIC ("Buffered packet of seqno=" << headSeq << " len=" << p->GetSize ());
-  // Update variables
-  m_size += p->GetSize ();      // Occupancy
-  for (i = m_data.begin (); i != m_data.end (); ++i)
+  else
     {
-      if (i->first < m_nextRxSeq)
-        {
-          continue;
-        }
-      else if (i->first > m_nextRxSeq)
-        {
-          break;
-        };
-      m_nextRxSeq = i->first + SequenceNumber32 (i->second->GetSize ());
-      m_availBytes += i->second->GetSize ();
+      // The data fills the hole at m_nextRxSeq: the block following it, if
+      // any, is now in order too
+      NS_ASSERT (block.first == m_nextRxSeq && m_blocks.front ().first == block.first);
+      m_availBytes += static_cast<uint32_t> (block.second - m_nextRxSeq);
+      m_nextRxSeq = block.second;
+      m_blocks.pop_front ();
       ClearSackList (m_nextRxSeq);
     }
   NS_LOG_LOGIC ("Updated buffer occupancy=" << m_size << " nextRxSeq=" << m_nextRxSeq);
@@ -241,9 +288,12 @@ TcpRxBuffer::UpdateSackList (const SequenceNumber32 &head, const SequenceNumber3
   NS_LOG_FUNCTION (this << head << tail);
   NS_ASSERT (head > m_nextRxSeq);
 
-  TcpOptionSack::SackBlock current;
-  current.first = head;
-  current.second = tail;
+  // The contiguous block containing [head, tail)
+  TcpOptionSack::SackBlock current =
+    *std::lower_bound (m_blocks.begin (), m_blocks.end (), head,
+                       [] (const TcpOptionSack::SackBlock &block, const SequenceNumber32 &s)
+                       { return block.second <= s; });
+  NS_ASSERT (current.first <= head && tail <= current.second);
 
   // The block "current" has been safely stored. Now we need to build the SACK
   // list, to be advertised. From RFC 2018:
@@ -270,54 +320,24 @@ TcpRxBuffer::UpdateSackList (const SequenceNumber32 &head, const SequenceNumber3
   //     TCP implementations [RFC1323]).  After the first SACK block, the
   //     following SACK blocks in the SACK option may be listed in
   //     arbitrary order.
+  //
+  // Every block of the list was a whole block of m_blocks when reported, and
+  // a block only changes by growing into "current": the blocks to drop are
+  // the ones it contains.
 
-  m_sackList.push_front (current);
-
-  // We have inserted the block at the beginning of the list. Now, we should
-  // check if any existing blocks overlap with that.
-  bool updated = false;
-  TcpOptionSack::SackList::iterator it = m_sackList.begin ();
-  TcpOptionSack::SackBlock begin = *it;
-  TcpOptionSack::SackBlock merged;
-  ++it;
-
-  // Iterates until we examined all blocks in the list (maximum 4)
-  while (it != m_sackList.end ())
+  TcpOptionSack::SackList::iterator it;
+  for (it = m_sackList.begin (); it != m_sackList.end (); )
     {
-      current = *it;
-
-      // This is a left merge:
-      // [current_first; current_second] [beg_first; beg_second]
-      if (begin.first == current.second)
+      if (current.first <= it->first && it->second <= current.second)
         {
-          NS_ASSERT (current.first < begin.second);
-          merged = TcpOptionSack::SackBlock (current.first, begin.second);
-          updated = true;
-        }
-      // while this is a right merge
-      // [begin_first; begin_second] [current_first; current_second]
-      else if (begin.second == current.first)
-        {
-          NS_ASSERT (begin.first < current.second);
-          merged = TcpOptionSack::SackBlock (begin.first, current.second);
-          updated = true;
+          it = m_sackList.erase (it);
         }
-
-      // If we have merged the blocks (and the result is in merged) we should
-      // delete the current block (it), the first block, and insert the merged
-      // one at the beginning.
-      if (updated)
+      else
         {
-          m_sackList.erase (it);
-          m_sackList.pop_front ();
-          m_sackList.push_front (merged);
-          it = m_sackList.begin ();
-          begin = *it;
-          updated = false;
+          ++it;
         }
-
-      ++it;
     }
+  m_sackList.push_front (current);
 
   // Since the maximum blocks that fits into a TCP header are 4, there's no
   // point on maintaining the others.
@@ -326,10 +346,8 @@ TcpRxBuffer::UpdateSackList (const SequenceNumber32 &head, const SequenceNumber3
       m_sackList.pop_back ();
     }
 
-  // Please note that, if a block b is discarded and then a block contiguous
-  // to b is received, only that new block (without the b part) is reported.
-  // This is perfectly fine for the RFC point (a), given that we do not report any
-  // overlapping blocks shortly after.
+  // If a block b is discarded and then a block contiguous to b is received,
+  // the block reported includes b, as RFC point (a) requires.
 }
 
 void
@@ -369,31 +387,42 @@ TcpRxBuffer::Extract (uint32_t maxSize)
   NS_LOG_LOGIC ("Requested to extract " << extractSize << " bytes from TcpRxBuffer of size=" << m_size);
   if (extractSize == 0) return nullptr;  // No contiguous block to return
   NS_ASSERT (m_data.size ()); // At least we have something to extract
-  Ptr<Packet> outPkt = Create<Packet> (); // The packet that contains all the data to return
-  BufIterator i;
+  Ptr<Packet> outPkt = nullptr; // The packet that contains all the data to return
   while (extractSize)
     { // Check the buffered data for delivery
-      i = m_data.begin ();
+      BufIterator i = m_data.begin ();
       NS_ASSERT (i->first <= m_nextRxSeq); // in-sequence data expected
       // Check if we send the whole pkt or just a partial
       uint32_t pktSize = i->second->GetSize ();
+      Ptr<Packet> part;
       if (pktSize <= extractSize)
-        { // Whole packet is extracted
-          outPkt->AddAtEnd (i->second);
-          m_data.erase (i);
+        { // Whole packet is extracted, no longer referenced by the buffer
+          part = i->second;
+          m_data.pop_front ();
           m_size -= pktSize;
           m_availBytes -= pktSize;
           extractSize -= pktSize;
+          if (outPkt == nullptr)
+            {
+              outPkt = part;
+              continue;
+            }
         }
       else
-        { // Partial is extracted and done
-          outPkt->AddAtEnd (i->second->CreateFragment (0, extractSize));
-          m_data[i->first + SequenceNumber32 (extractSize)] = i->second->CreateFragment (extractSize, pktSize - extractSize);
-          m_data.erase (i);
+        { // Partial is extracted and done, the rest stays in place
+          part = i->second->CreateFragment (0, extractSize);
+          i->second = i->second->CreateFragment (extractSize, pktSize - extractSize);
+          i->first = i->first + SequenceNumber32 (extractSize);
           m_size -= extractSize;
           m_availBytes -= extractSize;
           extractSize = 0;
+          if (outPkt == nullptr)
+            {
+              outPkt = part;
+              continue;
+            }
         }
+      outPkt->AddAtEnd (part);
     }
   if (outPkt->GetSize () == 0)
     {
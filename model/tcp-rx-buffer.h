@@ -21,7 +21,7 @@
 #ifndef TCP_RX_BUFFER_H
 #define TCP_RX_BUFFER_H
 
-#include <map>
+#include <deque>
 #include "ns3/traced-value.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/sequence-number.h"
@@ -53,6 +53,14 @@ class Packet;
  * To store data, use Add; for retrieving a certain amount of ordered data, use
  * the method Extract.
  *
+ * The segments are kept in a deque sorted by sequence number, without
+ * overlaps: a segment received in order is appended at the back, and Extract
+ * pops whole segments from the front (a partially read segment is replaced
+ * in place by its remainder). The data after NextRxSequence is also tracked
+ * as the sorted list of its contiguous blocks, so that filling a hole moves
+ * NextRxSequence past the whole following block at once, and a new SACK
+ * block is read from that list instead of being rebuilt by merging.
+ *
  * SACK list
  * ---------
  *
@@ -141,7 +149,7 @@ public:
    * reflect the number of bytes ready to send to the application. This
    * function handles overlap by triming the head of the inputted packet and
    * removing data from the buffer that overlaps the tail of the inputted
-   * packet
+   * packet. The buffer stores a copy of the data, p stays the caller's.
    *
    * \param p packet
    * \param tcph packet's TCP header
@@ -182,6 +190,30 @@ public:
   bool GotFin () const { return m_gotFin; }
 
 private:
+  /// a stored segment: sequence number of its first byte, and its data
+  typedef std::pair<SequenceNumber32, Ptr<Packet> > Segment;
+  /// container for data stored in the buffer
+  typedef std::deque<Segment>::iterator BufIterator;
+
+  /**
+   * \brief Find the first segment that ends after seq
+   *
+   * \param seq sequence number
+   * \return the segment, or the end of the buffer if no data follows seq
+   */
+  BufIterator FindSegment (const SequenceNumber32 &seq);
+
+  /**
+   * \brief Add a range of data to the blocks after m_nextRxSeq
+   *
+   * The range is merged with the blocks it overlaps or touches.
+   *
+   * \param head sequence number of the first byte
+   * \param tail sequence number of the last byte plus one
+   * \return the block that now contains the range
+   */
+  TcpOptionSack::SackBlock AddBlock (const SequenceNumber32 &head, const SequenceNumber32 &tail);
+
   /**
    * \brief Update the sack list, with the block seq starting at the beginning
    *
@@ -197,6 +229,9 @@ private:
    * (or other) options, it is even less. For more detail about this function,
    * please see the source code and in-line comments.
    *
+   * The first block is the whole contiguous block containing [head, tail),
+   * taken from m_blocks.
+   *
    * \param head sequence number of the block at the beginning
    * \param tail sequence number of the block at the end
    */
@@ -217,15 +252,14 @@ private:
 
   TcpOptionSack::SackList m_sackList; //!< Sack list (updated constantly)
 
-  /// container for data stored in the buffer
-  typedef std::map<SequenceNumber32, Ptr<Packet> >::iterator BufIterator;
   TracedValue<SequenceNumber32> m_nextRxSeq; //!< Seqnum of the first missing byte in data (RCV.NXT)
   SequenceNumber32 m_finSeq;                 //!< Seqnum of the FIN packet
   bool m_gotFin;                             //!< Did I received FIN packet?
   uint32_t m_size;                           //!< Number of total data bytes in the buffer, not necessarily contiguous
   uint32_t m_maxBuffer;                      //!< Upper bound of the number of data bytes in buffer (RCV.WND)
   uint32_t m_availBytes;                     //!< Number of bytes available to read, i.e. contiguous block at head
-  std::map<SequenceNumber32, Ptr<Packet> > m_data; //!< Corresponding data (may be null)
+  std::deque<Segment> m_data;                //!< Corresponding data, sorted and disjoint
+  std::deque<TcpOptionSack::SackBlock> m_blocks; //!< Contiguous blocks of data after m_nextRxSeq, sorted
 };
 
 } //namespace ns3
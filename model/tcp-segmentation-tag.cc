@@ -0,0 +1,89 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "tcp-segmentation-tag.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpSegmentationTag");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpSegmentationTag);
+
+TcpSegmentationTag::TcpSegmentationTag ()
+  : m_segmentSize (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+TcpSegmentationTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpSegmentationTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpSegmentationTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpSegmentationTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpSegmentationTag::GetSerializedSize (void) const
+{
+  return 4;
+}
+
+void
+TcpSegmentationTag::Serialize (TagBuffer i) const
+{
+  NS_LOG_FUNCTION (this << &i);
+  i.WriteU32 (m_segmentSize);
+}
+
+void
+TcpSegmentationTag::Deserialize (TagBuffer i)
+{
+  NS_LOG_FUNCTION (this << &i);
+  m_segmentSize = i.ReadU32 ();
+}
+
+void
+TcpSegmentationTag::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "TcpSegmentationTag [segment size: " << m_segmentSize << "] ";
+}
+
+void
+TcpSegmentationTag::SetSegmentSize (uint32_t size)
+{
+  m_segmentSize = size;
+}
+
+uint32_t
+TcpSegmentationTag::GetSegmentSize (void) const
+{
+  return m_segmentSize;
+}
+
+} // namespace ns3
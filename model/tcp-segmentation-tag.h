@@ -0,0 +1,73 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCP_SEGMENTATION_TAG_H
+#define TCP_SEGMENTATION_TAG_H
+
+#include "ns3/tag.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Marks a TCP super-segment to be cut into wire segments
+ *
+ * Models TCP segmentation offload: with TcpSocketBase::TsoMaxSize set,
+ * the socket hands several segments of new data to IPv4 as one packet
+ * with a single TCP header, and tags it with the segment size.
+ * Ipv4L3Protocol removes the tag and cuts the packet into segments of
+ * that size, each with its own TCP and IPv4 header, before the interface,
+ * so that the devices and the network only see wire-sized frames.
+ *
+ * \see Ipv4L3Protocol::DoSegmentation
+ */
+class TcpSegmentationTag : public Tag
+{
+public:
+  TcpSegmentationTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \brief Set the payload size of the wire segments
+   * \param size the segment size (bytes)
+   */
+  void SetSegmentSize (uint32_t size);
+
+  /**
+   * \brief Get the payload size of the wire segments
+   * \return the segment size (bytes)
+   */
+  uint32_t GetSegmentSize (void) const;
+
+private:
+  uint32_t m_segmentSize; //!< Payload size of the wire segments
+};
+
+} // namespace ns3
+
+#endif /* TCP_SEGMENTATION_TAG_H */
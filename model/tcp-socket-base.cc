@@ -22,6 +22,7 @@
 #define NS_LOG_APPEND_CONTEXT \
   if (m_node) { std::clog << " [node " << m_node->GetId () << "] "; }
 
+#include <algorithm>
 #include "ns3/abort.h"
 #include "ns3/node.h"
 #include "ns3/inet-socket-address.h"
@@ -52,10 +53,11 @@
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
 #include "tcp-header.h"
-#include "tcp-option-winscale.h"
 #include "tcp-option-ts.h"
-#include "tcp-option-sack-permitted.h"
 #include "tcp-option-sack.h"
+#include "tcp-timestamp-tag.h"
+#include "tcp-segmentation-tag.h"
+#include "internet-checksum.h"
 #include "tcp-congestion-ops.h"
 #include "tcp-recovery-ops.h"
 #include "ns3/tcp-rate-ops.h"
@@ -110,6 +112,51 @@ TcpSocketBase::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&TcpSocketBase::m_timestampEnabled),
                    MakeBooleanChecker ())
+    .AddAttribute ("PreciseRtt",
+                   "Carry full resolution send timestamps in a TcpTimestampTag, "
+                   "echoed by the receiver, and hand the raw RTT sample of an "
+                   "echoed tag to the congestion control instead of the "
+                   "smoothed estimate",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_preciseRttEnabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("RttPerSegment",
+                   "Take an RTT sample for every segment acknowledged, from its "
+                   "send time, in TcpSocketState::m_rttSamples, besides the "
+                   "sample taken once per ACK",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_rttPerSegment),
+                   MakeBooleanChecker ())
+    .AddAttribute ("RxCoalesceBytes",
+                   "Receive offload: acknowledge in-sequence data once this many "
+                   "bytes are pending, instead of every DelAckCount segments. "
+                   "0 disables it",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpSocketBase::m_rxCoalesceBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RxCoalesceTimeout",
+                   "Receive offload: longest time an in-sequence segment waits "
+                   "for its ACK, replaces DelAckTimeout when RxCoalesceBytes is set",
+                   TimeValue (MicroSeconds (10)),
+                   MakeTimeAccessor (&TcpSocketBase::m_rxCoalesceTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("TsoMaxSize",
+                   "Segmentation offload: largest run of new data, in bytes, sent "
+                   "as one super-segment and cut into SegmentSize segments by "
+                   "IPv4 before the device. The Tx trace and the IPv4 SendOutgoing "
+                   "trace see the super-segment, not its wire segments. Paced "
+                   "sockets, among them TIMELY in Paced mode, send single "
+                   "segments whatever this size. 0 disables it; IPv6 sockets ignore it",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpSocketBase::m_tsoMaxSize),
+                   MakeUintegerChecker<uint32_t> (0, 65000))
+    .AddAttribute ("BatchDataSent",
+                   "Notify the application of the new data sent once for all "
+                   "the segments sent at the same simulation event, instead of "
+                   "scheduling a notification per segment",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_batchDataSent),
+                   MakeBooleanChecker ())
     .AddAttribute ("MinRto",
                    "Minimum retransmit timeout value",
                    TimeValue (Seconds (1.0)), // RFC 6298 says min RTO=1 sec, but Linux uses 200ms.
@@ -217,6 +264,10 @@ TcpSocketBase::GetTypeId (void)
                      "TCP slow start threshold (bytes)",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_ssThTrace),
                      "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("AckCoalescing",
+                     "Segments and bytes of in-sequence data covered by each ACK sent",
+                     MakeTraceSourceAccessor (&TcpSocketBase::m_ackCoalescingTrace),
+                     "ns3::TcpSocketBase::AckCoalescingTracedCallback")
     .AddTraceSource ("Tx",
                      "Send tcp packet to IP protocol",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_txTrace),
@@ -346,6 +397,14 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_sndWindShift (sock.m_sndWindShift),
     m_timestampEnabled (sock.m_timestampEnabled),
     m_timestampToEcho (sock.m_timestampToEcho),
+    m_preciseRttEnabled (sock.m_preciseRttEnabled),
+    m_rttPerSegment (sock.m_rttPerSegment),
+    m_rxCoalesceBytes (sock.m_rxCoalesceBytes),
+    m_rxCoalesceTimeout (sock.m_rxCoalesceTimeout),
+    m_tsoMaxSize (sock.m_tsoMaxSize),
+    m_batchDataSent (sock.m_batchDataSent),
+    m_tsTagToEchoValid (sock.m_tsTagToEchoValid),
+    m_tsTagToEcho (sock.m_tsTagToEcho),
     m_recover (sock.m_recover),
     m_recoverActive (sock.m_recoverActive),
     m_retxThresh (sock.m_retxThresh),
@@ -392,6 +451,11 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
       m_recoveryOps = sock.m_recoveryOps->Fork ();
     }
 
+  if (m_tcp != nullptr)
+    {
+      SetTimerWheel (m_tcp->GetTimerWheel ());
+    }
+
   m_rateOps = CreateObject <TcpRateLinux> ();
   if (m_tcb->m_sendEmptyPacketCallback.IsNull ())
     {
@@ -467,6 +531,7 @@ TcpSocketBase::~TcpSocketBase (void)
     }
   m_tcp = 0;
   CancelAllTimers ();
+  m_dataSentEvent.Cancel ();
 }
 
 /* Associate a node with this TCP socket */
@@ -481,6 +546,18 @@ void
 TcpSocketBase::SetTcp (Ptr<TcpL4Protocol> tcp)
 {
   m_tcp = tcp;
+  SetTimerWheel (tcp->GetTimerWheel ());
+}
+
+/* Keep the TCP timers on the timer wheel of the node */
+void
+TcpSocketBase::SetTimerWheel (Ptr<TcpTimerWheel> wheel)
+{
+  m_retxEvent.SetWheel (wheel);
+  m_lastAckEvent.SetWheel (wheel);
+  m_delAckEvent.SetWheel (wheel);
+  m_persistEvent.SetWheel (wheel);
+  m_timewaitEvent.SetWheel (wheel);
 }
 
 /* Set an RTT estimator with this socket */
@@ -1273,6 +1350,9 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
   SocketPriorityTag priorityTag;
   packet->RemovePacketTag (priorityTag);
 
+  TcpTimestampTag timestampTag;
+  bool hasTimestampTag = packet->RemovePacketTag (timestampTag);
+
   // Peel off TCP header
   TcpHeader tcpHeader;
   packet->RemoveHeader (tcpHeader);
@@ -1296,6 +1376,12 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
 
   m_rxTrace (packet, tcpHeader, this);
 
+  m_tsTagEchoRcvd = false;
+  if (hasTimestampTag)
+    {
+      ProcessTimestampTag (timestampTag, seq);
+    }
+
   if (tcpHeader.GetFlags () & TcpHeader::SYN)
     {
       /* The window field in a segment where the SYN bit is set (i.e., a <SYN>
@@ -1306,7 +1392,7 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
 
       if (tcpHeader.HasOption (TcpOption::WINSCALE) && m_winScalingEnabled)
         {
-          ProcessOptionWScale (tcpHeader.GetOption (TcpOption::WINSCALE));
+          ProcessOptionWScale (tcpHeader);
         }
       else
         {
@@ -1315,7 +1401,7 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
 
       if (tcpHeader.HasOption (TcpOption::SACKPERMITTED) && m_sackEnabled)
         {
-          ProcessOptionSackPermitted (tcpHeader.GetOption (TcpOption::SACKPERMITTED));
+          ProcessOptionSackPermitted (tcpHeader);
         }
       else
         {
@@ -1326,8 +1412,7 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
       // When receiving a <SYN> or <SYN-ACK> we should adapt TS to the other end
       if (tcpHeader.HasOption (TcpOption::TS) && m_timestampEnabled)
         {
-          ProcessOptionTimestamp (tcpHeader.GetOption (TcpOption::TS),
-                                  tcpHeader.GetSequenceNumber ());
+          ProcessOptionTimestamp (tcpHeader);
         }
       else
         {
@@ -1362,8 +1447,7 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
             }
           else
             {
-              ProcessOptionTimestamp (tcpHeader.GetOption (TcpOption::TS),
-                                      tcpHeader.GetSequenceNumber ());
+              ProcessOptionTimestamp (tcpHeader);
             }
         }
 
@@ -1376,13 +1460,13 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
     { // Zero window: Enter persist state to send 1 byte to probe
       NS_LOG_LOGIC (this << " Enter zerowindow persist state");
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
       NS_LOG_LOGIC ("Schedule persist timeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_persistTimeout).GetSeconds ());
-      m_persistEvent = Simulator::Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
-      NS_ASSERT (m_persistTimeout == Simulator::GetDelayLeft (m_persistEvent));
+      m_persistEvent.Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
+      NS_ASSERT (m_persistTimeout == m_persistEvent.GetDelayLeft ());
     }
 
   // TCP state machine code in different process functions
@@ -1550,22 +1634,11 @@ void
 TcpSocketBase::ReadOptions (const TcpHeader &tcpHeader, uint32_t *bytesSacked)
 {
   NS_LOG_FUNCTION (this << tcpHeader);
-  TcpHeader::TcpOptionList::const_iterator it;
-  const TcpHeader::TcpOptionList options = tcpHeader.GetOptionList ();
 
-  for (it = options.begin (); it != options.end (); ++it)
+  // Check only for ACK options here
+  if (tcpHeader.GetSackBlockCount () > 0)
     {
-      const Ptr<const TcpOption> option = (*it);
-
-      // Check only for ACK options here
-      switch (option->GetKind ())
-        {
-        case TcpOption::SACK:
-          *bytesSacked = ProcessOptionSack (option);
-          break;
-        default:
-          continue;
-        }
+      *bytesSacked = ProcessOptionSack (tcpHeader);
     }
 }
 
@@ -2633,7 +2706,7 @@ TcpSocketBase::DoPeerClose (void)
       m_dataRetrCount = m_dataRetries; // prevent endless FINs
       NS_LOG_LOGIC ("TcpSocketBase " << this << " scheduling LATO1");
       Time lastRto = m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4);
-      m_lastAckEvent = Simulator::Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
+      m_lastAckEvent.Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
     }
 }
 
@@ -2649,7 +2722,7 @@ TcpSocketBase::Destroy (void)
       m_tcp->RemoveSocket (this);
     }
   NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
   CancelAllTimers ();
 }
 
@@ -2665,7 +2738,7 @@ TcpSocketBase::Destroy6 (void)
       m_tcp->RemoveSocket (this);
     }
   NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
   CancelAllTimers ();
 }
 
@@ -2695,6 +2768,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
     }
 
   AddSocketTags (p);
+  AddTimestampTag (p);
 
   header.SetFlags (flags);
   header.SetSequenceNumber (s);
@@ -2763,6 +2837,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
     { // If sending an ACK, cancel the delay ACK as well
       m_delAckEvent.Cancel ();
       m_delAckCount = 0;
+      AckPendingData ();
       if (m_highTxAck < header.GetAckNumber ())
         {
           m_highTxAck = header.GetAckNumber ();
@@ -2793,7 +2868,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
       NS_LOG_LOGIC ("Schedule retransmission timeout at time "
                     << Simulator::Now ().GetSeconds () << " to expire at time "
                     << (Simulator::Now () + m_rto.Get ()).GetSeconds ());
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::SendEmptyPacket, this, flags);
+      m_retxEvent.Schedule (m_rto, &TcpSocketBase::SendEmptyPacket, this, flags);
     }
 }
 
@@ -3048,12 +3123,42 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
   NS_LOG_FUNCTION (this << seq << maxSize << withAck);
 
   bool isStartOfTransmission = BytesInFlight () == 0U;
-  TcpTxItem *outItem = m_txBuffer->CopyFromSequence (maxSize, seq);
+  bool isSuperSegment = maxSize > m_tcb->m_segmentSize;
+  NS_ASSERT (!isSuperSegment || m_tsoMaxSize > 0);
+  TcpTxItem *outItem = m_txBuffer->CopyFromSequence (std::min (maxSize, m_tcb->m_segmentSize), seq);
 
   m_rateOps->SkbSent(outItem, isStartOfTransmission);
 
   bool isRetransmission = outItem->IsRetrans ();
   Ptr<Packet> p = outItem->GetPacketCopy ();
+
+  // With checksums, the payload sum is kept by the TX buffer items
+  bool checksum = Node::ChecksumEnabled ();
+  uint16_t payloadSum = checksum ? outItem->GetPayloadSum () : 0;
+
+  // Segmentation offload: the following whole segments join the first one,
+  // each keeping its own item (and scoreboard entry) in the TX buffer
+  uint32_t segments = 1;
+  while (isSuperSegment && p->GetSize () == segments * m_tcb->m_segmentSize
+         && p->GetSize () + m_tcb->m_segmentSize <= maxSize
+         && m_txBuffer->SizeFromSequence (seq + p->GetSize ()) >= m_tcb->m_segmentSize)
+    {
+      outItem = m_txBuffer->CopyFromSequence (m_tcb->m_segmentSize, seq + p->GetSize ());
+      m_rateOps->SkbSent (outItem, false);
+      if (checksum)
+        {
+          payloadSum = ChecksumAdd (payloadSum, outItem->GetPayloadSum (), p->GetSize ());
+        }
+      p->AddAtEnd (outItem->GetPacketCopy ());
+      segments++;
+    }
+  if (segments > 1)
+    {
+      TcpSegmentationTag segmentation;
+      segmentation.SetSegmentSize (m_tcb->m_segmentSize);
+      p->AddPacketTag (segmentation);
+    }
+
   uint32_t sz = p->GetSize (); // Size of packet
   uint8_t flags = withAck ? TcpHeader::ACK : 0;
   uint32_t remainingData = m_txBuffer->SizeFromSequence (seq + SequenceNumber32 (sz));
@@ -3085,6 +3190,7 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     {
       m_delAckEvent.Cancel ();
       m_delAckCount = 0;
+      AckPendingData ();
     }
 
   if (m_tcb->m_ecnState == TcpSocketState::ECN_ECE_RCVD && m_ecnEchoSeq.Get() > m_ecnCWRSeq.Get () && !isRetransmission)
@@ -3097,6 +3203,7 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     }
 
   AddSocketTags (p);
+  AddTimestampTag (p);
 
   if (m_closeOnEmpty && (remainingData == 0))
     {
@@ -3128,6 +3235,10 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     }
   header.SetWindowSize (AdvertisedWindowSize ());
   AddOptions (header);
+  if (checksum)
+    {
+      header.SetPayloadSum (payloadSum);
+    }
 
   if (m_retxEvent.IsExpired ())
     {
@@ -3136,7 +3247,7 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       NS_LOG_LOGIC (this << " SendDataPacket Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds () );
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      m_retxEvent.Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
     }
 
   m_txTrace (p, header, this);
@@ -3158,7 +3269,17 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
                     ". Header " << header);
     }
 
-  UpdateRttHistory (seq, sz, isRetransmission);
+  if (segments > 1)
+    { // One entry per wire segment, as they are ACKed one by one
+      for (uint32_t offset = 0; offset < sz; offset += m_tcb->m_segmentSize)
+        {
+          UpdateRttHistory (seq + offset, std::min (sz - offset, m_tcb->m_segmentSize), isRetransmission);
+        }
+    }
+  else
+    {
+      UpdateRttHistory (seq, sz, isRetransmission);
+    }
 
   // Update bytes sent during recovery phase
   if (m_tcb->m_congState == TcpSocketState::CA_RECOVERY || m_tcb->m_congState == TcpSocketState::CA_CWR)
@@ -3167,7 +3288,16 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
     }
 
   // Notify the application of the data being sent unless this is a retransmit
-  if (!isRetransmission)
+  if (!isRetransmission && m_batchDataSent)
+    {
+      // the segments sent until the notification runs share it
+      m_dataSentPending += seq + sz - m_tcb->m_highTxMark.Get ();
+      if (!m_dataSentEvent.IsRunning ())
+        {
+          m_dataSentEvent = Simulator::ScheduleNow (&TcpSocketBase::NotifyDataSentBatch, this);
+        }
+    }
+  else if (!isRetransmission)
     {
       Simulator::ScheduleNow (&TcpSocketBase::NotifyDataSent, this,
                               (seq + sz - m_tcb->m_highTxMark.Get ()));
@@ -3177,6 +3307,15 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
   return sz;
 }
 
+void
+TcpSocketBase::NotifyDataSentBatch (void)
+{
+  NS_LOG_FUNCTION (this << m_dataSentPending);
+  uint32_t size = m_dataSentPending;
+  m_dataSentPending = 0;
+  NotifyDataSent (size);
+}
+
 void
 TcpSocketBase::UpdateRttHistory (const SequenceNumber32 &seq, uint32_t sz,
                                  bool isRetransmission)
@@ -3184,24 +3323,71 @@ TcpSocketBase::UpdateRttHistory (const SequenceNumber32 &seq, uint32_t sz,
   NS_LOG_FUNCTION (this);
 
   // update the history of sequence numbers used to calculate the RTT
+  // The entries are kept disjoint, so that FindRttHistory can search them by seq
   if (isRetransmission == false)
     { // This is the next expected one, just log at end
+      if (!m_history.empty () && m_history.back ().seq + SequenceNumber32 (m_history.back ().count) > seq)
+        {
+          m_history.back ().count = seq - m_history.back ().seq;
+        }
       m_history.push_back (RttHistory (seq, sz, Simulator::Now ()));
     }
   else
     { // This is a retransmit, find in list and mark as re-tx
-      for (std::deque<RttHistory>::iterator i = m_history.begin (); i != m_history.end (); ++i)
-        {
-          if ((seq >= i->seq) && (seq < (i->seq + SequenceNumber32 (i->count))))
-            { // Found it
+      std::deque<RttHistory>::iterator i = FindRttHistory (seq);
+      if (i != m_history.end ())
+        { // Found it
+          SequenceNumber32 end = seq + SequenceNumber32 (sz);
+          i->retx = true;
+          i->count = end - i->seq; // And update count in hist
+          // The next entries the retransmission reaches are re-tx too; each
+          // entry ends where the next one starts, the last one at the end
+          for (std::deque<RttHistory>::iterator next = i + 1;
+               next != m_history.end () && next->seq < end; ++next)
+            {
+              i->count = next->seq - i->seq;
+              i = next;
               i->retx = true;
-              i->count = ((seq + SequenceNumber32 (sz)) - i->seq); // And update count in hist
-              break;
+              i->count = std::max<uint32_t> (i->count, end - i->seq);
             }
         }
     }
 }
 
+std::deque<RttHistory>::iterator
+TcpSocketBase::FindRttHistory (const SequenceNumber32 &seq)
+{
+  NS_LOG_FUNCTION (this << seq);
+
+  // The history is sorted by sequence, as only new data is appended, and
+  // its entries are disjoint
+  if (m_history.empty () || seq < m_history.front ().seq)
+    {
+      return m_history.end ();
+    }
+
+  // With full sized segments, the entry is at a known distance from the front
+  uint32_t index = static_cast<uint32_t> (seq - m_history.front ().seq) / std::max (m_tcb->m_segmentSize, 1U);
+  if (index < m_history.size ())
+    {
+      i = m_history.begin () + index;
+      if ((seq >= i->seq) && (seq < (i->seq + SequenceNumber32 (i->count))))
+        {
+          return i;
+        }
+    }
+
+  i = std::upper_bound (m_history.begin (), m_history.end (), seq,
+                        [] (const SequenceNumber32 &s, const RttHistory &h)
+                        { return s < h.seq; });
+  --i;
+  if (seq < (i->seq + SequenceNumber32 (i->count)))
+    {
+      return i;
+    }
+  return m_history.end ();
+}
+
 // Note that this function did not implement the PSH flag
 uint32_t
 TcpSocketBase::SendPendingData (bool withAck)
@@ -3291,6 +3477,20 @@ TcpSocketBase::SendPendingData (bool withAck)
           uint32_t maxSizeToSend = static_cast<uint32_t> (nextHigh - next);
           s = std::min (s, maxSizeToSend);
 
+          // Segmentation offload: as many whole segments of new data as the
+          // windows allow go in one super-segment. A paced socket (including
+          // TIMELY in Paced mode) keeps sending single segments: the pacing
+          // timer is set from the bytes handed to IPv4, and a super-segment
+          // would leave as a line-rate burst of its wire segments
+          if (m_tsoMaxSize > m_tcb->m_segmentSize && !m_tcb->m_pacing && m_endPoint != nullptr
+              && s == m_tcb->m_segmentSize && next >= m_tcb->m_highTxMark.Get ()
+              && availableData > m_tcb->m_segmentSize)
+            {
+              uint32_t rWndLeft = static_cast<uint32_t> ((m_highRxAckMark.Get () + SequenceNumber32 (m_rWnd.Get ())) - next);
+              s = std::min (std::min (availableWindow, rWndLeft), m_tsoMaxSize);
+              s = std::max (s - s % m_tcb->m_segmentSize, m_tcb->m_segmentSize);
+            }
+
           // (C.2) If any of the data octets sent in (C.1) are below HighData,
           //       HighRxt MUST be set to the highest sequence number of the
           //       retransmitted segment unless NextSeg () rule (4) was
@@ -3480,6 +3680,9 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
           return;
         }
     }
+  m_rxPendingSegments++;
+  m_rxPendingBytes += p->GetSize ();
+
   // Now send a new ACK packet acknowledging all received and delivered data
   if (m_tcb->m_rxBuffer->Size () > m_tcb->m_rxBuffer->Available () || m_tcb->m_rxBuffer->NextRxSequence () > expectedSeq + p->GetSize ())
     { // A gap exists in the buffer, or we filled a gap: Always ACK
@@ -3497,7 +3700,21 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
     }
   else
     { // In-sequence packet: ACK if delayed ack count allows
-      if (++m_delAckCount >= m_delAckMaxCount)
+      bool ackNow;
+      Time ackDelay = m_delAckTimeout;
+      if (m_rxCoalesceBytes > 0)
+        { // Receive offload: one ACK for a run of in-sequence segments.
+          // m_delAckCount is only set to force the first ACK of a connection
+          ackNow = (m_delAckMaxCount > 0 && m_delAckCount >= m_delAckMaxCount)
+            || m_rxPendingBytes >= m_rxCoalesceBytes
+            || m_tcb->m_ecnState == TcpSocketState::ECN_CE_RCVD;
+          ackDelay = m_rxCoalesceTimeout;
+        }
+      else
+        {
+          ackNow = ++m_delAckCount >= m_delAckMaxCount;
+        }
+      if (ackNow)
         {
           m_delAckEvent.Cancel ();
           m_delAckCount = 0;
@@ -3521,10 +3738,9 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
       else if (m_delAckEvent.IsExpired ())
         {
           m_congestionControl->CwndEvent (m_tcb, TcpSocketState::CA_EVENT_DELAYED_ACK);
-          m_delAckEvent = Simulator::Schedule (m_delAckTimeout,
-                                               &TcpSocketBase::DelAckTimeout, this);
+          m_delAckEvent.Schedule (ackDelay, &TcpSocketBase::DelAckTimeout, this);
           NS_LOG_LOGIC (this << " scheduled delayed ACK at " <<
-                        (Simulator::Now () + Simulator::GetDelayLeft (m_delAckEvent)).GetSeconds ());
+                        (Simulator::Now () + m_delAckEvent.GetDelayLeft ()).GetSeconds ());
         }
     }
 }
@@ -3541,6 +3757,8 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
 {
   SequenceNumber32 ackSeq = tcpHeader.GetAckNumber ();
   Time m = Time (0.0);
+  bool precise = false; // m comes from the echoed TcpTimestampTag
+  m_tcb->m_rttSamples.clear ();
 
   // An ack has been received, calculate rtt and log this measurement
   // Note we use a linear search (O(n)) for this since for the common
@@ -3550,11 +3768,14 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
       RttHistory& h = m_history.front ();
       if (!h.retx && ackSeq >= (h.seq + SequenceNumber32 (h.count)))
         { // Ok to use this sample
-          if (m_timestampEnabled && tcpHeader.HasOption (TcpOption::TS))
+          if (m_preciseRttEnabled && m_tsTagEchoRcvd)
             {
-              Ptr<const TcpOptionTS> ts;
-              ts = DynamicCast<const TcpOptionTS> (tcpHeader.GetOption (TcpOption::TS));
-              m = TcpOptionTS::ElapsedTimeFromTsValue (ts->GetEcho ());
+              m = Simulator::Now () - m_tsTagEcho;
+              precise = true;
+            }
+          else if (m_timestampEnabled && tcpHeader.HasOption (TcpOption::TS))
+            {
+              m = TcpOptionTS::ElapsedTimeFromTsValue (tcpHeader.GetTimestampEcho ());
             }
           else
             {
@@ -3571,6 +3792,10 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
         {
           break;                                                              // Done removing
         }
+      if (m_rttPerSegment && !h.retx && h.count > 0)
+        { // Karn: no sample from retransmitted segments
+          m_tcb->m_rttSamples.push_back (Simulator::Now () - h.time);
+        }
       m_history.pop_front (); // Remove
     }
 
@@ -3579,7 +3804,9 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
       m_rtt->Measurement (m);                // Log the measurement
       // RFC 6298, clause 2.4
       m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
-      m_tcb->m_lastRtt = m_rtt->GetEstimate ();
+      // With PreciseRtt, delay-based congestion controls get the raw sample
+      // of the tag; the coarser samples only feed the estimator, as before
+      m_tcb->m_lastRtt = precise ? m : m_rtt->GetEstimate ();
       m_tcb->m_minRtt = std::min (m_tcb->m_lastRtt.Get (), m_tcb->m_minRtt);
       NS_LOG_INFO (this << m_tcb->m_lastRtt << m_tcb->m_minRtt);
     }
@@ -3599,7 +3826,7 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack, bool resetRTO)
   if (m_state != SYN_RCVD && resetRTO)
     { // Set RTO unless the ACK is received in SYN_RCVD state
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
       // On receiving a "New" ack we restart retransmission timer .. RFC 6298
       // RFC 6298, clause 2.4
@@ -3608,7 +3835,7 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack, bool resetRTO)
       NS_LOG_LOGIC (this << " Schedule ReTxTimeout at time " <<
                     Simulator::Now ().GetSeconds () << " to expire at time " <<
                     (Simulator::Now () + m_rto.Get ()).GetSeconds ());
-      m_retxEvent = Simulator::Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
+      m_retxEvent.Schedule (m_rto, &TcpSocketBase::ReTxTimeout, this);
     }
 
   // Note the highest ACK and tell app to send more
@@ -3626,7 +3853,7 @@ TcpSocketBase::NewAck (SequenceNumber32 const& ack, bool resetRTO)
   if (m_txBuffer->Size () == 0 && m_state != FIN_WAIT_1 && m_state != CLOSING)
     { // No retransmit timer if no data to retransmit
       NS_LOG_LOGIC (this << " Cancelled ReTxTimeout event which was set to expire at " <<
-                    (Simulator::Now () + Simulator::GetDelayLeft (m_retxEvent)).GetSeconds ());
+                    (Simulator::Now () + m_retxEvent.GetDelayLeft ()).GetSeconds ());
       m_retxEvent.Cancel ();
     }
 }
@@ -3764,6 +3991,26 @@ TcpSocketBase::ReTxTimeout ()
                  ") there is more than one segment (" << m_tcb->m_segmentSize << ")");
 }
 
+void
+TcpSocketBase::AckPendingData (void)
+{
+  if (m_rxPendingSegments == 0)
+    {
+      return;
+    }
+  m_ackCoalescingTrace (m_rxPendingSegments, m_rxPendingBytes);
+  m_rxAckedSegments += m_rxPendingSegments;
+  m_rxAcks++;
+  m_rxPendingSegments = 0;
+  m_rxPendingBytes = 0;
+}
+
+double
+TcpSocketBase::GetAckCoalescingRatio (void) const
+{
+  return m_rxAcks > 0 ? static_cast<double> (m_rxAckedSegments) / m_rxAcks : 0.0;
+}
+
 void
 TcpSocketBase::DelAckTimeout (void)
 {
@@ -3799,7 +4046,7 @@ TcpSocketBase::LastAckTimeout (void)
       SendEmptyPacket (TcpHeader::FIN | TcpHeader::ACK);
       NS_LOG_LOGIC ("TcpSocketBase " << this << " rescheduling LATO1");
       Time lastRto = m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4);
-      m_lastAckEvent = Simulator::Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
+      m_lastAckEvent.Schedule (lastRto, &TcpSocketBase::LastAckTimeout, this);
     }
 }
 
@@ -3855,7 +4102,7 @@ TcpSocketBase::PersistTimeout ()
   NS_LOG_LOGIC ("Schedule persist timeout at time "
                 << Simulator::Now ().GetSeconds () << " to expire at time "
                 << (Simulator::Now () + m_persistTimeout).GetSeconds ());
-  m_persistEvent = Simulator::Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
+  m_persistEvent.Schedule (m_persistTimeout, &TcpSocketBase::PersistTimeout, this);
 }
 
 void
@@ -3922,8 +4169,8 @@ TcpSocketBase::TimeWait ()
     }
   // Move from TIME_WAIT to CLOSED after 2*MSL. Max segment lifetime is 2 min
   // according to RFC793, p.28
-  m_timewaitEvent = Simulator::Schedule (Seconds (2 * m_msl),
-                                         &TcpSocketBase::CloseAndNotify, this);
+  m_timewaitEvent.Schedule (Seconds (2 * m_msl),
+                            &TcpSocketBase::CloseAndNotify, this);
 }
 
 /* Below are the attribute get/set functions */
@@ -4106,15 +4353,13 @@ TcpSocketBase::AddOptions (TcpHeader& header)
 }
 
 void
-TcpSocketBase::ProcessOptionWScale (const Ptr<const TcpOption> option)
+TcpSocketBase::ProcessOptionWScale (const TcpHeader &tcpHeader)
 {
-  NS_LOG_FUNCTION (this << option);
-
-  Ptr<const TcpOptionWinScale> ws = DynamicCast<const TcpOptionWinScale> (option);
+  NS_LOG_FUNCTION (this << tcpHeader);
 
   // In naming, we do the contrary of RFC 1323. The received scaling factor
   // is Rcv.Wind.Scale (and not Snd.Wind.Scale)
-  m_sndWindShift = ws->GetScale ();
+  m_sndWindShift = tcpHeader.GetWindowScale ();
 
   if (m_sndWindShift > 14)
     {
@@ -4156,38 +4401,36 @@ TcpSocketBase::AddOptionWScale (TcpHeader &header)
   NS_LOG_FUNCTION (this << header);
   NS_ASSERT (header.GetFlags () & TcpHeader::SYN);
 
-  Ptr<TcpOptionWinScale> option = CreateObject<TcpOptionWinScale> ();
-
   // In naming, we do the contrary of RFC 1323. The sended scaling factor
   // is Snd.Wind.Scale (and not Rcv.Wind.Scale)
 
   m_rcvWindShift = CalculateWScale ();
-  option->SetScale (m_rcvWindShift);
-
-  header.AppendOption (option);
+  header.AppendWindowScale (m_rcvWindShift);
 
   NS_LOG_INFO (m_node->GetId () << " Send a scaling factor of " <<
                static_cast<int> (m_rcvWindShift));
 }
 
 uint32_t
-TcpSocketBase::ProcessOptionSack (const Ptr<const TcpOption> option)
+TcpSocketBase::ProcessOptionSack (const TcpHeader &tcpHeader)
 {
-  NS_LOG_FUNCTION (this << option);
+  NS_LOG_FUNCTION (this << tcpHeader);
 
-  Ptr<const TcpOptionSack> s = DynamicCast<const TcpOptionSack> (option);
-  return m_txBuffer->Update (s->GetSackList (), MakeCallback (&TcpRateOps::SkbDelivered, m_rateOps));
+  TcpOptionSack::SackList list;
+  for (uint8_t i = 0; i < tcpHeader.GetSackBlockCount (); ++i)
+    {
+      list.push_back (tcpHeader.GetSackBlock (i));
+    }
+  return m_txBuffer->Update (list, MakeCallback (&TcpRateOps::SkbDelivered, m_rateOps));
 }
 
 void
-TcpSocketBase::ProcessOptionSackPermitted (const Ptr<const TcpOption> option)
+TcpSocketBase::ProcessOptionSackPermitted (const TcpHeader &tcpHeader)
 {
-  NS_LOG_FUNCTION (this << option);
-
-  Ptr<const TcpOptionSackPermitted> s = DynamicCast<const TcpOptionSackPermitted> (option);
+  NS_LOG_FUNCTION (this << tcpHeader);
 
   NS_ASSERT (m_sackEnabled == true);
-  NS_LOG_INFO (m_node->GetId () << " Received a SACK_PERMITTED option " << s);
+  NS_LOG_INFO (m_node->GetId () << " Received a SACK_PERMITTED option");
 }
 
 void
@@ -4196,8 +4439,7 @@ TcpSocketBase::AddOptionSackPermitted (TcpHeader &header)
   NS_LOG_FUNCTION (this << header);
   NS_ASSERT (header.GetFlags () & TcpHeader::SYN);
 
-  Ptr<TcpOptionSackPermitted> option = CreateObject<TcpOptionSackPermitted> ();
-  header.AppendOption (option);
+  header.AppendSackPermitted ();
   NS_LOG_INFO (m_node->GetId () << " Add option SACK-PERMITTED");
 }
 
@@ -4206,56 +4448,43 @@ TcpSocketBase::AddOptionSack (TcpHeader& header)
 {
   NS_LOG_FUNCTION (this << header);
 
-  // Calculate the number of SACK blocks allowed in this packet
-  uint8_t optionLenAvail = header.GetMaxOptionLength () - header.GetOptionLength ();
-  uint8_t allowedSackBlocks = (optionLenAvail - 2) / 8;
-
-  TcpOptionSack::SackList sackList = m_tcb->m_rxBuffer->GetSackList ();
-  if (allowedSackBlocks == 0 || sackList.empty ())
+  // Append as many SACK blocks as the option space allows
+  if (!header.AppendSack (m_tcb->m_rxBuffer->GetSackList ()))
     {
       NS_LOG_LOGIC ("No space available or sack list empty, not adding sack blocks");
       return;
     }
 
-  // Append the allowed number of SACK blocks
-  Ptr<TcpOptionSack> option = CreateObject<TcpOptionSack> ();
-  TcpOptionSack::SackList::iterator i;
-  for (i = sackList.begin (); allowedSackBlocks > 0 && i != sackList.end (); ++i)
-    {
-      option->AddSackBlock (*i);
-      allowedSackBlocks--;
-    }
-
-  header.AppendOption (option);
-  NS_LOG_INFO (m_node->GetId () << " Add option SACK " << *option);
+  NS_LOG_INFO (m_node->GetId () << " Add option SACK with " <<
+               static_cast<int> (header.GetSackBlockCount ()) << " blocks");
 }
 
 void
-TcpSocketBase::ProcessOptionTimestamp (const Ptr<const TcpOption> option,
-                                       const SequenceNumber32 &seq)
+TcpSocketBase::ProcessOptionTimestamp (const TcpHeader &tcpHeader)
 {
-  NS_LOG_FUNCTION (this << option);
+  NS_LOG_FUNCTION (this << tcpHeader);
 
-  Ptr<const TcpOptionTS> ts = DynamicCast<const TcpOptionTS> (option);
+  uint32_t timestamp = tcpHeader.GetTimestampValue ();
+  SequenceNumber32 seq = tcpHeader.GetSequenceNumber ();
 
   // This is valid only when no overflow occurs. It happens
   // when a connection last longer than 50 days.
-  if (m_tcb->m_rcvTimestampValue > ts->GetTimestamp ())
+  if (m_tcb->m_rcvTimestampValue > timestamp)
     {
       // Do not save a smaller timestamp (probably there is reordering)
       return;
     }
 
-  m_tcb->m_rcvTimestampValue = ts->GetTimestamp ();
-  m_tcb->m_rcvTimestampEchoReply = ts->GetEcho ();
+  m_tcb->m_rcvTimestampValue = timestamp;
+  m_tcb->m_rcvTimestampEchoReply = tcpHeader.GetTimestampEcho ();
 
   if (seq == m_tcb->m_rxBuffer->NextRxSequence () && seq <= m_highTxAck)
     {
-      m_timestampToEcho = ts->GetTimestamp ();
+      m_timestampToEcho = timestamp;
     }
 
   NS_LOG_INFO (m_node->GetId () << " Got timestamp=" <<
-               m_timestampToEcho << " and Echo="     << ts->GetEcho ());
+               m_timestampToEcho << " and Echo="     << m_tcb->m_rcvTimestampEchoReply);
 }
 
 void
@@ -4263,14 +4492,52 @@ TcpSocketBase::AddOptionTimestamp (TcpHeader& header)
 {
   NS_LOG_FUNCTION (this << header);
 
-  Ptr<TcpOptionTS> option = CreateObject<TcpOptionTS> ();
+  uint32_t timestamp = TcpOptionTS::NowToTsValue ();
+  header.AppendTimestamp (timestamp, m_timestampToEcho);
+  NS_LOG_INFO (m_node->GetId () << " Add option TS, ts=" <<
+               timestamp << " echo=" << m_timestampToEcho);
+}
 
-  option->SetTimestamp (TcpOptionTS::NowToTsValue ());
-  option->SetEcho (m_timestampToEcho);
+void
+TcpSocketBase::ProcessTimestampTag (const TcpTimestampTag &tag,
+                                    const SequenceNumber32 &seq)
+{
+  NS_LOG_FUNCTION (this << seq);
 
-  header.AppendOption (option);
-  NS_LOG_INFO (m_node->GetId () << " Add option TS, ts=" <<
-               option->GetTimestamp () << " echo=" << m_timestampToEcho);
+  if (tag.HasEcho ())
+    {
+      m_tsTagEchoRcvd = true;
+      m_tsTagEcho = tag.GetEcho ();
+    }
+
+  // Same rule as TSecr (RFC 7323): echo the stamp of the oldest segment
+  // not yet acknowledged
+  if (!m_tsTagToEchoValid
+      || (seq == m_tcb->m_rxBuffer->NextRxSequence () && seq <= m_highTxAck))
+    {
+      m_tsTagToEcho = tag.GetTimestamp ();
+      m_tsTagToEchoValid = true;
+    }
+
+  NS_LOG_INFO (m_node->GetId () << " Got timestamp tag=" <<
+               tag.GetTimestamp () << " and Echo=" << m_tsTagEcho);
+}
+
+void
+TcpSocketBase::AddTimestampTag (const Ptr<Packet> &p) const
+{
+  if (!m_preciseRttEnabled && !m_tsTagToEchoValid)
+    {
+      return;
+    }
+
+  TcpTimestampTag tag;
+  tag.SetTimestamp (Simulator::Now ());
+  if (m_tsTagToEchoValid)
+    {
+      tag.SetEcho (m_tsTagToEcho);
+    }
+  p->ReplacePacketTag (tag);
 }
 
 void TcpSocketBase::UpdateWindowSize (const TcpHeader &header)
@@ -32,6 +32,7 @@
 #include "ns3/data-rate.h"
 #include "ns3/node.h"
 #include "ns3/tcp-socket-state.h"
+#include "ns3/tcp-timer-wheel.h"
 
 namespace ns3 {
 
@@ -50,6 +51,7 @@ class TcpOption;
 class Ipv4Interface;
 class Ipv6Interface;
 class TcpRateOps;
+class TcpTimestampTag;
 
 /**
  * \ingroup tcp
@@ -603,6 +605,24 @@ public:
   typedef void (* TcpTxRxTracedCallback)(const Ptr<const Packet> packet, const TcpHeader& header,
                                          const Ptr<const TcpSocketBase> socket);
 
+  /**
+   * TracedCallback signature for the data covered by an ACK.
+   *
+   * \param [in] segments Data segments received since the previous ACK
+   * \param [in] bytes Bytes received since the previous ACK
+   */
+  typedef void (* AckCoalescingTracedCallback)(uint32_t segments, uint32_t bytes);
+
+  /**
+   * \brief Get the average number of data segments covered by an ACK
+   *
+   * This is the coalescing ratio of the receiver: about DelAckCount with
+   * delayed ACKs, and RxCoalesceBytes / segment size with receive offload.
+   *
+   * \return received data segments per ACK sent, 0 before the first ACK
+   */
+  double GetAckCoalescingRatio (void) const;
+
 protected:
   // Implementing ns3::TcpSocket -- Attribute get/set
   // inherited, no need to doc
@@ -778,6 +798,12 @@ protected:
    */
   virtual uint32_t SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool withAck);
 
+  /**
+   * \brief Notify the application of the new data sent since the
+   *        notification was scheduled (BatchDataSent)
+   */
+  void NotifyDataSentBatch (void);
+
   /**
    * \brief Send a empty packet that carries a flag, e.g., ACK
    *
@@ -1030,6 +1056,17 @@ protected:
   virtual void UpdateRttHistory (const SequenceNumber32 &seq, uint32_t sz,
                                  bool isRetransmission);
 
+  /**
+   * \brief Find the RTT history entry of a sequence number
+   *
+   * The lookup is O(1) when the entries are full sized segments, and a
+   * binary search otherwise, as UpdateRttHistory keeps the entries disjoint.
+   *
+   * \param seq the sequence number
+   * \return the entry containing seq, or the end of m_history
+   */
+  std::deque<RttHistory>::iterator FindRttHistory (const SequenceNumber32 &seq);
+
   /**
    * \brief Update buffers w.r.t. ACK
    * \param seq the sequence number
@@ -1068,6 +1105,11 @@ protected:
    */
   virtual void DelAckTimeout (void);
 
+  /**
+   * \brief Account the data segments covered by the ACK being sent
+   */
+  void AckPendingData (void);
+
   /**
    * \brief Timeout at LAST_ACK, close the connection
    */
@@ -1117,9 +1159,9 @@ protected:
    * Read the window scale option (encoded logarithmically) and save it.
    * Per RFC 1323, the value can't exceed 14.
    *
-   * \param option Window scale option read from the header
+   * \param tcpHeader header carrying the window scale option
    */
-  void ProcessOptionWScale (const Ptr<const TcpOption> option);
+  void ProcessOptionWScale (const TcpHeader &tcpHeader);
   /**
    * \brief Add the window scale option to the header
    *
@@ -1145,17 +1187,17 @@ protected:
    * Currently this is a placeholder, since no operations should be done
    * on such option.
    *
-   * \param option SACK PERMITTED option from the header
+   * \param tcpHeader header carrying the SACK PERMITTED option
    */
-  void ProcessOptionSackPermitted (const Ptr<const TcpOption> option);
+  void ProcessOptionSackPermitted (const TcpHeader &tcpHeader);
 
   /**
    * \brief Read the SACK option
    *
-   * \param option SACK option from the header
+   * \param tcpHeader header carrying the SACK option
    * \returns the number of bytes sacked by this option
    */
-  uint32_t ProcessOptionSack(const Ptr<const TcpOption> option);
+  uint32_t ProcessOptionSack (const TcpHeader &tcpHeader);
 
   /**
    * \brief Add the SACK PERMITTED option to the header
@@ -1178,11 +1220,9 @@ protected:
    * to utilize later to calculate RTT.
    *
    * \see EstimateRtt
-   * \param option Option from the segment
-   * \param seq Sequence number of the segment
+   * \param tcpHeader header of the segment, carrying the timestamp option
    */
-  void ProcessOptionTimestamp (const Ptr<const TcpOption> option,
-                               const SequenceNumber32 &seq);
+  void ProcessOptionTimestamp (const TcpHeader &tcpHeader);
   /**
    * \brief Add the timestamp option to the header
    *
@@ -1193,6 +1233,30 @@ protected:
    */
   void AddOptionTimestamp (TcpHeader& header);
 
+  /**
+   * \brief Process the full resolution timestamp tag from other side
+   *
+   * Same bookkeeping as ProcessOptionTimestamp: save the peer send time to
+   * be echoed in our out-packets, and the echo it carries, to be used by
+   * EstimateRtt when PreciseRtt is enabled.
+   *
+   * \see EstimateRtt
+   * \param tag Tag removed from the segment
+   * \param seq Sequence number of the segment
+   */
+  void ProcessTimestampTag (const TcpTimestampTag &tag,
+                            const SequenceNumber32 &seq);
+
+  /**
+   * \brief Add the full resolution timestamp tag to an outgoing packet
+   *
+   * The tag is added if PreciseRtt is enabled, or if the peer sent us one
+   * (so that its stamp is echoed back).
+   *
+   * \param p Packet to which add the tag to
+   */
+  void AddTimestampTag (const Ptr<Packet> &p) const;
+
   /**
    * \brief Performs a safe subtraction between a and b (a-b)
    *
@@ -1243,18 +1307,42 @@ protected:
   SequenceNumber32 GetHighRxAck (void) const;
 
 protected:
+  /**
+   * \brief Set the timer wheel of the TCP timers
+   * \param wheel the timer wheel of the node
+   */
+  void SetTimerWheel (Ptr<TcpTimerWheel> wheel);
+
   // Counters and events
-  EventId           m_retxEvent     {}; //!< Retransmission event
-  EventId           m_lastAckEvent  {}; //!< Last ACK timeout event
-  EventId           m_delAckEvent   {}; //!< Delayed ACK timeout event
-  EventId           m_persistEvent  {}; //!< Persist event: Send 1 byte to probe for a non-zero Rx window
-  EventId           m_timewaitEvent {}; //!< TIME_WAIT expiration event: Move this socket to CLOSED state
+  TcpTimer          m_retxEvent;     //!< Retransmission event
+  TcpTimer          m_lastAckEvent;  //!< Last ACK timeout event
+  TcpTimer          m_delAckEvent;   //!< Delayed ACK timeout event
+  TcpTimer          m_persistEvent;  //!< Persist event: Send 1 byte to probe for a non-zero Rx window
+  TcpTimer          m_timewaitEvent; //!< TIME_WAIT expiration event: Move this socket to CLOSED state
 
   // ACK management
   uint32_t          m_dupAckCount {0};     //!< Dupack counter
   uint32_t          m_delAckCount {0};     //!< Delayed ACK counter
   uint32_t          m_delAckMaxCount {0};  //!< Number of packet to fire an ACK before delay timeout
 
+  // Receive offload (ACK coalescing)
+  uint32_t          m_rxCoalesceBytes {0};             //!< Pending bytes that fire an ACK, 0 to disable
+  Time              m_rxCoalesceTimeout {MicroSeconds (10)}; //!< Longest delay of a coalesced ACK
+  uint32_t          m_rxPendingSegments {0};           //!< Data segments received since the last ACK
+  uint32_t          m_rxPendingBytes {0};              //!< Data bytes received since the last ACK
+  uint64_t          m_rxAckedSegments {0};             //!< Data segments covered by the ACKs sent
+  uint64_t          m_rxAcks {0};                      //!< ACKs sent covering data
+
+  TracedCallback<uint32_t, uint32_t> m_ackCoalescingTrace; //!< Data covered by each ACK
+
+  // Segmentation offload
+  uint32_t          m_tsoMaxSize {0};                  //!< Largest super-segment (bytes), 0 to disable
+
+  // Batched DataSent notification
+  bool              m_batchDataSent {false};           //!< One DataSent notification per batch of segments
+  uint32_t          m_dataSentPending {0};             //!< New data bytes sent, not notified yet
+  EventId           m_dataSentEvent {};                //!< Pending batched DataSent notification
+
   // Nagle algorithm
   bool              m_noDelay {false};     //!< Set to true to disable Nagle's algorithm
 
@@ -1315,6 +1403,14 @@ protected:
   bool     m_timestampEnabled {true}; //!< Timestamp option enabled
   uint32_t m_timestampToEcho  {0};    //!< Timestamp to echo
 
+  // Full resolution timestamps (TcpTimestampTag)
+  bool m_preciseRttEnabled {false};          //!< Stamp segments with TcpTimestampTag, use it for RTT
+  bool m_rttPerSegment     {false};          //!< Fill m_tcb->m_rttSamples on each ACK
+  bool m_tsTagToEchoValid  {false};          //!< A peer TcpTimestampTag has been recorded
+  Time m_tsTagToEcho       {Seconds (0.0)};  //!< Peer send time to echo
+  bool m_tsTagEchoRcvd     {false};          //!< The segment being processed carried an echo
+  Time m_tsTagEcho         {Seconds (0.0)};  //!< Echo carried by the segment being processed
+
   EventId m_sendPendingDataEvent {}; //!< micro-delay event to send pending data
 
   // Fast Retransmit and Recovery
@@ -115,6 +115,7 @@ TcpSocketState::TcpSocketState (const TcpSocketState &other)
     m_minRtt (other.m_minRtt),
     m_bytesInFlight (other.m_bytesInFlight),
     m_lastRtt (other.m_lastRtt),
+    m_rttSamples (other.m_rttSamples),
     m_ecnMode (other.m_ecnMode),
     m_useEcn (other.m_useEcn)
 {
@@ -18,6 +18,7 @@
 #ifndef TCP_SOCKET_STATE_H
 #define TCP_SOCKET_STATE_H
 
+#include <vector>
 #include "ns3/object.h"
 #include "ns3/data-rate.h"
 #include "ns3/traced-value.h"
@@ -196,6 +197,7 @@ public:
 
   TracedValue<uint32_t>  m_bytesInFlight {0};        //!< Bytes in flight
   TracedValue<Time>      m_lastRtt {Seconds (0.0)};  //!< Last RTT sample collected
+  std::vector<Time>      m_rttSamples;               //!< RTT of each segment ACKed by the last ACK (TcpSocketBase::RttPerSegment)
 
   Ptr<TcpRxBuffer>       m_rxBuffer;                 //!< Rx buffer (reordering buffer)
 
@@ -0,0 +1,573 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/simulator.h"
+#include "tcp-timer-wheel.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpTimerWheel");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpTimerWheel);
+
+static const uint64_t TICK_BITS = 8;               //!< log2 of the LEVEL_TICK slots
+static const uint64_t BLOCK_BITS = 6;              //!< log2 of the LEVEL_BLOCK slots
+static const uint64_t TICK_MASK = (1 << TICK_BITS) - 1;
+static const uint64_t FAR_BITS = TICK_BITS + BLOCK_BITS;
+static const uint64_t FAR_MASK = (1 << FAR_BITS) - 1;
+static const uint64_t NO_TICK = std::numeric_limits<uint64_t>::max ();
+
+TcpTimer::TcpTimer ()
+  : m_running (false),
+    m_prev (0),
+    m_next (0),
+    m_level (TcpTimerWheel::LEVEL_NONE),
+    m_slot (0)
+{
+}
+
+TcpTimer::~TcpTimer ()
+{
+  Cancel ();
+}
+
+void
+TcpTimer::SetWheel (Ptr<TcpTimerWheel> wheel)
+{
+  NS_ASSERT_MSG (!m_running, "Timer wheel changed under a running timer");
+  m_wheel = wheel;
+}
+
+void
+TcpTimer::Schedule (const Time &delay, const Ptr<EventImpl> &function)
+{
+  m_function = function;
+  if (m_wheel != 0)
+    {
+      m_wheel->Arm (this, delay);
+      return;
+    }
+
+  m_event.Cancel ();
+  m_deadline = Simulator::Now () + delay;
+  m_running = true;
+  m_event = Simulator::Schedule (delay, &TcpTimer::Expire, this);
+}
+
+void
+TcpTimer::Cancel (void)
+{
+  if (!m_running)
+    {
+      return;
+    }
+  if (m_wheel != 0)
+    {
+      m_wheel->Disarm (this);
+      return;
+    }
+
+  m_event.Cancel ();
+  m_running = false;
+}
+
+bool
+TcpTimer::IsRunning (void) const
+{
+  return m_running;
+}
+
+bool
+TcpTimer::IsExpired (void) const
+{
+  return !m_running;
+}
+
+Time
+TcpTimer::GetDelayLeft (void) const
+{
+  return m_running ? m_deadline - Simulator::Now () : Seconds (0);
+}
+
+void
+TcpTimer::Expire (void)
+{
+  m_running = false;
+  // the function may schedule the timer again, replacing m_function
+  Ptr<EventImpl> function = m_function;
+  function->Invoke ();
+}
+
+TypeId
+TcpTimerWheel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpTimerWheel")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpTimerWheel> ()
+    .AddAttribute ("Enabled",
+                   "Keep the TCP timers of the node on the wheel, with one "
+                   "simulator event for all of them, instead of one simulator "
+                   "event per timer Schedule",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpTimerWheel::m_enabled),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Tick",
+                   "Duration of a wheel slot; the firing times do not depend "
+                   "on it. Best set to the ClockGranularity of the sockets",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&TcpTimerWheel::m_tick),
+                   MakeTimeChecker (NanoSeconds (1)))
+  ;
+  return tid;
+}
+
+TcpTimerWheel::TcpTimerWheel ()
+  : m_enabled (false),
+    m_current (0),
+    m_blockBits (0),
+    m_far (0),
+    m_farMin (NO_TICK),
+    m_due (0),
+    m_wakeTime (Time::Max ()),
+    m_running (false),
+    m_arms (0),
+    m_cancels (0),
+    m_expirations (0),
+    m_schedulerInserts (0),
+    m_schedulerCancels (0)
+{
+  NS_LOG_FUNCTION (this);
+  std::fill (m_tickSlots, m_tickSlots + 256, static_cast<TcpTimer *> (0));
+  std::fill (m_tickBits, m_tickBits + 4, 0);
+  std::fill (m_blockSlots, m_blockSlots + 64, static_cast<TcpTimer *> (0));
+}
+
+TcpTimerWheel::~TcpTimerWheel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpTimerWheel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  Object::DoDispose ();
+}
+
+bool
+TcpTimerWheel::IsEnabled (void) const
+{
+  return m_enabled;
+}
+
+uint64_t
+TcpTimerWheel::GetTimerArms (void) const
+{
+  return m_arms;
+}
+
+uint64_t
+TcpTimerWheel::GetTimerCancels (void) const
+{
+  return m_cancels;
+}
+
+uint64_t
+TcpTimerWheel::GetTimerExpirations (void) const
+{
+  return m_expirations;
+}
+
+uint64_t
+TcpTimerWheel::GetSchedulerInserts (void) const
+{
+  return m_schedulerInserts;
+}
+
+uint64_t
+TcpTimerWheel::GetSchedulerCancels (void) const
+{
+  return m_schedulerCancels;
+}
+
+uint64_t
+TcpTimerWheel::TickOf (const Time &time) const
+{
+  return time.GetTimeStep () / m_tick.GetTimeStep ();
+}
+
+Time
+TcpTimerWheel::TickStart (uint64_t tick) const
+{
+  return TimeStep (tick * m_tick.GetTimeStep ());
+}
+
+void
+TcpTimerWheel::Arm (TcpTimer *timer, const Time &delay)
+{
+  m_arms++;
+  if (timer->m_running)
+    {
+      Remove (timer);
+    }
+  timer->m_deadline = Simulator::Now () + delay;
+  timer->m_running = true;
+
+  if (!m_enabled)
+    {
+      timer->m_event = Simulator::Schedule (delay, &TcpTimerWheel::Fire, this, timer);
+      m_schedulerInserts++;
+      return;
+    }
+
+  Time wakeTime = Place (timer);
+  if (!m_running)
+    {
+      WakeUpBy (wakeTime);
+    }
+}
+
+void
+TcpTimerWheel::Disarm (TcpTimer *timer)
+{
+  m_cancels++;
+  Remove (timer);
+  timer->m_running = false;
+}
+
+void
+TcpTimerWheel::Remove (TcpTimer *timer)
+{
+  if (timer->m_event.IsRunning ())
+    {
+      timer->m_event.Cancel ();
+      m_schedulerCancels++;
+    }
+  if (timer->m_level != LEVEL_NONE)
+    {
+      Unlink (timer);
+    }
+}
+
+Time
+TcpTimerWheel::Place (TcpTimer *timer)
+{
+  uint64_t tick = TickOf (timer->m_deadline);
+  if (tick <= m_current)
+    {
+      InsertDue (timer);
+      return timer->m_deadline;
+    }
+  if ((tick >> TICK_BITS) == (m_current >> TICK_BITS))
+    {
+      Link (timer, LEVEL_TICK, tick & TICK_MASK);
+      return TickStart (tick);
+    }
+  if ((tick >> FAR_BITS) == (m_current >> FAR_BITS))
+    {
+      Link (timer, LEVEL_BLOCK, (tick >> TICK_BITS) & ((1 << BLOCK_BITS) - 1));
+      return TickStart (tick & ~TICK_MASK);
+    }
+  Link (timer, LEVEL_FAR, 0);
+  m_farMin = std::min (m_farMin, tick);
+  return TickStart (tick & ~FAR_MASK);
+}
+
+void
+TcpTimerWheel::Link (TcpTimer *timer, Level level, uint8_t slot)
+{
+  TcpTimer **head;
+  switch (level)
+    {
+    case LEVEL_TICK:
+      head = &m_tickSlots[slot];
+      m_tickBits[slot >> 6] |= uint64_t (1) << (slot & 63);
+      break;
+    case LEVEL_BLOCK:
+      head = &m_blockSlots[slot];
+      m_blockBits |= uint64_t (1) << slot;
+      break;
+    case LEVEL_FAR:
+      head = &m_far;
+      break;
+    default:
+      NS_FATAL_ERROR ("Timers are linked in the due list by InsertDue");
+      return;
+    }
+
+  timer->m_level = level;
+  timer->m_slot = slot;
+  timer->m_prev = 0;
+  timer->m_next = *head;
+  if (*head != 0)
+    {
+      (*head)->m_prev = timer;
+    }
+  *head = timer;
+}
+
+void
+TcpTimerWheel::Unlink (TcpTimer *timer)
+{
+  if (timer->m_next != 0)
+    {
+      timer->m_next->m_prev = timer->m_prev;
+    }
+  if (timer->m_prev != 0)
+    {
+      timer->m_prev->m_next = timer->m_next;
+    }
+  else
+    {
+      switch (timer->m_level)
+        {
+        case LEVEL_TICK:
+          m_tickSlots[timer->m_slot] = timer->m_next;
+          if (timer->m_next == 0)
+            {
+              m_tickBits[timer->m_slot >> 6] &= ~(uint64_t (1) << (timer->m_slot & 63));
+            }
+          break;
+        case LEVEL_BLOCK:
+          m_blockSlots[timer->m_slot] = timer->m_next;
+          if (timer->m_next == 0)
+            {
+              m_blockBits &= ~(uint64_t (1) << timer->m_slot);
+            }
+          break;
+        case LEVEL_FAR:
+          m_far = timer->m_next;
+          break;
+        case LEVEL_DUE:
+          m_due = timer->m_next;
+          break;
+        default:
+          NS_FATAL_ERROR ("Timer not on the wheel");
+        }
+    }
+  timer->m_prev = 0;
+  timer->m_next = 0;
+  timer->m_level = LEVEL_NONE;
+}
+
+void
+TcpTimerWheel::InsertDue (TcpTimer *timer)
+{
+  TcpTimer *prev = 0;
+  TcpTimer *next = m_due;
+  while (next != 0 && next->m_deadline <= timer->m_deadline)
+    {
+      prev = next;
+      next = next->m_next;
+    }
+
+  timer->m_level = LEVEL_DUE;
+  timer->m_slot = 0;
+  timer->m_prev = prev;
+  timer->m_next = next;
+  if (next != 0)
+    {
+      next->m_prev = timer;
+    }
+  if (prev != 0)
+    {
+      prev->m_next = timer;
+    }
+  else
+    {
+      m_due = timer;
+    }
+}
+
+TcpTimer *
+TcpTimerWheel::TakeList (Level level, uint8_t slot)
+{
+  TcpTimer *list;
+  switch (level)
+    {
+    case LEVEL_TICK:
+      list = m_tickSlots[slot];
+      m_tickSlots[slot] = 0;
+      m_tickBits[slot >> 6] &= ~(uint64_t (1) << (slot & 63));
+      break;
+    case LEVEL_BLOCK:
+      list = m_blockSlots[slot];
+      m_blockSlots[slot] = 0;
+      m_blockBits &= ~(uint64_t (1) << slot);
+      break;
+    case LEVEL_FAR:
+      list = m_far;
+      m_far = 0;
+      m_farMin = NO_TICK;
+      break;
+    default:
+      NS_FATAL_ERROR ("Only the wheel lists are taken");
+      return 0;
+    }
+
+  for (TcpTimer *timer = list; timer != 0; timer = timer->m_next)
+    {
+      timer->m_level = LEVEL_NONE;
+    }
+  return list;
+}
+
+uint64_t
+TcpTimerWheel::NextOccupiedTick (void) const
+{
+  uint64_t next = NO_TICK;
+
+  // LEVEL_TICK holds the ticks after the current one in its block
+  uint32_t slot = (m_current & TICK_MASK) + 1;
+  for (uint32_t word = slot >> 6; word < 4 && next == NO_TICK; ++word)
+    {
+      uint64_t bits = m_tickBits[word];
+      if (word == slot >> 6 && (slot & 63) != 0)
+        {
+          bits &= ~uint64_t (0) << (slot & 63);
+        }
+      if (bits != 0)
+        {
+          next = (m_current & ~TICK_MASK) | (word << 6) | __builtin_ctzll (bits);
+        }
+    }
+
+  // LEVEL_BLOCK the blocks after the current one in its far block
+  uint32_t block = ((m_current >> TICK_BITS) & ((1 << BLOCK_BITS) - 1)) + 1;
+  uint64_t bits = block < 64 ? m_blockBits & (~uint64_t (0) << block) : 0;
+  if (bits != 0)
+    {
+      next = std::min (next, (m_current & ~FAR_MASK) | (uint64_t (__builtin_ctzll (bits)) << TICK_BITS));
+    }
+
+  // LEVEL_FAR the later far blocks
+  if (m_far != 0)
+    {
+      next = std::min (next, m_farMin & ~FAR_MASK);
+    }
+  return next;
+}
+
+void
+TcpTimerWheel::Advance (uint64_t tick)
+{
+  while (m_current < tick)
+    {
+      uint64_t next = NextOccupiedTick ();
+      if (next > tick)
+        {
+          m_current = tick;
+          return;
+        }
+      m_current = next;
+
+      // cascade the lists that start at this tick, then take its slot
+      if ((next & FAR_MASK) == 0)
+        {
+          TcpTimer *timer = TakeList (LEVEL_FAR, 0);
+          while (timer != 0)
+            {
+              TcpTimer *following = timer->m_next;
+              Place (timer);
+              timer = following;
+            }
+        }
+      if ((next & TICK_MASK) == 0)
+        {
+          TcpTimer *timer = TakeList (LEVEL_BLOCK, (next >> TICK_BITS) & ((1 << BLOCK_BITS) - 1));
+          while (timer != 0)
+            {
+              TcpTimer *following = timer->m_next;
+              Place (timer);
+              timer = following;
+            }
+        }
+      TcpTimer *timer = TakeList (LEVEL_TICK, next & TICK_MASK);
+      while (timer != 0)
+        {
+          TcpTimer *following = timer->m_next;
+          InsertDue (timer);
+          timer = following;
+        }
+    }
+}
+
+void
+TcpTimerWheel::WakeUpBy (const Time &time)
+{
+  // the current tick lags behind until the wheel runs: a list it has not
+  // reached yet may start in the past
+  Time wakeTime = std::max (time, Simulator::Now ());
+  if (m_event.IsRunning ())
+    {
+      if (m_wakeTime <= wakeTime)
+        {
+          return;
+        }
+      m_event.Cancel ();
+      m_schedulerCancels++;
+    }
+  m_wakeTime = wakeTime;
+  m_event = Simulator::Schedule (wakeTime - Simulator::Now (), &TcpTimerWheel::Run, this);
+  m_schedulerInserts++;
+}
+
+void
+TcpTimerWheel::Fire (TcpTimer *timer)
+{
+  m_expirations++;
+  timer->Expire ();
+}
+
+void
+TcpTimerWheel::Run (void)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  m_running = true;
+  m_wakeTime = Time::Max ();
+
+  Advance (TickOf (now));
+  while (m_due != 0 && m_due->m_deadline <= now)
+    {
+      TcpTimer *timer = m_due;
+      Unlink (timer);
+      Fire (timer);
+    }
+  m_running = false;
+
+  if (m_due != 0)
+    {
+      WakeUpBy (m_due->m_deadline);
+    }
+  else
+    {
+      uint64_t next = NextOccupiedTick ();
+      if (next != NO_TICK)
+        {
+          WakeUpBy (TickStart (next));
+        }
+    }
+}
+
+} // namespace ns3
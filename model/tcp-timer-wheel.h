@@ -0,0 +1,327 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCP_TIMER_WHEEL_H
+#define TCP_TIMER_WHEEL_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/event-impl.h"
+#include "ns3/make-event.h"
+
+namespace ns3 {
+
+class TcpTimerWheel;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief A TCP timer (retransmission, delayed ACK, persist, ...)
+ *
+ * Used like an EventId: Schedule replaces the pending expiration, if any,
+ * Cancel removes it. With a TcpTimerWheel set and enabled, re-arming and
+ * cancelling the timer do not touch the simulator scheduler; otherwise the
+ * timer schedules a simulator event per Schedule.
+ *
+ * The timer is not copyable; it is cancelled when destroyed.
+ */
+class TcpTimer
+{
+public:
+  TcpTimer ();
+  ~TcpTimer ();
+
+  /**
+   * \brief Set the timer wheel of the node
+   * \param wheel the wheel, or 0 to schedule simulator events directly
+   */
+  void SetWheel (Ptr<TcpTimerWheel> wheel);
+
+  /**
+   * \brief Schedule the timer to invoke a member function
+   *
+   * Any pending expiration is replaced.
+   *
+   * \param delay the delay
+   * \param memPtr the member function
+   * \param obj the object
+   * \param args the arguments
+   */
+  template <typename MEM, typename OBJ, typename... Ts>
+  void Schedule (const Time &delay, MEM memPtr, OBJ obj, Ts... args);
+
+  /**
+   * \brief Schedule the timer to invoke an event
+   * \param delay the delay
+   * \param function the event invoked on expiration
+   */
+  void Schedule (const Time &delay, const Ptr<EventImpl> &function);
+
+  /**
+   * \brief Cancel the pending expiration, if any
+   */
+  void Cancel (void);
+
+  /**
+   * \return true if an expiration is pending
+   */
+  bool IsRunning (void) const;
+
+  /**
+   * \return true if no expiration is pending
+   */
+  bool IsExpired (void) const;
+
+  /**
+   * \return the time left before the expiration, zero if none is pending
+   */
+  Time GetDelayLeft (void) const;
+
+private:
+  friend class TcpTimerWheel;
+
+  TcpTimer (const TcpTimer &);              //!< not copyable
+  TcpTimer & operator= (const TcpTimer &);  //!< not copyable
+
+  /**
+   * \brief Invoke the function of the timer
+   */
+  void Expire (void);
+
+  Ptr<TcpTimerWheel> m_wheel;   //!< Timer wheel, if any
+  Ptr<EventImpl> m_function;    //!< Event invoked on expiration
+  EventId m_event;              //!< Simulator event, when not on a wheel
+  Time m_deadline;              //!< Expiration time
+  bool m_running;               //!< Expiration pending
+
+  // Links of the wheel lists
+  TcpTimer *m_prev;             //!< Previous timer of the list
+  TcpTimer *m_next;             //!< Next timer of the list
+  uint8_t m_level;              //!< List of the timer (TcpTimerWheel::Level)
+  uint8_t m_slot;               //!< Slot of the timer in its level
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Per-node hierarchical timer wheel for the TCP timers
+ *
+ * TCP re-arms its retransmission timer on nearly every ACK and cancels its
+ * delayed ACK timer on nearly every second segment; as simulator events,
+ * each of these is an insertion or a cancellation in the global scheduler.
+ * On the wheel, arming and cancelling a TcpTimer only link and unlink it
+ * from a list, and the wheel keeps a single simulator event, at the next
+ * occupied tick.
+ *
+ * The wheel has 256 slots of one Tick, 64 slots of 256 ticks, and an
+ * overflow list for the timers further away. At a tick, the timers of the
+ * slot move to a list sorted by expiration time, from which they fire at
+ * their exact time: the wheel moves the simulator event to the first of
+ * them. The firing times are thus those of simulator events, whatever the
+ * tick; the tick only sets how often the wheel wakes up, and is best set to
+ * the ClockGranularity of the sockets, which the RTO is a multiple of.
+ *
+ * The wheel counts the timer operations and the scheduler operations they
+ * cost, with the wheel enabled or not, so that runs with and without it can
+ * be compared. TcpL4Protocol holds one wheel per node.
+ */
+class TcpTimerWheel : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpTimerWheel ();
+  virtual ~TcpTimerWheel ();
+
+  /**
+   * \return true if the timers are kept on the wheel
+   */
+  bool IsEnabled (void) const;
+
+  /**
+   * \return the number of TcpTimer::Schedule calls
+   */
+  uint64_t GetTimerArms (void) const;
+
+  /**
+   * \return the number of TcpTimer::Cancel calls on a running timer
+   */
+  uint64_t GetTimerCancels (void) const;
+
+  /**
+   * \return the number of timers that expired
+   */
+  uint64_t GetTimerExpirations (void) const;
+
+  /**
+   * \return the number of simulator events scheduled for the timers
+   */
+  uint64_t GetSchedulerInserts (void) const;
+
+  /**
+   * \return the number of simulator events cancelled for the timers
+   */
+  uint64_t GetSchedulerCancels (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  friend class TcpTimer;
+
+  /// Lists of the timers
+  enum Level
+  {
+    LEVEL_TICK = 0,  //!< One slot per tick
+    LEVEL_BLOCK = 1, //!< One slot per 256 ticks
+    LEVEL_FAR = 2,   //!< Beyond the 16384 ticks of LEVEL_BLOCK
+    LEVEL_DUE = 3,   //!< Current tick, sorted by expiration time
+    LEVEL_NONE = 4   //!< Not on the wheel
+  };
+
+  /**
+   * \brief Arm a timer, replacing its pending expiration
+   * \param timer the timer
+   * \param delay the delay
+   */
+  void Arm (TcpTimer *timer, const Time &delay);
+
+  /**
+   * \brief Cancel the pending expiration of a timer
+   * \param timer the timer
+   */
+  void Disarm (TcpTimer *timer);
+
+  /**
+   * \brief Remove a timer from its list or cancel its simulator event
+   * \param timer the timer
+   */
+  void Remove (TcpTimer *timer);
+
+  /**
+   * \brief Put a timer in the list of its expiration time
+   * \param timer the timer
+   * \return the time the wheel must wake up at for this timer
+   */
+  Time Place (TcpTimer *timer);
+
+  /**
+   * \brief Link a timer at the head of a list
+   * \param timer the timer
+   * \param level the level
+   * \param slot the slot in the level
+   */
+  void Link (TcpTimer *timer, Level level, uint8_t slot);
+
+  /**
+   * \brief Unlink a timer from its list
+   * \param timer the timer
+   */
+  void Unlink (TcpTimer *timer);
+
+  /**
+   * \brief Insert a timer in the due list, after those expiring no later
+   * \param timer the timer
+   */
+  void InsertDue (TcpTimer *timer);
+
+  /**
+   * \brief Detach a list
+   * \param level the level
+   * \param slot the slot in the level
+   * \return the first timer of the list, whose timers are no longer linked
+   */
+  TcpTimer* TakeList (Level level, uint8_t slot);
+
+  /**
+   * \brief Move the current tick forward, processing the occupied ticks
+   * \param tick the new current tick
+   */
+  void Advance (uint64_t tick);
+
+  /**
+   * \return the first occupied tick after the current one, or UINT64_MAX
+   */
+  uint64_t NextOccupiedTick (void) const;
+
+  /**
+   * \brief Make sure the simulator event fires no later than a time
+   * \param time the time
+   */
+  void WakeUpBy (const Time &time);
+
+  /**
+   * \brief Simulator event: process the ticks and fire the due timers
+   */
+  void Run (void);
+
+  /**
+   * \brief Expire a timer
+   * \param timer the timer, no longer on the wheel
+   */
+  void Fire (TcpTimer *timer);
+
+  /**
+   * \param time a time
+   * \return the tick of the time
+   */
+  uint64_t TickOf (const Time &time) const;
+
+  /**
+   * \param tick a tick
+   * \return the start time of the tick
+   */
+  Time TickStart (uint64_t tick) const;
+
+  bool m_enabled;                  //!< Keep the timers on the wheel
+  Time m_tick;                     //!< Tick duration
+
+  uint64_t m_current;              //!< Current tick, processed
+  TcpTimer *m_tickSlots[256];      //!< Slots of one tick
+  uint64_t m_tickBits[4];          //!< Occupied LEVEL_TICK slots
+  TcpTimer *m_blockSlots[64];      //!< Slots of 256 ticks
+  uint64_t m_blockBits;            //!< Occupied LEVEL_BLOCK slots
+  TcpTimer *m_far;                 //!< Timers beyond LEVEL_BLOCK
+  uint64_t m_farMin;               //!< Lower bound of the overflow ticks
+  TcpTimer *m_due;                 //!< Timers of the current tick, by expiration time
+
+  EventId m_event;                 //!< Simulator event of the wheel
+  Time m_wakeTime;                 //!< Time of m_event
+  bool m_running;                  //!< Inside Run
+
+  uint64_t m_arms;                 //!< TcpTimer::Schedule calls
+  uint64_t m_cancels;              //!< TcpTimer::Cancel calls on running timers
+  uint64_t m_expirations;          //!< Timers expired
+  uint64_t m_schedulerInserts;     //!< Simulator events scheduled
+  uint64_t m_schedulerCancels;     //!< Simulator events cancelled
+};
+
+template <typename MEM, typename OBJ, typename... Ts>
+void
+TcpTimer::Schedule (const Time &delay, MEM memPtr, OBJ obj, Ts... args)
+{
+  Schedule (delay, Ptr<EventImpl> (MakeEvent (memPtr, obj, args...), false));
+}
+
+} // namespace ns3
+
+#endif /* TCP_TIMER_WHEEL_H */
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "tcp-timestamp-tag.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpTimestampTag");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpTimestampTag);
+
+TcpTimestampTag::TcpTimestampTag ()
+  : m_timestamp (0),
+    m_echo (0),
+    m_hasEcho (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+TcpTimestampTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpTimestampTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpTimestampTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpTimestampTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpTimestampTag::GetSerializedSize (void) const
+{
+  return 8 + 8 + 1;
+}
+
+void
+TcpTimestampTag::Serialize (TagBuffer i) const
+{
+  NS_LOG_FUNCTION (this << &i);
+  i.WriteU64 (static_cast<uint64_t> (m_timestamp));
+  i.WriteU64 (static_cast<uint64_t> (m_echo));
+  i.WriteU8 (m_hasEcho ? 1 : 0);
+}
+
+void
+TcpTimestampTag::Deserialize (TagBuffer i)
+{
+  NS_LOG_FUNCTION (this << &i);
+  m_timestamp = static_cast<int64_t> (i.ReadU64 ());
+  m_echo = static_cast<int64_t> (i.ReadU64 ());
+  m_hasEcho = (i.ReadU8 () != 0);
+}
+
+void
+TcpTimestampTag::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "TcpTimestampTag [ts: " << GetTimestamp ();
+  if (m_hasEcho)
+    {
+      os << ", echo: " << GetEcho ();
+    }
+  os << "] ";
+}
+
+void
+TcpTimestampTag::SetTimestamp (Time ts)
+{
+  m_timestamp = ts.GetTimeStep ();
+}
+
+Time
+TcpTimestampTag::GetTimestamp (void) const
+{
+  return TimeStep (m_timestamp);
+}
+
+void
+TcpTimestampTag::SetEcho (Time echo)
+{
+  m_echo = echo.GetTimeStep ();
+  m_hasEcho = true;
+}
+
+Time
+TcpTimestampTag::GetEcho (void) const
+{
+  return TimeStep (m_echo);
+}
+
+bool
+TcpTimestampTag::HasEcho (void) const
+{
+  return m_hasEcho;
+}
+
+} // namespace ns3
@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCP_TIMESTAMP_TAG_H
+#define TCP_TIMESTAMP_TAG_H
+
+#include "ns3/tag.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Full resolution send timestamp carried beside a TCP segment
+ *
+ * Models NIC hardware timestamping: the sender stamps each segment with
+ * the simulator time, the receiver echoes the stamp of the segment it is
+ * acknowledging (with the same rules as RFC 7323 TSecr), and the sender
+ * computes the RTT as a Time without the millisecond rounding of
+ * TcpOptionTS. Being a packet tag, it takes no space on the wire.
+ *
+ * \see TcpSocketBase::ProcessTimestampTag
+ */
+class TcpTimestampTag : public Tag
+{
+public:
+  TcpTimestampTag ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * \brief Set the send time of the segment
+   * \param ts the send time
+   */
+  void SetTimestamp (Time ts);
+
+  /**
+   * \brief Get the send time of the segment
+   * \return the send time
+   */
+  Time GetTimestamp (void) const;
+
+  /**
+   * \brief Set the echoed send time of a segment received from the peer
+   * \param echo the echoed time
+   */
+  void SetEcho (Time echo);
+
+  /**
+   * \brief Get the echoed send time
+   * \return the echoed time; only meaningful if HasEcho () is true
+   */
+  Time GetEcho (void) const;
+
+  /**
+   * \brief Check if the tag carries an echo
+   * \return true if SetEcho has been called
+   */
+  bool HasEcho (void) const;
+
+private:
+  int64_t m_timestamp; //!< Send time, in simulator time steps
+  int64_t m_echo;      //!< Echoed send time, in simulator time steps
+  bool    m_hasEcho;   //!< True if m_echo is valid
+};
+
+} // namespace ns3
+
+#endif /* TCP_TIMESTAMP_TAG_H */
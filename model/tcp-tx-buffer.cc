@@ -24,6 +24,7 @@
 
 #include "ns3/packet.h"
 #include "ns3/log.h"
+#include "ns3/boolean.h"
 #include "ns3/abort.h"
 #include "ns3/tcp-option-ts.h"
 
@@ -46,6 +47,20 @@ TcpTxBuffer::GetTypeId (void)
                      "First unacknowledged sequence number (SND.UNA)",
                      MakeTraceSourceAccessor (&TcpTxBuffer::m_firstByteSeq),
                      "ns3::SequenceNumber32TracedValueCallback")
+    .AddAttribute ("SegmentAligned",
+                   "Cut the application data into segments when it is added, "
+                   "so that transmissions and retransmissions do not split "
+                   "and merge packets",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpTxBuffer::m_segmentAligned),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ConsistencyCheck",
+                   "Check the scoreboard counters, index and bounds against "
+                   "the sent list after each change, and abort on a mismatch. "
+                   "It walks the whole sent list, so it is for debugging only",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpTxBuffer::m_consistencyCheck),
+                   MakeBooleanChecker ())
   ;
   return tid;
 }
@@ -58,9 +73,11 @@ TcpTxBuffer::GetTypeId (void)
  * initialized below is insignificant.
  */
 TcpTxBuffer::TcpTxBuffer (uint32_t n)
-  : m_maxBuffer (32768), m_size (0), m_sentSize (0), m_firstByteSeq (n)
+  : m_maxBuffer (32768), m_size (0), m_sentSize (0), m_firstByteSeq (n),
+    m_lostHigh (n), m_nextSegHigh (n)
 {
   m_rWndCallback = MakeNullCallback<uint32_t> ();
+  m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
 }
 
 TcpTxBuffer::~TcpTxBuffer (void)
@@ -174,6 +191,7 @@ TcpTxBuffer::SetHeadSequence (const SequenceNumber32& seq)
   // if you change the head with data already sent, something bad will happen
   NS_ASSERT (m_sentList.size () == 0);
   m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+  ResetScoreboardBounds ();
 }
 
 bool
@@ -184,7 +202,31 @@ TcpTxBuffer::Add (Ptr<Packet> p)
                                 << m_firstByteSeq << ", availSize=" << Available ());
   if (p->GetSize () <= Available ())
     {
-      if (p->GetSize () > 0)
+      if (p->GetSize () > 0 && m_segmentAligned && m_segmentSize > 0)
+        {
+          uint32_t offset = 0;
+          // Fill up the last item; it is not sent yet, so nobody else sees it
+          if (!m_appList.empty () && m_appList.back ()->m_packet->GetSize () < m_segmentSize)
+            {
+              offset = std::min (m_segmentSize - m_appList.back ()->m_packet->GetSize (),
+                                 p->GetSize ());
+              m_appList.back ()->m_packet->AddAtEnd (p->CreateFragment (0, offset));
+              m_appList.back ()->m_hasPayloadSum = false;
+            }
+          while (offset < p->GetSize ())
+            {
+              uint32_t length = std::min (m_segmentSize, p->GetSize () - offset);
+              TcpTxItem *item = new TcpTxItem ();
+              item->m_packet = p->CreateFragment (offset, length);
+              m_appList.insert (m_appList.end (), item);
+              offset += length;
+            }
+          m_size += p->GetSize ();
+
+          NS_LOG_LOGIC ("Updated size=" << m_size << ", lastSeq=" <<
+                        m_firstByteSeq + SequenceNumber32 (m_size));
+        }
+      else if (p->GetSize () > 0)
         {
           TcpTxItem *item = new TcpTxItem ();
           item->m_packet = p->Copy ();
@@ -287,6 +329,11 @@ TcpTxBuffer::GetNewSegment (uint32_t numBytes)
   NS_LOG_INFO ("AppList start at " << startOfAppList << ", sentSize = " <<
                m_sentSize << " firstByte: " << m_firstByteSeq);
 
+  if (m_segmentAligned)
+    {
+      numBytes = std::min (numBytes, m_appList.front ()->m_packet->GetSize ());
+    }
+
   TcpTxItem *item = GetPacketFromList (m_appList, startOfAppList,
                                        numBytes, startOfAppList);
   item->m_startSeq = startOfAppList;
@@ -296,7 +343,7 @@ TcpTxBuffer::GetNewSegment (uint32_t numBytes)
   NS_ASSERT (it != m_appList.end ());
 
   m_appList.erase (it);
-  m_sentList.insert (m_sentList.end (), item);
+  m_sentIndex[item->m_startSeq] = m_sentList.insert (m_sentList.end (), item);
   m_sentSize += item->m_packet->GetSize ();
 
   return item;
@@ -310,40 +357,60 @@ TcpTxBuffer::GetTransmittedSegment (uint32_t numBytes, const SequenceNumber32 &s
   NS_ASSERT (numBytes <= m_sentSize);
   NS_ASSERT (m_sentList.size () >= 1);
 
-  auto it = m_sentList.begin ();
+  PacketList::iterator it = FindSentItem (seq);
   bool listEdited = false;
   uint32_t s = numBytes;
 
   // Avoid to merge different packet for this retransmission if flags are
   // different.
-  for (; it != m_sentList.end(); ++it)
+  if ((*it)->m_startSeq == seq && m_segmentAligned)
+    {
+      s = std::min (s, (*it)->m_packet->GetSize ());
+    }
+  else if ((*it)->m_startSeq == seq)
     {
-      if ((*it)->m_startSeq == seq)
+      auto next = it;
+      next++;
+      if (next != m_sentList.end ())
         {
-          auto next = it;
-          next++;
-          if (next != m_sentList.end ())
+          // Next is not sacked and have the same value for m_lost ... there is the possibility to merge
+          if ((! (*next)->m_sacked) && ((*it)->m_lost == (*next)->m_lost))
             {
-              // Next is not sacked and have the same value for m_lost ... there is the possibility to merge
-              if ((! (*next)->m_sacked) && ((*it)->m_lost == (*next)->m_lost))
-                {
-                  s = std::min(s, (*it)->m_packet->GetSize () + (*next)->m_packet->GetSize ());
-                }
-              else
-                {
-                  // Next is sacked... better to retransmit only the first segment
-                  s = std::min(s, (*it)->m_packet->GetSize ());
-                }
+              s = std::min(s, (*it)->m_packet->GetSize () + (*next)->m_packet->GetSize ());
             }
           else
             {
+              // Next is sacked... better to retransmit only the first segment
               s = std::min(s, (*it)->m_packet->GetSize ());
             }
-          break;
+        }
+      else
+        {
+          s = std::min(s, (*it)->m_packet->GetSize ());
         }
     }
 
-  TcpTxItem *item = GetPacketFromList (m_sentList, m_firstByteSeq, s, seq, &listEdited);
+  // Items before the one containing seq are not touched
+  PacketList::iterator previous = it;
+  bool isHead = (it == m_sentList.begin ());
+  if (!isHead)
+    {
+      --previous;
+    }
+
+  SequenceNumber32 startOfIt = (*it)->m_startSeq;
+  TcpTxItem *item = GetPacketFromList (m_sentList, it, startOfIt, s, seq, &listEdited);
+
+  if (listEdited)
+    {
+      ReindexSentItems (isHead ? m_sentList.begin () : ++previous, seq + s);
+
+      // Merging may have cleared the retransmitted flag of an item after seq
+      if (seq < m_nextSegHigh)
+        {
+          m_nextSegHigh = seq;
+        }
+    }
 
   if (! item->m_retrans)
     {
@@ -359,21 +426,101 @@ TcpTxBuffer::FindHighestSacked () const
 {
   NS_LOG_FUNCTION (this);
 
-  SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
+  if (m_sackedRanges.empty ())
+    {
+      return std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+    }
 
-  auto ret = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+  PacketList::const_iterator it = FindSentItem (m_sackedRanges.rbegin ()->second - 1);
+  return std::make_pair (it, (*it)->m_startSeq);
+}
 
-  for (auto it = m_sentList.begin (); it != m_sentList.end (); ++it)
+TcpTxBuffer::PacketList::iterator
+TcpTxBuffer::FindSentItem (const SequenceNumber32 &seq) const
+{
+  NS_LOG_FUNCTION (this << seq);
+  SentIndex::const_iterator index_it = m_sentIndex.upper_bound (seq);
+  NS_ASSERT_MSG (index_it != m_sentIndex.begin (), "Seq " << seq << " is before the sent list");
+  --index_it;
+  NS_ASSERT (index_it->first + (*index_it->second)->m_packet->GetSize () > seq);
+  return index_it->second;
+}
+
+void
+TcpTxBuffer::ReindexSentItems (PacketList::iterator first, const SequenceNumber32 &end)
+{
+  NS_LOG_FUNCTION (this << end);
+  SequenceNumber32 start = (*first)->m_startSeq;
+  m_sentIndex.erase (m_sentIndex.lower_bound (start), m_sentIndex.lower_bound (end));
+
+  // The item after the edited ones may start at end, after a split
+  for (PacketList::iterator it = first; it != m_sentList.end (); ++it)
     {
-      const TcpTxItem *item = *it;
-      if (item->m_sacked)
+      m_sentIndex[(*it)->m_startSeq] = it;
+      if ((*it)->m_startSeq >= end)
+        {
+          break;
+        }
+    }
+}
+
+void
+TcpTxBuffer::AddSackedRange (const TcpTxItem *item)
+{
+  SequenceNumber32 start = item->m_startSeq;
+  SequenceNumber32 end = start + item->m_packet->GetSize ();
+
+  // Merge with the ranges just before and after
+  SackedRanges::iterator next = m_sackedRanges.lower_bound (start);
+  if (next != m_sackedRanges.end () && next->first == end)
+    {
+      end = next->second;
+      next = m_sackedRanges.erase (next);
+    }
+  if (next != m_sackedRanges.begin ())
+    {
+      SackedRanges::iterator previous = std::prev (next);
+      NS_ASSERT (previous->second <= start);
+      if (previous->second == start)
         {
-          ret = std::make_pair (it, beginOfCurrentPacket);
+          previous->second = end;
+          return;
         }
-      beginOfCurrentPacket += item->m_packet->GetSize ();
     }
+  m_sackedRanges.insert (next, std::make_pair (start, end));
+}
+
+void
+TcpTxBuffer::RemoveSackedRange (const TcpTxItem *item)
+{
+  SequenceNumber32 start = item->m_startSeq;
+  SequenceNumber32 end = start + item->m_packet->GetSize ();
+
+  SackedRanges::iterator range = m_sackedRanges.upper_bound (start);
+  NS_ASSERT (range != m_sackedRanges.begin ());
+  --range;
+  NS_ASSERT (range->first <= start && range->second >= end);
 
-  return ret;
+  SequenceNumber32 rangeEnd = range->second;
+  if (range->first == start)
+    {
+      m_sackedRanges.erase (range);
+    }
+  else
+    {
+      range->second = start;
+    }
+  if (rangeEnd > end)
+    {
+      m_sackedRanges[end] = rangeEnd;
+    }
+}
+
+void
+TcpTxBuffer::ResetScoreboardBounds ()
+{
+  m_lostHigh = m_firstByteSeq;
+  m_nextSegHigh = m_firstByteSeq;
 }
 
 
@@ -385,6 +532,8 @@ TcpTxBuffer::SplitItems (TcpTxItem *t1, TcpTxItem *t2, uint32_t size) const
 
   t1->m_packet = t2->m_packet->CreateFragment (0, size);
   t2->m_packet->RemoveAtStart (size);
+  t1->m_hasPayloadSum = false;
+  t2->m_hasPayloadSum = false;
 
   t1->m_startSeq = t2->m_startSeq;
   t1->m_sacked = t2->m_sacked;
@@ -401,6 +550,15 @@ TcpTxItem*
 TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listStartFrom,
                                 uint32_t numBytes, const SequenceNumber32 &seq,
                                 bool *listEdited) const
+{
+  return GetPacketFromList (list, list.begin (), listStartFrom, numBytes, seq, listEdited);
+}
+
+TcpTxItem*
+TcpTxBuffer::GetPacketFromList (PacketList &list, PacketList::iterator it,
+                                const SequenceNumber32 &startOfIt,
+                                uint32_t numBytes, const SequenceNumber32 &seq,
+                                bool *listEdited) const
 {
   NS_LOG_FUNCTION (this << numBytes << seq);
 
@@ -434,14 +592,13 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
   Ptr<Packet> currentPacket = nullptr;
   TcpTxItem *currentItem = nullptr;
   TcpTxItem *outItem = nullptr;
-  PacketList::iterator it = list.begin ();
-  SequenceNumber32 beginOfCurrentPacket = listStartFrom;
+  SequenceNumber32 beginOfCurrentPacket = startOfIt;
 
   while (it != list.end ())
     {
       currentItem = *it;
       currentPacket = currentItem->m_packet;
-      NS_ASSERT_MSG (list != m_sentList || currentItem->m_startSeq >= m_firstByteSeq,
+      NS_ASSERT_MSG (&list != &m_sentList || currentItem->m_startSeq >= m_firstByteSeq,
                      "start: " << m_firstByteSeq << " currentItem start: " <<
                      currentItem->m_startSeq);
 
@@ -477,7 +634,7 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
                   *listEdited = true;
                 }
 
-              return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
+              return GetPacketFromList (list, it, seq, numBytes, seq, listEdited);
             }
           else
             {
@@ -515,9 +672,11 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
                   // current > outPacket in the list. Merge current with the
                   // previous, and recurse.
                   NS_ASSERT (it != list.begin ());
+                  PacketList::iterator current = it;
                   TcpTxItem *previous = *(--it);
+                  SequenceNumber32 beginOfPrevious = beginOfCurrentPacket - previous->m_packet->GetSize ();
 
-                  list.erase (it);
+                  list.erase (current);
 
                   MergeItems (previous, currentItem);
                   delete currentItem;
@@ -526,7 +685,7 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
                       *listEdited = true;
                     }
 
-                  return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
+                  return GetPacketFromList (list, it, beginOfPrevious, numBytes, seq, listEdited);
                 }
             }
           else if (numBytes < currentPacket->GetSize ())
@@ -566,7 +725,7 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
                                    // in the previous if
 
           MergeItems (currentItem, next);
-          list.erase (it);
+          it = list.erase (it);
 
           delete next;
 
@@ -575,7 +734,7 @@ TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listSt
               *listEdited = true;
             }
 
-          return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
+          return GetPacketFromList (list, --it, seq, numBytes, seq, listEdited);
         }
     }
 
@@ -625,6 +784,7 @@ TcpTxBuffer::MergeItems (TcpTxItem *t1, TcpTxItem *t2) const
     }
 
   t1->m_packet->AddAtEnd (t2->m_packet);
+  t1->m_hasPayloadSum = false;
 
   NS_LOG_INFO ("Situation after the merge: " << *t1);
 }
@@ -655,16 +815,16 @@ bool
 TcpTxBuffer::IsRetransmittedDataAcked (const SequenceNumber32& ack) const
 {
   NS_LOG_FUNCTION (this);
-  for (const auto &it : m_sentList)
-     {
-       TcpTxItem *item = it;
-       Ptr<Packet> p = item->m_packet;
-       if (item->m_startSeq + p->GetSize () == ack && !item->m_sacked && item->m_retrans)
-         {
-           return true;
-         }
-     }
-  return false;
+  // The only item that can end at ack is the one before it
+  SentIndex::const_iterator index_it = m_sentIndex.lower_bound (ack);
+  if (index_it == m_sentIndex.begin ())
+    {
+      return false;
+    }
+  --index_it;
+  TcpTxItem *item = *index_it->second;
+  Ptr<Packet> p = item->m_packet;
+  return item->m_startSeq + p->GetSize () == ack && !item->m_sacked && item->m_retrans;
 }
 
 void
@@ -713,6 +873,8 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq,
 
           RemoveFromCounts (item, pktSize);
 
+          NS_ASSERT (m_sentIndex.begin ()->second == i);
+          m_sentIndex.erase (m_sentIndex.begin ());
           i = m_sentList.erase (i);
           NS_LOG_INFO ("Removed " << *item << " lost: " << m_lostOut <<
                        " retrans: " << m_retrans << " sacked: " << m_sackedOut <<
@@ -732,7 +894,10 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq,
           NS_LOG_INFO (*item);
           // PacketTags are preserved when fragmenting
           item->m_packet = item->m_packet->CreateFragment (offset, pktSize);
+          item->m_hasPayloadSum = false;
+          m_sentIndex.erase (m_sentIndex.begin ());
           item->m_startSeq += offset;
+          m_sentIndex[item->m_startSeq] = i;
           m_size -= offset;
           m_sentSize -= offset;
           m_firstByteSeq += offset;
@@ -751,6 +916,28 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq,
       m_firstByteSeq = seq;
     }
 
+  // Forget the sacked bytes that have been acked, and move the boundaries
+  // that have been passed by SND.UNA
+  while (!m_sackedRanges.empty ()
+         && m_sackedRanges.begin ()->second <= m_firstByteSeq)
+    {
+      m_sackedRanges.erase (m_sackedRanges.begin ());
+    }
+  if (!m_sackedRanges.empty () && m_sackedRanges.begin ()->first < m_firstByteSeq)
+    {
+      SequenceNumber32 end = m_sackedRanges.begin ()->second;
+      m_sackedRanges.erase (m_sackedRanges.begin ());
+      m_sackedRanges[m_firstByteSeq] = end;
+    }
+  if (m_lostHigh < m_firstByteSeq)
+    {
+      m_lostHigh = m_firstByteSeq;
+    }
+  if (m_nextSegHigh < m_firstByteSeq)
+    {
+      m_nextSegHigh = m_firstByteSeq;
+    }
+
   if (!m_sentList.empty ())
     {
       TcpTxItem *head = m_sentList.front ();
@@ -762,9 +949,10 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq,
           // when adding Reno dupacks in the count.
           head->m_sacked = false;
           m_sackedOut -= head->m_packet->GetSize ();
+          RemoveSackedRange (head);
           NS_LOG_INFO ("Moving the SACK flag from the HEAD to another segment");
-          AddRenoSack ();
           MarkHeadAsLost ();
+          AddRenoSack ();
         }
 
       NS_ASSERT_MSG (head->m_startSeq == seq,
@@ -796,17 +984,19 @@ TcpTxBuffer::Update (const TcpOptionSack::SackList &list,
 
   for (auto option_it = list.begin (); option_it != list.end (); ++option_it)
     {
-      PacketList::iterator item_it = m_sentList.begin ();
-      SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-
       if (m_firstByteSeq + m_sentSize < (*option_it).first)
         {
           NS_LOG_INFO ("Not updating scoreboard, the option block is outside the sent list");
           return bytesSacked;
         }
 
-      while (item_it != m_sentList.end ())
+      // First item starting inside the block
+      SentIndex::const_iterator index_it = m_sentIndex.lower_bound (std::max ((*option_it).first, m_firstByteSeq.Get ()));
+
+      while (index_it != m_sentIndex.end ())
         {
+          PacketList::iterator item_it = index_it->second;
+          SequenceNumber32 beginOfCurrentPacket = index_it->first;
           uint32_t pktSize = (*item_it)->m_packet->GetSize ();
 
           // Check the boundary of this packet ... only mark as sacked if
@@ -814,56 +1004,58 @@ TcpTxBuffer::Update (const TcpOptionSack::SackList &list,
           // is reporting as sacked single range bytes that are not mapped 1:1
           // in what we have, the option is discarded. There's room for improvement
           // here.
-          if (beginOfCurrentPacket >= (*option_it).first
-              && beginOfCurrentPacket + pktSize <= (*option_it).second)
+          if (beginOfCurrentPacket + pktSize > (*option_it).second)
             {
-              if ((*item_it)->m_sacked)
-                {
-                  NS_ASSERT (!(*item_it)->m_lost);
-                  NS_LOG_INFO ("Received block " << *option_it <<
-                               ", checking sentList for block " << *(*item_it) <<
-                               ", found in the sackboard already sacked");
-                }
-              else
-                {
-                  if ((*item_it)->m_lost)
-                    {
-                      (*item_it)->m_lost = false;
-                      m_lostOut -= (*item_it)->m_packet->GetSize ();
-                    }
+              // We already passed the received block end. Exit from the loop
+              NS_LOG_INFO ("Received block [" << *option_it <<
+                           ", checking sentList for block " << *(*item_it) <<
+                           "], not found, breaking loop");
+              break;
+            }
 
-                  (*item_it)->m_sacked = true;
-                  m_sackedOut += (*item_it)->m_packet->GetSize ();
-                  bytesSacked += (*item_it)->m_packet->GetSize ();
+          if ((*item_it)->m_sacked)
+            {
+              NS_ASSERT (!(*item_it)->m_lost);
+              NS_LOG_INFO ("Received block " << *option_it <<
+                           ", checking sentList for block " << *(*item_it) <<
+                           ", found in the sackboard already sacked");
+
+              // Skip the items sacked together with this one
+              SackedRanges::const_iterator range = m_sackedRanges.upper_bound (beginOfCurrentPacket);
+              NS_ASSERT (range != m_sackedRanges.begin ());
+              --range;
+              index_it = m_sentIndex.lower_bound (range->second);
+              continue;
+            }
 
-                  if (m_highestSack.first == m_sentList.end()
-                      || m_highestSack.second <= beginOfCurrentPacket + pktSize)
-                    {
-                      m_highestSack = std::make_pair (item_it, beginOfCurrentPacket);
-                    }
+          if ((*item_it)->m_lost)
+            {
+              (*item_it)->m_lost = false;
+              m_lostOut -= (*item_it)->m_packet->GetSize ();
+            }
 
-                  NS_LOG_INFO ("Received block " << *option_it <<
-                               ", checking sentList for block " << *(*item_it) <<
-                               ", found in the sackboard, sacking, current highSack: " <<
-                               m_highestSack.second);
+          (*item_it)->m_sacked = true;
+          m_sackedOut += (*item_it)->m_packet->GetSize ();
+          bytesSacked += (*item_it)->m_packet->GetSize ();
+          AddSackedRange (*item_it);
 
-                  if (!sackedCb.IsNull ())
-                    {
-                      sackedCb (*item_it);
-                    }
-                }
+          if (m_highestSack.first == m_sentList.end()
+              || m_highestSack.second <= beginOfCurrentPacket + pktSize)
+            {
+              m_highestSack = std::make_pair (item_it, beginOfCurrentPacket);
             }
-          else if (beginOfCurrentPacket + pktSize > (*option_it).second)
+
+          NS_LOG_INFO ("Received block " << *option_it <<
+                       ", checking sentList for block " << *(*item_it) <<
+                       ", found in the sackboard, sacking, current highSack: " <<
+                       m_highestSack.second);
+
+          if (!sackedCb.IsNull ())
             {
-              // We already passed the received block end. Exit from the loop
-              NS_LOG_INFO ("Received block [" << *option_it <<
-                           ", checking sentList for block " << *(*item_it) <<
-                           "], not found, breaking loop");
-              break;
+              sackedCb (*item_it);
             }
 
-          beginOfCurrentPacket += pktSize;
-          ++item_it;
+          ++index_it;
         }
     }
 
@@ -886,7 +1078,6 @@ TcpTxBuffer::UpdateLostCount ()
 {
   NS_LOG_FUNCTION (this);
   uint32_t sacked = 0;
-  SequenceNumber32 beginOfCurrentPacket = m_highestSack.second;
   if (m_highestSack.first == m_sentList.end ())
     {
       NS_LOG_INFO ("Status before the update: " << *this <<
@@ -898,33 +1089,49 @@ TcpTxBuffer::UpdateLostCount ()
                    ", will start from item " << *(*m_highestSack.first));
     }
 
-  for (auto it = m_highestSack.first; it != m_sentList.begin(); --it)
+  // Walk down the sacked items, jumping over the holes between the sacked
+  // ranges, until m_dupAckThresh of them are found. The head is not counted.
+  PacketList::const_iterator it = m_highestSack.first;
+  SequenceNumber32 lostUpTo = m_highestSack.second;
+  bool isLost = sacked >= m_dupAckThresh;
+  while (!isLost && it != m_sentList.begin ())
     {
       TcpTxItem *item = *it;
       if (item->m_sacked)
         {
-          sacked++;
+          if (++sacked >= m_dupAckThresh)
+            {
+              isLost = true;
+              lostUpTo = item->m_startSeq;
+            }
+          --it;
+          continue;
         }
 
-      if (sacked >= m_dupAckThresh)
+      SackedRanges::const_iterator range = m_sackedRanges.lower_bound (item->m_startSeq);
+      if (range == m_sackedRanges.begin ())
         {
-          if (!item->m_sacked && !item->m_lost)
-            {
-              item->m_lost = true;
-              m_lostOut += item->m_packet->GetSize ();
-            }
+          break;
         }
-      beginOfCurrentPacket -= item->m_packet->GetSize ();
+      --range;
+      it = FindSentItem (range->second - 1);
     }
 
-  if (sacked >= m_dupAckThresh)
+  // Every item before lostUpTo and not sacked is lost; the ones before
+  // m_lostHigh have already been marked
+  if (isLost && m_lostHigh < lostUpTo)
     {
-      TcpTxItem *item = *m_sentList.begin ();
-      if (!item->m_lost)
+      for (auto index_it = m_sentIndex.lower_bound (m_lostHigh);
+           index_it != m_sentIndex.end () && index_it->first < lostUpTo; ++index_it)
         {
-          item->m_lost = true;
-          m_lostOut += item->m_packet->GetSize ();
+          TcpTxItem *item = *index_it->second;
+          if (!item->m_sacked && !item->m_lost)
+            {
+              item->m_lost = true;
+              m_lostOut += item->m_packet->GetSize ();
+            }
         }
+      m_lostHigh = lostUpTo;
     }
   NS_LOG_INFO ("Status after the update: " << *this);
   ConsistencyCheck ();
@@ -935,37 +1142,26 @@ TcpTxBuffer::IsLost (const SequenceNumber32 &seq) const
 {
   NS_LOG_FUNCTION (this << seq);
 
-  SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-  PacketList::const_iterator it;
-
-  if (seq >= m_highestSack.second)
+  if (m_highestSack.first == m_sentList.end () || seq >= m_highestSack.second)
     {
       return false;
     }
 
-  // In theory, using a map and hints when inserting elements can improve
-  // performance
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  // The first item at or after seq is lost or sacked if it starts before
+  // m_lostHigh. After m_lostHigh, no item is lost.
+  SentIndex::const_iterator index_it = m_sentIndex.lower_bound (seq);
+  if (index_it == m_sentIndex.end ())
     {
-      // Search for the right iterator before calling IsLost()
-      if (beginOfCurrentPacket >= seq)
-        {
-          if ((*it)->m_lost == true)
-            {
-              NS_LOG_INFO ("seq=" << seq << " is lost because of lost flag");
-              return true;
-            }
-
-          if ((*it)->m_sacked == true)
-            {
-              NS_LOG_INFO ("seq=" << seq << " is not lost because of sacked flag");
-              return false;
-            }
-        }
+      return false;
+    }
 
-      beginOfCurrentPacket += (*it)->m_packet->GetSize ();
+  if ((*index_it->second)->m_lost)
+    {
+      NS_LOG_INFO ("seq=" << seq << " is lost because of lost flag");
+      return true;
     }
 
+  NS_LOG_INFO ("seq=" << seq << " is not lost because of sacked flag, or no lost segment follows");
   return false;
 }
 
@@ -986,37 +1182,49 @@ TcpTxBuffer::NextSeg (SequenceNumber32 *seq, SequenceNumber32 *seqHigh, bool isR
    *           received SACK.
    *
    *     (1.c) IsLost (S2) returns true.
+   *
+   * Apart from the head, which is checked first, the items before
+   * m_nextSegHigh are sacked or retransmitted. The first item that is
+   * neither is S2 if it is lost, since no item is lost after a not lost and
+   * not sacked one; otherwise, it is S3.
    */
-  PacketList::const_iterator it;
-  TcpTxItem *item;
+  SentIndex::const_iterator index_it = m_sentIndex.begin ();
+  if (index_it != m_sentIndex.end ()
+      && ((*index_it->second)->m_retrans || (*index_it->second)->m_sacked))
+    {
+      index_it = m_sentIndex.lower_bound (m_nextSegHigh);
+      if (index_it == m_sentIndex.begin ())
+        {
+          ++index_it;
+        }
+      while (index_it != m_sentIndex.end ()
+             && ((*index_it->second)->m_retrans || (*index_it->second)->m_sacked))
+        {
+          ++index_it;
+        }
+      m_nextSegHigh = index_it == m_sentIndex.end () ? m_firstByteSeq + m_sentSize
+                                                     : index_it->first;
+    }
+
   SequenceNumber32 seqPerRule3;
   bool isSeqPerRule3Valid = false;
-  SequenceNumber32 beginOfCurrentPkt = m_firstByteSeq;
 
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  if (index_it != m_sentIndex.end ())
     {
-      item = *it;
-
       // Condition 1.a , 1.b , and 1.c
-      if (item->m_retrans == false && item->m_sacked == false)
+      if ((*index_it->second)->m_lost)
         {
-          if (item->m_lost)
-            {
-              NS_LOG_INFO("IsLost, returning" << beginOfCurrentPkt);
-              *seq = beginOfCurrentPkt;
-              *seqHigh = *seq + m_segmentSize;
-              return true;
-            }
-          else if (seqPerRule3.GetValue () == 0 && isRecovery)
-            {
-              NS_LOG_INFO ("Saving for rule 3 the seq " << beginOfCurrentPkt);
-              isSeqPerRule3Valid = true;
-              seqPerRule3 = beginOfCurrentPkt;
-            }
+          NS_LOG_INFO("IsLost, returning" << index_it->first);
+          *seq = index_it->first;
+          *seqHigh = *seq + m_segmentSize;
+          return true;
+        }
+      else if (isRecovery)
+        {
+          NS_LOG_INFO ("Saving for rule 3 the seq " << index_it->first);
+          isSeqPerRule3Valid = true;
+          seqPerRule3 = index_it->first;
         }
-
-      // Nothing found, iterate
-      beginOfCurrentPkt += item->m_packet->GetSize ();
     }
 
   /* (2) If no sequence number 'S2' per rule (1) exists but there
@@ -1224,11 +1432,21 @@ TcpTxBuffer::ResetRenoSack ()
   NS_LOG_FUNCTION (this);
 
   m_sackedOut = 0;
+  ResetScoreboardBounds ();
+  bool isLostPrefix = true;
   for (auto it = m_sentList.begin (); it != m_sentList.end (); ++it)
     {
       (*it)->m_sacked = false;
+
+      // Without the sacked items, only the leading lost items are below m_lostHigh
+      isLostPrefix = isLostPrefix && (*it)->m_lost;
+      if (isLostPrefix)
+        {
+          m_lostHigh = (*it)->m_startSeq + (*it)->m_packet->GetSize ();
+        }
     }
 
+  m_sackedRanges.clear ();
   m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
 }
 
@@ -1258,6 +1476,9 @@ TcpTxBuffer::ResetSentList ()
   m_lostOut = 0;
   m_retrans = 0;
   m_sackedOut = 0;
+  m_sentIndex.clear ();
+  m_sackedRanges.clear ();
+  ResetScoreboardBounds ();
   m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
 }
 
@@ -1269,6 +1490,7 @@ TcpTxBuffer::ResetLastSegmentSent ()
     {
       TcpTxItem *item = m_sentList.back ();
 
+      m_sentIndex.erase (item->m_startSeq);
       m_sentList.pop_back ();
       m_sentSize -= item->m_packet->GetSize ();
       if (item->m_retrans)
@@ -1276,6 +1498,16 @@ TcpTxBuffer::ResetLastSegmentSent ()
           m_retrans -= item->m_packet->GetSize ();
         }
       m_appList.insert (m_appList.begin (), item);
+
+      // The item will be sent again as a new one
+      if (m_lostHigh > item->m_startSeq)
+        {
+          m_lostHigh = item->m_startSeq;
+        }
+      if (m_nextSegHigh > item->m_startSeq)
+        {
+          m_nextSegHigh = item->m_startSeq;
+        }
     }
   ConsistencyCheck ();
 }
@@ -1290,6 +1522,7 @@ TcpTxBuffer::SetSentListLost (bool resetSack)
     {
       m_sackedOut = 0;
       m_lostOut = m_sentSize;
+      m_sackedRanges.clear ();
       m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
     }
   else
@@ -1297,6 +1530,10 @@ TcpTxBuffer::SetSentListLost (bool resetSack)
       m_lostOut = 0;
     }
 
+  // Everything is lost or sacked, and nothing is retransmitted
+  ResetScoreboardBounds ();
+  m_lostHigh = m_firstByteSeq + m_sentSize;
+
   for (auto it = m_sentList.begin (); it != m_sentList.end (); ++it)
     {
       if (resetSack)
@@ -1370,6 +1607,7 @@ TcpTxBuffer::MarkHeadAsLost ()
         {
           m_sentList.front ()->m_sacked = false;
           m_sackedOut -= m_sentList.front ()->m_packet->GetSize ();
+          RemoveSackedRange (m_sentList.front ());
         }
 
       if (m_sentList.front ()->m_retrans)
@@ -1383,6 +1621,12 @@ TcpTxBuffer::MarkHeadAsLost ()
           m_sentList.front()->m_lost = true;
           m_lostOut += m_sentList.front ()->m_packet->GetSize ();
         }
+
+      SequenceNumber32 headEnd = m_firstByteSeq + m_sentList.front ()->m_packet->GetSize ();
+      if (m_lostHigh < headEnd)
+        {
+          m_lostHigh = headEnd;
+        }
     }
   ConsistencyCheck ();
 }
@@ -1406,17 +1650,23 @@ TcpTxBuffer::AddRenoSack (void)
   // We can _never_ SACK the head, so start from the second segment sent
   auto it = ++m_sentList.begin ();
 
-  // Find the "highest sacked" point, that is SND.UNA + m_sackedOut
-  while (it != m_sentList.end () && (*it)->m_sacked)
+  // Find the "highest sacked" point, that is SND.UNA + m_sackedOut: the end
+  // of the sacked range which the second segment belongs to
+  if (it != m_sentList.end () && (*it)->m_sacked)
     {
-      ++it;
+      SackedRanges::const_iterator range = m_sackedRanges.upper_bound ((*it)->m_startSeq);
+      --range;
+      SentIndex::const_iterator index_it = m_sentIndex.find (range->second);
+      it = index_it == m_sentIndex.end () ? m_sentList.end () : index_it->second;
     }
 
   // Add to the sacked size the size of the first "not sacked" segment
   if (it != m_sentList.end ())
     {
+      NS_ASSERT (!(*it)->m_sacked);
       (*it)->m_sacked = true;
       m_sackedOut += (*it)->m_packet->GetSize ();
+      AddSackedRange (*it);
       m_highestSack = std::make_pair (it, (*it)->m_startSeq);
       NS_LOG_INFO ("Added a Reno SACK, status: " << *this);
     }
@@ -1432,9 +1682,7 @@ TcpTxBuffer::AddRenoSack (void)
 void
 TcpTxBuffer::ConsistencyCheck () const
 {
-  static const bool enable = false;
-
-  if (!enable)
+  if (!m_consistencyCheck)
     {
       return;
     }
@@ -1442,12 +1690,23 @@ TcpTxBuffer::ConsistencyCheck () const
   uint32_t sacked = 0;
   uint32_t lost = 0;
   uint32_t retrans = 0;
+  SackedRanges ranges;
 
   for (auto it = m_sentList.begin (); it != m_sentList.end (); ++it)
     {
+      SequenceNumber32 start = (*it)->m_startSeq;
+      SequenceNumber32 end = start + (*it)->m_packet->GetSize ();
       if ((*it)->m_sacked)
         {
           sacked += (*it)->m_packet->GetSize ();
+          if (!ranges.empty () && ranges.rbegin ()->second == start)
+            {
+              ranges.rbegin ()->second = end;
+            }
+          else
+            {
+              ranges[start] = end;
+            }
         }
       if ((*it)->m_lost)
         {
@@ -1457,14 +1716,28 @@ TcpTxBuffer::ConsistencyCheck () const
         {
           retrans += (*it)->m_packet->GetSize ();
         }
+
+      auto index_it = m_sentIndex.find (start);
+      NS_ABORT_MSG_UNLESS (index_it != m_sentIndex.end () && index_it->second == it,
+                           "Item " << *(*it) << " is not indexed");
+      NS_ABORT_MSG_UNLESS (start >= m_lostHigh || (*it)->m_lost || (*it)->m_sacked,
+                           "Item " << *(*it) << " before " << m_lostHigh << " is not lost");
+      NS_ABORT_MSG_UNLESS (start < m_lostHigh || !(*it)->m_lost,
+                           "Item " << *(*it) << " after " << m_lostHigh << " is lost");
+      NS_ABORT_MSG_UNLESS (it == m_sentList.begin () || start >= m_nextSegHigh
+                           || (*it)->m_retrans || (*it)->m_sacked,
+                           "Item " << *(*it) << " before " << m_nextSegHigh << " can be sent");
     }
 
-  NS_ASSERT_MSG (sacked == m_sackedOut, "Counted SACK: " << sacked <<
-                 " stored SACK: " << m_sackedOut);
-  NS_ASSERT_MSG (lost == m_lostOut, " Counted lost: " << lost <<
-                 " stored lost: " << m_lostOut);
-  NS_ASSERT_MSG (retrans == m_retrans, " Counted retrans: " << retrans <<
-                 " stored retrans: " << m_retrans);
+  NS_ABORT_MSG_UNLESS (m_sentIndex.size () == m_sentList.size (), "Stale items in the index");
+  NS_ABORT_MSG_UNLESS (ranges == m_sackedRanges, "Sacked ranges are out of sync");
+
+  NS_ABORT_MSG_UNLESS (sacked == m_sackedOut, "Counted SACK: " << sacked <<
+                       " stored SACK: " << m_sackedOut);
+  NS_ABORT_MSG_UNLESS (lost == m_lostOut, " Counted lost: " << lost <<
+                       " stored lost: " << m_lostOut);
+  NS_ABORT_MSG_UNLESS (retrans == m_retrans, " Counted retrans: " << retrans <<
+                       " stored retrans: " << m_retrans);
 }
 
 std::ostream &
@@ -22,6 +22,8 @@
 #ifndef TCP_TX_BUFFER_H
 #define TCP_TX_BUFFER_H
 
+#include <map>
+
 #include "ns3/object.h"
 #include "ns3/traced-value.h"
 #include "ns3/sequence-number.h"
@@ -73,6 +75,38 @@ class Packet;
  * documentation) and maintaining the scoreboard is a matter of travelling the
  * list and set the SACK flag on the corresponding segment sent.
  *
+ * The list is not travelled from the head on each ACK, which would make every
+ * ACK cost O(window) during a loss episode with a large window. The sent
+ * items are indexed by their starting sequence, and the sacked bytes are kept
+ * as the disjoint ranges they cover, so that a SACK block is mapped in
+ * O(log n) plus the items it newly sacks. Lost and retransmitted segments are
+ * found through two boundaries that only move forward between two resets of
+ * the scoreboard (RTO, Reno SACK reset):
+ *
+ * - below m_lostHigh every item is lost or sacked, above it none is lost,
+ * since the loss detection always marks the whole prefix below the dupThresh
+ * highest sacked item (see UpdateLostCount);
+ * - below m_nextSegHigh every item is sacked or retransmitted, and cannot be
+ * returned by NextSeg.
+ *
+ * Therefore IsLost is a lookup, while UpdateLostCount and NextSeg only visit
+ * the items between the previous boundary and the new one.
+ *
+ * Segment-aligned mode
+ * --------------------
+ *
+ * By default, Add stores each application packet as it is, and
+ * CopyFromSequence cuts and glues these packets (SplitItems, MergeItems) to
+ * build each requested segment; a bulk sender writing 512 bytes at a time
+ * pays a fragment and two or three merges per segment. With the attribute
+ * SegmentAligned, Add cuts the application data into items of one segment
+ * size (the last one is filled up by the next Add). New data and
+ * retransmissions are then served by handing out whole items: a request
+ * starting at an item boundary is capped to that item instead of being
+ * merged with the next one. A request shorter than the item (e.g., limited
+ * by the window) still splits it, and the remainder is sent alone so that the
+ * following items stay aligned.
+ *
  * Item properties
  * ---------------
  *
@@ -224,6 +258,8 @@ public:
   /**
    * \brief Append a data packet to the end of the buffer
    *
+   * In segment-aligned mode the data is stored in items of one segment size.
+   *
    * \param p The packet to be appended to the Tx buffer
    * \return Boolean to indicate success
    */
@@ -412,6 +448,8 @@ private:
   friend std::ostream & operator<< (std::ostream & os, TcpTxBuffer const & tcpTxBuf);
 
   typedef std::list<TcpTxItem*> PacketList; //!< container for data stored in the buffer
+  typedef std::map<SequenceNumber32, PacketList::iterator> SentIndex; //!< sent items by starting sequence
+  typedef std::map<SequenceNumber32, SequenceNumber32> SackedRanges; //!< sacked bytes, as start and end of each range
 
   /**
    * \brief Update the lost count
@@ -428,8 +466,9 @@ private:
    * The {New}Reno cases, for now, are managed in TcpSocketBase through the
    * call to MarkHeadAsLost.
    * This function is, therefore, called after a SACK option has been received,
-   * and updates the lost count. It can be probably optimized by not walking
-   * the entire list, but a subset.
+   * and updates the lost count. The items below m_lostHigh are already lost or
+   * sacked, so it only walks down the sacked ranges to find the dupThresh
+   * highest sacked item, and marks the items between m_lostHigh and that item.
    *
    */
   void UpdateLostCount ();
@@ -564,6 +603,26 @@ private:
                                 uint32_t numBytes, const SequenceNumber32 &requestedSeq,
                                 bool *listEdited = nullptr) const;
 
+  /**
+   * \brief Get a block (which is returned as Packet) from a list, starting the
+   * search from an item
+   *
+   * The items before the start are not visited, nor edited.
+   *
+   * \see GetPacketFromList
+   * \param list List to extract block from
+   * \param it Item from which the search starts, at or before requestedSeq
+   * \param startOfIt Starting sequence of the item
+   * \param numBytes Bytes to extract, starting from requestedSeq
+   * \param requestedSeq Requested sequence
+   * \param listEdited output parameter which indicates if the list has been edited
+   * \return the item that contains the right packet
+   */
+  TcpTxItem* GetPacketFromList (PacketList &list, PacketList::iterator it,
+                                const SequenceNumber32 &startOfIt,
+                                uint32_t numBytes, const SequenceNumber32 &requestedSeq,
+                                bool *listEdited) const;
+
   /**
    * \brief Merge two TcpTxItem
    *
@@ -590,7 +649,7 @@ private:
 
   /**
    * \brief Check if the values of sacked, lost, retrans, are in sync
-   * with the sent list.
+   * with the sent list, when the ConsistencyCheck attribute is set.
    */
   void ConsistencyCheck () const;
 
@@ -601,8 +660,46 @@ private:
   std::pair <TcpTxBuffer::PacketList::const_iterator, SequenceNumber32>
   FindHighestSacked () const;
 
+  /**
+   * \brief Find the sent item containing a sequence
+   * \param seq the sequence, inside the sent list
+   * \return the iterator of the item
+   */
+  PacketList::iterator FindSentItem (const SequenceNumber32 &seq) const;
+
+  /**
+   * \brief Index the sent items between two items after they have been split
+   * or merged
+   *
+   * \param first the first item edited
+   * \param end the first sequence after the edited items
+   */
+  void ReindexSentItems (PacketList::iterator first, const SequenceNumber32 &end);
+
+  /**
+   * \brief Add the bytes of a newly sacked item to the sacked ranges
+   * \param item the sacked item
+   */
+  void AddSackedRange (const TcpTxItem *item);
+
+  /**
+   * \brief Remove the bytes of an item, which is not sacked anymore, from
+   * the sacked ranges
+   * \param item the item
+   */
+  void RemoveSackedRange (const TcpTxItem *item);
+
+  /**
+   * \brief Reset the lost and NextSeg boundaries to the head of the sent list
+   *
+   * To be called when the flags of the items are changed all at once.
+   */
+  void ResetScoreboardBounds ();
+
   PacketList m_appList;  //!< Buffer for application data
   PacketList m_sentList; //!< Buffer for sent (but not acked) data
+  SentIndex m_sentIndex; //!< Iterators of the sent items, by starting sequence
+  SackedRanges m_sackedRanges; //!< Union of the sacked items
   uint32_t m_maxBuffer;  //!< Max number of data bytes in buffer (SND.WND)
   uint32_t m_size;       //!< Size of all data in this buffer
   uint32_t m_sentSize;   //!< Size of sent (and not discarded) segments
@@ -610,6 +707,8 @@ private:
 
   TracedValue<SequenceNumber32> m_firstByteSeq; //!< Sequence number of the first byte in data (SND.UNA)
   std::pair <PacketList::const_iterator, SequenceNumber32> m_highestSack; //!< Highest SACK byte
+  SequenceNumber32 m_lostHigh; //!< Items starting before are lost or sacked, the others are not lost
+  mutable SequenceNumber32 m_nextSegHigh; //!< Items starting before are sacked or retransmitted
 
   uint32_t m_lostOut   {0}; //!< Number of lost bytes
   uint32_t m_sackedOut {0}; //!< Number of sacked bytes
@@ -619,6 +718,8 @@ private:
   uint32_t m_segmentSize {0}; //!< Segment size from TcpSocketBase
   bool     m_renoSack {false}; //!< Indicates if AddRenoSack was called
   bool     m_sackEnabled {true}; //!< Indicates if SACK is enabled on this connection
+  bool     m_segmentAligned {false}; //!< Store application data in items of one segment
+  bool     m_consistencyCheck {false}; //!< Check the scoreboard after each change
 
   static Callback<void, TcpTxItem *> m_nullCb; //!< Null callback for an item
 };
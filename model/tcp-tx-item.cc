@@ -16,7 +16,9 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  */
+#include <vector>
 #include "tcp-tx-item.h"
+#include "internet-checksum.h"
 
 namespace ns3 {
 
@@ -94,6 +96,21 @@ TcpTxItem::GetLastSent (void) const
   return m_lastSent;
 }
 
+uint16_t
+TcpTxItem::GetPayloadSum (void)
+{
+  if (!m_hasPayloadSum)
+    {
+      // scratch space reused by all the items
+      static std::vector<uint8_t> data;
+      data.resize (m_packet->GetSize ());
+      m_packet->CopyData (data.data (), data.size ());
+      m_payloadSum = ChecksumSum (data.data (), data.size ());
+      m_hasPayloadSum = true;
+    }
+  return m_payloadSum;
+}
+
 TcpTxItem::RateInformation &
 TcpTxItem::GetRateInformation (void)
 {
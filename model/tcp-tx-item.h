@@ -78,6 +78,17 @@ public:
    */
   const Time & GetLastSent (void) const;
 
+  /**
+   * \brief Get the one's complement sum of the packet bytes
+   *
+   * The sum is computed on the first call and kept until the buffer
+   * changes the packet, so that retransmissions of the item do not read
+   * the payload again (see TcpHeader::SetPayloadSum).
+   *
+   * \return the folded, not complemented, sum
+   */
+  uint16_t GetPayloadSum (void);
+
   /**
    * \brief Various rate-related information, can be accessed by TcpRateOps.
    *
@@ -111,6 +122,8 @@ private:
   bool m_lost          {false};      //!< Indicates if the segment has been lost (RTO)
   Time m_lastSent      {Time::Max ()};//!< Timestamp of the time at which the segment has been sent last time
   bool m_sacked        {false};      //!< Indicates if the segment has been SACKed
+  bool m_hasPayloadSum {false};      //!< Indicates if m_payloadSum is the sum of m_packet
+  uint16_t m_payloadSum {0};         //!< Cached one's complement sum of m_packet
 
   RateInformation m_rateInfo;        //!< Rate information of the item
 };
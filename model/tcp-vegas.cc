@@ -111,14 +111,23 @@ TcpVegas::PktsAcked (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
     tcp_rtt_stat(rtt.GetMicroSeconds());
 
     
-  m_minRtt = std::min (m_minRtt, rtt);
+  if (tcb->m_rttSamples.empty ())
+    {
+      m_minRtt = std::min (m_minRtt, rtt);
+      m_baseRtt = std::min (m_baseRtt, rtt);
+      m_cntRtt++;
+    }
+  else
+    { // One sample per ACKed segment (TcpSocketBase::RttPerSegment)
+      for (const Time &sample : tcb->m_rttSamples)
+        {
+          m_minRtt = std::min (m_minRtt, sample);
+          m_baseRtt = std::min (m_baseRtt, sample);
+          m_cntRtt++;
+        }
+    }
   NS_LOG_DEBUG ("Updated m_minRtt = " << m_minRtt);
-
-  m_baseRtt = std::min (m_baseRtt, rtt);
   NS_LOG_DEBUG ("Updated m_baseRtt = " << m_baseRtt);
-
-  // Update RTT counter
-  m_cntRtt++;
   NS_LOG_DEBUG ("Updated m_cntRtt = " << m_cntRtt);
   
 }
@@ -37,6 +37,11 @@
 
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/enum.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+#include <limits>
 
 namespace ns3
 {
@@ -87,7 +92,45 @@ namespace ns3
                                 .AddAttribute("initial_rate", "initial sending rate",
                                               DoubleValue(5),
                                               MakeDoubleAccessor(&TCPCCTIMELY::m_sendingRate),
-                                              MakeDoubleChecker<float>());
+                                              MakeDoubleChecker<float>())
+                                .AddAttribute("RateMode", "Enforce the rate through cwnd (Window) or through per-segment pacing (Paced)",
+                                              EnumValue(TCPCCTIMELY::WINDOW),
+                                              MakeEnumAccessor(&TCPCCTIMELY::m_rateMode),
+                                              MakeEnumChecker(TCPCCTIMELY::WINDOW, "Window",
+                                                              TCPCCTIMELY::PACED, "Paced"))
+                                .AddAttribute("RateUnit", "value of one unit of sending rate in Paced mode",
+                                              DataRateValue(DataRate("1Mb/s")),
+                                              MakeDataRateAccessor(&TCPCCTIMELY::m_rateUnit),
+                                              MakeDataRateChecker())
+                                .AddAttribute("CwndGain", "cwnd cap in Paced mode, in multiples of rate * minRtt",
+                                              DoubleValue(2.0),
+                                              MakeDoubleAccessor(&TCPCCTIMELY::m_cwndGain),
+                                              MakeDoubleChecker<double>(1.0))
+                                .AddAttribute("CompletionEventBytes", "bytes ACKed per completion event, 0 updates the rate on ACKs (legacy)",
+                                              UintegerValue(0),
+                                              MakeUintegerAccessor(&TCPCCTIMELY::m_chunkBytes),
+                                              MakeUintegerChecker<uint32_t>())
+                                .AddAttribute("CompletionEventSample", "RTT sample used for a completion event",
+                                              EnumValue(TCPCCTIMELY::SAMPLE_MIN),
+                                              MakeEnumAccessor(&TCPCCTIMELY::m_chunkSample),
+                                              MakeEnumChecker(TCPCCTIMELY::SAMPLE_MIN, "Min",
+                                                              TCPCCTIMELY::SAMPLE_LAST, "Last",
+                                                              TCPCCTIMELY::SAMPLE_MEDIAN, "Median"))
+                                .AddTraceSource("AcksProcessed", "ACKs handed to PktsAcked",
+                                                MakeTraceSourceAccessor(&TCPCCTIMELY::m_acksProcessed),
+                                                "ns3::TracedValueCallback::Uint64")
+                                .AddTraceSource("RateUpdates", "rate updates performed",
+                                                MakeTraceSourceAccessor(&TCPCCTIMELY::m_rateUpdates),
+                                                "ns3::TracedValueCallback::Uint64")
+                                .AddTraceSource("NormalizedGradient", "normalized RTT gradient of each rate update",
+                                                MakeTraceSourceAccessor(&TCPCCTIMELY::m_gradientTrace),
+                                                "ns3::TracedValueCallback::Double")
+                                .AddTraceSource("RttDiff", "EWMA filtered RTT difference of each rate update (us)",
+                                                MakeTraceSourceAccessor(&TCPCCTIMELY::m_rttDiffTrace),
+                                                "ns3::TracedValueCallback::Double")
+                                .AddTraceSource("SendingRate", "sending rate after each rate update",
+                                                MakeTraceSourceAccessor(&TCPCCTIMELY::m_rateTrace),
+                                                "ns3::TracedValueCallback::Double");
 
         return tid;
     }
@@ -128,7 +171,19 @@ namespace ns3
           m_doingTIMELYNow(true),
           m_begSndNxt(0),
           m_lastt(0),
-          m_samplertt(0)
+          m_samplertt(0),
+          m_rateMode(WINDOW),
+          m_rateUnit(DataRate("1Mb/s")),
+          m_cwndGain(2.0),
+          m_chunkBytes(0),
+          m_chunkSample(SAMPLE_MIN),
+          m_chunkAcked(0),
+          m_chunkRtt(MAXFLOAT),
+          m_acksProcessed(0),
+          m_rateUpdates(0),
+          m_gradientTrace(0),
+          m_rttDiffTrace(0),
+          m_rateTrace(0)
 
     {
         NS_LOG_FUNCTION(this);
@@ -155,7 +210,19 @@ namespace ns3
           m_doingTIMELYNow(true),
           m_begSndNxt(0),
           m_lastt(0),
-          m_samplertt(0)
+          m_samplertt(0),
+          m_rateMode(sock.m_rateMode),
+          m_rateUnit(sock.m_rateUnit),
+          m_cwndGain(sock.m_cwndGain),
+          m_chunkBytes(sock.m_chunkBytes),
+          m_chunkSample(sock.m_chunkSample),
+          m_chunkAcked(0),
+          m_chunkRtt(MAXFLOAT),
+          m_acksProcessed(0),
+          m_rateUpdates(0),
+          m_gradientTrace(0),
+          m_rttDiffTrace(0),
+          m_rateTrace(0)
 
     {
         NS_LOG_FUNCTION(this);
@@ -172,6 +239,128 @@ namespace ns3
         return CopyObject<TCPCCTIMELY>(this);
     }
 
+    void
+    TCPCCTIMELY::Init(Ptr<TcpSocketState> tcb)
+    {
+        NS_LOG_FUNCTION(this << tcb);
+        if (m_rateMode == PACED)
+        {
+            // every segment, including the initial window, leaves at the TIMELY rate
+            tcb->m_pacing = true;
+            tcb->m_paceInitialWindow = true;
+            ApplyRate(tcb);
+        }
+    }
+
+    bool
+    TCPCCTIMELY::HasCongControl() const
+    {
+        return m_rateMode == PACED;
+    }
+
+    uint64_t
+    TCPCCTIMELY::GetAcksProcessed() const
+    {
+        return m_acksProcessed;
+    }
+
+    uint64_t
+    TCPCCTIMELY::GetRateUpdates() const
+    {
+        return m_rateUpdates;
+    }
+
+    bool
+    TCPCCTIMELY::CompletionEvent(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
+                                 double &rtt)
+    {
+        m_chunkAcked += segmentsAcked * tcb->m_segmentSize;
+        if (tcb->m_rttSamples.empty())
+        {
+            AddChunkSample(rtt);
+        }
+        else
+        {
+            // one sample per ACKed segment (TcpSocketBase::RttPerSegment)
+            for (const Time &sample : tcb->m_rttSamples)
+            {
+                AddChunkSample(sample.ToDouble(Time::US));
+            }
+        }
+
+        if (m_chunkAcked < m_chunkBytes)
+        {
+            return false;
+        }
+
+        if (m_chunkSample == SAMPLE_MEDIAN)
+        {
+            std::vector<double>::iterator mid = m_chunkRtts.begin() + m_chunkRtts.size() / 2;
+            std::nth_element(m_chunkRtts.begin(), mid, m_chunkRtts.end());
+            rtt = *mid;
+            m_chunkRtts.clear();
+        }
+        else
+        {
+            rtt = m_chunkRtt;
+        }
+        // a cumulative ACK spanning several chunks is still one event
+        m_chunkAcked = 0;
+        m_chunkRtt = MAXFLOAT;
+        return true;
+    }
+
+    void
+    TCPCCTIMELY::AddChunkSample(double rtt)
+    {
+        switch (m_chunkSample)
+        {
+        case SAMPLE_MIN:
+            m_chunkRtt = std::min(m_chunkRtt, rtt);
+            break;
+        case SAMPLE_LAST:
+            m_chunkRtt = rtt;
+            break;
+        case SAMPLE_MEDIAN:
+            m_chunkRtts.push_back(rtt);
+            break;
+        }
+    }
+
+    void
+    TCPCCTIMELY::ApplyRate(Ptr<TcpSocketState> tcb)
+    {
+        m_rateTrace = this->m_sendingRate;
+
+        if (m_rateMode == WINDOW)
+        {
+            // adjust window size based on sending rate
+            tcb->m_cWnd = this->m_sendingRate * tcb->m_segmentSize;
+            return;
+        }
+
+        // never pace below one rate unit, the MD step can drive the rate to zero
+        double units = std::max(this->m_sendingRate, 1.0);
+        DataRate rate(static_cast<uint64_t>(units * m_rateUnit.GetBitRate()));
+        if (rate > tcb->m_maxPacingRate)
+        {
+            rate = tcb->m_maxPacingRate;
+        }
+        tcb->m_pacingRate = rate;
+        NS_LOG_DEBUG("Pacing rate set to " << rate);
+
+        if (this->m_minRtt == MAXFLOAT || tcb->m_segmentSize == 0)
+        {
+            // no RTT sample yet, keep the initial window
+            return;
+        }
+        // safety cap: the pacer sets the departure times, cwnd only bounds
+        // the amount of data in flight to a few rate-delay products
+        double cap = m_cwndGain * rate.GetBitRate() / 8.0 * this->m_minRtt / 1e6;
+        cap = std::min(cap, static_cast<double>(std::numeric_limits<uint32_t>::max()));
+        tcb->m_cWnd = std::max(static_cast<uint32_t>(cap), 2 * tcb->m_segmentSize);
+    }
+
     void
     TCPCCTIMELY::PktsAcked(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
                            const Time &rtt)
@@ -181,37 +370,62 @@ namespace ns3
         NS_LOG_FUNCTION(this << tcb << segmentsAcked << rtt);
         // Update RTT counter
         m_cntRtt++;
+        m_acksProcessed++;
         if (rtt.IsZero())
         {
+            // no RTT sample, e.g. after a retransmission, but the ACKed bytes
+            // still count toward the completion event
+            if (m_chunkBytes > 0)
+            {
+                m_chunkAcked += segmentsAcked * tcb->m_segmentSize;
+            }
             return;
         }
+        // keep the sub-microsecond part, the gradient of 2us links lives there
+        double acked_rtt = rtt.ToDouble(Time::US);
         if (!tcp_rtt_stat.IsNull())
-            tcp_rtt_stat(rtt.GetMicroSeconds());
+            tcp_rtt_stat(acked_rtt);
 
-        double acked_rtt = rtt.GetMicroSeconds();
         // update baseRTT, not used for timely
         m_baseRtt = std::min(m_baseRtt, acked_rtt);
 
         this->m_minRtt = std::min(this->m_minRtt, acked_rtt);
-        double current_time = ns3::Simulator::Now().GetMicroSeconds(); // compute rate at most once per RTT
-
-        if (current_time - this->m_lastt < this->m_samplertt)
+        for (const Time &sample : tcb->m_rttSamples)
         {
-            // we do not want to overweigh the new information
-            // std::cout << "skipping..." << std::endl;
-            return;
+            this->m_minRtt = std::min(this->m_minRtt, sample.ToDouble(Time::US));
         }
-        this->m_lastt = current_time;
-        NS_LOG_DEBUG("Updated m_baseRtt = " << m_baseRtt);
 
-        if (this->m_samplertt == 0)
+        if (m_chunkBytes > 0)
         {
-            this->m_samplertt = acked_rtt;
+            // completion event mode: one update per chunk of ACKed bytes
+            if (!CompletionEvent(tcb, segmentsAcked, acked_rtt))
+            {
+                return;
+            }
         }
         else
         {
-            this->m_samplertt = acked_rtt * (1 - this->m_alpha) + this->m_alpha * this->m_samplertt;
+            double current_time = ns3::Simulator::Now().GetMicroSeconds(); // compute rate at most once per RTT
+
+            if (current_time - this->m_lastt < this->m_samplertt)
+            {
+                // we do not want to overweigh the new information
+                // std::cout << "skipping..." << std::endl;
+                return;
+            }
+            this->m_lastt = current_time;
+
+            if (this->m_samplertt == 0)
+            {
+                this->m_samplertt = acked_rtt;
+            }
+            else
+            {
+                this->m_samplertt = acked_rtt * (1 - this->m_alpha) + this->m_alpha * this->m_samplertt;
+            }
         }
+        NS_LOG_DEBUG("Updated m_baseRtt = " << m_baseRtt);
+        m_rateUpdates++;
 
         double new_rtt = acked_rtt;
         if (m_prevRTT == -1)
@@ -229,7 +443,8 @@ namespace ns3
 
 
         double normalized_gradient = this->m_newRTTDiff / this->m_minRtt;
-        std::cout << "G," << normalized_gradient << "," << ns3::Simulator::Now().GetMicroSeconds() << std::endl;
+        m_rttDiffTrace = this->m_newRTTDiff;
+        m_gradientTrace = normalized_gradient;
 
         if (new_rtt < this->m_lowerth)
         {
@@ -238,7 +453,7 @@ namespace ns3
             // rate ← rate + δ ;
             this->m_sendingRate = this->m_sendingRate + this->m_ai;
             this->m_eventcount = 0;
-            tcb->m_cWnd = this->m_sendingRate * tcb->m_segmentSize;
+            ApplyRate(tcb);
             return;
         }
         else if (new_rtt > this->m_higherth)
@@ -249,7 +464,7 @@ namespace ns3
 
             this->m_sendingRate = this->m_sendingRate * (1 - this->m_md * (1 - this->m_higherth / new_rtt));
             this->m_eventcount = 0;
-            tcb->m_cWnd = this->m_sendingRate * tcb->m_segmentSize;
+            ApplyRate(tcb);
 
             return;
         }
@@ -283,8 +498,7 @@ namespace ns3
             this->m_sendingRate = this->m_sendingRate * (1 - this->m_md * normalized_gradient);
         }
 
-        // adjust window size based on sending rate
-        tcb->m_cWnd = this->m_sendingRate * tcb->m_segmentSize;
+        ApplyRate(tcb);
     }
 
     void
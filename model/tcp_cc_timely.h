@@ -32,6 +32,10 @@
 #define TCPCCTIMELY_H
 
 #include "tcp-congestion-ops.h"
+#include "ns3/data-rate.h"
+#include "ns3/traced-value.h"
+
+#include <vector>
 
 namespace ns3
 {
@@ -51,6 +55,25 @@ namespace ns3
     class TCPCCTIMELY : public TcpNewReno
     {
     public:
+        /**
+         * \brief How the computed sending rate is enforced
+         */
+        typedef enum
+        {
+            WINDOW, //!< Legacy mode: cwnd = rate * segmentSize
+            PACED   //!< Drive the socket pacing rate, cwnd is only a safety cap
+        } RateMode_t;
+
+        /**
+         * \brief RTT sample taken for a completion event
+         */
+        typedef enum
+        {
+            SAMPLE_MIN,   //!< Smallest RTT seen during the chunk
+            SAMPLE_LAST,  //!< RTT of the ACK that completed the chunk
+            SAMPLE_MEDIAN //!< Median of the RTTs seen during the chunk
+        } ChunkSample_t;
+
         /**
          * \brief Get the type ID.
          * \return the object TypeId
@@ -121,8 +144,73 @@ namespace ns3
 
         virtual Ptr<TcpCongestionOps> Fork();
 
+        /**
+         * \brief Enable pacing on the socket when running in PACED mode
+         *
+         * \param tcb internal congestion state
+         */
+        virtual void Init(Ptr<TcpSocketState> tcb);
+
+        /**
+         * \brief In PACED mode the rate is owned by TIMELY
+         *
+         * Returning true keeps TcpSocketBase::UpdatePacingRate and the recovery
+         * algorithm from overwriting the pacing rate and cwnd set by TIMELY.
+         *
+         * \return true in PACED mode, false in WINDOW mode
+         */
+        virtual bool HasCongControl() const;
+
+        /**
+         * \brief Number of ACKs handed to PktsAcked
+         * \return the ACK counter
+         */
+        uint64_t GetAcksProcessed() const;
+
+        /**
+         * \brief Number of rate updates performed
+         * \return the update counter
+         */
+        uint64_t GetRateUpdates() const;
+
     protected:
     private:
+        /**
+         * \brief Enforce m_sendingRate on the socket
+         *
+         * In WINDOW mode the rate is written into cwnd (in segments). In PACED
+         * mode it is converted with m_rateUnit into the socket pacing rate, and
+         * cwnd is capped to m_cwndGain times the rate-delay product.
+         *
+         * \param tcb internal congestion state
+         */
+        void ApplyRate(Ptr<TcpSocketState> tcb);
+
+        /**
+         * \brief Aggregate an ACK into the current completion event
+         *
+         * ACKed bytes are accumulated until m_chunkBytes is reached (the
+         * ACKs without an RTT sample add their bytes in PktsAcked), and
+         * the RTT sample of the chunk is kept as selected by m_chunkSample.
+         * The per-segment samples of tcb->m_rttSamples are used instead of
+         * rtt when the socket takes them.
+         *
+         * \param tcb internal congestion state
+         * \param segmentsAcked count of segments ACKed
+         * \param rtt RTT of this ACK in us; on chunk boundary, replaced by
+         * the RTT sample of the chunk
+         * \return true if the ACK completes a chunk
+         */
+        bool CompletionEvent(Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
+                             double &rtt);
+
+        /**
+         * \brief Add an RTT sample to the current completion event
+         *
+         * \param rtt RTT sample in us
+         */
+        void AddChunkSample(double rtt);
+
         /**
          * \brief Enable Vegas algorithm to start taking Vegas samples
          *
@@ -166,6 +254,25 @@ namespace ns3
         SequenceNumber32 m_begSndNxt; //!< Right edge during last RTT
         double m_lastt;
         double m_samplertt;
+
+        // rate enforcement
+        RateMode_t m_rateMode; //!< WINDOW or PACED
+        DataRate m_rateUnit;   //!< Value of one unit of m_sendingRate in PACED mode
+        double m_cwndGain;     //!< cwnd cap in PACED mode, in multiples of rate * minRtt
+
+        // completion events
+        uint32_t m_chunkBytes;            //!< Completion event size in bytes, 0 to update per ACK
+        ChunkSample_t m_chunkSample;      //!< RTT sample kept for a completion event
+        uint32_t m_chunkAcked;            //!< Bytes ACKed in the current chunk
+        double m_chunkRtt;                //!< Min or last RTT of the current chunk
+        std::vector<double> m_chunkRtts;  //!< RTTs of the current chunk (median only)
+        TracedValue<uint64_t> m_acksProcessed; //!< ACKs handed to PktsAcked
+        TracedValue<uint64_t> m_rateUpdates;   //!< Rate updates performed
+
+        // traces
+        TracedValue<double> m_gradientTrace; //!< Normalized RTT gradient of the last update
+        TracedValue<double> m_rttDiffTrace;  //!< EWMA filtered RTT difference of the last update, in us
+        TracedValue<double> m_rateTrace;     //!< Sending rate after the last update
     };
 
 } // namespace ns3
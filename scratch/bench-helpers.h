@@ -0,0 +1,105 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Timing and check helpers shared by the microbenchmarks of scratch.
+ */
+
+#ifndef BENCH_HELPERS_H
+#define BENCH_HELPERS_H
+
+#include <stdint.h>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "ns3/abort.h"
+
+/**
+ * \brief Abort with both values unless a value equals its reference
+ * \param value the value computed by the code under test
+ * \param reference the value of the reference model
+ * \param msg what differs, streamed like the message of NS_ABORT_MSG
+ */
+#define BENCH_CHECK_EQUAL(value, reference, msg)                        \
+  NS_ABORT_MSG_UNLESS ((value) == (reference),                          \
+                       msg << ": " << (value) << " instead of " << (reference))
+
+/**
+ * \brief Wall clock time of a piece of code, over one or more runs
+ *
+ * Each Start and Stop pair adds the time in between to the total, so that
+ * a loop can time its own work and not the checks or the setup around it.
+ */
+class BenchTimer
+{
+public:
+  BenchTimer ()
+    : m_elapsed (0)
+  {
+  }
+
+  /// Start a run
+  void Start (void)
+  {
+    m_start = std::chrono::steady_clock::now ();
+  }
+
+  /// End the run begun by Start, adding its time to the total
+  void Stop (void)
+  {
+    m_elapsed += std::chrono::steady_clock::now () - m_start;
+  }
+
+  /// \return the total in milliseconds
+  double Ms (void) const
+  {
+    return std::chrono::duration<double, std::milli> (m_elapsed).count ();
+  }
+
+  /**
+   * \param n the number of operations timed
+   * \return the total in nanoseconds per operation
+   */
+  double NsPer (double n) const
+  {
+    return std::chrono::duration<double, std::nano> (m_elapsed).count () / n;
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_start;   //!< Start of the current run
+  std::chrono::steady_clock::duration m_elapsed;   //!< Total of the runs
+};
+
+/**
+ * \brief Parse a comma separated list of sizes, as given on the command line
+ * \param list the list, like "100,1000,10000"
+ * \return the sizes
+ */
+inline std::vector<uint32_t>
+ParseSizes (const std::string &list)
+{
+  std::vector<uint32_t> sizes;
+  std::istringstream stream (list);
+  std::string item;
+  while (std::getline (stream, item, ','))
+    {
+      sizes.push_back (std::stoul (item));
+    }
+  return sizes;
+}
+
+#endif /* BENCH_HELPERS_H */
@@ -0,0 +1,153 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Balance and goodput of the ECMP route choices of global routing.
+ *
+ * The hosts of one leaf send --flows bulk TCP flows each to the hosts of
+ * another leaf, through --spines spines chosen per --ecmp: "first",
+ * "random" per packet, or "flow" hash, with flowlets if --flowletUs is not
+ * 0. The program prints the packets of each uplink of the first leaf, as
+ * counted by its Ipv4EcmpSelector, their max / mean ratio, and the goodput.
+ *
+ * ./waf --run "scratch/ecmp-flow-bench --ecmp=flow --flowletUs=0"
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("EcmpFlowBench");
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t spines = 4;
+  uint32_t hosts = 8;
+  uint32_t flows = 4;
+  double time = 0.05;
+  std::string ecmp = "flow";
+  uint32_t flowletUs = 0;
+
+  CommandLine cmd;
+  cmd.AddValue ("spines", "spine switches", spines);
+  cmd.AddValue ("hosts", "hosts per leaf switch", hosts);
+  cmd.AddValue ("flows", "flows per sending host", flows);
+  cmd.AddValue ("time", "sending time in seconds", time);
+  cmd.AddValue ("ecmp", "route choice among the spines: first, random or flow", ecmp);
+  cmd.AddValue ("flowletUs", "flowlet timeout in microseconds, 0 for none", flowletUs);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_UNLESS (ecmp == "first" || ecmp == "random" || ecmp == "flow", "unknown --ecmp " << ecmp);
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::RandomEcmpRouting", BooleanValue (ecmp == "random"));
+  Config::SetDefault ("ns3::Ipv4GlobalRouting::FlowEcmpRouting", BooleanValue (ecmp == "flow"));
+  Config::SetDefault ("ns3::Ipv4EcmpSelector::FlowletTimeout", TimeValue (MicroSeconds (flowletUs)));
+  Config::SetDefault ("ns3::Ipv4EcmpSelector::CountLoad", BooleanValue (true));
+  Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (1448));
+
+  NodeContainer spineNodes;
+  spineNodes.Create (spines);
+  NodeContainer leafNodes;
+  leafNodes.Create (2);
+  NodeContainer hostNodes;
+  hostNodes.Create (2 * hosts);
+  NodeContainer all (spineNodes, leafNodes, hostNodes);
+
+  InternetStackHelper internet;
+  internet.Install (all);
+  for (uint32_t i = 0; i < all.GetN (); i++)
+    {
+      Ptr<Ipv4GlobalRouting> routing = all.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+      routing->GetEcmpSelector ()->SetAttribute ("Seed", UintegerValue (all.Get (i)->GetId ()));
+    }
+
+  PointToPointHelper link;
+  link.SetDeviceAttribute ("DataRate", StringValue ("10Gbps"));
+  link.SetChannelAttribute ("Delay", StringValue ("2us"));
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  // interface and spine address of each uplink of the first leaf
+  std::vector<std::pair<uint32_t, Ipv4Address> > uplinks;
+  for (uint32_t l = 0; l < 2; l++)
+    {
+      for (uint32_t s = 0; s < spines; s++)
+        {
+          NetDeviceContainer devices = link.Install (leafNodes.Get (l), spineNodes.Get (s));
+          Ipv4InterfaceContainer interfaces = address.Assign (devices);
+          address.NewNetwork ();
+          if (l == 0)
+            {
+              Ptr<Ipv4> ipv4 = leafNodes.Get (0)->GetObject<Ipv4> ();
+              uplinks.push_back (std::make_pair (ipv4->GetInterfaceForDevice (devices.Get (0)),
+                                                 interfaces.GetAddress (1)));
+            }
+        }
+    }
+  std::vector<Ipv4Address> receivers;
+  for (uint32_t h = 0; h < 2 * hosts; h++)
+    {
+      Ipv4InterfaceContainer interfaces = address.Assign (link.Install (hostNodes.Get (h), leafNodes.Get (h / hosts)));
+      address.NewNetwork ();
+      receivers.push_back (interfaces.GetAddress (0));
+    }
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  ApplicationContainer sinks;
+  ApplicationContainer sources;
+  for (uint32_t h = 0; h < hosts; h++)
+    {
+      for (uint32_t f = 0; f < flows; f++)
+        {
+          uint16_t port = 5000 + f;
+          PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+          sinks.Add (sink.Install (hostNodes.Get (hosts + h)));
+          BulkSendHelper source ("ns3::TcpSocketFactory", InetSocketAddress (receivers[hosts + h], port));
+          sources.Add (source.Install (hostNodes.Get (h)));
+        }
+    }
+  sinks.Start (Seconds (0));
+  sources.Start (Seconds (0.001));
+  sources.Stop (Seconds (0.001 + time));
+  Simulator::Stop (Seconds (0.001 + time));
+  Simulator::Run ();
+
+  Ptr<Ipv4EcmpSelector> selector = leafNodes.Get (0)->GetObject<GlobalRouter> ()->GetRoutingProtocol ()->GetEcmpSelector ();
+  uint64_t total = 0;
+  uint64_t most = 0;
+  std::cout << "uplink\tpackets" << std::endl;
+  for (uint32_t s = 0; s < uplinks.size (); s++)
+    {
+      uint64_t packets = selector->GetPackets (uplinks[s].first, uplinks[s].second);
+      std::cout << s << "\t" << packets << std::endl;
+      total += packets;
+      most = std::max (most, packets);
+    }
+  uint64_t received = 0;
+  for (uint32_t i = 0; i < sinks.GetN (); i++)
+    {
+      received += DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx ();
+    }
+  std::cout << "max / mean\t" << (total > 0 ? double (most) * uplinks.size () / total : 0) << std::endl;
+  std::cout << "goodput\t" << received * 8 / time / 1e9 << " Gbps" << std::endl;
+  Simulator::Destroy ();
+  return 0;
+}
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Microbenchmark of Ipv4EndPointDemux and Ipv6EndPointDemux.
+ *
+ * With one listener and N accepted connections, as at the sink of an
+ * incast, the program times Lookup of established and of new connections,
+ * Allocate + DeAllocate, the same established lookups on IPv6, and the
+ * ephemeral open and close of a client with min (N, 16000) connections.
+ * Every lookup must find its end point.
+ *
+ * ./waf --run "scratch/endpoint-demux-bench --sizes=10,1000,100000"
+ */
+
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/ipv4-end-point-demux.h"
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv6-end-point-demux.h"
+#include "ns3/ipv6-end-point.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("EndPointDemuxBench");
+
+static const uint16_t LISTEN_PORT = 8080;
+static const Ipv4Address LOCAL ("11.11.0.1");
+static const Ipv6Address LOCAL6 ("2001:db8::1");
+
+// peer of connection i: distinct address and port for any i < 2^32
+static Ipv4Address
+PeerAddress (uint32_t i)
+{
+  return Ipv4Address (0x0a000000 + (i >> 4));
+}
+
+static Ipv6Address
+PeerAddress6 (uint32_t i)
+{
+  uint8_t buf[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0 };
+  buf[12] = (i >> 28) & 0xff;
+  buf[13] = (i >> 20) & 0xff;
+  buf[14] = (i >> 12) & 0xff;
+  buf[15] = (i >> 4) & 0xff;
+  return Ipv6Address (buf);
+}
+
+static uint16_t
+PeerPort (uint32_t i)
+{
+  return 49152 + (i & 0xf);
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string sizes = "10,1000,100000";
+  uint32_t lookups = 1000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("sizes", "comma separated numbers of connections", sizes);
+  cmd.AddValue ("lookups", "lookups timed per size", lookups);
+  cmd.Parse (argc, argv);
+
+  Ptr<Ipv4Interface> interface = CreateObject<Ipv4Interface> ();
+  Ptr<Ipv6Interface> interface6 = CreateObject<Ipv6Interface> ();
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  std::cout << "endpoints\testablished ns/lookup\tnew ns/lookup\tallocate+deallocate ns"
+            << "\tipv6 established ns/lookup\tephemeral open+close ns" << std::endl;
+  std::vector<uint32_t> counts = ParseSizes (sizes);
+  for (uint32_t c = 0; c < counts.size (); c++)
+    {
+      uint32_t n = counts[c];
+      Ipv4EndPointDemux demux;
+      demux.Allocate (0, Ipv4Address::GetAny (), LISTEN_PORT);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          demux.Allocate (0, LOCAL, LISTEN_PORT, PeerAddress (i), PeerPort (i));
+        }
+
+      std::vector<uint32_t> order (lookups);
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          order[i] = rng->GetInteger (0, n - 1);
+        }
+
+      uint32_t found = 0;
+      BenchTimer establishedTimer;
+      establishedTimer.Start ();
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          found += demux.Lookup (LOCAL, LISTEN_PORT, PeerAddress (order[i]), PeerPort (order[i]), interface).size ();
+        }
+      establishedTimer.Stop ();
+      BENCH_CHECK_EQUAL (found, lookups, "established connections found");
+
+      found = 0;
+      BenchTimer freshTimer;
+      freshTimer.Start ();
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          found += demux.Lookup (LOCAL, LISTEN_PORT, PeerAddress (n + order[i]), PeerPort (n + order[i]), interface).size ();
+        }
+      freshTimer.Stop ();
+      BENCH_CHECK_EQUAL (found, lookups, "new connections matched by the listener");
+
+      uint32_t churn = std::min (lookups, 100000u);
+      BenchTimer allocateTimer;
+      allocateTimer.Start ();
+      for (uint32_t i = 0; i < churn; i++)
+        {
+          demux.DeAllocate (demux.Allocate (0, LOCAL, LISTEN_PORT, PeerAddress (n + i), PeerPort (n + i)));
+        }
+      allocateTimer.Stop ();
+
+      Ipv6EndPointDemux demux6;
+      demux6.Allocate (0, Ipv6Address::GetAny (), LISTEN_PORT);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          demux6.Allocate (0, LOCAL6, LISTEN_PORT, PeerAddress6 (i), PeerPort (i));
+        }
+      found = 0;
+      BenchTimer established6Timer;
+      established6Timer.Start ();
+      for (uint32_t i = 0; i < lookups; i++)
+        {
+          found += demux6.Lookup (LOCAL6, LISTEN_PORT, PeerAddress6 (order[i]), PeerPort (order[i]), interface6).size ();
+        }
+      established6Timer.Stop ();
+      BENCH_CHECK_EQUAL (found, lookups, "IPv6 established connections found");
+
+      // client side: connect () = ephemeral Allocate, then SetPeer
+      Ipv4EndPointDemux client;
+      for (uint32_t i = 0; i < std::min (n, 16000u); i++)
+        {
+          client.Allocate (LOCAL)->SetPeer (PeerAddress (0), LISTEN_PORT);
+        }
+      BenchTimer ephemeralTimer;
+      ephemeralTimer.Start ();
+      for (uint32_t i = 0; i < churn; i++)
+        {
+          Ipv4EndPoint *endPoint = client.Allocate (LOCAL);
+          NS_ABORT_MSG_UNLESS (endPoint != 0, "ephemeral ports exhausted");
+          endPoint->SetPeer (PeerAddress (0), LISTEN_PORT);
+          client.DeAllocate (endPoint);
+        }
+      ephemeralTimer.Stop ();
+
+      std::cout << n << "\t" << establishedTimer.NsPer (lookups) << "\t" << freshTimer.NsPer (lookups)
+                << "\t" << allocateTimer.NsPer (churn) << "\t" << established6Timer.NsPer (lookups)
+                << "\t" << ephemeralTimer.NsPer (churn) << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Cost of the global routing update after a link failure.
+ *
+ * The link between the first leaf and the first spine of a two-tier Clos
+ * (1960 nodes by default) goes down and up again --flaps times. Each change
+ * is timed through GlobalRouteManager::UpdateRoutes, with
+ * "GlobalRoutingIncremental", and through a full recompute. With --check,
+ * both must give every node the same table, in the Clos and, first, in
+ * --graphs random point-to-point graphs with equal-cost paths after
+ * --changes random interface downs, ups and address changes each.
+ *
+ * ./waf --run "scratch/global-routing-flap-bench --flaps=5 --check=1"
+ */
+
+#include <functional>
+#include <sstream>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("GlobalRoutingFlapBench");
+
+// hash of the global routing table of every node
+static std::vector<std::size_t>
+HashTables (const NodeContainer &nodes)
+{
+  std::vector<std::size_t> hashes;
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      std::ostringstream table;
+      Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper> (&table);
+      nodes.Get (i)->GetObject<GlobalRouter> ()->GetRoutingProtocol ()->PrintRoutingTable (stream);
+      hashes.push_back (std::hash<std::string> () (table.str ()));
+    }
+  return hashes;
+}
+
+static void
+Recompute (void)
+{
+  GlobalRouteManager::DeleteGlobalRoutes ();
+  GlobalRouteManager::BuildGlobalRoutingDatabase ();
+  GlobalRouteManager::InitializeRoutes ();
+}
+
+// abort unless every node has the same table after both updates
+static void
+CheckTables (const NodeContainer &nodes, const std::vector<std::size_t> &incrementalTables,
+             const std::vector<std::size_t> &fullTables, const std::string &change)
+{
+  for (uint32_t n = 0; n < nodes.GetN (); n++)
+    {
+      BENCH_CHECK_EQUAL (incrementalTables[n], fullTables[n],
+                         change << ": table hash of node " << nodes.Get (n)->GetId () << " after the incremental update");
+    }
+}
+
+static void
+CheckRandomGraphs (uint32_t graphs, uint32_t routers, uint32_t changes)
+{
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  for (uint32_t g = 0; g < graphs; g++)
+    {
+      NodeContainer nodes;
+      nodes.Create (routers);
+      InternetStackHelper internet;
+      internet.Install (nodes);
+
+      PointToPointHelper link;
+      std::vector<NetDeviceContainer> links;
+      for (uint32_t n = 1; n < routers; n++)
+        {
+          links.push_back (link.Install (nodes.Get (n), nodes.Get (rng->GetInteger (0, n - 1))));
+        }
+      for (uint32_t n = 0; n < routers; n++)
+        {
+          uint32_t a = rng->GetInteger (0, routers - 1);
+          uint32_t b = rng->GetInteger (0, routers - 1);
+          if (a != b)
+            {
+              links.push_back (link.Install (nodes.Get (a), nodes.Get (b)));
+            }
+        }
+      Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+      for (uint32_t l = 0; l < links.size (); l++)
+        {
+          address.Assign (links[l]);
+          address.NewNetwork ();
+        }
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+      for (uint32_t c = 0; c < changes; c++)
+        {
+          Ptr<NetDevice> device = links[rng->GetInteger (0, links.size () - 1)].Get (rng->GetInteger (0, 1));
+          Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+          uint32_t interface = ipv4->GetInterfaceForDevice (device);
+          if (rng->GetValue () < 0.3)
+            {
+              ipv4->RemoveAddress (interface, 0);
+              ipv4->AddAddress (interface, Ipv4InterfaceAddress (address.NewAddress (), Ipv4Mask ("255.255.255.252")));
+              address.NewNetwork ();
+            }
+          else if (ipv4->IsUp (interface))
+            {
+              ipv4->SetDown (interface);
+            }
+          else
+            {
+              ipv4->SetUp (interface);
+            }
+
+          GlobalRouteManager::UpdateRoutes (device->GetNode ());
+          std::vector<std::size_t> incrementalTables = HashTables (nodes);
+          Recompute ();
+          std::ostringstream change;
+          change << "graph " << g << ", change " << c;
+          CheckTables (nodes, incrementalTables, HashTables (nodes), change.str ());
+        }
+      // a new node list, routing database and address space for the next graph
+      Simulator::Destroy ();
+      Ipv4AddressGenerator::Reset ();
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t spines = 8;
+  uint32_t leaves = 32;
+  uint32_t hosts = 60;
+  uint32_t flaps = 5;
+  bool check = false;
+  uint32_t graphs = 20;
+  uint32_t routers = 30;
+  uint32_t changes = 50;
+
+  CommandLine cmd;
+  cmd.AddValue ("spines", "spine switches", spines);
+  cmd.AddValue ("leaves", "leaf switches", leaves);
+  cmd.AddValue ("hosts", "hosts per leaf switch", hosts);
+  cmd.AddValue ("flaps", "times the link goes down and up", flaps);
+  cmd.AddValue ("check", "compare the tables of the incremental and of the full update", check);
+  cmd.AddValue ("graphs", "random graphs checked with --check", graphs);
+  cmd.AddValue ("routers", "routers of a random graph", routers);
+  cmd.AddValue ("changes", "interface changes per random graph", changes);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("GlobalRoutingIncremental", BooleanValue (true));
+  if (check)
+    {
+      CheckRandomGraphs (graphs, routers, changes);
+      std::cout << graphs << " random graphs checked" << std::endl;
+    }
+
+  NodeContainer spineNodes;
+  spineNodes.Create (spines);
+  NodeContainer leafNodes;
+  leafNodes.Create (leaves);
+  NodeContainer hostNodes;
+  hostNodes.Create (leaves * hosts);
+  NodeContainer all (spineNodes, leafNodes, hostNodes);
+
+  InternetStackHelper internet;
+  internet.Install (all);
+
+  PointToPointHelper link;
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  NetDeviceContainer flapped;
+  for (uint32_t l = 0; l < leaves; l++)
+    {
+      for (uint32_t s = 0; s < spines; s++)
+        {
+          NetDeviceContainer devices = link.Install (leafNodes.Get (l), spineNodes.Get (s));
+          address.Assign (devices);
+          address.NewNetwork ();
+          if (l == 0 && s == 0)
+            {
+              flapped = devices;
+            }
+        }
+      for (uint32_t h = 0; h < hosts; h++)
+        {
+          NetDeviceContainer devices = link.Install (leafNodes.Get (l), hostNodes.Get (l * hosts + h));
+          address.Assign (devices);
+          address.NewNetwork ();
+        }
+    }
+
+  BenchTimer populate;
+  populate.Start ();
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  populate.Stop ();
+  std::cout << all.GetN () << " nodes, routes populated in " << populate.Ms () << " ms" << std::endl;
+
+  Ptr<Node> leaf = leafNodes.Get (0);
+  Ptr<Ipv4> ipv4 = leaf->GetObject<Ipv4> ();
+  uint32_t interface = ipv4->GetInterfaceForDevice (flapped.Get (0));
+
+  std::cout << "change\tincremental ms\tfull ms" << std::endl;
+  double incrementalTotal = 0;
+  double fullTotal = 0;
+  for (uint32_t i = 0; i < 2 * flaps; i++)
+    {
+      bool down = i % 2 == 0;
+      if (down)
+        {
+          ipv4->SetDown (interface);
+        }
+      else
+        {
+          ipv4->SetUp (interface);
+        }
+
+      BenchTimer incremental;
+      incremental.Start ();
+      GlobalRouteManager::UpdateRoutes (leaf);
+      incremental.Stop ();
+      std::vector<std::size_t> incrementalTables;
+      if (check)
+        {
+          incrementalTables = HashTables (all);
+        }
+
+      BenchTimer full;
+      full.Start ();
+      Recompute ();
+      full.Stop ();
+      if (check)
+        {
+          CheckTables (all, incrementalTables, HashTables (all), down ? "down" : "up");
+        }
+
+      incrementalTotal += incremental.Ms ();
+      fullTotal += full.Ms ();
+      std::cout << (down ? "down" : "up") << "\t" << incremental.Ms () << "\t" << full.Ms () << std::endl;
+    }
+  std::cout << "mean\t" << incrementalTotal / (2 * flaps) << "\t" << fullTotal / (2 * flaps) << std::endl;
+  return 0;
+}
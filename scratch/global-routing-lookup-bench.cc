@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Cost of a global routing lookup on a switch with a large table.
+ *
+ * The first leaf of a two-tier Clos (1960 nodes by default) routes a packet
+ * to every interface address, --rounds times, through RouteOutput, and the
+ * same destinations are looked up by a scan of a copy of the table, as
+ * before the prefix tries. Both must pick the same route.
+ *
+ * ./waf --run "scratch/global-routing-lookup-bench --rounds=100"
+ */
+
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("GlobalRoutingLookupBench");
+
+// first of the routes matching dest in a copy of the table
+static const Ipv4RoutingTableEntry *
+Scan (const std::vector<Ipv4RoutingTableEntry> &hostRoutes,
+      const std::vector<Ipv4RoutingTableEntry> &networkRoutes,
+      Ipv4Address dest)
+{
+  std::vector<const Ipv4RoutingTableEntry *> allRoutes;
+  for (uint32_t i = 0; i < hostRoutes.size (); i++)
+    {
+      if (hostRoutes[i].GetDest () == dest)
+        {
+          allRoutes.push_back (&hostRoutes[i]);
+        }
+    }
+  if (allRoutes.empty ())
+    {
+      for (uint32_t j = 0; j < networkRoutes.size (); j++)
+        {
+          if (networkRoutes[j].GetDestNetworkMask ().IsMatch (dest, networkRoutes[j].GetDestNetwork ()))
+            {
+              allRoutes.push_back (&networkRoutes[j]);
+            }
+        }
+    }
+  return allRoutes.empty () ? 0 : allRoutes[0];
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t spines = 8;
+  uint32_t leaves = 32;
+  uint32_t hosts = 60;
+  uint32_t rounds = 100;
+
+  CommandLine cmd;
+  cmd.AddValue ("spines", "spine switches", spines);
+  cmd.AddValue ("leaves", "leaf switches", leaves);
+  cmd.AddValue ("hosts", "hosts per leaf switch", hosts);
+  cmd.AddValue ("rounds", "lookups of every destination", rounds);
+  cmd.Parse (argc, argv);
+
+  NodeContainer spineNodes;
+  spineNodes.Create (spines);
+  NodeContainer leafNodes;
+  leafNodes.Create (leaves);
+  NodeContainer hostNodes;
+  hostNodes.Create (leaves * hosts);
+  NodeContainer all (spineNodes, leafNodes, hostNodes);
+
+  InternetStackHelper internet;
+  internet.Install (all);
+
+  PointToPointHelper link;
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  std::vector<Ipv4Address> destinations;
+  for (uint32_t l = 0; l < leaves; l++)
+    {
+      for (uint32_t s = 0; s < spines; s++)
+        {
+          Ipv4InterfaceContainer interfaces = address.Assign (link.Install (leafNodes.Get (l), spineNodes.Get (s)));
+          destinations.push_back (interfaces.GetAddress (0));
+          destinations.push_back (interfaces.GetAddress (1));
+          address.NewNetwork ();
+        }
+      for (uint32_t h = 0; h < hosts; h++)
+        {
+          Ipv4InterfaceContainer interfaces = address.Assign (link.Install (leafNodes.Get (l), hostNodes.Get (l * hosts + h)));
+          destinations.push_back (interfaces.GetAddress (0));
+          destinations.push_back (interfaces.GetAddress (1));
+          address.NewNetwork ();
+        }
+    }
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+
+  Ptr<Ipv4GlobalRouting> routing = leafNodes.Get (0)->GetObject<GlobalRouter> ()->GetRoutingProtocol ();
+  std::vector<Ipv4RoutingTableEntry> hostRoutes;
+  std::vector<Ipv4RoutingTableEntry> networkRoutes;
+  for (uint32_t i = 0; i < routing->GetNRoutes (); i++)
+    {
+      // GetRoute numbers the host routes first
+      Ipv4RoutingTableEntry route = *routing->GetRoute (i);
+      if (route.IsHost () && networkRoutes.empty ())
+        {
+          hostRoutes.push_back (route);
+        }
+      else
+        {
+          networkRoutes.push_back (route);
+        }
+    }
+  std::cout << all.GetN () << " nodes, " << hostRoutes.size () << " host and "
+            << networkRoutes.size () << " network routes on the leaf switch, "
+            << destinations.size () << " destinations" << std::endl;
+
+  Ptr<Packet> packet = Create<Packet> ();
+  Ptr<Ipv4> ipv4 = leafNodes.Get (0)->GetObject<Ipv4> ();
+  for (uint32_t d = 0; d < destinations.size (); d++)
+    {
+      Ipv4Header header;
+      header.SetDestination (destinations[d]);
+      Socket::SocketErrno sockerr;
+      Ptr<Ipv4Route> route = routing->RouteOutput (packet, header, 0, sockerr);
+      const Ipv4RoutingTableEntry *scanned = Scan (hostRoutes, networkRoutes, destinations[d]);
+      NS_ABORT_MSG_UNLESS ((route == 0) == (scanned == 0), "lookup and scan disagree on " << destinations[d]);
+      NS_ABORT_MSG_UNLESS (route == 0 || (route->GetGateway () == scanned->GetGateway ()
+                                          && route->GetOutputDevice () == ipv4->GetNetDevice (scanned->GetInterface ())),
+                           "lookup and scan pick other routes to " << destinations[d]);
+    }
+
+  uint64_t lookups = uint64_t (rounds) * destinations.size ();
+  uint32_t routed = 0;
+  BenchTimer lookup;
+  lookup.Start ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      for (uint32_t d = 0; d < destinations.size (); d++)
+        {
+          Ipv4Header header;
+          header.SetDestination (destinations[d]);
+          Socket::SocketErrno sockerr;
+          routed += routing->RouteOutput (packet, header, 0, sockerr) != 0;
+        }
+    }
+  lookup.Stop ();
+
+  BenchTimer scan;
+  scan.Start ();
+  for (uint32_t r = 0; r < rounds; r++)
+    {
+      for (uint32_t d = 0; d < destinations.size (); d++)
+        {
+          routed += Scan (hostRoutes, networkRoutes, destinations[d]) != 0;
+        }
+    }
+  scan.Stop ();
+
+  std::cout << "RouteOutput\t" << lookup.NsPer (lookups) << " ns per lookup" << std::endl;
+  std::cout << "table scan\t" << scan.NsPer (lookups) << " ns per lookup" << std::endl;
+  std::cout << routed << " routed" << std::endl;
+  return 0;
+}
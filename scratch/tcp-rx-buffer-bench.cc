@@ -0,0 +1,469 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Microbenchmark and regression check of the TcpRxBuffer reordering.
+ *
+ * A receiver with a window of W segments Adds the segments of a lossy path
+ * and Extracts the in-order data; the program times both per segment. With
+ * --check, on this input and first on random segments (overlaps, holes,
+ * duplicates, wrap-around), the Add result, RCV.NXT, Size, Available,
+ * MaxRxSequence and the extracted bytes must match a reference buffer
+ * keeping the segments in a map, and the SACK list must hold at most 4
+ * whole blocks, the first one holding the segment just stored (RFC 2018).
+ *
+ * ./waf --run "scratch/tcp-rx-buffer-bench --windows=100,1000,10000"
+ */
+
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/tcp-rx-buffer.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpRxBufferBench");
+
+static const uint32_t MSS = 1000;
+
+// payload byte at a sequence number, to check the extracted data
+static uint8_t
+PayloadByte (SequenceNumber32 seq)
+{
+  return static_cast<uint8_t> (seq.GetValue () * 131 + 7);
+}
+
+static Ptr<Packet>
+MakeSegment (SequenceNumber32 seq, uint32_t size)
+{
+  std::vector<uint8_t> data (size);
+  for (uint32_t i = 0; i < size; i++)
+    {
+      data[i] = PayloadByte (seq + SequenceNumber32 (i));
+    }
+  return Create<Packet> (data.data (), size);
+}
+
+/*
+ * TcpRxBuffer as a map of segments: the in-order data is found by walking
+ * the map from the front after each Add, and a new SACK block is merged
+ * with the list block by block.
+ */
+class ReferenceRxBuffer
+{
+public:
+  ReferenceRxBuffer (SequenceNumber32 n, uint32_t maxBuffer)
+    : m_nextRxSeq (n),
+      m_size (0),
+      m_maxBuffer (maxBuffer),
+      m_availBytes (0)
+  {
+  }
+
+  bool Add (Ptr<Packet> p, SequenceNumber32 seq)
+  {
+    SequenceNumber32 headSeq = seq;
+    SequenceNumber32 tailSeq = seq + SequenceNumber32 (p->GetSize ());
+    if (headSeq < m_nextRxSeq)
+      {
+        headSeq = m_nextRxSeq;
+      }
+    if (!m_data.empty ())
+      {
+        SequenceNumber32 maxSeq = m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+        if (maxSeq < tailSeq)
+          {
+            tailSeq = maxSeq;
+          }
+        if (tailSeq < headSeq)
+          {
+            headSeq = tailSeq;
+          }
+      }
+    std::map<SequenceNumber32, Ptr<Packet> >::iterator i = m_data.begin ();
+    while (i != m_data.end () && i->first <= tailSeq)
+      {
+        SequenceNumber32 lastByteSeq = i->first + SequenceNumber32 (i->second->GetSize ());
+        if (lastByteSeq > headSeq)
+          {
+            if (i->first > headSeq && lastByteSeq < tailSeq)
+              {
+                m_size -= i->second->GetSize ();
+                m_data.erase (i++);
+                continue;
+              }
+            if (i->first <= headSeq)
+              {
+                headSeq = lastByteSeq;
+              }
+            if (lastByteSeq >= tailSeq)
+              {
+                tailSeq = i->first;
+              }
+          }
+        ++i;
+      }
+    if (headSeq >= tailSeq)
+      {
+        return false;
+      }
+    m_data[headSeq] = p->CreateFragment (headSeq - seq, tailSeq - headSeq);
+    m_lastHead = headSeq;
+    if (headSeq > m_nextRxSeq)
+      {
+        UpdateSackList (headSeq, tailSeq);
+      }
+    m_size += tailSeq - headSeq;
+    for (i = m_data.begin (); i != m_data.end () && i->first <= m_nextRxSeq; ++i)
+      {
+        if (i->first == m_nextRxSeq)
+          {
+            m_nextRxSeq = i->first + SequenceNumber32 (i->second->GetSize ());
+            m_availBytes += i->second->GetSize ();
+            ClearSackList (m_nextRxSeq);
+          }
+      }
+    return true;
+  }
+
+  Ptr<Packet> Extract (uint32_t maxSize)
+  {
+    uint32_t extractSize = std::min (maxSize, m_availBytes);
+    if (extractSize == 0)
+      {
+        return 0;
+      }
+    Ptr<Packet> outPkt = Create<Packet> ();
+    while (extractSize)
+      {
+        std::map<SequenceNumber32, Ptr<Packet> >::iterator i = m_data.begin ();
+        uint32_t pktSize = i->second->GetSize ();
+        uint32_t size = std::min (pktSize, extractSize);
+        outPkt->AddAtEnd (i->second->CreateFragment (0, size));
+        if (size < pktSize)
+          {
+            m_data[i->first + SequenceNumber32 (size)] = i->second->CreateFragment (size, pktSize - size);
+          }
+        m_data.erase (i);
+        m_size -= size;
+        m_availBytes -= size;
+        extractSize -= size;
+      }
+    return outPkt;
+  }
+
+  SequenceNumber32 NextRxSequence (void) const
+  {
+    return m_nextRxSeq;
+  }
+
+  SequenceNumber32 MaxRxSequence (void) const
+  {
+    if (!m_data.empty () && m_nextRxSeq > m_data.begin ()->first)
+      {
+        return m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+      }
+    return m_nextRxSeq + SequenceNumber32 (m_maxBuffer);
+  }
+
+  uint32_t Size (void) const
+  {
+    return m_size;
+  }
+
+  uint32_t Available (void) const
+  {
+    return m_availBytes;
+  }
+
+  // first byte stored by the last successful Add
+  SequenceNumber32 LastHead (void) const
+  {
+    return m_lastHead;
+  }
+
+  const TcpOptionSack::SackList &GetSackList (void) const
+  {
+    return m_sackList;
+  }
+
+  // contiguous blocks of the data after RCV.NXT
+  std::vector<TcpOptionSack::SackBlock> Blocks (void) const
+  {
+    std::vector<TcpOptionSack::SackBlock> blocks;
+    for (std::map<SequenceNumber32, Ptr<Packet> >::const_iterator i = m_data.begin (); i != m_data.end (); ++i)
+      {
+        SequenceNumber32 tail = i->first + SequenceNumber32 (i->second->GetSize ());
+        if (i->first <= m_nextRxSeq)
+          {
+            continue;
+          }
+        if (!blocks.empty () && blocks.back ().second == i->first)
+          {
+            blocks.back ().second = tail;
+          }
+        else
+          {
+            blocks.push_back (TcpOptionSack::SackBlock (i->first, tail));
+          }
+      }
+    return blocks;
+  }
+
+private:
+  void UpdateSackList (SequenceNumber32 head, SequenceNumber32 tail)
+  {
+    m_sackList.push_front (TcpOptionSack::SackBlock (head, tail));
+    TcpOptionSack::SackList::iterator it = m_sackList.begin ();
+    TcpOptionSack::SackBlock begin = *it;
+    for (++it; it != m_sackList.end (); ++it)
+      {
+        TcpOptionSack::SackBlock merged;
+        if (begin.first == it->second)
+          {
+            merged = TcpOptionSack::SackBlock (it->first, begin.second);
+          }
+        else if (begin.second == it->first)
+          {
+            merged = TcpOptionSack::SackBlock (begin.first, it->second);
+          }
+        else
+          {
+            continue;
+          }
+        m_sackList.erase (it);
+        m_sackList.pop_front ();
+        m_sackList.push_front (merged);
+        it = m_sackList.begin ();
+        begin = *it;
+      }
+    if (m_sackList.size () > 4)
+      {
+        m_sackList.pop_back ();
+      }
+  }
+
+  void ClearSackList (SequenceNumber32 seq)
+  {
+    for (TcpOptionSack::SackList::iterator it = m_sackList.begin (); it != m_sackList.end (); )
+      {
+        if (it->second <= seq)
+          {
+            it = m_sackList.erase (it);
+          }
+        else
+          {
+            ++it;
+          }
+      }
+  }
+
+  std::map<SequenceNumber32, Ptr<Packet> > m_data;
+  TcpOptionSack::SackList m_sackList;
+  SequenceNumber32 m_nextRxSeq;
+  SequenceNumber32 m_lastHead;
+  uint32_t m_size;
+  uint32_t m_maxBuffer;
+  uint32_t m_availBytes;
+};
+
+static bool
+Add (Ptr<TcpRxBuffer> buffer, ReferenceRxBuffer *reference, Ptr<Packet> p, SequenceNumber32 seq)
+{
+  TcpHeader header;
+  header.SetSequenceNumber (seq);
+  bool added = buffer->Add (p, header);
+  if (reference != 0)
+    {
+      SequenceNumber32 next = reference->NextRxSequence ();
+      BENCH_CHECK_EQUAL (added, reference->Add (p, seq), "Add of " << seq);
+      TcpOptionSack::SackList sack = buffer->GetSackList ();
+      NS_ABORT_MSG_UNLESS (!added || reference->NextRxSequence () > next || reference->LastHead () <= next
+                           || (!sack.empty () && sack.front ().first <= reference->LastHead ()
+                               && reference->LastHead () < sack.front ().second),
+                           "the first SACK block does not hold " << reference->LastHead ());
+    }
+  return added;
+}
+
+static Ptr<Packet>
+Extract (Ptr<TcpRxBuffer> buffer, ReferenceRxBuffer *reference, uint32_t maxSize)
+{
+  SequenceNumber32 head = buffer->NextRxSequence () - static_cast<int32_t> (buffer->Available ());
+  Ptr<Packet> p = buffer->Extract (maxSize);
+  if (reference != 0)
+    {
+      Ptr<Packet> expected = reference->Extract (maxSize);
+      uint32_t size = p == 0 ? 0 : p->GetSize ();
+      BENCH_CHECK_EQUAL (size, expected == 0 ? 0 : expected->GetSize (), "bytes of Extract (" << maxSize << ")");
+      std::vector<uint8_t> data (size);
+      if (size > 0)
+        {
+          p->CopyData (data.data (), size);
+        }
+      for (uint32_t i = 0; i < size; i++)
+        {
+          BENCH_CHECK_EQUAL (uint32_t (data[i]), uint32_t (PayloadByte (head + SequenceNumber32 (i))),
+                             "byte extracted at " << head + SequenceNumber32 (i));
+        }
+    }
+  return p;
+}
+
+static void
+Check (Ptr<TcpRxBuffer> buffer, const ReferenceRxBuffer &reference)
+{
+  BENCH_CHECK_EQUAL (buffer->NextRxSequence (), reference.NextRxSequence (), "RCV.NXT");
+  BENCH_CHECK_EQUAL (buffer->Size (), reference.Size (), "Size");
+  BENCH_CHECK_EQUAL (buffer->Available (), reference.Available (), "Available");
+  BENCH_CHECK_EQUAL (buffer->MaxRxSequence (), reference.MaxRxSequence (), "MaxRxSequence");
+
+  TcpOptionSack::SackList sack = buffer->GetSackList ();
+  NS_ABORT_MSG_UNLESS (sack.size () <= 4, sack.size () << " SACK blocks");
+  std::vector<TcpOptionSack::SackBlock> blocks = reference.Blocks ();
+  for (TcpOptionSack::SackList::iterator b = sack.begin (); b != sack.end (); ++b)
+    {
+      NS_ABORT_MSG_UNLESS (std::find (blocks.begin (), blocks.end (), *b) != blocks.end (),
+                           "SACK block [" << b->first << ", " << b->second << ") is not a block of the buffer");
+      NS_ABORT_MSG_UNLESS (std::find (std::next (b), sack.end (), *b) == sack.end (),
+                           "SACK block [" << b->first << ", " << b->second << ") is repeated");
+    }
+  // a full list may have dropped a block the reference still reports
+  if (sack.size () < 4)
+    {
+      const TcpOptionSack::SackList &expected = reference.GetSackList ();
+      for (TcpOptionSack::SackList::const_iterator e = expected.begin (); e != expected.end (); ++e)
+        {
+          bool covered = false;
+          for (TcpOptionSack::SackList::const_iterator b = sack.begin (); b != sack.end (); ++b)
+            {
+              covered = covered || (b->first <= e->first && e->second <= b->second);
+            }
+          NS_ABORT_MSG_UNLESS (covered, "reference SACK block [" << e->first << ", " << e->second << ") is missing");
+        }
+    }
+}
+
+// random segments and Extracts around RCV.NXT
+static void
+CheckRandom (Ptr<UniformRandomVariable> rng, uint32_t window, uint32_t steps)
+{
+  // close to the wraparound of the sequence numbers
+  SequenceNumber32 isn (0xffffffff - rng->GetInteger (0, 2 * window * MSS));
+  Ptr<TcpRxBuffer> buffer = CreateObject<TcpRxBuffer> (isn.GetValue ());
+  buffer->SetMaxBufferSize (window * MSS);
+  ReferenceRxBuffer reference (isn, window * MSS);
+  for (uint32_t step = 0; step < steps; step++)
+    {
+      if (rng->GetValue () < 0.7)
+        {
+          // in order, or up to twice the window ahead, maybe starting before
+          // an earlier segment or before RCV.NXT
+          uint32_t ahead = rng->GetValue () < 0.2 ? 0 : rng->GetInteger (0, 2 * window) * MSS;
+          uint32_t back = rng->GetValue () < 0.2 ? rng->GetInteger (0, MSS) : 0;
+          uint32_t size = rng->GetValue () < 0.7 ? MSS : rng->GetInteger (1, 3 * MSS);
+          SequenceNumber32 seq = reference.NextRxSequence () + SequenceNumber32 (ahead) - static_cast<int32_t> (back);
+          Add (buffer, &reference, MakeSegment (seq, size), seq);
+        }
+      else
+        {
+          uint32_t maxSize = rng->GetValue () < 0.5 ? rng->GetInteger (1, 2 * MSS) : window * MSS;
+          Extract (buffer, &reference, maxSize);
+        }
+      Check (buffer, reference);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string windows = "100,1000,10000";
+  uint32_t segments = 100000;
+  double loss = 0.01;
+  bool check = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("windows", "comma separated receive windows, in segments", windows);
+  cmd.AddValue ("segments", "segments received per window", segments);
+  cmd.AddValue ("loss", "drop probability of new segments", loss);
+  cmd.AddValue ("check", "compare each step with the reference buffer", check);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  std::cout << "window\tns/segment\tretransmissions" << std::endl;
+  std::vector<uint32_t> windowSizes = ParseSizes (windows);
+  for (uint32_t w = 0; w < windowSizes.size (); w++)
+    {
+      uint32_t window = windowSizes[w];
+      if (check)
+        {
+          CheckRandom (rng, window, 20000);
+        }
+
+      Ptr<TcpRxBuffer> buffer = CreateObject<TcpRxBuffer> (1);
+      buffer->SetMaxBufferSize (window * MSS);
+      ReferenceRxBuffer reference (SequenceNumber32 (1), window * MSS);
+      ReferenceRxBuffer *replay = check ? &reference : 0;
+
+      // segment numbers are counted from the first byte sent
+      std::deque<std::pair<uint32_t, uint32_t> > lost; // segment, retransmitted after this one is sent
+      uint32_t sent = 0;
+      uint32_t retransmissions = 0;
+      BenchTimer timer;
+      for (uint32_t received = 0; received < segments; )
+        {
+          uint32_t next = (buffer->NextRxSequence () - SequenceNumber32 (1)) / MSS;
+          uint32_t segment;
+          if (!lost.empty () && (lost.front ().second <= sent || sent == next + window))
+            {
+              segment = lost.front ().first;
+              lost.pop_front ();
+              retransmissions++;
+            }
+          else
+            {
+              NS_ABORT_MSG_IF (sent == next + window, "the window stalled");
+              segment = sent++;
+              if (rng->GetValue () < loss)
+                {
+                  lost.push_back (std::make_pair (segment, sent + 3));
+                  continue;
+                }
+            }
+          SequenceNumber32 seq (1 + segment * MSS);
+          Ptr<Packet> p = MakeSegment (seq, MSS);
+
+          timer.Start ();
+          Add (buffer, replay, p, seq);
+          Extract (buffer, replay, buffer->Available ());
+          timer.Stop ();
+          received++;
+          if (check)
+            {
+              Check (buffer, reference);
+            }
+        }
+
+      std::cout << window << "\t" << timer.NsPer (segments) << "\t" << retransmissions << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,367 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Microbenchmark and regression check of the TcpTxBuffer SACK scoreboard.
+ *
+ * A sender keeps W segments in flight over a lossy FIFO path and feeds the
+ * SACK blocks and ACKs of the receiver to Update and DiscardUpTo, sending
+ * through NextSeg; the program times these calls per ACK. With --check, the
+ * lost, sacked and retransmitted bytes, IsLost and NextSeg must match a
+ * reference scoreboard walking a plain list of segments, and the buffer
+ * runs its ConsistencyCheck after each change.
+ *
+ * ./waf --run "scratch/tcp-scoreboard-bench --windows=100,1000,10000"
+ */
+
+#include <deque>
+#include <limits>
+#include <map>
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/tcp-tx-buffer.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpScoreboardBench");
+
+static const uint32_t MSS = 1000;
+static const uint32_t DUPTHRESH = 3;
+
+static uint32_t
+ReceiverWindow (void)
+{
+  return std::numeric_limits<uint32_t>::max ();
+}
+
+/*
+ * The scoreboard as a list walk, on segments of MSS bytes: segment i starts
+ * at head + i * MSS.
+ */
+class ReferenceScoreboard
+{
+public:
+  struct Segment
+  {
+    bool sacked {false};
+    bool lost {false};
+    bool retrans {false};
+  };
+
+  ReferenceScoreboard (void)
+    : m_highestSack (-1)
+  {
+  }
+
+  void Send (uint32_t i)
+  {
+    if (i == m_segments.size ())
+      {
+        m_segments.push_back (Segment ());
+      }
+    else if (!m_segments[i].retrans)
+      {
+        m_segments[i].retrans = true;
+      }
+  }
+
+  // blocks in segments relative to the head, [first, second)
+  void Update (const std::vector<std::pair<uint32_t, uint32_t> > &blocks)
+  {
+    bool sacked = false;
+    for (uint32_t b = 0; b < blocks.size (); b++)
+      {
+        if (blocks[b].first > m_segments.size ())
+          {
+            return;
+          }
+        for (uint32_t i = blocks[b].first; i < blocks[b].second && i < m_segments.size (); i++)
+          {
+            if (!m_segments[i].sacked)
+              {
+                m_segments[i].sacked = true;
+                m_segments[i].lost = false;
+                m_highestSack = std::max (m_highestSack, static_cast<int32_t> (i));
+                sacked = true;
+              }
+          }
+      }
+    if (!sacked)
+      {
+        return;
+      }
+    // RFC 6675: lost if DupThresh segments above are sacked; the head is not counted
+    uint32_t count = 0;
+    for (int32_t i = m_highestSack; i > 0; i--)
+      {
+        if (m_segments[i].sacked)
+          {
+            count++;
+          }
+        if (count >= DUPTHRESH && !m_segments[i].sacked)
+          {
+            m_segments[i].lost = true;
+          }
+      }
+    if (count >= DUPTHRESH)
+      {
+        m_segments[0].lost = true;
+      }
+  }
+
+  void Ack (uint32_t n)
+  {
+    m_segments.erase (m_segments.begin (), m_segments.begin () + n);
+    m_highestSack -= n;
+    if (m_highestSack < 0)
+      {
+        m_highestSack = -1;
+      }
+  }
+
+  bool IsLost (uint32_t i) const
+  {
+    if (m_highestSack < 0 || static_cast<int32_t> (i) >= m_highestSack)
+      {
+        return false;
+      }
+    for (; i < m_segments.size (); i++)
+      {
+        if (m_segments[i].lost)
+          {
+            return true;
+          }
+        if (m_segments[i].sacked)
+          {
+            return false;
+          }
+      }
+    return false;
+  }
+
+  // segment to send, m_segments.size () for new data, -1 for none
+  int32_t NextSeg (bool isRecovery, bool hasNewData) const
+  {
+    int32_t rule3 = -1;
+    for (uint32_t i = 0; i < m_segments.size (); i++)
+      {
+        if (!m_segments[i].retrans && !m_segments[i].sacked)
+          {
+            if (m_segments[i].lost)
+              {
+                return i;
+              }
+            if (rule3 < 0 && isRecovery)
+              {
+                rule3 = i;
+              }
+          }
+      }
+    return hasNewData ? m_segments.size () : rule3;
+  }
+
+  uint32_t Bytes (bool Segment::*flag) const
+  {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < m_segments.size (); i++)
+      {
+        n += (m_segments[i].*flag) ? MSS : 0;
+      }
+    return n;
+  }
+
+private:
+  std::deque<Segment> m_segments;
+  int32_t m_highestSack;
+};
+
+static void
+Check (Ptr<TcpTxBuffer> buffer, const ReferenceScoreboard &reference, uint32_t segments)
+{
+  BENCH_CHECK_EQUAL (buffer->GetLost (), reference.Bytes (&ReferenceScoreboard::Segment::lost),
+                     "lost bytes of " << *buffer);
+  BENCH_CHECK_EQUAL (buffer->GetSacked (), reference.Bytes (&ReferenceScoreboard::Segment::sacked),
+                     "sacked bytes of " << *buffer);
+  BENCH_CHECK_EQUAL (buffer->GetRetransmitsCount (), reference.Bytes (&ReferenceScoreboard::Segment::retrans),
+                     "retransmitted bytes of " << *buffer);
+  for (uint32_t i = 0; i < segments; i++)
+    {
+      BENCH_CHECK_EQUAL (buffer->IsLost (buffer->HeadSequence () + i * MSS), reference.IsLost (i),
+                         "IsLost of segment " << i << " of " << *buffer);
+    }
+  bool hasNewData = buffer->SizeFromSequence (buffer->HeadSequence () + segments * MSS) > 0;
+  for (uint32_t rule3 = 0; rule3 < 2; rule3++)
+    {
+      SequenceNumber32 seq, seqHigh;
+      int32_t next = buffer->NextSeg (&seq, &seqHigh, rule3) ? (seq - buffer->HeadSequence ()) / MSS : -1;
+      BENCH_CHECK_EQUAL (next, reference.NextSeg (rule3, hasNewData), "NextSeg of " << *buffer);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string windows = "100,1000,10000";
+  uint32_t acks = 100000;
+  double loss = 0.01;
+  bool check = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("windows", "comma separated windows, in segments", windows);
+  cmd.AddValue ("acks", "ACKs timed per window", acks);
+  cmd.AddValue ("loss", "drop probability of new segments", loss);
+  cmd.AddValue ("check", "compare each step with the reference scoreboard", check);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+
+  std::cout << "window\tns/ack\tretransmissions" << std::endl;
+  std::vector<uint32_t> windowSizes = ParseSizes (windows);
+  for (uint32_t w = 0; w < windowSizes.size (); w++)
+    {
+      uint32_t window = windowSizes[w];
+      Ptr<TcpTxBuffer> buffer = CreateObject<TcpTxBuffer> ();
+      buffer->SetAttribute ("ConsistencyCheck", BooleanValue (check));
+      buffer->SetHeadSequence (SequenceNumber32 (1));
+      buffer->SetMaxBufferSize (std::numeric_limits<uint32_t>::max ());
+      buffer->SetSegmentSize (MSS);
+      buffer->SetDupAckThresh (DUPTHRESH);
+      buffer->SetRWndCallback (MakeCallback (&ReceiverWindow));
+      ReferenceScoreboard reference;
+
+      // segment numbers are counted from the first byte sent
+      std::deque<uint32_t> path;
+      std::map<uint32_t, uint32_t> received; // out of order runs, [first, second)
+      uint32_t cumAck = 0;
+      uint32_t sent = 0;
+      uint32_t retransmissions = 0;
+      BenchTimer timer;
+
+      for (uint32_t ack = 0; ack < acks; )
+        {
+          timer.Start ();
+          while (buffer->Size () - (sent - cumAck) * MSS < window * MSS)
+            {
+              buffer->Add (Create<Packet> (window * MSS));
+            }
+          SequenceNumber32 seq, seqHigh;
+          while (buffer->BytesInFlight () < window * MSS
+                 && buffer->NextSeg (&seq, &seqHigh, true))
+            {
+              uint32_t segment = cumAck + (seq - buffer->HeadSequence ()) / MSS;
+              buffer->CopyFromSequence (MSS, seq);
+              timer.Stop ();
+              if (check)
+                {
+                  reference.Send (segment - cumAck);
+                }
+              if (segment < sent)
+                {
+                  path.push_back (segment);
+                  retransmissions++;
+                }
+              else
+                {
+                  sent++;
+                  if (rng->GetValue () >= loss)
+                    {
+                      path.push_back (segment);
+                    }
+                }
+              timer.Start ();
+            }
+          timer.Stop ();
+          NS_ABORT_MSG_IF (path.empty (), "the window stalled");
+
+          // the receiver gets the first segment in the path
+          uint32_t segment = path.front ();
+          path.pop_front ();
+          if (segment >= cumAck)
+            {
+              uint32_t first = segment;
+              uint32_t last = segment + 1;
+              std::map<uint32_t, uint32_t>::iterator run = received.upper_bound (segment);
+              if (run != received.end () && run->first == last)
+                {
+                  last = run->second;
+                  run = received.erase (run);
+                }
+              if (run != received.begin () && std::prev (run)->second >= first)
+                {
+                  --run;
+                  first = run->first;
+                  last = std::max (last, run->second);
+                  received.erase (run);
+                }
+              received[first] = last;
+              if (received.begin ()->first == cumAck)
+                {
+                  cumAck = received.begin ()->second;
+                  received.erase (received.begin ());
+                }
+            }
+
+          TcpOptionSack::SackList blocks;
+          std::vector<std::pair<uint32_t, uint32_t> > referenceBlocks;
+          std::map<uint32_t, uint32_t>::iterator own = received.upper_bound (segment);
+          if (own != received.begin () && std::prev (own)->second > segment)
+            {
+              --own;
+              blocks.push_back (std::make_pair (SequenceNumber32 (1 + own->first * MSS),
+                                                SequenceNumber32 (1 + own->second * MSS)));
+              referenceBlocks.push_back (*own);
+            }
+          else
+            {
+              own = received.end ();
+            }
+          for (std::map<uint32_t, uint32_t>::reverse_iterator r = received.rbegin ();
+               r != received.rend () && blocks.size () < 3; ++r)
+            {
+              if (own == received.end () || r->first != own->first)
+                {
+                  blocks.push_back (std::make_pair (SequenceNumber32 (1 + r->first * MSS),
+                                                    SequenceNumber32 (1 + r->second * MSS)));
+                  referenceBlocks.push_back (*r);
+                }
+            }
+
+          uint32_t acked = cumAck - (buffer->HeadSequence () - SequenceNumber32 (1)) / MSS;
+          timer.Start ();
+          buffer->Update (blocks);
+          buffer->DiscardUpTo (SequenceNumber32 (1 + cumAck * MSS));
+          timer.Stop ();
+          ack++;
+
+          if (check)
+            {
+              uint32_t head = cumAck - acked;
+              for (uint32_t b = 0; b < referenceBlocks.size (); b++)
+                {
+                  referenceBlocks[b].first -= head;
+                  referenceBlocks[b].second -= head;
+                }
+              reference.Update (referenceBlocks);
+              reference.Ack (acked);
+              Check (buffer, reference, sent - cumAck);
+            }
+        }
+
+      std::cout << window << "\t" << timer.NsPer (acks) << "\t" << retransmissions << std::endl;
+    }
+  return 0;
+}
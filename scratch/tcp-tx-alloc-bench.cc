@@ -0,0 +1,212 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Allocations of the TcpTxBuffer send path, with and without the
+ * SegmentAligned attribute.
+ *
+ * A bulk sender adds --sendSize byte writes and sends --mss byte segments
+ * the way TcpSocketBase::SendDataPacket does, with a fraction --retransmit
+ * of retransmissions and --partial of short segments. The program counts
+ * the operator new calls from Add to DiscardUpTo, as Packet has no counter,
+ * and times the path per MB. With --check, every transmitted byte must
+ * match the pattern written by the application.
+ *
+ * ./waf --run "scratch/tcp-tx-alloc-bench --mb=100"
+ */
+
+#include <cstdlib>
+#include <deque>
+#include <limits>
+#include <new>
+#include <vector>
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/tcp-tx-buffer.h"
+#include "bench-helpers.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpTxAllocBench");
+
+static uint64_t g_allocations = 0;
+
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size == 0 ? 1 : size);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void *
+operator new[] (std::size_t size)
+{
+  return operator new (size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete[] (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete[] (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+static uint32_t
+ReceiverWindow (void)
+{
+  return std::numeric_limits<uint32_t>::max ();
+}
+
+// byte of the stream at offset, when each write of sendSize bytes carries the pattern
+static uint8_t
+PatternByte (uint64_t offset, uint32_t sendSize)
+{
+  return static_cast<uint8_t> ((offset % sendSize) * 7 + 1);
+}
+
+static void
+Verify (Ptr<Packet> p, const SequenceNumber32 &seq, uint32_t sendSize, std::vector<uint8_t> &data)
+{
+  p->CopyData (data.data (), p->GetSize ());
+  for (uint32_t i = 0; i < p->GetSize (); i++)
+    {
+      BENCH_CHECK_EQUAL (uint32_t (data[i]), uint32_t (PatternByte (seq.GetValue () - 1 + i, sendSize)),
+                         "byte " << i << " of the segment at " << seq);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t mb = 100;
+  uint32_t sendSize = 512;
+  uint32_t mss = 536;
+  uint32_t window = 100;
+  double retransmit = 0.01;
+  double partial = 0.0;
+  bool check = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("mb", "MB transmitted per mode", mb);
+  cmd.AddValue ("sendSize", "bytes per application write", sendSize);
+  cmd.AddValue ("mss", "segment size", mss);
+  cmd.AddValue ("window", "segments in flight", window);
+  cmd.AddValue ("retransmit", "fraction of ACKs preceded by a retransmission of the head", retransmit);
+  cmd.AddValue ("partial", "fraction of new segments shortened by the window", partial);
+  cmd.AddValue ("check", "verify the content of every transmitted packet", check);
+  cmd.Parse (argc, argv);
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  uint64_t total = static_cast<uint64_t> (mb) * 1000000;
+  std::vector<uint8_t> data (std::max (mss, sendSize));
+
+  Ptr<Packet> chunk;
+  if (check)
+    {
+      for (uint32_t i = 0; i < sendSize; i++)
+        {
+          data[i] = PatternByte (i, sendSize);
+        }
+      chunk = Create<Packet> (data.data (), sendSize);
+    }
+  else
+    {
+      chunk = Create<Packet> (sendSize);
+    }
+
+  std::cout << "mode\tallocations/MB\tns/MB\tsegments\tretransmissions" << std::endl;
+  for (uint32_t aligned = 0; aligned < 2; aligned++)
+    {
+      Ptr<TcpTxBuffer> buffer = CreateObject<TcpTxBuffer> ();
+      buffer->SetAttribute ("SegmentAligned", BooleanValue (aligned));
+      buffer->SetHeadSequence (SequenceNumber32 (1));
+      buffer->SetMaxBufferSize (2 * window * mss);
+      buffer->SetSegmentSize (mss);
+      buffer->SetRWndCallback (MakeCallback (&ReceiverWindow));
+      RngSeedManager::SetRun (1);
+      rng = CreateObject<UniformRandomVariable> ();
+
+      std::deque<SequenceNumber32> inFlight; // end of each segment
+      SequenceNumber32 next (1);
+      uint64_t added = 0;
+      uint64_t segments = 0;
+      uint64_t retransmissions = 0;
+      uint64_t allocations = 0;
+      BenchTimer timer;
+
+      while (buffer->HeadSequence ().GetValue () - 1 < total)
+        {
+          uint64_t before = g_allocations;
+          timer.Start ();
+          while (added < total && buffer->Available () >= sendSize)
+            {
+              buffer->Add (chunk);
+              added += sendSize;
+            }
+          while (inFlight.size () < window && buffer->SizeFromSequence (next) > 0)
+            {
+              uint32_t size = rng->GetValue () < partial ? rng->GetInteger (1, mss) : mss;
+              Ptr<Packet> p = buffer->CopyFromSequence (size, next)->GetPacketCopy ();
+              if (check)
+                {
+                  Verify (p, next, sendSize, data);
+                }
+              next += p->GetSize ();
+              inFlight.push_back (next);
+              segments++;
+            }
+          if (rng->GetValue () < retransmit)
+            {
+              Ptr<Packet> p = buffer->CopyFromSequence (mss, buffer->HeadSequence ())->GetPacketCopy ();
+              if (check)
+                {
+                  Verify (p, buffer->HeadSequence (), sendSize, data);
+                }
+              retransmissions++;
+            }
+          buffer->DiscardUpTo (inFlight.front ());
+          inFlight.pop_front ();
+          timer.Stop ();
+          allocations += g_allocations - before;
+        }
+
+      std::cout << (aligned ? "aligned" : "default") << "\t" << static_cast<double> (allocations) / mb
+                << "\t" << timer.NsPer (mb) << "\t" << segments << "\t" << retransmissions << std::endl;
+    }
+  return 0;
+}
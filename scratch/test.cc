@@ -40,7 +40,7 @@
 
 #include <iostream>
 #include <fstream>
-#include <queue>
+#include <vector>
 
 #include "ns3/error-model.h"
 #include "ns3/core-module.h"
@@ -55,9 +55,18 @@ using namespace ns3;
 NS_LOG_COMPONENT_DEFINE("test-incast-example");
 double queue_stat = 0;
 double queue_stat_num = 0;
-std::priority_queue<double> rtt_pq;
+// streaming RTT quantiles: one sketch per sender flow, plus samples of other sockets
+Ptr<QuantileSketch> rtt_sketch;
+std::vector<Ptr<QuantileSketch>> flow_rtt;
 bool redir_output = true;
 
+// columnar binary trace of the G/Q/RTT series, read by Draw/main.py
+Ptr<BinaryTraceWriter> trace_writer;
+uint32_t series_g;
+uint32_t series_q;
+uint32_t series_rtt;
+uint32_t series_rate;
+
 // referring to congestion_control example
 void TcPacketsInQueueTrace(uint32_t oldValue, uint32_t newValue)
 {
@@ -66,7 +75,7 @@ void TcPacketsInQueueTrace(uint32_t oldValue, uint32_t newValue)
 
     if (redir_output)
     {
-        std::cout << "Q," << newValue << "," << ns3::Simulator::Now().GetMicroSeconds() << std::endl;
+        trace_writer->Write(series_q, newValue);
     }
 }
 // tail/avg rtt stat
@@ -74,9 +83,59 @@ void TCPrtt_stat(double rtt)
 {
     if (redir_output)
     {
-        std::cout << "RTT," << rtt << "," << ns3::Simulator::Now().GetMicroSeconds() << std::endl;
+        trace_writer->Write(series_rtt, rtt);
+    }
+    rtt_sketch->Add(rtt);
+}
+
+void FlowRtt_stat(uint32_t flow, double rtt)
+{
+    if (redir_output)
+    {
+        trace_writer->Write(series_rtt, rtt);
     }
-    rtt_pq.push(rtt);
+    flow_rtt[flow]->Add(rtt);
+}
+
+// the sender sockets only exist once the applications are started
+void ConnectFlowRttStats(ApplicationContainer apps)
+{
+    for (uint32_t i = 0; i < apps.GetN(); i++)
+    {
+        Ptr<Socket> socket = DynamicCast<BulkSendApplication>(apps.Get(i))->GetSocket();
+        PointerValue cc;
+        socket->GetAttribute("CongestionOps", cc);
+        cc.Get<TcpCongestionOps>()->SetAttribute("TCP_RTTstat", CallbackValue(MakeBoundCallback(&FlowRtt_stat, i)));
+    }
+}
+
+void PrintRttQuantiles(std::string name, Ptr<QuantileSketch> sketch)
+{
+    std::cout << name << " RTT p50/p90/p99/p99.9: "
+              << sketch->GetQuantile(0.5) << " / "
+              << sketch->GetQuantile(0.9) << " / "
+              << sketch->GetQuantile(0.99) << " / "
+              << sketch->GetQuantile(0.999) << " μs ("
+              << sketch->GetCount() << " samples)" << std::endl;
+}
+
+void TimelyGradientTrace(double oldValue, double newValue)
+{
+    trace_writer->Write(series_g, newValue);
+}
+
+void TimelyRateTrace(double oldValue, double newValue)
+{
+    trace_writer->Write(series_rate, newValue);
+}
+
+// TIMELY instances only exist once the sockets are created by the applications
+void ConnectTimelyTraces()
+{
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::TcpL4Protocol/SocketList/*/CongestionOps/$ns3::TCPCCTIMELY/NormalizedGradient",
+                                  MakeCallback(&TimelyGradientTrace));
+    Config::ConnectWithoutContext("/NodeList/*/$ns3::TcpL4Protocol/SocketList/*/CongestionOps/$ns3::TCPCCTIMELY/SendingRate",
+                                  MakeCallback(&TimelyRateTrace));
 }
 
 int main(int argc, char *argv[])
@@ -93,13 +152,23 @@ int main(int argc, char *argv[])
     double Lth = 500;
     double initial_rate = 5;
     uint32_t n = 5; // HAI
+    bool paced = false; // drive the pacing rate instead of cwnd
+    bool precise_rtt = false; // full resolution RTT samples (TcpTimestampTag)
+    bool aligned_tx = false; // TX buffer cut into segments at enqueue (TcpTxBuffer::SegmentAligned)
+    bool rtt_per_segment = false; // one RTT sample per ACKed segment (TcpSocketBase::RttPerSegment)
+    uint32_t ack_coalesce = 0; // receiver ACKs once per this many bytes (TcpSocketBase::RxCoalesceBytes), 0 uses delayed ACKs
+    uint32_t tso = 0; // largest super-segment handed to IPv4 (TcpSocketBase::TsoMaxSize), 0 disables
+    bool checksum = false; // compute and verify IPv4 and TCP checksums (ChecksumEnabled)
+    bool timer_wheel = false; // TCP timers on a per-node timer wheel (TcpTimerWheel::Enabled)
+    bool batch_sent = false; // one DataSent notification per batch of segments (TcpSocketBase::BatchDataSent)
+    uint32_t chunk = 0; // bytes per completion event, 0 updates on ACKs
 
 
     // test env parameters
     std::string bandWidth = "25Mbps";
     std::string delay = "2us";
     double start_t = 1;
-    double end_t = 11;
+    double end_t = 10; // sending time, offset by start_t after parsing
     int active_incast = 15;
     int incast_num = 15;
     redir_output = true;
@@ -107,6 +176,8 @@ int main(int argc, char *argv[])
     int queueSize = 800000; // bytes
 
     std::string congestion_rule = "TCPCCTIMELY";
+    std::string trace_dir = "timely_trace";
+    std::string topology = "bridge";
 
     CommandLine ops;
     ops.AddValue("congestion", "Protocol to use: TCPCCTIMELY, TcpNewReno, TcpLinuxReno, "
@@ -118,6 +189,9 @@ int main(int argc, char *argv[])
     ops.AddValue("bandwitdh", "egress bandwidth", bandWidth);
     ops.AddValue("incast", "incast num", incast_num);
     ops.AddValue("incast", "active incast", active_incast);
+    ops.AddValue("queue_size", "switch egress queue size in bytes", queueSize);
+    ops.AddValue("duration", "seconds the sources send for", end_t);
+    ops.AddValue("topology", "bridge (CSMA learning bridge) or star (output-queued switch)", topology);
     ops.AddValue("Alpha", "Alpha", Alpha);
     ops.AddValue("AI", "AI", AI);
     ops.AddValue("MD", "MD", MD);
@@ -125,11 +199,25 @@ int main(int argc, char *argv[])
     ops.AddValue("Hth", "Hth", Hth);
     ops.AddValue("Lth", "Lth", Lth);
     ops.AddValue("HAI", "HAI counter", n);
+    ops.AddValue("paced", "TIMELY paced rate mode", paced);
+    ops.AddValue("precise_rtt", "full resolution RTT samples", precise_rtt);
+    ops.AddValue("aligned_tx", "segment-aligned TX buffer", aligned_tx);
+    ops.AddValue("rtt_per_segment", "RTT sample per ACKed segment", rtt_per_segment);
+    ops.AddValue("ack_coalesce", "receiver bytes per ACK", ack_coalesce);
+    ops.AddValue("tso", "segmentation offload size in bytes", tso);
+    ops.AddValue("checksum", "compute and verify checksums", checksum);
+    ops.AddValue("timer_wheel", "TCP timers on a per-node timer wheel", timer_wheel);
+    ops.AddValue("batch_sent", "batched DataSent notifications", batch_sent);
+    ops.AddValue("chunk", "bytes per completion event", chunk);
+    ops.AddValue("trace", "write the G/Q/RTT series", redir_output);
+    ops.AddValue("trace_dir", "binary trace directory, one file per series", trace_dir);
 
     Config::SetDefault("ns3::TcpCongestionOps::TCP_RTTstat", CallbackValue(MakeCallback(&TCPrtt_stat)));
+    rtt_sketch = CreateObject<QuantileSketch>();
 
     // running flag
     ops.Parse(argc, argv);
+    end_t += start_t;
     if (show_options)
     {
         std::cout << "-------------------options-----------------" << std::endl;
@@ -142,6 +230,9 @@ int main(int argc, char *argv[])
                   << std::endl;
         std::cout << "--bandwitdh [define bandwidth: for example, 25Mbps]" << std::endl;
         std::cout << "--incast [define incast size: for example, 10]" << std::endl;
+        std::cout << "--queue_size [switch egress queue size in bytes: for example, 800000]" << std::endl;
+        std::cout << "--duration [seconds the sources send for: for example, 10]" << std::endl;
+        std::cout << "--topology [star: point-to-point links to an output-queued switch, bridge: CSMA links to a learning bridge, default bridge]" << std::endl;
         std::cout << "--Alpha [define EWMA weight: for example, 0.5]" << std::endl;
         std::cout << "--AI [define additive increase param: for example, 1]" << std::endl;
         std::cout << "--MD [define multiplicative decrease param: for example, 0.05]" << std::endl;
@@ -149,11 +240,31 @@ int main(int argc, char *argv[])
         std::cout << "--Hth [define Higher threshold: for example, 5500]" << std::endl;
         std::cout << "--initial_rate [define initial sending rate: for example, 5]" << std::endl;
         std::cout << "--HAI [define HAI counter: for example, 5]" << std::endl;
+        std::cout << "--paced [pace segments at the TIMELY rate instead of using it as cwnd: true/false, default false]" << std::endl;
+        std::cout << "--precise_rtt [nanosecond send timestamps echoed by the receiver for RTT samples: true/false, default false]" << std::endl;
+        std::cout << "--aligned_tx [cut application data into segments in the TX buffer, no split/merge on send: true/false, default false]" << std::endl;
+        std::cout << "--rtt_per_segment [RTT sample for every segment an ACK covers, fed to TIMELY and Vegas: true/false, default false]" << std::endl;
+        std::cout << "--ack_coalesce [receiver sends one ACK per this many in-sequence bytes, 0 uses delayed ACKs: for example, 65536, default 0]" << std::endl;
+        std::cout << "--tso [bytes of new data sent as one super-segment and cut into MSS segments by IPv4, 0 disables: for example, 64000, default 0]" << std::endl;
+        std::cout << "--checksum [compute IPv4 and TCP checksums on send and verify them on receive: true/false, default false]" << std::endl;
+        std::cout << "--timer_wheel [keep the TCP retransmission, delayed ACK and persist timers on a per-node timer wheel: true/false, default false]" << std::endl;
+        std::cout << "--batch_sent [notify the application of the data sent once per batch of segments, not once per segment: true/false, default false]" << std::endl;
+        std::cout << "--chunk [bytes ACKed per completion event, 0 updates on ACKs: for example, 16384, default 0]" << std::endl;
+        std::cout << "--trace [write the G/Q/RTT series: true/false, default true]" << std::endl;
+        std::cout << "--trace_dir [binary trace directory read by Draw/main.py, default timely_trace]" << std::endl;
 
 
         return 0;
     }
 
+    Config::SetDefault("ns3::TcpTxBuffer::SegmentAligned", BooleanValue(aligned_tx));
+    Config::SetDefault("ns3::TcpSocketBase::RttPerSegment", BooleanValue(rtt_per_segment));
+    Config::SetDefault("ns3::TcpSocketBase::RxCoalesceBytes", UintegerValue(ack_coalesce));
+    Config::SetDefault("ns3::TcpSocketBase::TsoMaxSize", UintegerValue(tso));
+    GlobalValue::Bind("ChecksumEnabled", BooleanValue(checksum));
+    Config::SetDefault("ns3::TcpTimerWheel::Enabled", BooleanValue(timer_wheel));
+    Config::SetDefault("ns3::TcpSocketBase::BatchDataSent", BooleanValue(batch_sent));
+
     // support tcp congestion rules
     if (congestion_rule.compare("TCPCCTIMELY") == 0)
     {
@@ -166,7 +277,13 @@ int main(int argc, char *argv[])
         Config::SetDefault("ns3::TCPCCTIMELY::Lth", DoubleValue(Lth));
         Config::SetDefault("ns3::TCPCCTIMELY::N_hai", UintegerValue(n));
         Config::SetDefault("ns3::TCPCCTIMELY::initial_rate", DoubleValue(initial_rate));
+        Config::SetDefault("ns3::TCPCCTIMELY::CompletionEventBytes", UintegerValue(chunk));
+        if (paced)
+        {
+            Config::SetDefault("ns3::TCPCCTIMELY::RateMode", EnumValue(TCPCCTIMELY::PACED));
+        }
         Config::SetDefault("ns3::TcpSocketBase::ClockGranularity", TimeValue(Time("1ns")));
+        Config::SetDefault("ns3::TcpSocketBase::PreciseRtt", BooleanValue(precise_rtt));
     }
     else
     {
@@ -178,38 +295,84 @@ int main(int argc, char *argv[])
         Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(TypeId::LookupByName(congestion_rule)));
     }
 
-    NodeContainer nodeContainer;
-    // N to 1 incast
-    nodeContainer.Create(incast_num + 1);
+    if (redir_output)
+    {
+        trace_writer = Create<BinaryTraceWriter>(trace_dir);
+        series_g = trace_writer->AddSeries("G");
+        series_q = trace_writer->AddSeries("Q");
+        series_rtt = trace_writer->AddSeries("RTT");
+        series_rate = trace_writer->AddSeries("RATE");
+    }
 
-    // one ethernet switch
-    NodeContainer ethernetSwitch;
-    ethernetSwitch.Create(1);
+    // N to 1 incast
+    Ptr<Node> sinkNode;
+    NodeContainer senders;
+    Ipv4Address sinkAddress;
+    Ptr<Queue<Packet>> switch_queue;
     CsmaHelper helper;
-    // set bandwidth and delay
-    helper.SetChannelAttribute("DataRate", StringValue(bandWidth)); 
-    helper.SetChannelAttribute("Delay", StringValue(delay));       
-
-    NetDeviceContainer nodedevicecontainer;
-    NetDeviceContainer switchdevicecontainer;
-
-    for (int i = 0; i < incast_num + 1; i++)
+    if (topology.compare("bridge") == 0)
     {
-        NetDeviceContainer connection = helper.Install(NodeContainer(nodeContainer.Get(i), ethernetSwitch));
-        nodedevicecontainer.Add(connection.Get(0));
-        switchdevicecontainer.Add(connection.Get(1));
+        NodeContainer nodeContainer;
+        nodeContainer.Create(incast_num + 1);
+
+        // one ethernet switch
+        NodeContainer ethernetSwitch;
+        ethernetSwitch.Create(1);
+        // set bandwidth and delay
+        helper.SetChannelAttribute("DataRate", StringValue(bandWidth));
+        helper.SetChannelAttribute("Delay", StringValue(delay));
+
+        NetDeviceContainer nodedevicecontainer;
+        NetDeviceContainer switchdevicecontainer;
+
+        for (int i = 0; i < incast_num + 1; i++)
+        {
+            NetDeviceContainer connection = helper.Install(NodeContainer(nodeContainer.Get(i), ethernetSwitch));
+            nodedevicecontainer.Add(connection.Get(0));
+            switchdevicecontainer.Add(connection.Get(1));
+        }
+        Ptr<Node> ethernetSwitchPtr = ethernetSwitch.Get(0);
+        BridgeHelper br;
+        br.Install(ethernetSwitchPtr, switchdevicecontainer);
+
+        // install L4 stack
+        InternetStackHelper internet;
+        internet.Install(nodeContainer);
+
+        Ipv4AddressHelper ip;
+        ip.SetBase("11.11.11.0", "255.255.255.0");
+        ip.Assign(nodedevicecontainer);
+
+        sinkNode = nodeContainer.Get(0);
+        for (int i = 1; i < incast_num + 1; i++)
+        {
+            senders.Add(nodeContainer.Get(i));
+        }
+        sinkAddress = Ipv4Address("11.11.11.1");
+        switch_queue = DynamicCast<CsmaNetDevice>(switchdevicecontainer.Get(0))->GetQueue();
+        switch_queue->SetMaxSize(QueueSize(BYTES, queueSize));
+    }
+    else
+    {
+        // full duplex links to an output-queued switch, cost per packet independent of incast_num
+        IncastStarHelper star(incast_num);
+        star.SetDeviceAttribute("DataRate", StringValue(bandWidth));
+        star.SetChannelAttribute("Delay", StringValue(delay));
+        star.SetSwitchAttribute("BufferSize", UintegerValue(queueSize));
+        star.Install();
+
+        InternetStackHelper internet;
+        star.InstallStack(internet);
+
+        Ipv4AddressHelper ip;
+        ip.SetBase("11.11.0.0", "255.255.0.0");
+        star.AssignIpv4Addresses(ip);
+
+        sinkNode = star.GetSink();
+        senders = star.GetSenders();
+        sinkAddress = star.GetSinkIpv4Address();
+        switch_queue = star.GetBottleneckQueue();
     }
-    Ptr<Node> ethernetSwitchPtr = ethernetSwitch.Get(0);
-    BridgeHelper br;
-    br.Install(ethernetSwitchPtr, switchdevicecontainer);
-
-    // install L4 stack
-    InternetStackHelper internet;
-    internet.Install(nodeContainer);
-
-    Ipv4AddressHelper ip;
-    ip.SetBase("11.11.11.0", "255.255.255.0");
-    ip.Assign(nodedevicecontainer);
 
     NS_LOG_INFO("Create Applications.");
     uint16_t tcp_port = 8080;
@@ -218,80 +381,104 @@ int main(int argc, char *argv[])
     // sinker
     PacketSinkHelper pktsinkhelper("ns3::TcpSocketFactory",
                                    Address(InetSocketAddress(Ipv4Address::GetAny(), tcp_port)));
-    ApplicationContainer appSink = pktsinkhelper.Install(nodeContainer.Get(0));
+    ApplicationContainer appSink = pktsinkhelper.Install(sinkNode);
     appSink.Start(Seconds(start_t));
 
     //  destination host
-    AddressValue remoteaddr(InetSocketAddress(Ipv4Address("11.11.11.1"), tcp_port));
+    AddressValue remoteaddr(InetSocketAddress(sinkAddress, tcp_port));
 
     // sender
     ApplicationContainer srcapp;
     int incast = 0;
 
-    for (int i = 1; i < incast_num + 1 && active_incast > 0; i++)
+    for (uint32_t i = 0; i < senders.GetN() && active_incast > 0; i++)
     {
-
-        std::string src_ip = "11.11.11.";
-        src_ip = src_ip + std::to_string(1 + i);
-
         BulkSendHelper source_helper("ns3::TcpSocketFactory",
-                                     InetSocketAddress(Ipv4Address(src_ip.c_str()),
-                                                       7070 + i));
+                                     InetSocketAddress(sinkAddress, tcp_port));
         source_helper.SetAttribute("MaxBytes", UintegerValue(0));
         source_helper.SetAttribute("Remote", remoteaddr);
-        srcapp.Add(source_helper.Install(nodeContainer.Get(i)));
+        srcapp.Add(source_helper.Install(senders.Get(i)));
         active_incast -= 1;
         incast += 1;
     }
     srcapp.Start(Seconds(start_t));
     srcapp.Stop(Seconds(end_t));
+    for (uint32_t i = 0; i < srcapp.GetN(); i++)
+    {
+        flow_rtt.push_back(CreateObject<QuantileSketch>());
+    }
+    Simulator::Schedule(Seconds(start_t) + NanoSeconds(1), &ConnectFlowRttStats, srcapp);
+    if (redir_output && congestion_rule.compare("TCPCCTIMELY") == 0)
+    {
+        Simulator::Schedule(Seconds(start_t) + NanoSeconds(1), &ConnectTimelyTraces);
+    }
 
     std::cout << "Configured incast nodes number: " << std::to_string(incast) << std::endl;
 
     NS_LOG_INFO("Tracing:");
 
-    Ptr<Queue<Packet>> switch_queue = DynamicCast<CsmaNetDevice>(switchdevicecontainer.Get(0))->GetQueue();
-
-    switch_queue->SetMaxSize(QueueSize(BYTES, queueSize));
     switch_queue->TraceConnectWithoutContext("PacketsInQueue", MakeCallback(&TcPacketsInQueueTrace));
 
-    AsciiTraceHelper tracer_helper;
-    helper.EnableAsciiAll(tracer_helper.CreateFileStream("tracing_data.txt"));
-    helper.EnablePcapAll("csma-bridge", false);
+    if (topology.compare("bridge") == 0)
+    {
+        AsciiTraceHelper tracer_helper;
+        helper.EnableAsciiAll(tracer_helper.CreateFileStream("tracing_data.txt"));
+        helper.EnablePcapAll("csma-bridge", false);
+    }
 
     NS_LOG_INFO("Run Simulation.");
     // Simulator::Stop(Seconds(end_t+10));
     Simulator::Run();
-    Simulator::Destroy();
-    NS_LOG_INFO("Done.");
-
-    double totalrtt = 0;
-    int size = (int)(rtt_pq.size() * 0.01);
-    int median = (int)(rtt_pq.size() * 0.5);
-    int len = rtt_pq.size();
-    int i = 0;
-    for (; i < size; i++)
+    // the accepted sockets go away with the simulator
+    if (ack_coalesce > 0)
+    {
+        std::list<Ptr<Socket>> sinkSockets = DynamicCast<PacketSink>(appSink.Get(0))->GetAcceptedSockets();
+        for (std::list<Ptr<Socket>>::iterator it = sinkSockets.begin(); it != sinkSockets.end(); ++it)
+        {
+            Address peer;
+            (*it)->GetPeerName(peer);
+            std::cout << "ACK coalescing " << InetSocketAddress::ConvertFrom(peer).GetIpv4() << ": "
+                      << DynamicCast<TcpSocketBase>(*it)->GetAckCoalescingRatio() << " segments/ACK" << std::endl;
+        }
+    }
+    // TCP timer operations and the scheduler events they cost, all nodes
+    uint64_t timer_ops[5] = {0, 0, 0, 0, 0};
+    for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
     {
-        totalrtt += rtt_pq.top();
-        // pop largest one
-        rtt_pq.pop();
+        Ptr<TcpL4Protocol> tcp = (*it)->GetObject<TcpL4Protocol>();
+        if (tcp == nullptr)
+        {
+            continue;
+        }
+        Ptr<TcpTimerWheel> wheel = tcp->GetTimerWheel();
+        timer_ops[0] += wheel->GetTimerArms();
+        timer_ops[1] += wheel->GetTimerCancels();
+        timer_ops[2] += wheel->GetTimerExpirations();
+        timer_ops[3] += wheel->GetSchedulerInserts();
+        timer_ops[4] += wheel->GetSchedulerCancels();
     }
-    double rtt_99 = rtt_pq.top();
-    for (; i < median; i++)
+    std::cout << "TCP timers (" << (timer_wheel ? "wheel" : "events") << "): " << timer_ops[0] << " armed, "
+              << timer_ops[1] << " cancelled, " << timer_ops[2] << " expired; scheduler: " << timer_ops[3]
+              << " inserts, " << timer_ops[4] << " cancels" << std::endl;
+    Simulator::Destroy();
+    if (redir_output)
     {
-        totalrtt += rtt_pq.top();
-        rtt_pq.pop();
+        trace_writer->Close();
     }
-    double rtt_50 = rtt_pq.top();
+    NS_LOG_INFO("Done.");
 
-    for (; i < len; i++)
+    // aggregate = merge of the per-flow sketches
+    Ptr<QuantileSketch> all_rtt = CreateObject<QuantileSketch>();
+    all_rtt->Merge(rtt_sketch);
+    for (uint32_t i = 0; i < flow_rtt.size(); i++)
     {
-        totalrtt += rtt_pq.top();
-        rtt_pq.pop();
+        PrintRttQuantiles("Flow " + std::to_string(i + 1), flow_rtt[i]);
+        all_rtt->Merge(flow_rtt[i]);
     }
-    std::cout << "99-percentile RTT: " << rtt_99 << " μs" << std::endl;
-    std::cout << "Median RTT: " << rtt_50 << " μs" << std::endl;
-    std::cout << "Average RTT: " << totalrtt / len << " μs" << std::endl;
+    PrintRttQuantiles("All flows", all_rtt);
+    std::cout << "99-percentile RTT: " << all_rtt->GetQuantile(0.99) << " μs" << std::endl;
+    std::cout << "Median RTT: " << all_rtt->GetQuantile(0.5) << " μs" << std::endl;
+    std::cout << "Average RTT: " << all_rtt->GetMean() << " μs" << std::endl;
     std::cout << "AVG queue occupancy: " << queue_stat / queue_stat_num << " pkts" << std::endl;
     double avg_throughput = DynamicCast<PacketSink>(appSink.Get(0))->GetTotalRx() * 8.0 / (end_t - start_t) / 1000000;
     std::cout << "AVG Throughput: " << avg_throughput << "Mbps" << std::endl;